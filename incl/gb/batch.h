@@ -0,0 +1,78 @@
+#ifndef GB_BATCH_H
+#define GB_BATCH_H
+#include <stddef.h>
+#include <stdint.h>
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/batch.h
+// Runs many independent emulation sessions in one process, without
+// video or host input, spread over a pool of worker threads.
+//
+// Sessions are dealt out to the workers' deques in contiguous runs.
+// Each worker runs the sessions at the back of its own deque, one at a
+// time, frame by frame, to completion. Once its deque is empty, it
+// steals the session at the front of another worker's deque, and once
+// every deque is empty, it exits, as every unfinished session is then
+// already being run.
+//
+// A session's core and PPU are allocated and initialized by the worker
+// that runs it, so that their pages are first touched (and so, under a
+// first-touch NUMA policy, placed) near that worker, and are freed as
+// soon as the session finishes.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct gb_batch_session
+// One ROM to run for a number of frames. Set `rom_filepath` and
+// `frames` before gb_batch_run(), which fills in the rest once the
+// session finishes.
+//-----------------------------------------------------------------------
+// Members:
+// * rom_filepath: ROM to run. Sessions may share a ROM, but a ROM with
+//   battery-backed RAM would then have them share its save file.
+// * frames: Number of frames to run.
+// * hash_log_path: Where to log a hash of each frame (see
+//   gb/ppu/hashlog.h), or NULL not to.
+// * frames_done: Number of frames run.
+// * cycles: Number of cycles emulated.
+// * failed: Set if the session could not be initialized, or one of its
+//   frames could not be drawn, in which case it stopped early.
+//=======================================================================
+// def struct gb_batch_session
+struct gb_batch_session {
+	const char* rom_filepath;
+	uint64_t frames;
+	const char* hash_log_path;
+	uint64_t frames_done;
+	uint64_t cycles;
+	uint8_t failed;
+}; // end struct gb_batch_session
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_batch_run()
+// Runs all `count` sessions to completion on up to `threads` worker
+// threads, the calling thread being one of them.
+// Returns nonzero if the workers could not be set up, in which case no
+// session was run.
+//=======================================================================
+uint8_t
+gb_batch_run(
+		struct gb_batch_session* restrict sessions,
+		size_t count,
+		unsigned threads);
+
+#endif // GB_BATCH_H
@@ -10,6 +10,7 @@
 //-------------------------------------------------------------------------
 //=========================================================================
 struct gb_core;
+struct gb_ppu_buf;
 
 //=========================================================================
 //-------------------------------------------------------------------------
@@ -18,8 +19,19 @@ struct gb_core;
 //=========================================================================
 uint8_t
 gb_core_init(struct gb_core* restrict core);
+uint8_t
+gb_core_init_rom(struct gb_core* restrict core, const char* restrict rom_filepath);
+void
+gb_core_destroy(struct gb_core* restrict core);
 void
 gb_core_run(struct gb_core* restrict core, struct gb_ppu* restrict ppu);
+// Like gb_core_run(), but emulates on a new thread, which hands frames
+// off through `buf` to the calling thread, which draws and presents
+// them and polls host input (see gb/ppu/buf.h).
+void
+gb_core_run_pipelined(
+		struct gb_core* restrict core,
+		struct gb_ppu_buf* restrict buf);
 void
 gb_core_set_pad(struct gb_core* restrict core, uint8_t gb_pad);
 
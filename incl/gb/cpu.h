@@ -3,6 +3,8 @@
 #include <stdalign.h>
 #include <stdint.h>
 #include "gb/core.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/jit.h"
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -35,20 +37,57 @@
 // * CPUSTATE_STOPPED
 //   Indicates that the last instruction run was STOP.
 //   TODO: Describe STOP mode. Don't forget to explain speed-switching.
+// * CPUSTATE_EI_PENDING
+//   Indicates that the last instruction run was EI, and IME must be set
+//   once the following instruction has run.
+//   Handled internally by the interpreter; never seen by its caller.
 //=======================================================================
 enum gb_cpu_state {
 	CPUSTATE_RUNNING     = 0x00,
 	CPUSTATE_INTERRUPTED = 0x01,
 	CPUSTATE_HALTED      = 0x02,
 	CPUSTATE_STOPPED     = 0x04,
-	CPUSTATE_TIMEDOUT    = 0x08
+	CPUSTATE_TIMEDOUT    = 0x08,
+	CPUSTATE_EI_PENDING  = 0x10
 }; // end enum gb_cpu_state
 
+#ifdef GB_CPU_LAZY_FLAGS
+//=======================================================================
+// doc enum gb_cpu_lazy_op
+// Operations whose flags may be evaluated lazily.
+// ADC and SBC are recorded as LAZY_ADD and LAZY_SUB with their carry,
+// CP as LAZY_SUB, and XOR as LAZY_OR.
+//=======================================================================
+enum gb_cpu_lazy_op {
+	LAZY_NONE = 0,
+	LAZY_ADD,
+	LAZY_SUB,
+	LAZY_AND,
+	LAZY_OR
+}; // end enum gb_cpu_lazy_op
+#endif
+
 //=======================================================================
 //-----------------------------------------------------------------------
 // External type definitions
 //-----------------------------------------------------------------------
 //=======================================================================
+#ifdef GB_CPU_LAZY_FLAGS
+//=======================================================================
+// doc struct gb_cpu_lazy_flags
+// The last operation which set flags, if they have not been computed.
+// While `op != LAZY_NONE`, the flag members of `struct gb_cpu` are
+// stale. For AND and OR, `lhs` holds the result.
+//=======================================================================
+// def struct gb_cpu_lazy_flags
+struct gb_cpu_lazy_flags {
+	uint8_t op;
+	uint8_t lhs;
+	uint8_t rhs;
+	uint8_t carry;
+}; // end struct gb_cpu_lazy_flags
+#endif
+
 // TODO: Move CPU documentation here from gb/core.h.
 struct gb_cpu {
 	alignas(uint16_t) uint8_t r[8];
@@ -59,6 +98,17 @@ struct gb_cpu {
 	uint8_t fh;
 	uint8_t fc;
 	uint8_t state;
+#ifdef GB_CPU_LAZY_FLAGS
+	struct gb_cpu_lazy_flags lazy;
+#endif
+#ifdef GB_CPU_COUNT_INSTRUCTIONS
+	// Number of instructions executed. Benchmarking builds only.
+	uint64_t instructions;
+#endif
+	struct gb_cpu_bcache bcache;
+#ifdef GB_CPU_JIT
+	struct gb_cpu_jit jit;
+#endif
 };
 
 //=======================================================================
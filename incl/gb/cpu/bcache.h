@@ -0,0 +1,148 @@
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/cpu/bcache.h
+// Pre-decoded basic block cache for the CPU interpreter.
+//
+// Code is decoded once into blocks of micro-ops (opcode plus resolved
+// immediate operand), which the interpreter executes without refetching
+// instruction bytes from memory. A block ends at the first instruction
+// which may transfer control (jumps, calls, returns, RST, HALT, STOP),
+// or once it reaches GB_CPU_BLOCK_MAX_UOPS micro-ops.
+//
+// Blocks are keyed by (bank, PC):
+// * ROM blocks (0x0000-0x7FFF) are tagged with the ROM bank mapped at
+//   their address when they were decoded, so switching banks simply
+//   causes blocks of the old bank to miss.
+// * Blocks anywhere else are tagged with bank 0.
+// * WRAM (0xC000-0xDFFF) and HRAM (0xFF80-0xFFFE) blocks are "watched":
+//   each 16-byte granule counts the blocks covering it, and a write to a
+//   granule with any invalidates those blocks which contain the byte
+//   written. Data sharing a granule with code (such as HRAM variables
+//   beside an OAM DMA routine) thus leaves the code cached.
+// Code anywhere else (VRAM, SRAM, echo RAM, OAM, I/O) is decoded one
+// instruction at a time and never cached.
+//-----------------------------------------------------------------------
+//=======================================================================
+#ifndef GB_CPU_BCACHE_H
+#define GB_CPU_BCACHE_H
+#include <stdint.h>
+#include "gb/core.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External constant definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+enum {
+	// Number of block slots. Must be a power of 2.
+	GB_CPU_BCACHE_SLOTS = 1024,
+	// Maximum number of micro-ops per block.
+	GB_CPU_BLOCK_MAX_UOPS = 16,
+	// Maximum number of bytes per block (3 per instruction).
+	GB_CPU_BLOCK_MAX_BYTES = 3 * GB_CPU_BLOCK_MAX_UOPS,
+	// Size of a write-watch granule, as a power of 2.
+	GB_CPU_BCACHE_GRANULE_BITS = 4,
+	// Value of `pc` for micro-ops that the interpreter must never
+	// execute (block terminators and invalidated blocks).
+	GB_CPU_UOP_NO_PC = UINT32_MAX
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External type definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct gb_cpu_uop
+// A single pre-decoded instruction.
+//-----------------------------------------------------------------------
+// Members:
+// * pc: Address of the instruction. Wider than 16 bits so that
+//   GB_CPU_UOP_NO_PC never matches a real PC.
+// * imm: The instruction's immediate operand, if any (little-endian
+//   for 16-bit operands). For CB-prefixed instructions, the CB opcode.
+// * opcode: The instruction's (first) opcode byte.
+//=======================================================================
+// def struct gb_cpu_uop
+struct gb_cpu_uop {
+	uint32_t pc;
+	uint16_t imm;
+	uint8_t opcode;
+}; // end struct gb_cpu_uop
+
+//=======================================================================
+// doc struct gb_cpu_block
+// A run of consecutive pre-decoded instructions.
+// `uop[len]` is always a terminator with `pc == GB_CPU_UOP_NO_PC`.
+//=======================================================================
+// def struct gb_cpu_block
+struct gb_cpu_block {
+	uint16_t pc;
+	uint16_t end; // Address following the last byte of the block.
+	uint16_t bank;
+	uint8_t len;
+	uint8_t valid;
+	struct gb_cpu_uop uop[GB_CPU_BLOCK_MAX_UOPS + 1];
+}; // end struct gb_cpu_block
+
+//=======================================================================
+// doc struct gb_cpu_bcache
+// Members:
+// * blocks: Direct-mapped block slots, indexed by a hash of block PC.
+// * current: The block most recently returned by gb_cpu_bcache_fetch().
+// * scratch: Holds an uncacheable instruction, decoded on demand.
+// * watch: Per-granule counts of the valid blocks covering each
+//   granule of WRAM/HRAM. Kept up to date as blocks are built, evicted,
+//   and invalidated.
+// * rom_bank: The ROM banks currently mapped at 0x0000-0x3FFF and
+//   0x4000-0x7FFF.
+//=======================================================================
+// def struct gb_cpu_bcache
+struct gb_cpu_bcache {
+	struct gb_cpu_block blocks[GB_CPU_BCACHE_SLOTS];
+	struct gb_cpu_block* current;
+	struct gb_cpu_uop scratch[2];
+	uint8_t watch[0x10000 >> GB_CPU_BCACHE_GRANULE_BITS];
+	uint16_t rom_bank[2];
+}; // end struct gb_cpu_bcache
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+void
+gb_cpu_bcache_init(struct gb_core* restrict core);
+
+//=======================================================================
+// doc gb_cpu_bcache_fetch()
+// Returns the micro-op for the instruction at the CPU's current PC.
+// Subsequent instructions of the same block follow it in memory, up to
+// a terminator with `pc == GB_CPU_UOP_NO_PC`.
+// The returned pointer remains valid until the next call.
+//=======================================================================
+const struct gb_cpu_uop*
+gb_cpu_bcache_fetch(struct gb_core* restrict core);
+
+//=======================================================================
+// doc gb_cpu_bcache_on_rom_bank()
+// Must be called whenever the ROM banks mapped at 0x0000-0x3FFF
+// (`bank0`) or 0x4000-0x7FFF (`bank`) may have changed.
+//=======================================================================
+void
+gb_cpu_bcache_on_rom_bank(
+		struct gb_core* restrict core,
+		uint16_t bank0,
+		uint16_t bank);
+
+//=======================================================================
+// doc gb_cpu_bcache_on_code_write()
+// Invalidates every block containing `addr`.
+// Memory writes must call this when the watch count of the granule
+// containing `addr` is nonzero.
+//=======================================================================
+void
+gb_cpu_bcache_on_code_write(struct gb_core* restrict core, uint16_t addr);
+
+#endif // GB_CPU_BCACHE_H
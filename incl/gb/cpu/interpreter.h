@@ -9,5 +9,14 @@
 void
 gb_cpu_interpret_frame(struct gb_core* restrict core);
 
+//=======================================================================
+// doc gb_cpu_sync_flags()
+// Brings the flag members of `core`'s CPU up to date, computing any
+// flags whose evaluation is still pending (see GB_CPU_LAZY_FLAGS).
+// Must be called before reading the flags from outside the interpreter.
+//=======================================================================
+void
+gb_cpu_sync_flags(struct gb_core* restrict core);
+
 #endif // GB_CPU_INTERPRETER_H
 
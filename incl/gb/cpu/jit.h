@@ -0,0 +1,243 @@
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/cpu/jit.h
+// Optional x86-64 translator for hot blocks of the block cache
+// (see gb/cpu/bcache.h). Enabled by defining GB_CPU_JIT.
+//
+// A block of ROM code which has been entered GB_CPU_JIT_THRESHOLD times
+// is translated into native code, from its first instruction up to the
+// first instruction which the translator does not handle (HALT, STOP,
+// EI/DI, RETI, DAA, and a few others). Only ROM is translated, so native
+// code never has to deal with self-modifying code.
+//
+// Before each instruction, native code checks that the scheduler's
+// budget outlasts it, and otherwise leaves for the interpreter to run
+// that instruction and enter the scheduler. No event thus falls due
+// within native code, so it reads memory (I/O registers included)
+// straight through the page tables (see `rpage` in struct gb_mem):
+// nothing which a read could observe changes while it runs.
+//
+// A block which jumps back to its own start (a wait or copy loop) keeps
+// looping in native code for as long as the budget allows.
+//
+// Writes are made through gb_cpu_jit_write8() and gb_cpu_jit_write16(),
+// and only to memory whose writes have no side effects beyond the store
+// (see gb_mem_is_plain_write()). A write anywhere else (I/O, MBC, SRAM)
+// leaves the native code before its instruction, which the interpreter
+// then runs; so does an instruction whose address is known to be such
+// when translating.
+//
+// The code buffer is never writable and executable at once: it is
+// mapped read/write while code is emitted into it, and read/execute
+// while it runs.
+//
+// Translations are tagged with the ROM bank of their block, so bank
+// switches simply cause translations of the old bank to miss.
+//
+// Defining GB_CPU_JIT_VERIFY as well runs each translation and then
+// the interpreter over the same instructions, aborting if the resulting
+// CPU state differs.
+//-----------------------------------------------------------------------
+//=======================================================================
+#ifndef GB_CPU_JIT_H
+#define GB_CPU_JIT_H
+#if defined(GB_CPU_JIT_VERIFY) && !defined(GB_CPU_JIT)
+#error "GB_CPU_JIT_VERIFY requires GB_CPU_JIT to be defined."
+#endif
+#ifdef GB_CPU_JIT
+#if !defined(__x86_64__)
+#error "GB_CPU_JIT requires an x86-64 host."
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/core.h"
+#include "gb/cpu/bcache.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External constant definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+enum {
+	// Number of times a block is entered before it is translated.
+	GB_CPU_JIT_THRESHOLD = 16,
+	// Size of the native code buffer of each core, in bytes.
+	GB_CPU_JIT_CODE_SIZE = 256 * 1024,
+	// Upper bound on the native code size of any single block.
+	GB_CPU_JIT_BLOCK_MAX_CODE = 2048,
+	// Upper bound on the writes logged while native code runs
+	// (GB_CPU_JIT_VERIFY only). A looping block leaves before its next
+	// pass could exceed it.
+	GB_CPU_JIT_MAX_WRITES = 16 * 2 * GB_CPU_BLOCK_MAX_UOPS
+};
+
+//=======================================================================
+// doc enum gb_cpu_jit_status
+// Enumerations:
+// * JIT_COLD: Not yet translated.
+// * JIT_NATIVE: Translated; `fn` is valid.
+// * JIT_REJECTED: Not worth translating (too few leading instructions
+//   are supported). Stays rejected until the slot is reused.
+//=======================================================================
+enum gb_cpu_jit_status {
+	JIT_COLD = 0,
+	JIT_NATIVE,
+	JIT_REJECTED
+}; // end enum gb_cpu_jit_status
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External type definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc gb_cpu_jit_fn
+// Native code of a block. Updates registers, flags, PC, and memory of
+// `core`, and subtracts the cycles taken from the scheduler's budget.
+// Returns the number of instructions run in the last pass through the
+// block, which is less than the entry's `len` if it left before a write
+// it could not make or an instruction the budget does not cover.
+// Earlier passes of a looping block are counted in `looped` of struct
+// gb_cpu_jit.
+//=======================================================================
+typedef uint8_t (*gb_cpu_jit_fn)(struct gb_core* core);
+
+//=======================================================================
+// doc struct gb_cpu_jit_entry
+// Translation of the block occupying the same slot of the block cache.
+//-----------------------------------------------------------------------
+// Members:
+// * fn: Native code, valid only if `status == JIT_NATIVE`.
+// * pc, bank: The block which the entry describes.
+// * heat: Number of times the block has been entered while cold.
+// * len: Number of instructions the native code executes, unless it
+//   leaves early (see gb_cpu_jit_fn).
+// * cycles: Cycles taken by the first instruction. Native code is not
+//   entered unless the budget outlasts it.
+// * status: See `enum gb_cpu_jit_status`.
+// * tagged: Nonzero if `pc` and `bank` are meaningful.
+//=======================================================================
+// def struct gb_cpu_jit_entry
+struct gb_cpu_jit_entry {
+	gb_cpu_jit_fn fn;
+	uint16_t pc;
+	uint16_t bank;
+	uint8_t heat;
+	uint8_t len;
+	uint8_t cycles;
+	uint8_t status;
+	uint8_t tagged;
+}; // end struct gb_cpu_jit_entry
+
+//=======================================================================
+// doc struct gb_cpu_jit_regs
+// The CPU state compared by GB_CPU_JIT_VERIFY builds.
+//=======================================================================
+// def struct gb_cpu_jit_regs
+struct gb_cpu_jit_regs {
+	uint8_t r[8];
+	uint16_t sp;
+	uint16_t pc;
+	uint8_t fz;
+	uint8_t fn;
+	uint8_t fh;
+	uint8_t fc;
+	int32_t budget;
+}; // end struct gb_cpu_jit_regs
+
+//=======================================================================
+// doc struct gb_cpu_jit_write
+// A write made by native code (GB_CPU_JIT_VERIFY only): the value at
+// `addr` before it, and the value written.
+//=======================================================================
+// def struct gb_cpu_jit_write
+struct gb_cpu_jit_write {
+	uint16_t addr;
+	uint8_t before;
+	uint8_t after;
+}; // end struct gb_cpu_jit_write
+
+//=======================================================================
+// doc struct gb_cpu_jit
+// Members:
+// * entry: Translations, indexed by block cache slot.
+// * code: Native code buffer. Mapped on first use.
+// * used: Number of bytes of `code` in use.
+// * writable: Nonzero while `code` is mapped read/write rather than
+//   read/execute.
+// * looped: Instructions run in passes through a looping block before
+//   the last one, since native code was last entered.
+// * verify_remaining: Instructions until the interpreter has caught up
+//   with `expect` (GB_CPU_JIT_VERIFY only).
+// * expect: State computed by native code (GB_CPU_JIT_VERIFY only).
+// * verify_pc: Address of the block being verified (GB_CPU_JIT_VERIFY
+//   only).
+// * writes, write_count: Writes made by native code, undone before the
+//   interpreter runs the same instructions (GB_CPU_JIT_VERIFY only).
+//=======================================================================
+// def struct gb_cpu_jit
+struct gb_cpu_jit {
+	struct gb_cpu_jit_entry entry[GB_CPU_BCACHE_SLOTS];
+	uint8_t* code;
+	size_t used;
+	uint8_t writable;
+	uint32_t looped;
+#ifdef GB_CPU_JIT_VERIFY
+	uint32_t verify_remaining;
+	struct gb_cpu_jit_regs expect;
+	uint16_t verify_pc;
+	struct gb_cpu_jit_write writes[GB_CPU_JIT_MAX_WRITES];
+	uint16_t write_count;
+#endif
+}; // end struct gb_cpu_jit
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+void
+gb_cpu_jit_init(struct gb_core* restrict core);
+// Unmaps the native code buffer.
+void
+gb_cpu_jit_destroy(struct gb_core* restrict core);
+
+//=======================================================================
+// doc gb_cpu_jit_fetch()
+// Replacement for gb_cpu_bcache_fetch(). Runs native code for as long
+// as the CPU is in a translated block, then returns the micro-op of
+// the next instruction to interpret.
+//=======================================================================
+const struct gb_cpu_uop*
+gb_cpu_jit_fetch(struct gb_core* restrict core);
+
+//=======================================================================
+// doc gb_cpu_jit_write8()
+// Called by native code to write `value` to `addr`.
+// Returns nonzero if written, or 0 if the write is not plain (see
+// gb_mem_is_plain_write()), in which case nothing is written.
+//=======================================================================
+uint8_t
+gb_cpu_jit_write8(struct gb_core* core, uint16_t addr, uint8_t value);
+
+//=======================================================================
+// doc gb_cpu_jit_write16()
+// Like gb_cpu_jit_write8(), for `value` written little-endian to `addr`
+// and `addr + 1`. Neither byte is written unless both writes are plain.
+//=======================================================================
+uint8_t
+gb_cpu_jit_write16(struct gb_core* core, uint16_t addr, uint16_t value);
+
+#ifdef GB_CPU_JIT_VERIFY
+//=======================================================================
+// doc gb_cpu_jit_verify()
+// Compares CPU state against the state computed by native code, which
+// the interpreter has just caught up with. Aborts on any difference.
+//=======================================================================
+void
+gb_cpu_jit_verify(struct gb_core* restrict core);
+#endif
+
+#endif // GB_CPU_JIT
+#endif // GB_CPU_JIT_H
@@ -0,0 +1,37 @@
+#ifndef GB_CPU_JIT_X64_H
+#define GB_CPU_JIT_X64_H
+#ifdef GB_CPU_JIT
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/cpu/bcache.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc gb_cpu_jit_x64_translate()
+// Translates the leading supported instructions of `block` into a
+// native function (see gb_cpu_jit_fn).
+//-----------------------------------------------------------------------
+// Parameters:
+// * dst: Destination of the native code. Must have room for at least
+//   GB_CPU_JIT_BLOCK_MAX_CODE bytes.
+// * size: Receives the number of bytes written to `dst`.
+// * cycles: Receives the number of cycles the first instruction takes.
+// * block: The block to translate.
+//-----------------------------------------------------------------------
+// Returns: The number of instructions translated. Nothing is written
+// to `dst` if this is 0.
+//=======================================================================
+uint8_t
+gb_cpu_jit_x64_translate(
+		uint8_t* restrict dst,
+		size_t* restrict size,
+		uint8_t* restrict cycles,
+		const struct gb_cpu_block* restrict block);
+
+#endif // GB_CPU_JIT
+#endif // GB_CPU_JIT_X64_H
@@ -29,11 +29,14 @@ gb_opc_components_at(
 		struct gb_opc_components* restrict dst,
 		const struct gb_core* restrict core,
 		uint16_t offset);
+// Disassembles `opc` into `buf`. If `core` is not NULL, the operands'
+// live values are reported too, which brings its flags up to date (see
+// gb_cpu_sync_flags()).
 size_t
 gb_opc_string(
 		char* restrict buf, size_t bufsz,
 		const struct gb_opc_components* restrict opc,
-		const struct gb_core* restrict core);
+		struct gb_core* restrict core);
 
 #endif // GB_CPU_OPC_H
 
@@ -0,0 +1,25 @@
+#ifndef GB_HASH_H
+#define GB_HASH_H
+#include <stddef.h>
+#include <stdint.h>
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/hash.h
+// Fast non-cryptographic hashing, for telling whether buffers differ
+// without keeping them around.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_hash64()
+// Returns the 64-bit XXH64 hash of `len` bytes at `data`, with `seed`.
+// Hashes are the same on every host, and match other XXH64
+// implementations.
+// Input is consumed 32 bytes at a time through four independent lanes,
+// which keeps several multipliers busy at once.
+//=======================================================================
+uint64_t
+gb_hash64(const void* restrict data, size_t len, uint64_t seed);
+
+#endif // GB_HASH_H
@@ -36,6 +36,12 @@ extern const char* gb_mem_rom_filepath;
 //=======================================================================
 uint8_t
 gb_mem_init(struct gb_core* restrict core);
+// Like gb_mem_init(), but loads `rom_filepath` rather than
+// `gb_mem_rom_filepath`, so that cores may be initialized concurrently.
+uint8_t
+gb_mem_init_rom(struct gb_core* restrict core, const char* restrict rom_filepath);
+void
+gb_mem_destroy(struct gb_core* restrict core);
 uint8_t
 gb_mem_direct_read(const struct gb_core* restrict core, uint16_t addr);
 uint8_t
@@ -61,10 +67,26 @@ gb_mem_u16write(
 		struct gb_core* restrict core,
 		uint16_t addr,
 		uint16_t value);
+// Returns nonzero if writing `addr` does nothing but store to memory
+// (VRAM, RAM, echo RAM, OAM, or HRAM), with no effect on I/O, the pak,
+// or the scheduler, so that it may be made out of step with the
+// scheduler (see gb/cpu/jit.h).
+uint8_t
+gb_mem_is_plain_write(const struct gb_core* restrict core, uint16_t addr);
+// Hands PPU state to `dst` as a snapshot, which stays valid while
+// emulation continues. Only the granules of VRAM and OAM written since
+// `dst` was last handed state are copied into `dst->buffer`.
 void
 gb_mem_copy_ppu_state(
 		struct gb_core* restrict core,
 		struct gb_ppu_state* restrict dst);
+// Hands PPU state to `dst` without copying VRAM or OAM, by pointing it
+// at the core's memory. Only valid until emulation continues, so for
+// drawing on the emulation thread.
+void
+gb_mem_view_ppu_state(
+		struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst);
 void
 gb_mem_set_pad(struct gb_core* restrict core, uint8_t gb_pad);
 
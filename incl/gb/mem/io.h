@@ -224,6 +224,14 @@ gb_mem_io_increment_div(struct gb_core* restrict core);
 void
 gb_mem_io_increment_tima(struct gb_core* restrict core);
 void
+gb_mem_io_skip_div(struct gb_core* restrict core, uint64_t increments);
+void
+gb_mem_io_skip_tima(struct gb_core* restrict core, uint64_t increments);
+void
+gb_mem_io_skip_lines(struct gb_core* restrict core, uint8_t lines);
+void
+gb_mem_io_capture_line(struct gb_core* restrict core, uint8_t line);
+void
 gb_mem_io_on_ifie_write(struct gb_core* restrict core);
 void
 gb_mem_io_update_joyp(struct gb_core* restrict core, uint8_t gb_pad);
@@ -1,14 +1,66 @@
 #ifndef GB_MEM_TYPEDEF_H
 #define GB_MEM_TYPEDEF_H
+#include <stdint.h>
+#include "gb/mem/region.h"
+#include "gb/ppu/shared.h"
+#include "gb/ppu/state.h"
+
+enum {
+	// Size of a VRAM/OAM write-tracking granule, as a power of 2.
+	// 16 bytes: one tile of tile data, half a row of a tile map, or four
+	// OAM entries.
+	GB_MEM_PPU_GRANULE_BITS = 4,
+	// Granules of VRAM, followed by those of OAM.
+	GB_MEM_PPU_VRAM_GRANULES = MEM_SZ_VRAM >> GB_MEM_PPU_GRANULE_BITS,
+	GB_MEM_PPU_GRANULES =
+		GB_MEM_PPU_VRAM_GRANULES + (MEM_SZ_OAM >> GB_MEM_PPU_GRANULE_BITS),
+	GB_MEM_PPU_DIRTY_WORDS = (GB_MEM_PPU_GRANULES + 63) / 64,
+	// Number of PPU state hand-offs for which dirty granules are kept.
+	// A snapshot last updated longer ago than that is copied in full.
+	GB_MEM_PPU_DIRTY_HISTORY = 4,
+};
 
 //=======================================================================
 // doc struct gb_mem
 // TODO: document
+//-----------------------------------------------------------------------
+// Members:
+// * rpage, wpage: Host memory backing each 256-byte page of the address
+//   space (indexed by `addr >> 8`) for reads and writes respectively.
+//   NULL if accesses to the page must take the slow path: unbacked
+//   reads return $FF, unbacked writes go to the register/MBC handlers.
+// * ppu_dirty: Per-granule flags of VRAM and OAM, set when a granule is
+//   written, for each of the last GB_MEM_PPU_DIRTY_HISTORY epochs.
+//   Row `e % GB_MEM_PPU_DIRTY_HISTORY` holds the writes of epoch `e`.
+// * ppu_epoch: Current epoch. Each hand-off of PPU state (see
+//   gb_mem_copy_ppu_state() and gb_mem_view_ppu_state()) ends one, and
+//   starts the next.
+// * ppu_lines: Registers of each visible line, indexed by LY, captured
+//   as the line enters mode 3 (see gb_mem_io_capture_line()). Lines keep
+//   their registers from the last frame until they are drawn again.
+// * ppu_palettes: The DMG palette registers, kept in step with `map`
+//   (see write_palette()).
+// * ppu_lines_changed: Set when a line is captured with registers other
+//   than those it had, and cleared by each hand-off.
+// * ppu_lcdc: LCDC as of the last hand-off.
+// * ppu_frames: Vertical blanks begun.
+// * ppu_generation: Bumped by each hand-off of PPU state which differs
+//   from the one before it: in VRAM, OAM, line registers, or LCDC.
 //=======================================================================
 // def struct gb_mem
 struct gb_mem {
 	struct gb_pak* pak;
+	const uint8_t* rpage[0x100];
+	uint8_t* wpage[0x100];
 	uint8_t map[0x10000]; // 64 KiB
+	uint64_t ppu_dirty[GB_MEM_PPU_DIRTY_HISTORY][GB_MEM_PPU_DIRTY_WORDS];
+	uint64_t ppu_epoch;
+	struct gb_ppu_line ppu_lines[PPU_SCR_HEIGHT];
+	struct gb_ppu_palettes ppu_palettes;
+	uint64_t ppu_frames;
+	uint64_t ppu_generation;
+	uint8_t ppu_lines_changed;
+	uint8_t ppu_lcdc;
 	uint8_t stat_int;
 	uint8_t ime;
 	uint8_t pad;
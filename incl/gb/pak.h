@@ -12,6 +12,7 @@
 // TODO: external-usage documentation
 //=======================================================================
 struct gb_pak;
+struct gb_mem;
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -26,6 +27,15 @@ struct gb_pak;
 struct gb_pak*
 gb_pak_create(const char* restrict pak_id);
 
+//=======================================================================
+// decl gb_pak_insert()
+// Maps the pak's ROM and RAM into `mem`, as they are after power-on,
+// and makes `mem` pass MBC register and RAM writes to the pak.
+// Returns nonzero if the pak's MBC is not supported.
+//=======================================================================
+int
+gb_pak_insert(struct gb_pak* restrict pak, struct gb_mem* restrict mem);
+
 //=======================================================================
 // decl gb_pak_delete()
 // TODO: document
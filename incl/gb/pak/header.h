@@ -21,7 +21,7 @@ struct pakhdr_alloc_info {
 	// Decoded meaning behind raw alloc bytes:
 	uint8_t mbc_id;
 	unsigned int battery : 1;
-	uint8_t rom_bank_count;
+	uint16_t rom_bank_count;
 	uint8_t ram_bank_count;
 	// Raw sizes of ROM and RAM in bytes, rather than banks:
 	size_t rom_size;
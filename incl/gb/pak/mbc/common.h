@@ -6,7 +6,7 @@
 
 //=======================================================================
 // decl mbc_sram_write()
-// TODO: documentation
+// Writes to the selected bank of the pak's RAM, if it is enabled.
 //=======================================================================
 void
 mbc_sram_write(
@@ -14,5 +14,26 @@ mbc_sram_write(
 		struct gb_pak* restrict pak,
 		uint16_t addr, uint8_t val);
 
-#endif // GB_PAK_MBC_COMMON_H
+//=======================================================================
+// decl mbc_map_rom()
+// Points the ROM pages of `mem` at banks `bank0` (0x0000-0x3FFF) and
+// `bank` (0x4000-0x7FFF) of the pak's ROM. Bank numbers beyond the
+// size of the ROM wrap around, as the unconnected bank lines would.
+//=======================================================================
+void
+mbc_map_rom(
+		struct gb_mem* restrict mem,
+		const struct gb_pak* restrict pak,
+		uint16_t bank0, uint16_t bank);
 
+//=======================================================================
+// decl mbc_map_ram()
+// Points the SRAM pages of `mem` at the selected bank of the pak's RAM,
+// or unmaps them if RAM is disabled or the bank does not exist.
+//=======================================================================
+void
+mbc_map_ram(
+		struct gb_mem* restrict mem,
+		const struct gb_pak* restrict pak);
+
+#endif // GB_PAK_MBC_COMMON_H
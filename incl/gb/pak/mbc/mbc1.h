@@ -0,0 +1,27 @@
+#ifndef GB_PAK_MBC_MBC1_H
+#define GB_PAK_MBC_MBC1_H
+#include <stdint.h>
+#include "gb/mem.h"
+#include "gb/pak.h"
+
+//=======================================================================
+// decl mbc_write8_rom_mbc1()
+// Writes to an MBC1 register, remapping ROM and RAM banks as needed.
+//=======================================================================
+void
+mbc_write8_rom_mbc1(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val);
+
+//=======================================================================
+// decl mbc_write8_ram_mbc1()
+// Writes to the selected RAM bank, if RAM is enabled.
+//=======================================================================
+void
+mbc_write8_ram_mbc1(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val);
+
+#endif // GB_PAK_MBC_MBC1_H
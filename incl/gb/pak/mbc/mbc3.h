@@ -0,0 +1,28 @@
+#ifndef GB_PAK_MBC_MBC3_H
+#define GB_PAK_MBC_MBC3_H
+#include <stdint.h>
+#include "gb/mem.h"
+#include "gb/pak.h"
+
+//=======================================================================
+// decl mbc_write8_rom_mbc3()
+// Writes to an MBC3 register, remapping ROM and RAM banks as needed.
+//=======================================================================
+void
+mbc_write8_rom_mbc3(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val);
+
+//=======================================================================
+// decl mbc_write8_ram_mbc3()
+// Writes to the selected RAM bank, if RAM is enabled. Writes to the
+// clock registers are ignored, as the RTC is not emulated.
+//=======================================================================
+void
+mbc_write8_ram_mbc3(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val);
+
+#endif // GB_PAK_MBC_MBC3_H
@@ -0,0 +1,106 @@
+#ifndef GB_PAK_SAV_H
+#define GB_PAK_SAV_H
+#include <assert.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+#include "gb/pak/const.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/pak/sav.h
+// Battery-backed pak RAM, kept in a shared mapping of its save file.
+//
+// Writes to the mapping reach the page cache immediately, so a crash of
+// the emulator loses nothing. To also survive a crash of the host, a
+// background thread msync()s pages marked dirty by paksav_mark(), once
+// writes to them have settled for PAKSAV_DEBOUNCE_MS, or at most
+// PAKSAV_FLUSH_INTERVAL_MS after they were first written, and once more
+// when the save is closed. The emulation thread never waits on it.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL CONSTANT DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+enum {
+	PAKSAV_PAGE_SIZE = 4096, // bytes per dirty bit
+	PAKSAV_DEBOUNCE_MS = 200,
+	PAKSAV_FLUSH_INTERVAL_MS = 1000,
+	// Largest RAM reported by any pak header (16 banks).
+	PAKSAV_MAX_SIZE = 16 * PAK_RAM_BANK_SIZE
+};
+static_assert(PAKSAV_MAX_SIZE / PAKSAV_PAGE_SIZE <= 32,
+		"Dirty bits of all pages must fit in `struct paksav.dirty`.");
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct paksav
+// Members:
+// * map: The save file, mapped read-write and shared.
+// * size: Size of `map`, in bytes.
+// * fd: The save file.
+// * dirty: Bit n is set if page n of `map` was written since the
+//   flusher last collected it.
+// * stop: Set by paksav_close() to make the flusher finish.
+//   Guarded by `lock`.
+// * lock, wake, flusher: Flusher thread and its wakeup signal.
+//=======================================================================
+// def struct paksav
+struct paksav {
+	uint8_t* map;
+	size_t size;
+	int fd;
+	atomic_uint_least32_t dirty;
+	uint8_t stop;
+	mtx_t lock;
+	cnd_t wake;
+	thrd_t flusher;
+}; // end struct paksav
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl paksav_open()
+// Maps the first `size` bytes of the save file at `filepath`, creating
+// or extending it with zeroes as necessary, and starts its flusher.
+// Returns NULL on failure.
+//=======================================================================
+struct paksav*
+paksav_open(const char* restrict filepath, size_t size);
+
+//=======================================================================
+// decl paksav_close()
+// Stops the flusher once it has flushed all dirty pages, then unmaps
+// and closes the save file.
+//=======================================================================
+void
+paksav_close(struct paksav* restrict sav);
+
+//=======================================================================
+// doc paksav_mark()
+// Marks the page containing byte `offset` of the save as dirty.
+// Called after writing to `sav->map`; the release makes the write
+// visible to the flusher before it sees the mark.
+//=======================================================================
+// def paksav_mark()
+static inline void
+paksav_mark(struct paksav* restrict sav, size_t offset) {
+	atomic_fetch_or_explicit(&sav->dirty,
+			(uint_least32_t)1 << (offset / PAKSAV_PAGE_SIZE),
+			memory_order_release);
+} // end paksav_mark()
+
+#endif // GB_PAK_SAV_H
@@ -10,19 +10,25 @@
 //=======================================================================
 // Assert that all MBC IDs can be uniquely-represented by uint8_t:
 static_assert(PAKMBC_COUNT < UINT8_MAX);
+struct paksav;
 struct gb_pak {
 	void* rom;
 	void* ram;
 	char* save_filepath;
-	uint16_t rom_bank_curr;
+	struct paksav* sav; // Mapped save file backing `ram`, if any
+	uint16_t rom_bank_curr; // Bank selected for 0x4000-0x7FFF (unmasked)
 	uint16_t rom_bank_count;
 	uint8_t ram_bank_curr;
 	uint8_t ram_bank_count;
 	uint8_t mbc_id;
+	uint8_t mbc1_bank2; // MBC1 only: 2-bit secondary bank register
 	// Feature flags:
 	unsigned int battery : 1;
+	unsigned int rom_mapped : 1; // `rom` is a file mapping, not part of the allocation
 	// State flags:
 	unsigned int dirty_ram : 1;
+	unsigned int ram_enabled : 1;
+	unsigned int mbc1_mode : 1; // MBC1 only: banking mode select
 }; // end struct gb_pak
 
 #endif // GB_PAK_TYPE_H
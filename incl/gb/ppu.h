@@ -1,21 +1,49 @@
 #ifndef GB_PPU_H
 #define GB_PPU_H
 #include <stdint.h>
+#include "gb/ppu/kernel.h"
 #include "gb/ppu/state.h"
-#include "gb/video/sdl.h"
+#include "gb/video.h"
+
+struct gb_ppu_hashlog;
+struct gb_ppu_pool;
 
 struct gb_ppu {
-	struct gb_video_sdl target;
+	struct gb_video* target; // Sink which frames are drawn to; not owned
+	// Workers which draw lines concurrently, or NULL to draw them all on
+	// the calling thread (the default); not owned (see gb/ppu/pool.h).
+	struct gb_ppu_pool* pool;
+	// Log which each frame drawn is hashed into, or NULL (the default);
+	// not owned (see gb/ppu/hashlog.h).
+	struct gb_ppu_hashlog* hashes;
 	struct gb_ppu_state state;
 	uint32_t dmg_colors[4];
+	// Colors of each line's palettes, resolved from `dmg_colors`, and the
+	// palette generation each line's were resolved from, or 0 if none
+	// (see gb_ppu_resolve_palettes()). Zero `line_palettes` after
+	// changing `dmg_colors`. The entries of each line past its DMG
+	// colors are kept 0, as the SIMD resolve kernels load the whole
+	// table (see gb/ppu/kernel.h).
+	uint32_t line_colors[PPU_SCR_HEIGHT][GB_PPU_DMG_COLORS];
+	uint32_t line_palettes[PPU_SCR_HEIGHT];
 };
 
 int
-gb_ppu_init(struct gb_ppu* restrict ppu);
+gb_ppu_init(struct gb_ppu* restrict ppu, struct gb_video* restrict target);
 void
 gb_ppu_destroy(struct gb_ppu* restrict ppu);
 uint8_t
 gb_dmg_draw(struct gb_ppu* restrict ppu);
+// Like gb_dmg_draw(), unless the handed-off state is of generation
+// `*shown`, in which case the target only repeats its last frame (or
+// it is drawn in full after all, if the target lost it).
+// Sets `*shown` to the generation presented.
+uint8_t
+gb_dmg_draw_changed(struct gb_ppu* restrict ppu, uint64_t* restrict shown);
+// Draws the handed-off state into `pixels` (PPU_SCR_HEIGHT rows of
+// PPU_SCR_WIDTH pixels) rather than the target sink.
+void
+gb_ppu_draw_frame(struct gb_ppu* restrict ppu, uint32_t* restrict pixels);
 
 #endif // GB_PPU_H
 
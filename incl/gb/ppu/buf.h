@@ -0,0 +1,122 @@
+#ifndef GB_PPU_BUF_H
+#define GB_PPU_BUF_H
+#include <stdatomic.h>
+#include <stdint.h>
+#include <threads.h>
+#include "gb/ppu.h"
+#include "gb/video.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/ppu/buf.h
+// Ring of PPU snapshots, through which one thread hands frames off to
+// another which draws them (see gb_core_run_pipelined()).
+//
+// Each slot is a whole PPU, with its own copy of VRAM, OAM, line
+// registers, and decoded tiles, so a frame can be drawn while later
+// ones are emulated. Slots are filled with gb_mem_copy_ppu_state(),
+// which only copies what was written since a slot was last filled, as
+// long as that was recent (see GB_MEM_PPU_DIRTY_HISTORY).
+//
+// The producer never waits: if every slot is still waiting to be drawn
+// or being drawn, it skips handing off that frame. The consumer always
+// draws the newest frame, releasing any older ones undrawn.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+enum {
+	PPU_MAX_BUFFERS = 32,
+	PPU_DEFAULT_BUFFERS = 3,
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct gb_ppu_buf
+// Members:
+// * slots, count: The PPUs which frames are handed off to. Slot
+//   `n % count` holds the `n`th frame published.
+// * published: Number of frames published.
+// * consumed: Number of frames drawn or skipped by the consumer. Slots
+//   of frames [consumed, published) belong to the consumer; the rest
+//   belong to the producer.
+// * dropped: Frames which the producer skipped, as no slot was free.
+// * closed: Set once the producer publishes no more frames.
+// * lock, ready: Where the consumer waits for frames.
+//=======================================================================
+// def struct gb_ppu_buf
+struct gb_ppu_buf {
+	struct gb_ppu* slots;
+	unsigned count;
+	atomic_uint_fast64_t published;
+	atomic_uint_fast64_t consumed;
+	atomic_uint_fast64_t dropped;
+	atomic_bool closed;
+	mtx_t lock;
+	cnd_t ready;
+}; // end struct gb_ppu_buf
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_ppu_buf_create()
+// Returns a ring of `count` slots (2 to PPU_MAX_BUFFERS), each drawing
+// to `target`, or NULL on failure.
+//=======================================================================
+struct gb_ppu_buf*
+gb_ppu_buf_create(unsigned count, struct gb_video* restrict target);
+
+//=======================================================================
+// decl gb_ppu_buf_destroy()
+//=======================================================================
+void
+gb_ppu_buf_destroy(struct gb_ppu_buf* restrict buf);
+
+//=======================================================================
+// decl gb_ppu_buf_acquire()
+// (Producer) Returns the slot to hand the next frame off to, or NULL if
+// none is free, in which case the frame should be skipped.
+//=======================================================================
+struct gb_ppu*
+gb_ppu_buf_acquire(struct gb_ppu_buf* restrict buf);
+
+//=======================================================================
+// decl gb_ppu_buf_publish()
+// (Producer) Passes the slot returned by gb_ppu_buf_acquire() to the
+// consumer.
+//=======================================================================
+void
+gb_ppu_buf_publish(struct gb_ppu_buf* restrict buf);
+
+//=======================================================================
+// decl gb_ppu_buf_close()
+// (Producer) Wakes the consumer, which receives no more frames.
+//=======================================================================
+void
+gb_ppu_buf_close(struct gb_ppu_buf* restrict buf);
+
+//=======================================================================
+// decl gb_ppu_buf_wait()
+// (Consumer) Waits for a frame to be published, and returns the slot of
+// the newest one, or NULL once the ring is closed.
+//=======================================================================
+struct gb_ppu*
+gb_ppu_buf_wait(struct gb_ppu_buf* restrict buf);
+
+//=======================================================================
+// decl gb_ppu_buf_release()
+// (Consumer) Returns the slot returned by gb_ppu_buf_wait() to the
+// producer, once it has been drawn.
+//=======================================================================
+void
+gb_ppu_buf_release(struct gb_ppu_buf* restrict buf);
+
+#endif // GB_PPU_BUF_H
@@ -0,0 +1,129 @@
+#ifndef GB_PPU_HASHLOG_H
+#define GB_PPU_HASHLOG_H
+#include <stdint.h>
+#include <stdio.h>
+#include "gb/ppu/shared.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/ppu/hashlog.h
+// Log of a hash of each frame drawn, for telling whether output changed
+// between runs without storing frames (see gb-hashdiff).
+//
+// Each frame is hashed twice (see gb/hash.h): once as drawn, and once
+// as the encoded pixels of its lines, before palettes are applied, so
+// that a palette change can be told apart from a change in what was
+// drawn.
+//
+// Logs are binary, little-endian: GB_PPU_HASHLOG_MAGIC and
+// GB_PPU_HASHLOG_VERSION (4 bytes each), then a record per frame drawn
+// of three 64-bit values: the frame's number (see `frame` in struct
+// gb_ppu_state), and its two hashes. Frames never drawn (as when
+// gb_core_run_pipelined() drops them) have no record. Frames drawn
+// while the LCD is off have both hashes 0.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+#define GB_PPU_HASHLOG_MAGIC "GBFH"
+enum {
+	GB_PPU_HASHLOG_VERSION = 1,
+	GB_PPU_HASHLOG_HEADER_SIZE = 8, // bytes
+	GB_PPU_HASHLOG_RECORD_SIZE = 24, // bytes
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def struct gb_ppu_hashlog_record
+struct gb_ppu_hashlog_record {
+	uint64_t frame;
+	uint64_t pixels; // Hash of the frame as drawn
+	uint64_t encoded; // Hash of its lines' encoded pixels
+}; // end struct gb_ppu_hashlog_record
+
+//=======================================================================
+// doc struct gb_ppu_hashlog
+// Members:
+// * file: Where records are written.
+// * last: Record of the last frame drawn, which frames repeating it
+//   (see gb_dmg_draw_changed()) are logged with.
+// * failed: Set once a write fails.
+// * encoded: Each line's encoded pixels, as gb_ppu_draw_line() encodes
+//   them, for the frame being drawn.
+//=======================================================================
+// def struct gb_ppu_hashlog
+struct gb_ppu_hashlog {
+	FILE* file;
+	struct gb_ppu_hashlog_record last;
+	uint8_t failed;
+	uint8_t encoded[PPU_SCR_HEIGHT][PPU_SCR_WIDTH];
+}; // end struct gb_ppu_hashlog
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_ppu_hashlog_open()
+// Creates the log at `path`, replacing any file there.
+// Returns nonzero on failure.
+//=======================================================================
+int
+gb_ppu_hashlog_open(struct gb_ppu_hashlog* restrict log, const char* restrict path);
+
+//=======================================================================
+// decl gb_ppu_hashlog_close()
+// Returns nonzero if any record could not be written.
+//=======================================================================
+int
+gb_ppu_hashlog_close(struct gb_ppu_hashlog* restrict log);
+
+//=======================================================================
+// decl gb_ppu_hashlog_frame()
+// Logs frame `frame`, drawn into `pixels` (PPU_SCR_HEIGHT rows of
+// PPU_SCR_WIDTH pixels), and encoded into `log->encoded`.
+//=======================================================================
+void
+gb_ppu_hashlog_frame(
+		struct gb_ppu_hashlog* restrict log,
+		uint64_t frame,
+		const uint32_t* restrict pixels);
+
+//=======================================================================
+// decl gb_ppu_hashlog_clear()
+// Logs frame `frame`, drawn with the LCD off.
+//=======================================================================
+void
+gb_ppu_hashlog_clear(struct gb_ppu_hashlog* restrict log, uint64_t frame);
+
+//=======================================================================
+// decl gb_ppu_hashlog_repeat()
+// Logs frame `frame`, identical to the last frame logged.
+//=======================================================================
+void
+gb_ppu_hashlog_repeat(struct gb_ppu_hashlog* restrict log, uint64_t frame);
+
+//=======================================================================
+// decl gb_ppu_hashlog_read_header()
+// Reads and checks the header of a log opened for reading.
+// Returns nonzero if `file` does not start with one.
+//=======================================================================
+int
+gb_ppu_hashlog_read_header(FILE* restrict file);
+
+//=======================================================================
+// decl gb_ppu_hashlog_read()
+// Reads the next record of a log into `dst`.
+// Returns 1 if one was read, 0 at the end of the log, or -1 if the log
+// ends partway through one, or cannot be read.
+//=======================================================================
+int
+gb_ppu_hashlog_read(FILE* restrict file, struct gb_ppu_hashlog_record* restrict dst);
+
+#endif // GB_PPU_HASHLOG_H
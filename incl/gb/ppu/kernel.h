@@ -0,0 +1,74 @@
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/ppu/kernel.h
+// Inner loops of line rendering, in a portable scalar version and, on
+// x86 hosts, vectorized versions for the instruction set extensions
+// the host supports. gb_ppu_kernels_init() picks the fastest version
+// of each kernel the host can run, once per process; until then (and
+// on other hosts) the scalar versions are used.
+//
+// Every version of a kernel produces exactly the same output.
+//-----------------------------------------------------------------------
+//=======================================================================
+#ifndef GB_PPU_KERNEL_H
+#define GB_PPU_KERNEL_H
+#include <stdint.h>
+#include "gb/ppu/shared.h"
+#include "gb/ppu/state.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GB_PPU_KERNELS_X86
+#endif
+
+enum {
+	// Entries in the color table of gb_ppu_resolve_dmg():
+	// OBP0 colors 0-3, OBP1 colors 0-3, BGP colors 0-3, then 4 entries
+	// of 0.
+	GB_PPU_DMG_COLORS = 16,
+};
+
+//=======================================================================
+// doc gb_ppu_decode_tile_fn
+// Decodes the 2 bits per pixel of tile data `data` into `dst`
+// (see struct gb_ppu_tile).
+//=======================================================================
+typedef void
+gb_ppu_decode_tile_fn(
+		struct gb_ppu_tile* restrict dst,
+		const uint8_t data[PPU_TILE_SIZE]);
+
+//=======================================================================
+// doc gb_ppu_resolve_dmg_fn
+// Resolves a line of encoded DMG pixels (see PPU_ENC_* in
+// gb/ppu/shared.h) to output colors through `colors`, all
+// GB_PPU_DMG_COLORS entries of which may be read.
+//=======================================================================
+typedef void
+gb_ppu_resolve_dmg_fn(
+		uint32_t dst[PPU_SCR_WIDTH],
+		const uint8_t enc[PPU_SCR_WIDTH],
+		const uint32_t colors[GB_PPU_DMG_COLORS]);
+
+// Versions in use.
+extern gb_ppu_decode_tile_fn* gb_ppu_decode_tile;
+extern gb_ppu_resolve_dmg_fn* gb_ppu_resolve_dmg;
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+void
+gb_ppu_kernels_init(void);
+
+// Individual versions, for testing and benchmarking.
+gb_ppu_decode_tile_fn gb_ppu_decode_tile_scalar;
+gb_ppu_resolve_dmg_fn gb_ppu_resolve_dmg_scalar;
+#ifdef GB_PPU_KERNELS_X86
+// Require SSE2, SSSE3, and AVX2 respectively.
+gb_ppu_decode_tile_fn gb_ppu_decode_tile_sse2;
+gb_ppu_resolve_dmg_fn gb_ppu_resolve_dmg_ssse3;
+gb_ppu_resolve_dmg_fn gb_ppu_resolve_dmg_avx2;
+#endif
+
+#endif // GB_PPU_KERNEL_H
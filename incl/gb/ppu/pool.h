@@ -0,0 +1,101 @@
+#ifndef GB_PPU_POOL_H
+#define GB_PPU_POOL_H
+#include <stdatomic.h>
+#include <stdint.h>
+#include <threads.h>
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/ppu/pool.h
+// Persistent worker threads which draw the lines of a frame
+// concurrently (see gb_ppu_draw_frame()).
+//
+// A frame is split into bands of PPU_POOL_BAND_LINES lines. Each line
+// depends only on the frame's PPU state, so bands may be drawn in any
+// order, by any thread, straight into the frame's pixel buffer.
+//
+// Handing a frame to the workers, and workers claiming its bands, takes
+// no locks: the frame is published by bumping a generation counter,
+// which shares an atomic word with the index of the next unclaimed
+// band. Workers spin briefly for the next frame, and only then park on
+// a condition variable, which the drawing thread signals only if a
+// worker is parked.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+struct gb_ppu;
+
+enum {
+	PPU_POOL_BAND_LINES = 8,
+	PPU_POOL_MAX_THREADS = 16,
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct gb_ppu_pool
+// Members:
+// * work: Generation of the frame being drawn (upper 32 bits), and the
+//   next of its bands to claim (lower 32 bits).
+// * bands_done: Bands of the current frame which have been drawn.
+// * parked: Workers parked on `wake`, or about to be.
+// * stop: Set to have workers exit.
+// * pixels, ppu: Current frame's destination and source. Written by
+//   the drawing thread before publishing the frame through `work`.
+// * lock, wake: Where idle workers park.
+// * threads, count: Worker threads, not counting the drawing thread.
+//=======================================================================
+// def struct gb_ppu_pool
+struct gb_ppu_pool {
+	atomic_uint_fast64_t work;
+	atomic_uint bands_done;
+	atomic_uint parked;
+	atomic_bool stop;
+	uint32_t* pixels;
+	const struct gb_ppu* ppu;
+	mtx_t lock;
+	cnd_t wake;
+	thrd_t threads[PPU_POOL_MAX_THREADS];
+	unsigned count;
+}; // end struct gb_ppu_pool
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_ppu_pool_init()
+// Starts `threads` workers (at most PPU_POOL_MAX_THREADS), which draw
+// alongside the thread calling gb_ppu_pool_draw().
+// Returns nonzero on failure, in which case no worker is left running.
+//=======================================================================
+int
+gb_ppu_pool_init(struct gb_ppu_pool* restrict pool, unsigned threads);
+
+//=======================================================================
+// decl gb_ppu_pool_destroy()
+// Stops and joins the workers. No frame may be being drawn.
+//=======================================================================
+void
+gb_ppu_pool_destroy(struct gb_ppu_pool* restrict pool);
+
+//=======================================================================
+// decl gb_ppu_pool_draw()
+// Draws every line of `ppu`'s state into `pixels`, which holds
+// PPU_SCR_HEIGHT rows of PPU_SCR_WIDTH pixels, with the calling thread
+// and the workers. Returns once every line is drawn.
+// Only one thread may draw through a pool at a time.
+//=======================================================================
+void
+gb_ppu_pool_draw(
+		struct gb_ppu_pool* restrict pool,
+		uint32_t* restrict pixels,
+		const struct gb_ppu* restrict ppu);
+
+#endif // GB_PPU_POOL_H
@@ -12,6 +12,8 @@ enum {
 	PPU_TILE_LEN = PPU_TILE_LENGTH, // pixels, exists for compatibility
 	PPU_TILE_ROW_SIZE = 2, // bytes
 	PPU_TILE_SIZE = PPU_TILE_ROW_SIZE * PPU_TILE_LENGTH, // bytes
+	PPU_TILE_COUNT = 384, // tiles of tile data (0x8000-0x97FF), per VRAM bank
+	PPU_TILE_DIRTY_WORDS = PPU_TILE_COUNT / 64,
 
 	// Background dimensions
 	PPU_BG_LENGTH = 256, // pixels, for any side
@@ -70,6 +72,14 @@ enum {
 	PPU_NUM_CGB_PALETTES = 8,
 };
 
+struct gb_ppu;
+struct gb_ppu_state;
+void
+gb_ppu_decode_tiles(struct gb_ppu_state* restrict state);
+void
+gb_ppu_index_objs(struct gb_ppu_state* restrict state);
+void
+gb_ppu_resolve_palettes(struct gb_ppu* restrict ppu);
 void
 gb_ppu_draw_line(
 		uint32_t dst[PPU_SCR_WIDTH],
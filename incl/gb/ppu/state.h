@@ -3,6 +3,7 @@
 #include <stdalign.h>
 #include <stdint.h>
 #include "gb/mem/region.h"
+#include "gb/ppu/shared.h"
 
 enum {
 	// DMG palettes are actually 3 bytes total, but the value is rounded up
@@ -12,19 +13,90 @@ enum {
 	PPU_BGP = 2,
 };
 
-struct gb_ppu_state {
-	// Immutable mid-line (all models):
-	uint8_t* vram; // MEM_VRAM_SZ on non-CGB, double that on CGB
-	uint8_t* oam; // MEM_OAM_SZ
-	// Immutable mid-line on CGB,
-	// can be modified mid-line on all other models:
-	uint8_t* palette;
-	// Can be modified mid-line:
+//=======================================================================
+// doc struct gb_ppu_palettes
+// The DMG palette registers.
+// `generation` is bumped by each write which changes any of them, so
+// equal generations always hold equal palettes, and colors resolved
+// from them can be kept until it changes (see struct gb_ppu).
+// Generation 0 is never used.
+//=======================================================================
+// def struct gb_ppu_palettes
+struct gb_ppu_palettes {
+	uint32_t generation;
+	uint8_t bgp;
+	uint8_t obp0;
+	uint8_t obp1;
+}; // end struct gb_ppu_palettes
+
+//=======================================================================
+// doc struct gb_ppu_line
+// The registers which a line was drawn with, as they were when it
+// entered mode 3.
+//=======================================================================
+// def struct gb_ppu_line
+struct gb_ppu_line {
+	struct gb_ppu_palettes palettes;
 	uint8_t lcdc;
 	uint8_t scy;
 	uint8_t scx;
 	uint8_t wy;
 	uint8_t wx;
+}; // end struct gb_ppu_line
+
+//=======================================================================
+// doc struct gb_ppu_tile
+// A decoded tile: the color index (0-3) of each pixel, one per byte,
+// by row, both as is (`px[0]`) and flipped horizontally (`px[1]`).
+//=======================================================================
+// def struct gb_ppu_tile
+struct gb_ppu_tile {
+	uint8_t px[2][PPU_TILE_LENGTH][PPU_TILE_LENGTH];
+}; // end struct gb_ppu_tile
+
+//=======================================================================
+// doc struct gb_ppu_line_objs
+// The objects which a line selects, as the OAM offsets of up to the
+// first PPU_MAX_OBJS_PER_LINE of them in OAM, in drawing priority order:
+// by ascending X-coordinate, then OAM offset, on DMG, and by OAM offset
+// alone on CGB.
+//=======================================================================
+// def struct gb_ppu_line_objs
+struct gb_ppu_line_objs {
+	uint8_t count;
+	uint8_t oam[PPU_MAX_OBJS_PER_LINE];
+}; // end struct gb_ppu_line_objs
+
+struct gb_ppu_state {
+	// Immutable mid-line (all models):
+	uint8_t* vram; // MEM_VRAM_SZ on non-CGB, double that on CGB
+	uint8_t* oam; // MEM_OAM_SZ
+	// Owned copy of VRAM followed by OAM, which `vram` and `oam` point
+	// into unless they view the core's memory directly.
+	uint8_t* buffer;
+	// Epoch of the core's memory that `buffer` is up to date with,
+	// or 0 if it is not (see struct gb_mem).
+	uint64_t synced;
+	// Decoded copy of each tile of tile data in VRAM bank 0. Only tiles
+	// not flagged in `tiles_dirty` are up to date
+	// (see gb_ppu_decode_tiles()).
+	struct gb_ppu_tile* tiles; // PPU_TILE_COUNT
+	uint64_t tiles_dirty[PPU_TILE_DIRTY_WORDS];
+	// Epoch of the core's memory up to which writes to tile data have
+	// been flagged in `tiles_dirty`, or 0 if none have.
+	uint64_t tiles_synced;
+	// Registers of each line, indexed by LY.
+	struct gb_ppu_line lines[PPU_SCR_HEIGHT];
+	// Objects of each line, indexed by LY (see gb_ppu_index_objs()).
+	struct gb_ppu_line_objs line_objs[PPU_SCR_HEIGHT];
+	// Generation of the core's PPU state as of the hand-off. Hand-offs
+	// of the same generation hold the same state (see struct gb_mem).
+	uint64_t generation;
+	// Vertical blanks begun before the hand-off, which numbers frames
+	// as emulated, whether or not each is handed off.
+	uint64_t frame;
+	// LCDC as of the hand-off, for whether the LCD is enabled at all.
+	uint8_t lcdc;
 	uint8_t mode;
 }; // end struct gb_ppu_state
 
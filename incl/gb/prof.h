@@ -0,0 +1,64 @@
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/prof.h
+// Optional wall-clock timing of the phases of emulating a frame.
+// Enabled by defining GB_PROFILE; otherwise the macros below expand to
+// nothing.
+//
+// Usage:
+//     GB_PROF_BEGIN(t);
+//     ...work...
+//     GB_PROF_END(GB_PROF_PRESENT, t);
+// Every thread accumulates into the same `gb_prof_ns`, so time spent in
+// a phase by PPU workers (see gb/ppu/pool.h) is counted too, and a
+// phase's total may exceed the wall-clock time it spanned.
+//-----------------------------------------------------------------------
+//=======================================================================
+#ifndef GB_PROF_H
+#define GB_PROF_H
+#include <stdint.h>
+
+//=======================================================================
+// doc enum gb_prof_phase
+// Enumerations:
+// * GB_PROF_CPU: The interpreter, excluding the scheduler.
+// * GB_PROF_SCH: The scheduler, including the events it fires.
+// * GB_PROF_PPU_ENCODE: Snapshotting PPU state, and encoding lines of
+//   BG, window, and objects into palette-relative colors.
+// * GB_PROF_PALETTE: Resolving encoded colors into output pixels.
+// * GB_PROF_PRESENT: Handing finished frames to the video sink.
+//=======================================================================
+enum gb_prof_phase {
+	GB_PROF_CPU = 0,
+	GB_PROF_SCH,
+	GB_PROF_PPU_ENCODE,
+	GB_PROF_PALETTE,
+	GB_PROF_PRESENT,
+	GB_PROF_PHASE_COUNT
+}; // end enum gb_prof_phase
+
+#ifdef GB_PROFILE
+#include <stdatomic.h>
+#include <time.h>
+
+// Nanoseconds spent in each phase, summed over all threads.
+extern _Atomic uint64_t gb_prof_ns[GB_PROF_PHASE_COUNT];
+
+//=======================================================================
+// def gb_prof_now()
+static inline uint64_t
+gb_prof_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+} // end gb_prof_now()
+
+#define GB_PROF_BEGIN(var) uint64_t var = gb_prof_now()
+#define GB_PROF_END(phase, var) atomic_fetch_add_explicit( \
+		&gb_prof_ns[(phase)], gb_prof_now() - (var), memory_order_relaxed)
+#else
+#define GB_PROF_BEGIN(var)
+#define GB_PROF_END(phase, var) ((void)0)
+#endif // GB_PROFILE
+
+#endif // GB_PROF_H
@@ -7,6 +7,7 @@
 #ifndef GB_SCH_H
 #define GB_SCH_H
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "gb/core.h"
 
@@ -16,16 +17,15 @@
 //-----------------------------------------------------------------------
 //=======================================================================
 enum gb_schev_id {
-	SCHEV_HEADER = 0,
-	SCHEV_PPU,
+	SCHEV_PPU = 0,
 	SCHEV_DIV,
 	SCHEV_TIMA,
 	SCHEV_SERIAL,
 	SCHEV_TIMELIMIT,
 
 	NUM_SCHEVS,
-	SCHEV_DISABLED = 0xFFFE,
-	SCHEV_NONE = 0xFFFF
+	// Heap position of an event which is not currently queued.
+	SCHEV_INACTIVE = 0xFF
 }; // end enum gb_schev_id
 
 // Every time a scheduled event fires, it must be rescheduled.
@@ -35,13 +35,11 @@ enum gb_schev_id {
 //
 // Rescheduling should be done by the event handler.
 
-// Retifying the following error will require:
-// 1. Increasing the bit width of member `next` in `struct gb_sch`
-// 2. Increasing the bit width of member `next` in `struct gb_schev`
-// 3. Increasing `SCHEV_DISABLED` to a higher value
-// 4. Increasing `SCHEV_NONE` to a higher value
-static_assert(NUM_SCHEVS <= SCHEV_DISABLED,
-		"Too many events enumerate using uint16_t.\n");
+// Rectifying the following error will require increasing the bit width
+// of member `pos` in `struct gb_schev` and of the elements of `heap`
+// in `struct gb_sch`, then increasing `SCHEV_INACTIVE` to match.
+static_assert(NUM_SCHEVS < SCHEV_INACTIVE,
+		"Too many events to enumerate using uint8_t.\n");
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -58,19 +56,19 @@ static_assert(NUM_SCHEVS <= SCHEV_DISABLED,
 // information exists within objects of this type.
 //-----------------------------------------------------------------------
 // Members:
-// * next:
-//   The index of the event scheduled to fire after this event.
-// * until:
-//   The number of cycles before this event fires AFTER all events
-//   scheduled to fire before this one fire.
-//   In other words, the number of cycles before this event fires is
-//   equal to the sum of the value of `until` in this event and the sum
-//   of the values of `until` in all events that will fire before this one.
+// * when:
+//   While queued, the absolute cycle timestamp (compared against
+//   `now` in `struct gb_sch`) at which this event fires.
+//   While paused, the number of cycles that remained before this event
+//   would have fired at the moment it was paused.
+// * pos:
+//   The index of this event within the scheduler's heap, or
+//   SCHEV_INACTIVE if this event is not queued.
 //=======================================================================
 // def struct gb_schev
 struct gb_schev {
-	int16_t until;
-	uint16_t next;
+	uint64_t when;
+	uint8_t pos;
 }; // end struct gb_schev
 
 //=======================================================================
@@ -79,16 +77,38 @@ struct gb_schev {
 // Tracks when events will fire, measured in emulated CPU cycles.
 //-----------------------------------------------------------------------
 // Members:
+// * now:
+//   Monotonic count of cycles emulated since the scheduler was
+//   initialized. Never wraps in practice (~2^44 seconds of emulation).
+//   Only brought up-to-date when the scheduler is entered; while the
+//   CPU is running, the current time is `next - budget`.
 // * next:
-//   The index of the event scheduled to fire next.
+//   Cached copy of the timestamp of the earliest queued event.
+//   UINT64_MAX if no events are queued.
+// * budget:
+//   The number of cycles the CPU may run before the scheduler must be
+//   entered to fire the next event. The interpreter consumes this
+//   directly as it executes instructions, and only calls into the
+//   scheduler once it reaches 0 (or below, if an instruction
+//   overshoots the event).
 // * ev:
 //   A static array of scheduler events.
 //   Each distinct event's position within the array is absolute,
 //   defined by its index specified in `enum gb_schev_id`.
+// * heap:
+//   Binary min-heap of the IDs of all queued events, ordered by
+//   ascending `when`. heap[0] is always the next event to fire.
+// * heap_size:
+//   The number of events currently queued in `heap`.
 //=======================================================================
 // def struct gb_sch
 struct gb_sch {
+	uint64_t now;
+	uint64_t next;
+	int32_t budget;
 	struct gb_schev ev[NUM_SCHEVS];
+	uint8_t heap[NUM_SCHEVS];
+	uint8_t heap_size;
 }; // end struct gb_sch
 
 //=======================================================================
@@ -101,6 +121,10 @@ gb_sch_init(struct gb_core* restrict core);
 void
 gb_sch_advance(struct gb_core* restrict core, uint8_t cycles);
 void
+gb_sch_run_due(struct gb_core* restrict core);
+void
+gb_sch_halt(struct gb_core* restrict core);
+void
 gb_sch_on_div_reset(struct gb_core* restrict core);
 void
 gb_sch_on_tac_update(
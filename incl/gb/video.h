@@ -0,0 +1,114 @@
+#ifndef GB_VIDEO_H
+#define GB_VIDEO_H
+#include <stdint.h>
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/video.h
+// Frame sink interface, through which the PPU presents frames and the
+// core receives host input.
+//
+// Implementations embed `struct gb_video` as their first member and
+// point its `ops` at their own table. Available sinks:
+// * gb/video/sdl.h: Draws to an SDL window, and reads the keyboard.
+// * gb/video/null.h: Discards frames. Needs no display.
+// * gb/video/mem.h: Hands each frame's pixels to the caller.
+// * gb/video/rec.h: Records frames to a file or pipe, as Y4M or raw RGBA.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL CONSTANT DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+enum {
+	// Returned by `repeat_frame` (see struct gb_video_ops) when the
+	// sink has lost its last frame, which must then be drawn in full.
+	GB_VIDEO_REDRAW = -1
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+struct gb_video;
+
+//=======================================================================
+// doc struct gb_video_input
+// Host input, as updated by gb_video_poll().
+// Members:
+// * pad: Pressed buttons (see gb/pad.h).
+// * fast_forward: Nonzero to run frames without pacing.
+//=======================================================================
+// def struct gb_video_input
+struct gb_video_input {
+	uint8_t pad;
+	uint8_t fast_forward;
+}; // end struct gb_video_input
+
+//=======================================================================
+// doc struct gb_video_ops
+// Members:
+// * start_drawing: Returns a PPU_SCR_WIDTH * PPU_SCR_HEIGHT pixel
+//   buffer for the next frame, or NULL on failure.
+// * finish_drawing: Presents the buffer returned by `start_drawing`.
+//   Returns nonzero on failure.
+// * draw_clear: Presents a blank frame, for when the LCD is off.
+//   Returns nonzero on failure.
+// * repeat_frame: Presents the last frame again, in place of drawing an
+//   identical one. Sinks which keep showing their last frame need not
+//   redraw it. Returns GB_VIDEO_REDRAW if the last frame was lost and
+//   nothing was presented, or another nonzero value on failure.
+// * poll: Updates `input` with pending host input. Returns nonzero if
+//   emulation should stop.
+// * destroy: Releases the sink's resources.
+//=======================================================================
+// def struct gb_video_ops
+struct gb_video_ops {
+	uint32_t* (*start_drawing)(struct gb_video* restrict vid);
+	int (*finish_drawing)(struct gb_video* restrict vid);
+	int (*draw_clear)(struct gb_video* restrict vid);
+	int (*repeat_frame)(struct gb_video* restrict vid);
+	int (*poll)(struct gb_video* restrict vid, struct gb_video_input* restrict input);
+	void (*destroy)(struct gb_video* restrict vid);
+}; // end struct gb_video_ops
+
+//=======================================================================
+// def struct gb_video
+struct gb_video {
+	const struct gb_video_ops* ops;
+}; // end struct gb_video
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static inline uint32_t*
+gb_video_start_drawing(struct gb_video* restrict vid) {
+	return vid->ops->start_drawing(vid);
+}
+static inline int
+gb_video_finish_drawing(struct gb_video* restrict vid) {
+	return vid->ops->finish_drawing(vid);
+}
+static inline int
+gb_video_draw_clear(struct gb_video* restrict vid) {
+	return vid->ops->draw_clear(vid);
+}
+static inline int
+gb_video_repeat_frame(struct gb_video* restrict vid) {
+	return vid->ops->repeat_frame(vid);
+}
+static inline int
+gb_video_poll(struct gb_video* restrict vid, struct gb_video_input* restrict input) {
+	return vid->ops->poll(vid, input);
+}
+static inline void
+gb_video_destroy(struct gb_video* restrict vid) {
+	vid->ops->destroy(vid);
+}
+
+#endif // GB_VIDEO_H
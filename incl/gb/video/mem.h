@@ -0,0 +1,44 @@
+#ifndef GB_VIDEO_MEM_H
+#define GB_VIDEO_MEM_H
+#include <stdint.h>
+#include "gb/ppu/shared.h"
+#include "gb/video.h"
+
+//=======================================================================
+// doc gb_video_mem_fn
+// Called with each finished frame. `pixels` stays valid until the next
+// frame starts drawing. Returns nonzero to stop emulation.
+//=======================================================================
+typedef int (*gb_video_mem_fn)(
+		void* user,
+		const uint32_t pixels[PPU_SCR_WIDTH * PPU_SCR_HEIGHT]);
+
+//=======================================================================
+// doc struct gb_video_mem
+// Sink which draws frames to memory owned by the caller.
+// Like the null sink, reports no input other than fast-forward.
+//-----------------------------------------------------------------------
+// Members:
+// * base: See gb/video.h.
+// * on_frame, user: Called with each finished frame, if not NULL.
+// * frames: Number of frames presented so far.
+// * stop: Set once `on_frame` asks to stop emulation.
+// * pixels: The most recent frame, row-major.
+//=======================================================================
+// def struct gb_video_mem
+struct gb_video_mem {
+	struct gb_video base;
+	gb_video_mem_fn on_frame;
+	void* user;
+	uint64_t frames;
+	uint8_t stop;
+	uint32_t pixels[PPU_SCR_WIDTH * PPU_SCR_HEIGHT];
+}; // end struct gb_video_mem
+
+void
+gb_video_mem_init(
+		struct gb_video_mem* restrict vid,
+		gb_video_mem_fn on_frame,
+		void* user);
+
+#endif // GB_VIDEO_MEM_H
@@ -0,0 +1,31 @@
+#ifndef GB_VIDEO_NULL_H
+#define GB_VIDEO_NULL_H
+#include <stdint.h>
+#include "gb/ppu/shared.h"
+#include "gb/video.h"
+
+//=======================================================================
+// doc struct gb_video_null
+// Sink which discards frames, for running without a display.
+// Reports no input other than fast-forward, as there is no display to
+// pace frames to.
+//-----------------------------------------------------------------------
+// Members:
+// * base: See gb/video.h.
+// * frames: Number of frames presented so far.
+// * frame_limit: Number of frames after which gb_video_poll() asks to
+//   stop, or 0 to never stop.
+// * pixels: Scratch buffer which frames are drawn to.
+//=======================================================================
+// def struct gb_video_null
+struct gb_video_null {
+	struct gb_video base;
+	uint64_t frames;
+	uint64_t frame_limit;
+	uint32_t pixels[PPU_SCR_WIDTH * PPU_SCR_HEIGHT];
+}; // end struct gb_video_null
+
+void
+gb_video_null_init(struct gb_video_null* restrict vid, uint64_t frame_limit);
+
+#endif // GB_VIDEO_NULL_H
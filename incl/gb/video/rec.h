@@ -0,0 +1,146 @@
+#ifndef GB_VIDEO_REC_H
+#define GB_VIDEO_REC_H
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+#include "gb/ppu/shared.h"
+#include "gb/video.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// gb/video/rec.h
+// Sink which records frames to a file descriptor (a file, or a pipe to
+// another program), for archiving and reviewing runs without a display
+// or an external encoder.
+//
+// Frames are written as either:
+// * GB_VIDEO_REC_Y4M: A YUV4MPEG2 stream of 4:4:4 BT.601 frames, at the
+//   Game Boy's frame rate, which most video tools read as is.
+// * GB_VIDEO_REC_RAW: Each frame's pixels as RGBA bytes, row-major,
+//   with no header.
+//
+// With `dedup` set, a frame identical to the one before it is written
+// as a repeat marker, in place of its pixels:
+// * Y4M: A frame header with the parameter `XREPEAT`, and no frame data.
+// * Raw: Each frame is tagged by a leading byte: 'F' followed by its
+//   pixels, or 'R' alone for a repeat.
+// Such streams must be expanded before other tools can read them.
+//
+// Frames are converted into a ring of slots, and written a batch of
+// slots at a time with writev(). Without a writer thread, the drawing
+// thread writes once the ring is full. With one, it writes as soon as
+// GB_VIDEO_REC_BATCH slots are pending, and the drawing thread only
+// waits on it if the ring fills, as when the output is persistently
+// slower than emulation; such waits are counted in `stalls`.
+//-----------------------------------------------------------------------
+//=======================================================================
+
+enum gb_video_rec_format {
+	GB_VIDEO_REC_Y4M,
+	GB_VIDEO_REC_RAW,
+};
+
+enum {
+	GB_VIDEO_REC_MAX_SLOTS = 256,
+	GB_VIDEO_REC_DEFAULT_SLOTS = 32,
+	// Pending slots which wake the writer thread.
+	GB_VIDEO_REC_BATCH = 8,
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct gb_video_rec_params
+// Members:
+// * fd: Where frames are written. Not closed by the sink.
+// * format: See enum gb_video_rec_format.
+// * dedup: Nonzero to write repeated frames as repeat markers.
+// * threaded: Nonzero to write from a writer thread.
+// * slots: Frames the ring holds (2 to GB_VIDEO_REC_MAX_SLOTS), or 0
+//   for GB_VIDEO_REC_DEFAULT_SLOTS.
+// * frame_limit: Number of frames after which gb_video_poll() asks to
+//   stop, or 0 to never stop.
+//=======================================================================
+// def struct gb_video_rec_params
+struct gb_video_rec_params {
+	int fd;
+	enum gb_video_rec_format format;
+	uint8_t dedup;
+	uint8_t threaded;
+	unsigned slots;
+	uint64_t frame_limit;
+}; // end struct gb_video_rec_params
+
+//=======================================================================
+// doc struct gb_video_rec
+// Like the null sink, reports no input other than fast-forward.
+//-----------------------------------------------------------------------
+// Members:
+// * base: See gb/video.h.
+// * fd, format, dedup, frame_limit: See struct gb_video_rec_params.
+// * frames: Number of frames presented so far.
+// * repeats: Frames of those written as repeat markers.
+// * stalls: Times the drawing thread waited for a free slot.
+// * failed: Set once a write fails, after which frames are discarded,
+//   and gb_video_poll() asks to stop.
+// * frame, cur: Pixel buffers; `frame[cur]` is drawn to next, and
+//   `frame[cur ^ 1]` holds the last frame written.
+// * data, slot_size, lens, count: The ring. Slot `n % count` holds
+//   the `n`th frame converted, `lens[n % count]` bytes long.
+// * published: Slots converted, which the writer may write.
+// * written: Slots written (or discarded, once `failed`).
+// * closing: Set once the writer thread should write what is left, and
+//   exit.
+// * lock, ready, space: Where the writer thread waits for slots to
+//   write, and the drawing thread for slots to convert into.
+// * writer, threaded: The writer thread, if `threaded`.
+//=======================================================================
+// def struct gb_video_rec
+struct gb_video_rec {
+	struct gb_video base;
+	int fd;
+	enum gb_video_rec_format format;
+	uint8_t dedup;
+	uint64_t frame_limit;
+	uint64_t frames;
+	uint64_t repeats;
+	uint64_t stalls;
+	atomic_bool failed;
+	uint32_t frame[2][PPU_SCR_WIDTH * PPU_SCR_HEIGHT];
+	uint8_t cur;
+	uint8_t* data;
+	size_t slot_size;
+	size_t* lens;
+	unsigned count;
+	atomic_uint_fast64_t published;
+	atomic_uint_fast64_t written;
+	atomic_bool closing;
+	mtx_t lock;
+	cnd_t ready;
+	cnd_t space;
+	thrd_t writer;
+	uint8_t threaded;
+}; // end struct gb_video_rec
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// decl gb_video_rec_init()
+// Writes the stream header, and starts the writer thread if requested.
+// Returns nonzero on failure.
+//=======================================================================
+int
+gb_video_rec_init(
+		struct gb_video_rec* restrict vid,
+		const struct gb_video_rec_params* restrict params);
+
+#endif // GB_VIDEO_REC_H
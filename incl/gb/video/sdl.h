@@ -1,11 +1,34 @@
 #ifndef GB_VIDEO_SDL_H
 #define GB_VIDEO_SDL_H
 #include <SDL.h>
+#include "gb/video.h"
 
+//=======================================================================
+// doc struct gb_video_sdl
+// Sink which draws frames to an SDL window, and reads pad input from the
+// keyboard (arrow keys, Z, X, right shift, return; hold F to fast
+// forward). Closing the window stops emulation.
+//-----------------------------------------------------------------------
+// Members:
+// * blank: Set if the last frame presented was blank, rather than
+//   `texture`.
+// * redraw: Set once the window's contents may have been lost (it was
+//   exposed or resized), until a frame is next presented.
+// * lost: Set once the render device was reset, losing `texture`, until
+//   the texture is recreated to draw the next frame.
+// * width, height: Size of `texture`, in pixels.
+//=======================================================================
+// def struct gb_video_sdl
 struct gb_video_sdl {
+	struct gb_video base;
 	SDL_Window* window;
 	SDL_Renderer* renderer;
 	SDL_Texture* texture;
+	uint8_t blank;
+	uint8_t redraw;
+	uint8_t lost;
+	int width;
+	int height;
 }; // end struct gb_video_sdl
 
 struct gb_video_sdl_params {
@@ -33,6 +56,8 @@ int
 gb_video_sdl_finish_drawing(struct gb_video_sdl* restrict vid);
 int
 gb_video_sdl_draw_clear(struct gb_video_sdl* restrict vid);
+int
+gb_video_sdl_repeat_frame(struct gb_video_sdl* restrict vid);
 
 #endif // GB_VIDEO_SDL_H
 
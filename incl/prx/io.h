@@ -12,10 +12,16 @@ prx_io_fpload(
 		char* restrict dst,
 		size_t dstsz,
 		const char* restrict fp);
+void*
+prx_io_fmap(size_t size, FILE* restrict file);
+void
+prx_io_funmap(void* map, size_t size);
 
 #if PRX_TRUNCATE_PREFIX >= 1
 #	define io_fload prx_io_fload
 #	define io_fpload prx_io_fpload
+#	define io_fmap prx_io_fmap
+#	define io_funmap prx_io_funmap
 #endif
 
 #endif // PRX_IO_H
@@ -0,0 +1,126 @@
+//=======================================================================
+// Batch runner.
+// Runs many emulation sessions at once without video, spread over every
+// CPU core (see gb/batch.h), and reports their aggregate throughput as
+// JSON with one value per line, like gb-bench.
+//
+// Usage: ./gb-batch [-j threads] [-f frames] [-n copies] [-H directory]
+//        <ROM-filepath>...
+// Each ROM is run `copies` times (default 1), for `frames` frames each
+// (default 3600). `threads` defaults to the number of online CPUs.
+// With `-H`, session `i` logs a hash of each frame to `directory/i.fhl`
+// (see gb/ppu/hashlog.h), for comparing with gb-hashdiff.
+//=======================================================================
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gb/batch.h"
+
+enum { DEFAULT_FRAMES = 3600 }; // 1 minute of emulated time
+
+static void
+print_usage(const char* restrict program_name);
+
+static double
+elapsed_seconds(
+		const struct timespec* restrict begin,
+		const struct timespec* restrict end) {
+	return (double)(end->tv_sec - begin->tv_sec)
+		+ (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+} // end elapsed_seconds()
+
+int main(int argc, char* argv[]) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned threads = cpus > 0 ? (unsigned)cpus : 1;
+	uint64_t frames = DEFAULT_FRAMES;
+	unsigned long copies = 1;
+	const char* hash_dir = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "j:f:n:H:")) != -1) {
+		switch (opt) {
+			case 'j': threads = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'f': frames = strtoull(optarg, NULL, 0); break;
+			case 'n': copies = strtoul(optarg, NULL, 0); break;
+			case 'H': hash_dir = optarg; break;
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind >= argc || copies == 0) {
+		print_usage(argc >= 1 ? argv[0] : "gb-batch");
+		return 1;
+	}
+
+	size_t roms = (size_t)(argc - optind);
+	size_t count = roms * copies;
+	struct gb_batch_session* sessions = calloc(count, sizeof(*sessions));
+	if (sessions == NULL) {
+		fprintf(stderr, "Unable to allocate %zu sessions.\n", count);
+		return 1;
+	}
+	// Room for "<directory>/<index>.fhl" for each session.
+	size_t path_size = hash_dir != NULL ? strlen(hash_dir) + 32 : 0;
+	char* hash_paths = calloc(count, path_size ? path_size : 1);
+	if (hash_paths == NULL) {
+		fprintf(stderr, "Unable to allocate %zu hash log paths.\n", count);
+		free(sessions);
+		return 1;
+	}
+	for (size_t i = 0; i < count; ++i) {
+		sessions[i].rom_filepath = argv[optind + i % roms];
+		sessions[i].frames = frames;
+		if (hash_dir != NULL) {
+			char* path = hash_paths + i * path_size;
+			snprintf(path, path_size, "%s/%zu.fhl", hash_dir, i);
+			sessions[i].hash_log_path = path;
+		}
+	}
+
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	if (gb_batch_run(sessions, count, threads)) {
+		fputs("Unable to start batch.\n", stderr);
+		free(hash_paths);
+		free(sessions);
+		return 1;
+	}
+	timespec_get(&end, TIME_UTC);
+
+	uint64_t total_frames = 0;
+	uint64_t total_cycles = 0;
+	size_t failed = 0;
+	for (size_t i = 0; i < count; ++i) {
+		total_frames += sessions[i].frames_done;
+		total_cycles += sessions[i].cycles;
+		if (sessions[i].failed) {
+			++failed;
+			fprintf(stderr, "Session %zu (%s) failed after %" PRIu64 " frames.\n",
+					i, sessions[i].rom_filepath, sessions[i].frames_done);
+		}
+	}
+	double seconds = elapsed_seconds(&begin, &end);
+	printf("{\n");
+	printf("  \"sessions\": %zu,\n", count);
+	printf("  \"failed\": %zu,\n", failed);
+	printf("  \"threads\": %u,\n", threads);
+	printf("  \"frames\": %" PRIu64 ",\n", total_frames);
+	printf("  \"cycles\": %" PRIu64 ",\n", total_cycles);
+	printf("  \"seconds\": %.6f,\n", seconds);
+	printf("  \"frames_per_sec\": %.2f,\n", (double)total_frames / seconds);
+	printf("  \"cycles_per_sec\": %.0f\n", (double)total_cycles / seconds);
+	printf("}\n");
+	free(hash_paths);
+	free(sessions);
+	return failed != 0;
+}
+
+static void
+print_usage(const char* restrict program_name) {
+	printf("Usage:\n\t%s [-j threads] [-f frames] [-n copies] [-H directory]"
+			" <ROM-filepath>...\n", program_name);
+} // end print_usage()
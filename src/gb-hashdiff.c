@@ -0,0 +1,108 @@
+//=======================================================================
+// Hash log differ.
+// Compares two frame hash logs (see gb/ppu/hashlog.h), as written by
+// `dgb --hash-log` or `gb-batch -H`, and reports the first frame whose
+// output differs between them.
+//
+// Usage: ./gb-hashdiff <log-A> <log-B>
+// Frames present in only one log (as when frames were dropped) are
+// skipped. Exits with 0 if every frame in both logs matches, 1 if a
+// frame differs or one log runs past the end of the other, and 2 if a
+// log cannot be read.
+//=======================================================================
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gb/ppu/hashlog.h"
+
+static void
+print_usage(const char* restrict program_name);
+static FILE*
+open_log(const char* restrict path);
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		print_usage(argc >= 1 ? argv[0] : "gb-hashdiff");
+		return 2;
+	}
+	FILE* logs[2] = {open_log(argv[1]), open_log(argv[2])};
+	int status = 2;
+	if (logs[0] == NULL || logs[1] == NULL)
+		goto close_logs;
+
+	struct gb_ppu_hashlog_record records[2];
+	int read[2] = {gb_ppu_hashlog_read(logs[0], &records[0]),
+		gb_ppu_hashlog_read(logs[1], &records[1])};
+	uint64_t matched = 0;
+	uint64_t skipped = 0;
+	while (read[0] == 1 && read[1] == 1) {
+		if (records[0].frame != records[1].frame) {
+			// Skip the frame missing from the other log.
+			int behind = records[0].frame > records[1].frame;
+			read[behind] = gb_ppu_hashlog_read(logs[behind], &records[behind]);
+			++skipped;
+			continue;
+		}
+		if (records[0].pixels != records[1].pixels
+				|| records[0].encoded != records[1].encoded) {
+			printf("Frame %" PRIu64 " differs, after %" PRIu64 " matching frames.\n",
+					records[0].frame, matched);
+			printf("  pixels:  %016" PRIx64 " %016" PRIx64 "\n",
+					records[0].pixels, records[1].pixels);
+			printf("  encoded: %016" PRIx64 " %016" PRIx64 "%s\n",
+					records[0].encoded, records[1].encoded,
+					records[0].encoded == records[1].encoded ? " (palettes only)" : "");
+			status = 1;
+			goto close_logs;
+		}
+		++matched;
+		read[0] = gb_ppu_hashlog_read(logs[0], &records[0]);
+		read[1] = gb_ppu_hashlog_read(logs[1], &records[1]);
+	}
+	for (int i = 0; i < 2; ++i) {
+		if (read[i] < 0) {
+			fprintf(stderr, "%s: truncated or unreadable.\n", argv[1 + i]);
+			goto close_logs;
+		}
+	}
+	if (read[0] != read[1]) {
+		int longer = read[1] == 1;
+		printf("%s continues past the end of %s, from frame %" PRIu64
+				", after %" PRIu64 " matching frames.\n",
+				argv[1 + longer], argv[2 - longer], records[longer].frame, matched);
+		status = 1;
+		goto close_logs;
+	}
+	printf("%" PRIu64 " frames match", matched);
+	if (skipped)
+		printf(" (%" PRIu64 " in only one log skipped)", skipped);
+	printf(".\n");
+	status = 0;
+
+close_logs:
+	for (int i = 0; i < 2; ++i) {
+		if (logs[i] != NULL)
+			fclose(logs[i]);
+	}
+	return status;
+}
+
+static FILE*
+open_log(const char* restrict path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		perror(path);
+		return NULL;
+	}
+	if (gb_ppu_hashlog_read_header(file)) {
+		fprintf(stderr, "%s: not a frame hash log.\n", path);
+		fclose(file);
+		return NULL;
+	}
+	return file;
+} // end open_log()
+
+static void
+print_usage(const char* restrict program_name) {
+	printf("Usage:\n\t%s <log-A> <log-B>\n", program_name);
+} // end print_usage()
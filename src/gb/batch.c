@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include "gb/batch.h"
+#include "gb/core.h"
+#include "gb/core/typedef.h"
+#include "gb/cpu/interpreter.h"
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/log.h"
+#include "gb/mem.h"
+#include "gb/ppu.h"
+#include "gb/ppu/hashlog.h"
+#include "gb/video.h"
+#include "gb/video/null.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL TYPE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc struct instance
+// Everything needed to run one session.
+//=======================================================================
+// def struct instance
+struct instance {
+	struct gb_core core;
+	struct gb_ppu ppu;
+	struct gb_video_null video;
+	struct gb_ppu_hashlog hashes;
+}; // end struct instance
+
+//=======================================================================
+// doc struct worker
+// Members:
+// * lock: Guards `head` and `tail`.
+// * head, tail: This worker's deque, as the indices [head, tail) of the
+//   sessions it has yet to start. The owner takes from the tail, and
+//   thieves from the head.
+// * thread: This worker's thread, unless it is the calling thread.
+// * started: Set if `thread` was created, and must be joined.
+// * all: Every worker, for stealing from.
+// * sessions: Every session.
+// * count: Number of workers.
+// Each worker is aligned to its own cache line, as thieves lock it.
+//=======================================================================
+// def struct worker
+struct worker {
+	alignas(64) mtx_t lock;
+	size_t head;
+	size_t tail;
+	thrd_t thread;
+	uint8_t started;
+	struct worker* all;
+	struct gb_batch_session* sessions;
+	unsigned count;
+}; // end struct worker
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static int
+worker_main(void* arg);
+static uint8_t
+take(struct worker* restrict worker, size_t* restrict session);
+static uint8_t
+steal(struct worker* restrict victim, size_t* restrict session);
+static void
+run_session(struct gb_batch_session* restrict session);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_batch_run()
+uint8_t
+gb_batch_run(
+		struct gb_batch_session* restrict sessions,
+		size_t count,
+		unsigned threads) {
+	assert(sessions != NULL || count == 0);
+	if (threads == 0)
+		threads = 1;
+	if (threads > count)
+		threads = count ? (unsigned)count : 1;
+
+	size_t size = (threads * sizeof(struct worker) + 63) & ~(size_t)63;
+	struct worker* workers = aligned_alloc(alignof(struct worker), size);
+	if (workers == NULL) {
+		LOGE("Unable to allocate %zu bytes.", size);
+		return 1;
+	}
+	for (unsigned w = 0; w < threads; ++w) {
+		if (mtx_init(&workers[w].lock, mtx_plain) != thrd_success) {
+			while (w--)
+				mtx_destroy(&workers[w].lock);
+			free(workers);
+			return 1;
+		}
+		workers[w].head = count * w / threads;
+		workers[w].tail = count * (w + 1) / threads;
+		workers[w].started = 0;
+		workers[w].all = workers;
+		workers[w].sessions = sessions;
+		workers[w].count = threads;
+	}
+
+	// Sessions of workers which fail to start are left to be stolen.
+	for (unsigned w = 1; w < threads; ++w) {
+		workers[w].started =
+			thrd_create(&workers[w].thread, worker_main, &workers[w]) == thrd_success;
+		if (!workers[w].started)
+			LOGW("Unable to start worker %u.", w);
+	}
+	worker_main(&workers[0]);
+	// Workers may steal from one another until they have all finished.
+	for (unsigned w = 1; w < threads; ++w) {
+		if (workers[w].started)
+			thrd_join(workers[w].thread, NULL);
+	}
+	for (unsigned w = 0; w < threads; ++w)
+		mtx_destroy(&workers[w].lock);
+	free(workers);
+	return 0;
+} // end gb_batch_run()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc worker_main()
+// Runs sessions from this worker's own deque, then stolen ones, until a
+// pass over every other worker finds nothing left to steal.
+//=======================================================================
+// def worker_main()
+static int
+worker_main(void* arg) {
+	struct worker* self = arg;
+	unsigned id = (unsigned)(self - self->all);
+	size_t session;
+	while (1) {
+		uint8_t found = take(self, &session);
+		for (unsigned i = 1; !found && i < self->count; ++i)
+			found = steal(&self->all[(id + i) % self->count], &session);
+		if (!found)
+			return 0;
+		run_session(&self->sessions[session]);
+	}
+} // end worker_main()
+
+//=======================================================================
+// def take()
+static uint8_t
+take(struct worker* restrict worker, size_t* restrict session) {
+	mtx_lock(&worker->lock);
+	uint8_t found = worker->head != worker->tail;
+	if (found)
+		*session = --worker->tail;
+	mtx_unlock(&worker->lock);
+	return found;
+} // end take()
+
+//=======================================================================
+// def steal()
+static uint8_t
+steal(struct worker* restrict victim, size_t* restrict session) {
+	mtx_lock(&victim->lock);
+	uint8_t found = victim->head != victim->tail;
+	if (found)
+		*session = victim->head++;
+	mtx_unlock(&victim->lock);
+	return found;
+} // end steal()
+
+//=======================================================================
+// doc run_session()
+// Allocates, runs, and frees one session's instance on the calling
+// thread. The instance is page-aligned, and zeroed here so that its
+// pages are first touched by this thread.
+// Results are only written back to `session` at the end, as sessions
+// run by different workers may share a cache line.
+//=======================================================================
+// def run_session()
+static void
+run_session(struct gb_batch_session* restrict session) {
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size = (sizeof(struct instance) + page - 1) / page * page;
+	struct instance* inst = aligned_alloc(page, size);
+	if (inst == NULL) {
+		LOGE("Unable to allocate %zu bytes.", size);
+		session->frames_done = session->cycles = 0;
+		session->failed = 1;
+		return;
+	}
+	memset(inst, 0, size);
+
+	uint64_t frames_done = 0;
+	uint64_t cycles = 0;
+	uint8_t failed = 1;
+	gb_video_null_init(&inst->video, 0);
+	if (gb_ppu_init(&inst->ppu, &inst->video.base))
+		goto free_inst;
+	if (session->hash_log_path != NULL) {
+		if (gb_ppu_hashlog_open(&inst->hashes, session->hash_log_path))
+			goto destroy_ppu;
+		inst->ppu.hashes = &inst->hashes;
+	}
+	if (gb_core_init_rom(&inst->core, session->rom_filepath))
+		goto close_hashes;
+
+	failed = 0;
+	while (frames_done < session->frames) {
+		gb_cpu_interpret_frame(&inst->core);
+		gb_mem_view_ppu_state(&inst->core, &inst->ppu.state);
+		if (gb_dmg_draw(&inst->ppu)) {
+			failed = 1;
+			break;
+		}
+		++frames_done;
+	}
+	cycles = (uint64_t)((int64_t)inst->core.sch.next - inst->core.sch.budget);
+	gb_core_destroy(&inst->core);
+close_hashes:
+	if (inst->ppu.hashes != NULL && gb_ppu_hashlog_close(inst->ppu.hashes))
+		failed = 1;
+destroy_ppu:
+	gb_ppu_destroy(&inst->ppu);
+free_inst:
+	gb_video_destroy(&inst->video.base);
+	free(inst);
+	session->frames_done = frames_done;
+	session->cycles = cycles;
+	session->failed = failed;
+} // end run_session()
@@ -1,18 +1,21 @@
 #include <assert.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <threads.h>
 #include <time.h>
-#include <SDL.h>
 #include "gb/core.h"
 #include "gb/cpu.h"
 #include "gb/cpu/interpreter.h"
+#include "gb/cpu/jit.h"
 #include "gb/log.h"
 #include "gb/mem.h"
 #include "gb/pad.h"
 #include "gb/ppu.h"
+#include "gb/ppu/buf.h"
 #include "gb/sch.h"
+#include "gb/video.h"
 
 #undef GB_LOG_MAX_LEVEL
 #define GB_LOG_MAX_LEVEL LVL_INF
@@ -23,18 +26,6 @@ enum {
 	NSEC_PER_FRAME = 16742706
 };
 
-struct input_state {
-	uint8_t pad;
-	uint8_t fast_forward;
-};
-
-static int
-handle_event(SDL_Event* restrict event, struct input_state* restrict state);
-static void
-handle_keydown(const SDL_KeyboardEvent* restrict kevent, struct input_state* restrict input);
-static void
-handle_keyup(const SDL_KeyboardEvent* restrict kevent, struct input_state* restrict input);
-
 static inline void
 add_timespec_nsec(
 		struct timespec* restrict dst,
@@ -74,16 +65,99 @@ cmp_timespec(
 	return lhs->tv_nsec - rhs->tv_nsec;
 } // end cmp_timespec()
 
+//=======================================================================
+// doc struct pipeline
+// Shared by the threads of gb_core_run_pipelined().
+// Members:
+// * core, buf: Emulated, and handed off through, by the emulation
+//   thread.
+// * pad, fast_forward: Host input, as last polled by the render thread.
+// * quit: Set by the render thread to stop the emulation thread.
+//=======================================================================
+// def struct pipeline
+struct pipeline {
+	struct gb_core* core;
+	struct gb_ppu_buf* buf;
+	atomic_uint_fast8_t pad;
+	atomic_bool fast_forward;
+	atomic_bool quit;
+}; // end struct pipeline
+
+//=======================================================================
+// doc pace_frame()
+// Sleeps until `next_frame_start_time` plus a frame, unless fast
+// forwarding or behind schedule, and advances it to the start of the
+// next frame. Returns nonzero on failure.
+//=======================================================================
+// def pace_frame()
+static uint8_t
+pace_frame(struct timespec* restrict next_frame_start_time, uint8_t fast_forward) {
+	// Add total frame time to the start time of this frame to get
+	// the start time of the next frame.
+	add_timespec_nsec(next_frame_start_time, NSEC_PER_FRAME);
+	// Calculate time between now and when
+	// the next frame should execute:
+	struct timespec now;
+	if (timespec_get(&now, TIME_UTC) != TIME_UTC) {
+		LOGF("timespec_get() failure.");
+		return 1;
+	}
+	
+	if (!fast_forward && cmp_timespec(next_frame_start_time, &now) >= 0) {
+		// Normal (frame-capped) speed, and ahead of or on schedule.
+		// Sleep until the next frame:
+		struct timespec sleep_duration;
+		sub_timespec(&sleep_duration, next_frame_start_time, &now);
+		LOGT("Sleeping for {.sec=%lld,.nsec=%lld}",
+				sleep_duration.tv_sec, sleep_duration.tv_nsec);
+		int sleep_result;
+		while (sleep_result = thrd_sleep(&sleep_duration, &sleep_duration)) {
+			LOGD("Sleep interrupted (%d). Remaining={.sec=%lld,.nsec=%lld}",
+					sleep_result, sleep_duration.tv_sec, sleep_duration.tv_nsec);
+			if (sleep_result < -1) {
+				LOGF("thrd_sleep() error.");
+				return 1;
+			}
+		} // end while (sleep interrupted)
+		LOGT("wake up");
+	} else {
+		// Either:
+		// 1. Fast forwarding, want to go as fast as possible, or
+		// 2. Behind schedule, and need to skip sleeping
+		// Either way, begin the next frame NOW.
+		*next_frame_start_time = now;
+	}
+	return 0;
+} // end pace_frame()
+
 //=======================================================================
 // def gb_core_init()
 uint8_t
 gb_core_init(struct gb_core* restrict core) {
+	return gb_core_init_rom(core, gb_mem_rom_filepath);
+} // end gb_core_init()
+
+//=======================================================================
+// def gb_core_init_rom()
+uint8_t
+gb_core_init_rom(struct gb_core* restrict core, const char* restrict rom_filepath) {
 	gb_cpu_init(core);
-	if (gb_mem_init(core))
+	if (gb_mem_init_rom(core, rom_filepath))
 		return 1;
 	gb_sch_init(core);
 	return 0;
-} // end gb_core_init()
+} // end gb_core_init_rom()
+
+//=======================================================================
+// def gb_core_destroy()
+// Releases the pak, saving its battery-backed RAM, and any JIT code.
+void
+gb_core_destroy(struct gb_core* restrict core) {
+	gb_mem_destroy(core);
+#ifdef GB_CPU_JIT
+	gb_cpu_jit_destroy(core);
+#endif
+} // end gb_core_destroy()
 
 //=======================================================================
 // def gb_core_run()
@@ -91,31 +165,26 @@ void
 gb_core_run(
 		struct gb_core* restrict core,
 		struct gb_ppu* restrict ppu) {
-	assert(!SDL_InitSubSystem(SDL_INIT_EVENTS)); // TODO
-
 	struct timespec next_frame_start_time;
 	if (timespec_get(&next_frame_start_time, TIME_UTC) != TIME_UTC) {
 		LOGF("timespec_get() failure.");
 		return;
 	}
-	struct input_state input = {.pad=gb_pad_init(), .fast_forward=0};
+	struct gb_video_input input = {.pad=gb_pad_init(), .fast_forward=0};
+	// Generation of the PPU state last presented; 0 is never handed off.
+	uint64_t shown = 0;
 	LOGT("enter main loop");
 	while (1) {
 		// Execute
 		gb_cpu_interpret_frame(core);
-		gb_mem_copy_ppu_state(core, &(ppu->state));
-		if (gb_dmg_draw(ppu))
+		gb_mem_view_ppu_state(core, &(ppu->state));
+		if (gb_dmg_draw_changed(ppu, &shown))
 			LOGF("gb_dmg_draw() failure");
 
 		// Host event handling
 		uint8_t old_pad = input.pad;
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
-			if (handle_event(&event, &input)) {
-				SDL_QuitSubSystem(SDL_INIT_EVENTS);
-				return;
-			}
-		} // end event polling
+		if (gb_video_poll(ppu->target, &input))
+			return;
 #undef GB_LOG_MAX_LEVEL
 #define GB_LOG_MAX_LEVEL LVL_TRC
 		LOGD("pad=0x%02X -> pad=0x%02X", old_pad, input.pad);
@@ -123,129 +192,83 @@ gb_core_run(
 #define GB_LOG_MAX_LEVEL LVL_INF
 		gb_core_set_pad(core, input.pad);
 
-		// Add total frame time to the start time of this frame to get
-		// the start time of the next frame.
-		add_timespec_nsec(&next_frame_start_time, NSEC_PER_FRAME);
-		// Calculate time between now and when
-		// the next frame should execute:
-		struct timespec now;
-		if (timespec_get(&now, TIME_UTC) != TIME_UTC) {
-			LOGF("timespec_get() failure.");
+		if (pace_frame(&next_frame_start_time, input.fast_forward))
 			return;
-		}
-		
-		if (!input.fast_forward && cmp_timespec(&next_frame_start_time, &now) >= 0) {
-			// Normal (frame-capped) speed, and ahead of or on schedule.
-			// Sleep until the next frame:
-			struct timespec sleep_duration;
-			sub_timespec(&sleep_duration, &next_frame_start_time, &now);
-			LOGT("Sleeping for {.sec=%lld,.nsec=%lld}",
-					sleep_duration.tv_sec, sleep_duration.tv_nsec);
-			int sleep_result;
-			while (sleep_result = thrd_sleep(&sleep_duration, &sleep_duration)) {
-				LOGD("Sleep interrupted (%d). Remaining={.sec=%lld,.nsec=%lld}",
-						sleep_result, sleep_duration.tv_sec, sleep_duration.tv_nsec);
-				if (sleep_result < -1) {
-					LOGF("thrd_sleep() error.");
-					return;
-				}
-			} // end while (sleep interrupted)
-			LOGT("wake up");
-		} else {
-			// Either:
-			// 1. Fast forwarding, want to go as fast as possible, or
-			// 2. Behind schedule, and need to skip sleeping
-			// Either way, begin the next frame NOW.
-			next_frame_start_time = now;
-		}
 	} // end while (1)
 } // end gb_core_run()
 
-void
-gb_core_set_pad(struct gb_core* restrict core, uint8_t gb_pad) {
-	gb_mem_set_pad(core, gb_pad);
-} // end gb_core_update_pad()
-
+//=======================================================================
+// doc emulate_main()
+// Emulation thread of gb_core_run_pipelined(): emulates frames at the
+// emulated frame rate, handing each off to the render thread if a
+// buffer is free, until told to quit.
+//=======================================================================
+// def emulate_main()
 static int
-handle_event(SDL_Event* restrict event, struct input_state* restrict input) {
-	switch(event->type) {
-		case SDL_KEYDOWN:
-			handle_keydown(&(event->key), input);
-			break;
-		case SDL_KEYUP:
-			handle_keyup(&(event->key), input);
-			break;
-		case SDL_WINDOWEVENT:
-			if (event->window.event == SDL_WINDOWEVENT_CLOSE)
-				return 1;
+emulate_main(void* arg) {
+	struct pipeline* pipe = arg;
+	struct timespec next_frame_start_time;
+	if (timespec_get(&next_frame_start_time, TIME_UTC) != TIME_UTC) {
+		LOGF("timespec_get() failure.");
+		gb_ppu_buf_close(pipe->buf);
+		return 1;
+	}
+	while (!atomic_load(&(pipe->quit))) {
+		gb_cpu_interpret_frame(pipe->core);
+		struct gb_ppu* ppu = gb_ppu_buf_acquire(pipe->buf);
+		if (ppu != NULL) {
+			gb_mem_copy_ppu_state(pipe->core, &(ppu->state));
+			gb_ppu_buf_publish(pipe->buf);
+		}
+
+		gb_core_set_pad(pipe->core, atomic_load(&(pipe->pad)));
+		if (pace_frame(&next_frame_start_time, atomic_load(&(pipe->fast_forward))))
 			break;
 	}
+	gb_ppu_buf_close(pipe->buf);
 	return 0;
-} // end handle_event()
+} // end emulate_main()
 
-static void
-handle_keydown(const SDL_KeyboardEvent* restrict kevent, struct input_state* restrict input) {
-	switch (kevent->keysym.sym) {
-		case SDLK_f:
-			input->fast_forward = 1;
-			break;
-		case SDLK_RIGHT:
-			input->pad = gb_pad_press(input->pad, GBPAD_RIGHT);
-			break;
-		case SDLK_LEFT:
-			input->pad = gb_pad_press(input->pad, GBPAD_LEFT);
-			break;
-		case SDLK_UP:
-			input->pad = gb_pad_press(input->pad, GBPAD_UP);
-			break;
-		case SDLK_DOWN:
-			input->pad = gb_pad_press(input->pad, GBPAD_DOWN);
-			break;
-		case SDLK_z:
-			input->pad = gb_pad_press(input->pad, GBPAD_A);
-			break;
-		case SDLK_x:
-			input->pad = gb_pad_press(input->pad, GBPAD_B);
-			break;
-		case SDLK_RSHIFT:
-			input->pad = gb_pad_press(input->pad, GBPAD_SELECT);
-			break;
-		case SDLK_RETURN:
-			input->pad = gb_pad_press(input->pad, GBPAD_START);
-			break;
-	} // end switch()
-} // end handle_keydown()
-
-static void
-handle_keyup(const SDL_KeyboardEvent* restrict kevent, struct input_state* restrict input) {
-	switch (kevent->keysym.sym) {
-		case SDLK_f:
-			input->fast_forward = 0;
-			break;
-		case SDLK_RIGHT:
-			input->pad = gb_pad_release(input->pad, GBPAD_RIGHT);
-			break;
-		case SDLK_LEFT:
-			input->pad = gb_pad_release(input->pad, GBPAD_LEFT);
-			break;
-		case SDLK_UP:
-			input->pad = gb_pad_release(input->pad, GBPAD_UP);
-			break;
-		case SDLK_DOWN:
-			input->pad = gb_pad_release(input->pad, GBPAD_DOWN);
-			break;
-		case SDLK_z:
-			input->pad = gb_pad_release(input->pad, GBPAD_A);
-			break;
-		case SDLK_x:
-			input->pad = gb_pad_release(input->pad, GBPAD_B);
-			break;
-		case SDLK_RSHIFT:
-			input->pad = gb_pad_release(input->pad, GBPAD_SELECT);
-			break;
-		case SDLK_RETURN:
-			input->pad = gb_pad_release(input->pad, GBPAD_START);
+//=======================================================================
+// def gb_core_run_pipelined()
+void
+gb_core_run_pipelined(
+		struct gb_core* restrict core,
+		struct gb_ppu_buf* restrict buf) {
+	assert(buf->count > 0);
+	struct gb_video* target = buf->slots[0].target;
+	struct gb_video_input input = {.pad=gb_pad_init(), .fast_forward=0};
+	struct pipeline pipe = {.core=core, .buf=buf};
+	atomic_init(&(pipe.pad), input.pad);
+	atomic_init(&(pipe.fast_forward), input.fast_forward);
+	atomic_init(&(pipe.quit), 0);
+
+	thrd_t emulator;
+	if (thrd_create(&emulator, emulate_main, &pipe) != thrd_success) {
+		LOGF("Unable to start emulation thread.");
+		return;
+	}
+	// Generation of the PPU state last presented; 0 is never handed off.
+	uint64_t shown = 0;
+	LOGT("enter render loop");
+	struct gb_ppu* ppu;
+	while ((ppu = gb_ppu_buf_wait(buf)) != NULL) {
+		if (gb_dmg_draw_changed(ppu, &shown))
+			LOGF("gb_dmg_draw() failure");
+		gb_ppu_buf_release(buf);
+
+		if (gb_video_poll(target, &input))
 			break;
-	} // end switch()
-} // end handle_keyup()
+		atomic_store(&(pipe.pad), input.pad);
+		atomic_store(&(pipe.fast_forward), input.fast_forward);
+	}
+	atomic_store(&(pipe.quit), 1);
+	thrd_join(emulator, NULL);
+	LOGI("Frames dropped for lack of a free PPU buffer: %" PRIuFAST64 ".",
+			(uint_fast64_t)atomic_load(&(buf->dropped)));
+} // end gb_core_run_pipelined()
 
+void
+gb_core_set_pad(struct gb_core* restrict core, uint8_t gb_pad) {
+	gb_mem_set_pad(core, gb_pad);
+} // end gb_core_update_pad()
@@ -2,6 +2,8 @@
 #include <stdint.h>
 #include "gb/core/typedef.h"
 #include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/jit.h"
 #include "gb/cpu/reg.h"
 #define GB_LOG_MAX_LEVEL LVL_TRC
 #include "gb/log.h"
@@ -25,6 +27,13 @@ gb_cpu_init(struct gb_core* restrict core) {
 	core->cpu.fh = 0;
 	core->cpu.fc = 0;
 	core->cpu.state = 0;
+#ifdef GB_CPU_LAZY_FLAGS
+	core->cpu.lazy.op = LAZY_NONE;
+#endif
+	gb_cpu_bcache_init(core);
+#ifdef GB_CPU_JIT
+	gb_cpu_jit_init(core);
+#endif
 } // end gb_cpu_init()
 
 //=======================================================================
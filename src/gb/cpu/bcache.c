@@ -0,0 +1,323 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/opc.h"
+#include "gb/cpu/opc/decoder/oper.h"
+#include "gb/cpu/opc/decoder/opnd.h"
+#include "gb/mem.h"
+#include "gb/mem/region.h"
+
+#define SELF (core->cpu.bcache)
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static inline uint8_t
+cacheable_region(
+		const struct gb_core* restrict core,
+		uint16_t pc,
+		uint16_t* restrict bank,
+		uint16_t* restrict end);
+static inline uint16_t
+slot(uint16_t pc);
+static uint8_t
+build_block(
+		struct gb_core* restrict core,
+		struct gb_cpu_block* restrict block,
+		uint16_t pc, uint16_t bank, uint16_t end);
+static inline uint8_t
+decode_uop(
+		const struct gb_core* restrict core,
+		struct gb_cpu_uop* restrict uop,
+		uint16_t pc);
+static inline uint8_t
+operand_size(uint8_t opnd_id);
+static inline uint8_t
+ends_block(uint8_t oper_id);
+static inline void
+invalidate_block(struct gb_core* restrict core, struct gb_cpu_block* restrict block);
+static inline void
+watch_block(
+		struct gb_core* restrict core,
+		const struct gb_cpu_block* restrict block,
+		int8_t delta);
+static const struct gb_cpu_uop*
+decode_scratch(struct gb_core* restrict core, uint16_t pc);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_cpu_bcache_init()
+void
+gb_cpu_bcache_init(struct gb_core* restrict core) {
+	for (uint16_t i = 0; i < GB_CPU_BCACHE_SLOTS; ++i) {
+		SELF.blocks[i].valid = 0;
+		invalidate_block(core, SELF.blocks + i);
+	}
+	memset(SELF.watch, 0, sizeof(SELF.watch));
+	SELF.current = NULL;
+	SELF.scratch[1].pc = GB_CPU_UOP_NO_PC;
+	SELF.rom_bank[0] = 0;
+	SELF.rom_bank[1] = 1;
+} // end gb_cpu_bcache_init()
+
+//=======================================================================
+// def gb_cpu_bcache_fetch()
+const struct gb_cpu_uop*
+gb_cpu_bcache_fetch(struct gb_core* restrict core) {
+	uint16_t pc = core->cpu.pc;
+	uint16_t bank;
+	uint16_t end;
+	if (!cacheable_region(core, pc, &bank, &end))
+		return decode_scratch(core, pc);
+
+	struct gb_cpu_block* block = SELF.blocks + slot(pc);
+	if (!block->valid || block->pc != pc || block->bank != bank) {
+		// Miss. Evict whatever occupied the slot.
+		invalidate_block(core, block);
+		if (!build_block(core, block, pc, bank, end))
+			return decode_scratch(core, pc);
+	}
+	SELF.current = block;
+	return block->uop;
+} // end gb_cpu_bcache_fetch()
+
+//=======================================================================
+// def gb_cpu_bcache_on_rom_bank()
+void
+gb_cpu_bcache_on_rom_bank(
+		struct gb_core* restrict core,
+		uint16_t bank0,
+		uint16_t bank) {
+	SELF.rom_bank[0] = bank0;
+	SELF.rom_bank[1] = bank;
+	// Blocks of old banks remain cached under their own bank, except
+	// for one which is currently executing from a region that was
+	// switched: its remaining micro-ops no longer reflect mapped memory.
+	struct gb_cpu_block* current = SELF.current;
+	if (current && current->valid && current->pc < MEM_E_ROM2
+	 && current->bank != SELF.rom_bank[current->pc >= MEM_B_ROM2])
+		invalidate_block(core, current);
+} // end gb_cpu_bcache_on_rom_bank()
+
+//=======================================================================
+// def gb_cpu_bcache_on_code_write()
+void
+gb_cpu_bcache_on_code_write(struct gb_core* restrict core, uint16_t addr) {
+	// Only a block beginning at most GB_CPU_BLOCK_MAX_BYTES - 1 bytes
+	// before `addr` can contain it, and each address has a single slot.
+	uint16_t first = (addr >= GB_CPU_BLOCK_MAX_BYTES - 1)
+		? addr - (GB_CPU_BLOCK_MAX_BYTES - 1) : 0;
+	for (uint32_t pc = first; pc <= addr; ++pc) {
+		struct gb_cpu_block* block = SELF.blocks + slot(pc);
+		if (block->valid && block->pc == pc && block->end > addr)
+			invalidate_block(core, block);
+	}
+} // end gb_cpu_bcache_on_code_write()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc cacheable_region()
+// Returns nonzero if code at `pc` may be cached, in which case the
+// bank to tag its block with, and the address at which its memory
+// region ends, are written to `bank` and `end`.
+//=======================================================================
+// def cacheable_region()
+static inline uint8_t
+cacheable_region(
+		const struct gb_core* restrict core,
+		uint16_t pc,
+		uint16_t* restrict bank,
+		uint16_t* restrict end) {
+	if (pc < MEM_E_ROM1) {
+		*bank = SELF.rom_bank[0];
+		*end = MEM_E_ROM1;
+	} else if (pc < MEM_E_ROM2) {
+		*bank = SELF.rom_bank[1];
+		*end = MEM_E_ROM2;
+	} else if (pc >= MEM_B_RAM1 && pc < MEM_E_RAM2) {
+		*bank = 0;
+		*end = MEM_E_RAM2;
+	} else if (pc >= MEM_B_HRAM && pc < MEM_E_HRAM) {
+		*bank = 0;
+		*end = MEM_E_HRAM;
+	} else {
+		return 0;
+	}
+	return 1;
+} // end cacheable_region()
+
+//=======================================================================
+// doc slot()
+// Fibonacci hash of `pc`, so that blocks which are a multiple of
+// GB_CPU_BCACHE_SLOTS bytes apart do not always collide.
+//=======================================================================
+// def slot()
+static inline uint16_t
+slot(uint16_t pc) {
+	static_assert(GB_CPU_BCACHE_SLOTS == 1 << 10);
+	return (uint16_t)(pc * 40503u) >> (16 - 10);
+} // end slot()
+
+//=======================================================================
+// doc build_block()
+// Decodes the block beginning at `pc` into `block`.
+// Returns 0 if not even the first instruction fits within the region
+// ending at `end`.
+//=======================================================================
+// def build_block()
+static uint8_t
+build_block(
+		struct gb_core* restrict core,
+		struct gb_cpu_block* restrict block,
+		uint16_t pc, uint16_t bank, uint16_t end) {
+	uint8_t len = 0;
+	uint32_t addr = pc;
+	while (len < GB_CPU_BLOCK_MAX_UOPS) {
+		struct gb_cpu_uop* uop = block->uop + len;
+		uint8_t oper_id = decode_uop(core, uop, addr);
+		uint8_t size = (uint8_t)(uop->pc); // See decode_uop()
+		if (addr + size > end)
+			break; // Instruction straddles the end of the region.
+		uop->pc = addr;
+		addr += size;
+		++len;
+		if (ends_block(oper_id))
+			break;
+	}
+	if (len == 0) {
+		invalidate_block(core, block);
+		return 0;
+	}
+
+	block->uop[len].pc = GB_CPU_UOP_NO_PC;
+	block->pc = pc;
+	block->end = addr;
+	block->bank = bank;
+	block->len = len;
+	block->valid = 1;
+	watch_block(core, block, 1);
+	return 1;
+} // end build_block()
+
+//=======================================================================
+// doc decode_uop()
+// Decodes the instruction at `pc` into `uop`, using the opcode decoder
+// to determine the size of its operands.
+// Returns the instruction's operation ID. The size of the instruction
+// in bytes is temporarily stored in `uop->pc`; callers must overwrite
+// it with the instruction's address.
+//=======================================================================
+// def decode_uop()
+static inline uint8_t
+decode_uop(
+		const struct gb_core* restrict core,
+		struct gb_cpu_uop* restrict uop,
+		uint16_t pc) {
+	struct gb_opc_components opc;
+	gb_opc_components_at(&opc, core, pc);
+	uop->opcode = gb_mem_direct_read(core, pc);
+
+	uint8_t size = 1;
+	if (uop->opcode == 0xCB)
+		size = 2;
+	else if (opc.oper_id != (uint8_t)OPER_INVALID)
+		size += operand_size(opc.opnd1_id) + operand_size(opc.opnd2_id);
+
+	uop->imm = 0;
+	if (size >= 2)
+		uop->imm = gb_mem_direct_read(core, pc + 1);
+	if (size >= 3)
+		uop->imm |= gb_mem_direct_read(core, pc + 2) << 8;
+	uop->pc = size;
+	return opc.oper_id;
+} // end decode_uop()
+
+//=======================================================================
+// doc operand_size()
+// Returns the number of bytes that an operand occupies after the opcode.
+//=======================================================================
+// def operand_size()
+static inline uint8_t
+operand_size(uint8_t opnd_id) {
+	if ((opnd_id & (OPND_IMMED | OPND_AFTER)) != (OPND_IMMED | OPND_AFTER))
+		return 0; // Register, flag, or encoded within the opcode.
+	return (opnd_id & OPND_16BIT) ? 2 : 1;
+} // end operand_size()
+
+//=======================================================================
+// doc ends_block()
+// Returns nonzero if an instruction may continue anywhere other than
+// the instruction following it.
+//=======================================================================
+// def ends_block()
+static inline uint8_t
+ends_block(uint8_t oper_id) {
+	return oper_id == (uint8_t)OPER_INVALID
+	    || oper_id == OPER_HALT
+	    || oper_id == OPER_STOP
+	    || (oper_id >= OPER_BRANCH_START && oper_id < OPER_BRANCH_END);
+} // end ends_block()
+
+//=======================================================================
+// doc invalidate_block()
+// Marks `block` invalid, releasing its watches, and poisons its
+// micro-ops so that an interpreter part-way through the block stops
+// following it.
+//=======================================================================
+// def invalidate_block()
+static inline void
+invalidate_block(struct gb_core* restrict core, struct gb_cpu_block* restrict block) {
+	if (block->valid)
+		watch_block(core, block, -1);
+	block->valid = 0;
+	for (uint8_t i = 0; i <= GB_CPU_BLOCK_MAX_UOPS; ++i)
+		block->uop[i].pc = GB_CPU_UOP_NO_PC;
+} // end invalidate_block()
+
+//=======================================================================
+// doc watch_block()
+// Adds `delta` to the watch count of every granule covered by `block`,
+// if it lies in writable memory.
+//=======================================================================
+// def watch_block()
+static inline void
+watch_block(
+		struct gb_core* restrict core,
+		const struct gb_cpu_block* restrict block,
+		int8_t delta) {
+	if (block->pc < MEM_B_RAM1)
+		return;
+	uint16_t last = (block->end - 1) >> GB_CPU_BCACHE_GRANULE_BITS;
+	for (uint16_t g = block->pc >> GB_CPU_BCACHE_GRANULE_BITS; g <= last; ++g) {
+		assert(delta > 0 || SELF.watch[g] > 0);
+		SELF.watch[g] += delta;
+	}
+} // end watch_block()
+
+//=======================================================================
+// doc decode_scratch()
+// Decodes the single instruction at `pc` without caching it.
+//=======================================================================
+// def decode_scratch()
+static const struct gb_cpu_uop*
+decode_scratch(struct gb_core* restrict core, uint16_t pc) {
+	decode_uop(core, SELF.scratch, pc);
+	SELF.scratch[0].pc = pc;
+	SELF.current = NULL;
+	return SELF.scratch;
+} // end decode_scratch()
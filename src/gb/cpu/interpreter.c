@@ -1,7 +1,10 @@
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include "gb/core/typedef.h"
 #include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/jit.h"
 #include "gb/cpu/opc.h"
 #include "gb/cpu/reg.h"
 #define GB_LOG_MAX_LEVEL LVL_TRC
@@ -10,6 +13,18 @@
 #include "gb/mem/io.h"
 #include "gb/sch.h"
 
+// Instruction dispatch method.
+// Threaded dispatch ends each instruction's handler with a jump straight
+// to the handler of the next instruction, through a table of handler
+// label addresses (one for unprefixed opcodes, one for CB-prefixed
+// opcodes). This requires the GCC "labels as values" extension.
+// Otherwise, a portable switch is used.
+// Define GB_CPU_DISPATCH_SWITCH to force the switch on GCC-compatible
+// compilers.
+#if defined(__GNUC__) && !defined(GB_CPU_DISPATCH_SWITCH)
+#define GB_CPU_DISPATCH_THREADED
+#endif
+
 //=======================================================================
 //-----------------------------------------------------------------------
 // Internal function declarations
@@ -19,12 +34,20 @@ static inline uint8_t
 call_isr(struct gb_core* restrict core);
 //static inline uint8_t
 //perform_halt(struct gb_core* restrict core);
+static void
+interpret(struct gb_core* restrict core);
+#ifndef GB_CPU_DISPATCH_THREADED
 static inline void
-interpret_once(struct gb_core* restrict core);
-static inline void
-CB_interpret_once(struct gb_core* restrict core);
-static inline void
+CB_interpret_once(struct gb_core* restrict core, uint8_t cb_opcode);
+#endif
+static inline uint8_t
 execute_EI(struct gb_core* restrict core);
+static inline uint8_t
+resolve_state(struct gb_core* restrict core);
+#ifdef GB_CPU_LAZY_FLAGS
+static void
+materialize_flags(struct gb_core* restrict core);
+#endif
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -35,8 +58,7 @@ execute_EI(struct gb_core* restrict core);
 void
 gb_cpu_interpret_frame(struct gb_core* restrict core) {
 	while (1) {
-		while (!(core->cpu.state))
-			interpret_once(core);
+		interpret(core);
 		if (core->cpu.state & CPUSTATE_INTERRUPTED) {
 			LOGD("Interrupt reported. Calling interrupt service routine...");
 			if (call_isr(core) == IO_IFE_VBLANK) {
@@ -44,13 +66,24 @@ gb_cpu_interpret_frame(struct gb_core* restrict core) {
 				return;
 			}
 		} else if (core->cpu.state & CPUSTATE_HALTED) {
-			while (!gb_mem_io_pending_interrupts(core))
-				gb_sch_advance(core, 1);
+			gb_sch_halt(core);
 			core->cpu.state &= ~CPUSTATE_HALTED;
 		}
 	}
 } // end interpret_frame()
 
+//=======================================================================
+// def gb_cpu_sync_flags()
+void
+gb_cpu_sync_flags(struct gb_core* restrict core) {
+#ifdef GB_CPU_LAZY_FLAGS
+	if (core->cpu.lazy.op != LAZY_NONE)
+		materialize_flags(core);
+#else
+	(void)core;
+#endif
+} // end gb_cpu_sync_flags()
+
 //=======================================================================
 //-----------------------------------------------------------------------
 // Internal function definitions
@@ -70,6 +103,10 @@ gb_cpu_interpret_frame(struct gb_core* restrict core) {
 #define WRITE_MEMu8(addr, value) gb_mem_u8write(CORE, addr, value)
 #define WRITE_MEMu16(addr, value) gb_mem_u16write(CORE, addr, value)
 #define WRITE_MEMFF(addr, value) gb_mem_u8writeff(CORE, addr, value)
+// Immediate operand of the current instruction (see gb/cpu/bcache.h).
+#define IMMu8 ((uint8_t)uop->imm)
+#define IMMs8 ((int8_t)uop->imm)
+#define IMMu16 (uop->imm)
 
 // Flag bit position constants
 enum flag_bit_position {
@@ -112,6 +149,46 @@ unpack_flags(struct gb_cpu* restrict cpu) {
 #define fH (CPU.fh)
 #define fC (CPU.fc)
 
+// Lazy flag evaluation.
+// With GB_CPU_LAZY_FLAGS defined, 8-bit ADD/ADC/SUB/SBC/CP/AND/XOR/OR
+// only record their operation and operands through SET_FLAGS(), and the
+// flags are computed by materialize_flags() once something needs them.
+// SYNC_FLAGS() must precede any read of the flags, as well as any write
+// which a later materialization would otherwise overwrite.
+// Without GB_CPU_LAZY_FLAGS, SET_FLAGS() computes the flags immediately.
+#ifdef GB_CPU_LAZY_FLAGS
+#define SYNC_FLAGS() sync_flags(CORE)
+#define SET_FLAGS(lazy_op, proc, lhs, rhs, carry) \
+	(CPU.lazy = (struct gb_cpu_lazy_flags){ (lazy_op), (lhs), (rhs), (carry) })
+static inline void
+sync_flags(struct gb_core* restrict core) {
+	if (CPU.lazy.op != LAZY_NONE)
+		materialize_flags(core);
+} // end sync_flags()
+#else
+#define SYNC_FLAGS() ((void)0)
+#define SET_FLAGS(lazy_op, proc, lhs, rhs, carry) proc(CORE, lhs, rhs, carry)
+#endif
+
+//=======================================================================
+// doc adv_cycles()
+// Consume the specified number of cycles from the scheduler's budget,
+// entering the scheduler only once the next event is due.
+//-----------------------------------------------------------------------
+// Parameters:
+// * core: Pointer to the emulated Game Boy core.
+//         Behavior is undefined if `core` does not point to a valid
+//         `struct gb_core` object.
+// * cycles: The number of cycles to consume.
+//=======================================================================
+// def adv_cycles()
+static inline void
+(adv_cycles)(struct gb_core* restrict core, uint_fast8_t cycles) {
+	core->sch.budget -= cycles;
+	if (core->sch.budget <= 0)
+		gb_sch_run_due(core);
+} // end adv_cycles()
+
 //=======================================================================
 // doc adv_cpu()
 // Advance emulated CPU by specified number of program bytes and cycles.
@@ -130,7 +207,7 @@ static inline void
 		uint_fast8_t inc_pc,
 		uint_fast8_t cycles) {
 	rPC += inc_pc;
-	gb_sch_advance(core, cycles);
+	adv_cycles(core, cycles);
 } // end adv_cpu()
 
 //=======================================================================
@@ -141,73 +218,92 @@ static inline uint8_t
 	return rhs;
 } // end LD8()
 //-----------------------------------------------------------------------
-static inline uint8_t
-(ADD8)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
-	uint_fast16_t sum = lhs + rhs;
+// Flag computations, shared by the operations below and by
+// materialize_flags().
+static inline void
+(ADD8_flags)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs, uint8_t carry) {
+	uint_fast16_t sum = lhs + rhs + carry;
 	fZ = (sum == 0);
 	fN = 0;
-	fH = ((lhs & 0xF) + (rhs & 0xF)) > 0xF;
+	fH = ((lhs & 0xF) + (rhs & 0xF) + carry) > 0xF;
 	fC = sum > 0xFF;
-	return (uint8_t)sum;
+} // end ADD8_flags()
+//-----------------------------------------------------------------------
+static inline void
+(SUB_flags)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs, uint8_t carry) {
+	uint_fast16_t diff = lhs - rhs - carry;
+	fZ = (diff == 0);
+	fN = 1;
+	fH = ((lhs & 0xF) - (rhs & 0xF) - carry) > 0xF;
+	fC = diff > 0xFF;
+} // end SUB_flags()
+//-----------------------------------------------------------------------
+static inline void
+(AND_flags)(struct gb_core* restrict core, uint8_t result, uint8_t, uint8_t) {
+	fZ = (result == 0);
+	fN = fC = 0;
+	fH = 1;
+} // end AND_flags()
+//-----------------------------------------------------------------------
+// Used by both OR and XOR.
+static inline void
+(OR_flags)(struct gb_core* restrict core, uint8_t result, uint8_t, uint8_t) {
+	fZ = (result == 0);
+	fN = fH = fC = 0;
+} // end OR_flags()
+//-----------------------------------------------------------------------
+static inline uint8_t
+(ADD8)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
+	SET_FLAGS(LAZY_ADD, ADD8_flags, lhs, rhs, 0);
+	return lhs + rhs;
 } // end ADD8()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (ADC)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
-	uint_fast16_t sum = lhs + rhs + fC;
-	fZ = (sum == 0);
-	fN = 0;
-	fH = ((lhs & 0xF) + (rhs & 0xF) + fC) > 0xF;
-	fC = sum > 0xFF;
-	return (uint8_t)sum;
+	SYNC_FLAGS();
+	uint8_t carry = fC;
+	SET_FLAGS(LAZY_ADD, ADD8_flags, lhs, rhs, carry);
+	return lhs + rhs + carry;
 } // end ADC()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SUB)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
-	uint_fast16_t diff = lhs - rhs;
-	fZ = (diff == 0);
-	fN = 1;
-	fH = ((lhs & 0xF) - (rhs & 0xF)) > 0xF;
-	fC = diff > 0xFF;
-	return (uint8_t)diff;
+	SET_FLAGS(LAZY_SUB, SUB_flags, lhs, rhs, 0);
+	return lhs - rhs;
 } // end SUB()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SBC)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
-	uint_fast16_t diff = lhs - rhs - fC;
-	fZ = (diff == 0);
-	fN = 1;
-	fH = ((lhs & 0xF) - (rhs & 0xF) - fC) > 0xF;
-	fC = diff > 0xFF;
-	return (uint8_t)diff;
+	SYNC_FLAGS();
+	uint8_t carry = fC;
+	SET_FLAGS(LAZY_SUB, SUB_flags, lhs, rhs, carry);
+	return lhs - rhs - carry;
 } // end SBC()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (AND)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
 	uint8_t result = lhs & rhs;
-	fZ = (result == 0);
-	fN = fC = 0;
-	fH = 1;
+	SET_FLAGS(LAZY_AND, AND_flags, result, 0, 0);
 	return result;
 } // end AND()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (XOR)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
 	uint8_t result = lhs ^ rhs;
-	fZ = (result == 0);
-	fN = fH = fC = 0;
+	SET_FLAGS(LAZY_OR, OR_flags, result, 0, 0);
 	return result;
 } // end XOR()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (OR)(struct gb_core* restrict core, uint8_t lhs, uint8_t rhs) {
 	uint8_t result = lhs | rhs;
-	fZ = (result == 0);
-	fN = fH = fC = 0;
+	SET_FLAGS(LAZY_OR, OR_flags, result, 0, 0);
 	return result;
 } // end OR()
 //-----------------------------------------------------------------------
 static inline uint8_t
 (INC8)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	++target;
 	fZ = (target == 0);
 	fN = 0;
@@ -217,6 +313,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (DEC8)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	--target;
 	fZ = (target == 0);
 	fN = 1;
@@ -247,6 +344,7 @@ static inline uint16_t
 //-----------------------------------------------------------------------
 static inline void
 (ADD_HL)(struct gb_core* restrict core, uint16_t rhs, uint16_t) {
+	SYNC_FLAGS();
 	uint32_t sum = rHL + rhs;
 	fN = 0;
 	fH = (((rHL & 0xFFF) + (rhs & 0xFFF)) > 0xFFF);
@@ -255,10 +353,10 @@ static inline void
 } // end ADD_HL()
 //-----------------------------------------------------------------------
 static inline uint16_t
-(ADD_SP_si8)(struct gb_core* restrict core) {
+(ADD_SP_si8)(struct gb_core* restrict core, int8_t si8) {
+	SYNC_FLAGS();
 	// DOES NOT MODIFY rSP WITHIN FUNCTION
-	int8_t si8 = READ_MEMs8(rPC+1);
-	uint16_t sum = rSP + READ_MEMs8(rPC+1);
+	uint16_t sum = rSP + si8;
 	fZ = fN = 0;
 	fH = (((rSP & 0xFFF) + si8) > 0xFFF);
 	fC = (sum < rSP);
@@ -280,6 +378,7 @@ static inline uint16_t
 //=======================================================================
 static inline uint8_t
 (RLCA)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	fC = (target >> 7);
 	fZ = fN = fH = 0;
 	return ((target << 1) | fC);
@@ -287,6 +386,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RRCA)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	fC = (target & 0x1);
 	fZ = fN = fH = 0;
 	return ((target >> 1) | (fC << 7));
@@ -294,6 +394,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RLA)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	uint8_t prev_fC = fC;
 	fC = (target >> 7);
 	fZ = fN = fH = 0;
@@ -302,6 +403,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RRA)(struct gb_core* restrict core, uint8_t target, uint8_t) {
+	SYNC_FLAGS();
 	uint8_t prev_fC = fC;
 	fC = (target & 0x1);
 	fZ = fN = fH = 0;
@@ -310,6 +412,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RLC)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	fC = (arg >> 7);
 	arg = (arg << 1) | fC;
 	fZ = (arg == 0);
@@ -319,6 +422,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RRC)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	fC = (arg & 0x1);
 	arg = (arg >> 1) | (fC << 7);
 	fZ = (arg = 0);
@@ -328,6 +432,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RL)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	uint8_t prev_carry = fC;
 	fC = (arg >> 7);
 	arg = (arg << 1) | prev_carry;
@@ -338,6 +443,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (RR)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	uint8_t prev_carry = fC;
 	fC = (arg & 0x1);
 	arg = (arg >> 1) | (prev_carry << 7);
@@ -348,6 +454,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SLA)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	fC = (arg >> 7);
 	arg <<= 1;
 	fZ == (arg == 0);
@@ -357,6 +464,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SRA)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	fC = (arg & 0x1);
 	// Shift right 1 bit, maintaining bit 7's original value:
 	arg = (arg & 0x80) | (arg >> 1);
@@ -367,6 +475,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SWAP)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	arg = (arg << 4) | (arg >> 4);
 	fZ = (arg == 0);
 	fH = fN = fC = 0;
@@ -375,6 +484,7 @@ static inline uint8_t
 //-----------------------------------------------------------------------
 static inline uint8_t
 (SRL)(struct gb_core* restrict core, uint8_t arg, uint8_t) {
+	SYNC_FLAGS();
 	fC = (arg & 0x1);
 	arg >>= 1;
 	fZ = (arg == 0);
@@ -387,6 +497,7 @@ static inline uint8_t
 //=======================================================================
 static inline void
 (BIT)(struct gb_core* restrict core, uint8_t value, uint_fast8_t bit) {
+	SYNC_FLAGS();
 	fZ = (value & (1 << bit)) == 0;
 	fH = 1;
 	fN = 0;
@@ -405,54 +516,56 @@ static inline uint8_t
 //=======================================================================
 // Jump operations
 //=======================================================================
-// NOTE: No memory reads are performed for conditional jumps when the
-// condition is false. This differs from actual hardware, which means
-// that any untaken jumps to addresses pointing to registers with
-// on-read effects will differ from hardware.
+// NOTE: Immediate operands are taken from pre-decoded micro-ops, so no
+// memory reads are performed for them when the instruction executes,
+// and none at all for conditional jumps whose condition is false.
+// This differs from actual hardware, which means that any instruction
+// whose operands lie in registers with on-read effects will differ
+// from hardware.
 //
 // This should only matter for the prohibited memory mapping 0xFEA0-0xFEFF,
 // which will trigger OAM corruption when read during PPU mode 2 on
 // specific models of Game Boy, which I don't care to replicate at this
 // time.
 static inline void
-(JP)(struct gb_core* restrict core, uint_fast8_t flag) {
+(JP)(struct gb_core* restrict core, uint_fast8_t flag, uint16_t dst) {
 	if (flag) {
-		rPC = READ_MEMu16(rPC+1);
-		gb_sch_advance(core, 4);
+		rPC = dst;
+		adv_cycles(core, 4);
 	} else
 		adv_cpu(core, 3, 3);
 } // end JP()
 //-----------------------------------------------------------------------
 static inline void
-(JR)(struct gb_core* restrict core, uint_fast8_t flag) {
+(JR)(struct gb_core* restrict core, uint_fast8_t flag, int8_t offset) {
 	if (flag) {
 		// Signed relative jump from -126 to 129
-		rPC += READ_MEMs8(rPC+1);
+		rPC += offset;
 		adv_cpu(core, 2, 3);
 	} else
 		adv_cpu(core, 2, 2);
 } // end JR()
 //-----------------------------------------------------------------------
 static inline void
-(CALL)(struct gb_core* restrict core, uint_fast8_t flag) {
+(CALL)(struct gb_core* restrict core, uint_fast8_t flag, uint16_t dst) {
 	if (flag) {
 		// Push address of instruction following this one to the stack.
 		PUSH(core, rPC+3, 0);
-		rPC = READ_MEMu16(rPC+1);
-		gb_sch_advance(core, 6);
+		rPC = dst;
+		adv_cycles(core, 6);
 	} else
 		adv_cpu(core, 3, 3);
 } // end CALL()
 //-----------------------------------------------------------------------
 static inline void
-(RET)(struct gb_core* restrict core, uint_fast8_t flag) {
+(RET)(struct gb_core* restrict core, uint_fast8_t flag, uint16_t) {
 	if (flag) {
 		// Pop address from top of the stack, jump to it.
 		rPC = POP(core, 0, 0);
 		if (flag == 1) // Conditional
-			gb_sch_advance(core, 5);
+			adv_cycles(core, 5);
 		else // Unconditional
-			gb_sch_advance(core, 4);
+			adv_cycles(core, 4);
 	} else
 		adv_cpu(core, 1, 2);
 } // end RET()
@@ -461,7 +574,7 @@ static inline void
 (RST)(struct gb_core* restrict core, uint_fast8_t dst) {
 	PUSH(core, rPC+1, 0); // Address of next instruction.
 	rPC = dst;
-	gb_sch_advance(core, 4);
+	adv_cycles(core, 4);
 } // end RST()
 
 //=======================================================================
@@ -470,6 +583,7 @@ static inline void
 // Decimal-Adjust Accumulator
 static inline uint8_t
 (DAA)(struct gb_core* restrict core, uint8_t value, uint8_t) {
+	SYNC_FLAGS();
 	// If DAA is preceded by ADC A, 0x99
 	// when C = 1 and A = 0x99
 	// Then A = 0x33, H = 1, C = 1
@@ -514,6 +628,7 @@ static inline uint8_t
 // Invert all bits in provided value, return modified value.
 static inline uint8_t
 (CPL)(struct gb_core* restrict core, uint8_t value, uint8_t) {
+	SYNC_FLAGS();
 	fN = fH = 1;
 	return ~value;
 } // end CPL()
@@ -521,6 +636,7 @@ static inline uint8_t
 // Set carry flag.
 static inline void
 (SCF)(struct gb_core* restrict core, uint8_t, uint8_t) {
+	SYNC_FLAGS();
 	fN = fH = 0;
 	fC = 1;
 } // end SCF()
@@ -528,6 +644,7 @@ static inline void
 // Complement (invert) carry flag.
 static inline void
 (CCF)(struct gb_core* restrict core, uint8_t, uint8_t) {
+	SYNC_FLAGS();
 	fN = fH = 0;
 	fC = !fC;
 } // end CCF()
@@ -538,14 +655,135 @@ static inline void
 #define DISCARD_REGISTER(unused, src) (src)
 #define DISCARD_MEMORY(unused, src) (src)
 
+#ifdef GB_CPU_COUNT_INSTRUCTIONS
+#define COUNT_INSTRUCTION() (++CPU.instructions)
+#else
+#define COUNT_INSTRUCTION() ((void)0)
+#endif
+
+#define UNIMPLEMENTED_OPCODE() \
+	fprintf(stderr, "Unimplemented opcode 0x%X at 0x%X", READ_MEMu8(rPC), rPC)
+
+// Advances `uop` to the micro-op of the instruction at PC. Within a
+// block, this is simply the following micro-op; anything else (block
+// terminators, jumps, invalidated blocks) falls back to the cache,
+// or to the JIT which runs hot blocks natively (see gb/cpu/jit.h).
+#define NEXT_UOP() do { \
+	VERIFY_JIT(); \
+	if ((++uop)->pc != rPC) \
+		uop = FETCH_UOP(); \
+} while (0)
+#ifdef GB_CPU_JIT
+// Native code reads and writes flags directly.
+#define FETCH_UOP() (SYNC_FLAGS(), gb_cpu_jit_fetch(core))
+#else
+#define FETCH_UOP() gb_cpu_bcache_fetch(core)
+#endif
+#ifdef GB_CPU_JIT_VERIFY
+// Once the interpreter has run the instructions that the JIT ran,
+// compare their results.
+#define VERIFY_JIT() do { \
+	if (CPU.jit.verify_remaining && !--CPU.jit.verify_remaining) { \
+		SYNC_FLAGS(); \
+		gb_cpu_jit_verify(core); \
+	} \
+} while (0)
+#else
+#define VERIFY_JIT() ((void)0)
+#endif
+
+// Defines the handler for `opcode`. The handler consists of the
+// remaining arguments, and must leave PC pointing to the next
+// instruction.
+#define OPCASE(opcode, ...) OPCASE_(__COUNTER__, opcode, __VA_ARGS__)
+
+#ifdef GB_CPU_DISPATCH_THREADED
+//-----------------------------------------------------------------------
+// Threaded dispatch
+// Handlers are placed inside `if (0)` blocks, reachable only through
+// their label. The first call to interpret() falls through every
+// handler's table assignment to populate the tables.
+// Cores may run on several threads at once (see gb/batch.h), so first
+// calls are serialized by `init_lock`, and `initialized` is published
+// with release ordering once the tables are filled.
+#define OPLABEL(n) OPLABEL_(n)
+#define OPLABEL_(n) op_##n
+// The table that OPCASE() registers handlers in.
+#define OPTABLE op_table
+
+#define INTERPRET_BEGIN \
+	static void* op_table[0x100]; \
+	static void* cb_table[0x100]; \
+	static atomic_uchar initialized = 0; \
+	static atomic_flag init_lock = ATOMIC_FLAG_INIT; \
+	if (atomic_load_explicit(&initialized, memory_order_acquire)) \
+		NEXT; \
+	while (atomic_flag_test_and_set_explicit(&init_lock, memory_order_acquire)) \
+		; /* Another thread is filling the tables. */ \
+	if (atomic_load_explicit(&initialized, memory_order_relaxed)) { \
+		atomic_flag_clear_explicit(&init_lock, memory_order_release); \
+		NEXT; \
+	} \
+	for (uint16_t i = 0; i < 0x100; ++i) \
+		op_table[i] = cb_table[i] = &&unimplemented;
+#define INTERPRET_END \
+	atomic_store_explicit(&initialized, 1, memory_order_release); \
+	atomic_flag_clear_explicit(&init_lock, memory_order_release); \
+	NEXT; \
+unimplemented: \
+	UNIMPLEMENTED_OPCODE(); \
+	NEXT;
+
+#define OPCASE_(n, opcode, ...) \
+	OPTABLE[opcode] = &&OPLABEL(n); \
+	if (0) { \
+	OPLABEL(n): \
+		__VA_ARGS__; \
+		NEXT; \
+	}
+// Dispatches the next instruction, returning instead if the CPU has
+// entered a state which the caller must handle.
+#define NEXT do { \
+	if (__builtin_expect(core->cpu.state, 0) && !resolve_state(core)) \
+		return; \
+	DISPATCH_UNCHECKED; \
+} while (0)
+// Dispatches the next instruction regardless of CPU state.
+#define DISPATCH_UNCHECKED do { \
+	COUNT_INSTRUCTION(); \
+	NEXT_UOP(); \
+	goto *op_table[uop->opcode]; \
+} while (0)
+#define CB_DISPATCH goto *cb_table[IMMu8]
+
+#else // !GB_CPU_DISPATCH_THREADED
+//-----------------------------------------------------------------------
+// Switch dispatch
+#define INTERPRET_BEGIN \
+	while (!core->cpu.state || resolve_state(core)) { \
+	dispatch: \
+		COUNT_INSTRUCTION(); \
+		NEXT_UOP(); \
+		switch (uop->opcode) {
+#define INTERPRET_END \
+			default: \
+				UNIMPLEMENTED_OPCODE(); \
+				break; \
+		} \
+	}
+
+#define OPCASE_(n, opcode, ...) \
+	case opcode: __VA_ARGS__; break
+#define DISPATCH_UNCHECKED goto dispatch
+#define CB_DISPATCH CB_interpret_once(core, IMMu8)
+#endif // GB_CPU_DISPATCH_THREADED
+
 #define OPCASE_R(opcode, proc, lhs, rhs, result_handling, op_bytes, op_cycles) \
-	case opcode: result_handling##_REGISTER(lhs, proc(CORE, lhs, rhs)); \
-	             adv_cpu(CORE, op_bytes, op_cycles); \
-	             break
+	OPCASE(opcode, result_handling##_REGISTER(lhs, proc(CORE, lhs, rhs)); \
+	               adv_cpu(CORE, op_bytes, op_cycles))
 #define OPCASE_M(opcode, proc, lhs, rhs, result_handling, op_bytes, op_cycles) \
-	case opcode: result_handling##_MEMORY(lhs, proc(CORE, READ_MEMu8(lhs), rhs)); \
-	             adv_cpu(CORE, op_bytes, op_cycles); \
-	             break
+	OPCASE(opcode, result_handling##_MEMORY(lhs, proc(CORE, READ_MEMu8(lhs), rhs)); \
+	               adv_cpu(CORE, op_bytes, op_cycles))
 
 // Used for 8-bit load (excluding LD [HL], r), arithmetic, and logical instructions.
 #define OPCASES_lhs_7r8HLi8(B_opcode, n_opcode, proc, lhs, result_handling) \
@@ -557,7 +795,7 @@ static inline void
 	OPCASE_R((B_opcode)+5, proc, lhs, rL, result_handling, 1, 1); \
 	OPCASE_R((B_opcode)+6, proc, lhs, READ_MEMu8(rHL), result_handling, 1, 2); \
 	OPCASE_R((B_opcode)+7, proc, lhs, rA, result_handling, 1, 1); \
-	OPCASE_R(n_opcode, proc, lhs, READ_MEMu8(rPC+1), result_handling, 2, 2)
+	OPCASE_R(n_opcode, proc, lhs, IMMu8, result_handling, 2, 2)
 
 // Used for 8-bit INC and DEC
 #define OPCASES_7r8HL(B_opcode, proc) \
@@ -584,12 +822,12 @@ static inline void
 // Used for conditional JR, RET, JP, and CALL
 // PC-modifying functions are responsible for advancing the cpu and scheduler.
 // Reasoning: Flag must be evaluated to determine how many cycles have passed.
-#define OPCASES_JP(NZ_opcode, uncond_opcode, proc) \
-	case (NZ_opcode)     : proc(CORE,  !fZ); break; \
-	case (NZ_opcode)+0x08: proc(CORE,   fZ); break; \
-	case (NZ_opcode)+0x10: proc(CORE,  !fC); break; \
-	case (NZ_opcode)+0x18: proc(CORE,   fC); break; \
-	case (uncond_opcode) : proc(CORE, 0xFF); break
+#define OPCASES_JP(NZ_opcode, uncond_opcode, proc, imm) \
+	OPCASE((NZ_opcode)     , SYNC_FLAGS(); proc(CORE,  !fZ, imm)); \
+	OPCASE((NZ_opcode)+0x08, SYNC_FLAGS(); proc(CORE,   fZ, imm)); \
+	OPCASE((NZ_opcode)+0x10, SYNC_FLAGS(); proc(CORE,  !fC, imm)); \
+	OPCASE((NZ_opcode)+0x18, SYNC_FLAGS(); proc(CORE,   fC, imm)); \
+	OPCASE((uncond_opcode) , proc(CORE, 0xFF, imm))
 
 // Used for rotation, shift, and bit instructions (all CB-prefixed operations)
 #define OPCASES_7r8HL_rhs(B_opcode, proc, rhs, result_handling, HL_cycles) \
@@ -613,6 +851,23 @@ static inline void
 	OPCASES_7r8HL_rhs((B_0_opcode)+0x30, proc, 6, result_handling, HL_cycles); \
 	OPCASES_7r8HL_rhs((B_0_opcode)+0x38, proc, 7, result_handling, HL_cycles)
 
+// All CB-prefixed operations
+#define OPCASES_CB \
+	/* Rotation/Shift operations */ \
+	/* `rhs` is unused, so `0` is passed to the macro. */ \
+	OPCASES_7r8HL_rhs(0x00, RLC , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x08, RRC , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x10, RL  , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x18, RR  , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x20, SLA , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x28, SRA , 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x30, SWAP, 0, WRITEBACK, 16); \
+	OPCASES_7r8HL_rhs(0x38, SRL , 0, WRITEBACK, 16); \
+	/* BIT, RES, and SET operations. */ \
+	OPCASES_7r8HL_8b(0x40, BIT, DISCARD, 12); \
+	OPCASES_7r8HL_8b(0x80, RES, WRITEBACK, 16); \
+	OPCASES_7r8HL_8b(0xC0, SET, WRITEBACK, 16)
+
 //=======================================================================
 // doc call_isr()
 // TODO
@@ -623,9 +878,9 @@ call_isr(struct gb_core* restrict core) {
 	core->cpu.state &= ~CPUSTATE_HALTED;
 	gb_mem_io_set_ime(core, 0);
 	PUSH(core, rPC, 0);
-	gb_sch_advance(core, 4);
+	adv_cycles(core, 4);
 	uint8_t pending = gb_mem_io_pending_interrupts(core);
-	gb_sch_advance(core, 1);
+	adv_cycles(core, 1);
 	uint8_t interrupt;
 	if (pending & IO_IFE_VBLANK) {
 		rPC = 0x0040;
@@ -651,18 +906,24 @@ call_isr(struct gb_core* restrict core) {
 } // end call_isr()
 
 //=======================================================================
-// doc interpret_once()
-// TODO
+// doc interpret()
+// Executes instructions until the CPU enters a state which must be
+// handled by the caller (see `enum gb_cpu_state`).
 //=======================================================================
-// def interpret_once()
-static inline void
-interpret_once(struct gb_core* restrict core) {
+// def interpret()
+static void
+interpret(struct gb_core* restrict core) {
 //	struct gb_opc_components opc;
 //	gb_opc_current_components(&opc, core);
 //	char buf[1024];
 //	gb_opc_string(buf, sizeof(buf), &opc, core);
 //	printf("%s\n", buf);
-	switch (READ_MEMu8(rPC)) {
+	// Never matches PC, forcing the first dispatch to fetch a block.
+	static const struct gb_cpu_uop no_uop[2] = {
+		{ .pc = GB_CPU_UOP_NO_PC }, { .pc = GB_CPU_UOP_NO_PC }
+	};
+	const struct gb_cpu_uop* uop = no_uop;
+	INTERPRET_BEGIN
 		//-------------------------------------------------------------------
 		// 8-bit load instructions
 		// LD r8, r8/[HL]/i8
@@ -674,36 +935,36 @@ interpret_once(struct gb_core* restrict core) {
 		OPCASES_lhs_7r8HLi8(0x68, 0x2E, LD8, rL, WRITEBACK);
 		OPCASES_lhs_7r8HLi8(0x78, 0x3E, LD8, rA, WRITEBACK);
 		// LD [HL], r8/i8:
-		case 0x70: WRITE_MEMu8(rHL, rB); adv_cpu(core, 1, 2); break;
-		case 0x71: WRITE_MEMu8(rHL, rC); adv_cpu(core, 1, 2); break;
-		case 0x72: WRITE_MEMu8(rHL, rD); adv_cpu(core, 1, 2); break;
-		case 0x73: WRITE_MEMu8(rHL, rE); adv_cpu(core, 1, 2); break;
-		case 0x74: WRITE_MEMu8(rHL, rH); adv_cpu(core, 1, 2); break;
-		case 0x75: WRITE_MEMu8(rHL, rL); adv_cpu(core, 1, 2); break;
-		case 0x77: WRITE_MEMu8(rHL, rA); adv_cpu(core, 1, 2); break;
-		case 0x36: WRITE_MEMu8(rHL, READ_MEMu8(rPC+1)); adv_cpu(core, 2, 3); break;
+		OPCASE(0x70, WRITE_MEMu8(rHL, rB); adv_cpu(core, 1, 2));
+		OPCASE(0x71, WRITE_MEMu8(rHL, rC); adv_cpu(core, 1, 2));
+		OPCASE(0x72, WRITE_MEMu8(rHL, rD); adv_cpu(core, 1, 2));
+		OPCASE(0x73, WRITE_MEMu8(rHL, rE); adv_cpu(core, 1, 2));
+		OPCASE(0x74, WRITE_MEMu8(rHL, rH); adv_cpu(core, 1, 2));
+		OPCASE(0x75, WRITE_MEMu8(rHL, rL); adv_cpu(core, 1, 2));
+		OPCASE(0x77, WRITE_MEMu8(rHL, rA); adv_cpu(core, 1, 2));
+		OPCASE(0x36, WRITE_MEMu8(rHL, IMMu8); adv_cpu(core, 2, 3));
 		// LD [r16], A / LD A, [r16]
-		case 0x02: WRITE_MEMu8(rBC, rA); adv_cpu(core, 1, 2); break;
-		case 0x12: WRITE_MEMu8(rDE, rA); adv_cpu(core, 1, 2); break;
-		case 0x0A: rA = READ_MEMu8(rBC); adv_cpu(core, 1, 2); break;
-		case 0x1A: rA = READ_MEMu8(rDE); adv_cpu(core, 1, 2); break;
+		OPCASE(0x02, WRITE_MEMu8(rBC, rA); adv_cpu(core, 1, 2));
+		OPCASE(0x12, WRITE_MEMu8(rDE, rA); adv_cpu(core, 1, 2));
+		OPCASE(0x0A, rA = READ_MEMu8(rBC); adv_cpu(core, 1, 2));
+		OPCASE(0x1A, rA = READ_MEMu8(rDE); adv_cpu(core, 1, 2));
 		// LD [HL+/-], A / LD A, [HL+/-]
 		// Increments/decrements the value of HL _AFTER_
 		// reading from/writing to the address it points to.
-		case 0x22: WRITE_MEMu8(rHL++, rA); adv_cpu(core, 1, 2); break;
-		case 0x32: WRITE_MEMu8(rHL--, rA); adv_cpu(core, 1, 2); break;
-		case 0x2A: rA = READ_MEMu8(rHL++); adv_cpu(core, 1, 2); break;
-		case 0x3A: rA = READ_MEMu8(rHL--); adv_cpu(core, 1, 2); break;
+		OPCASE(0x22, WRITE_MEMu8(rHL++, rA); adv_cpu(core, 1, 2));
+		OPCASE(0x32, WRITE_MEMu8(rHL--, rA); adv_cpu(core, 1, 2));
+		OPCASE(0x2A, rA = READ_MEMu8(rHL++); adv_cpu(core, 1, 2));
+		OPCASE(0x3A, rA = READ_MEMu8(rHL--); adv_cpu(core, 1, 2));
 		// LD [FF00+i8], A / LD A, [FF00+i8]
-		case 0xE0: WRITE_MEMFF(READ_MEMu8(rPC+1), rA); adv_cpu(core, 2, 3); break;
-		case 0xF0: rA = READ_MEMFF(READ_MEMu8(rPC+1)); adv_cpu(core, 2, 3); break;
+		OPCASE(0xE0, WRITE_MEMFF(IMMu8, rA); adv_cpu(core, 2, 3));
+		OPCASE(0xF0, rA = READ_MEMFF(IMMu8); adv_cpu(core, 2, 3));
 		// LD [FF00+C], A / LD A, [FF00+C]
 		// (C refers to the C register, not the carry flag)
-		case 0xE2: WRITE_MEMFF(rC, rA); adv_cpu(core, 1, 2); break;
-		case 0xF2: rA = READ_MEMFF(rC); adv_cpu(core, 1, 2); break;
+		OPCASE(0xE2, WRITE_MEMFF(rC, rA); adv_cpu(core, 1, 2));
+		OPCASE(0xF2, rA = READ_MEMFF(rC); adv_cpu(core, 1, 2));
 		// LD [i16], A / LD A, [i16]
-		case 0xEA: WRITE_MEMu8(READ_MEMu16(rPC+1), rA); adv_cpu(core, 3, 4); break;
-		case 0xFA: rA = READ_MEMu8(READ_MEMu16(rPC+1)); adv_cpu(core, 3, 4); break;
+		OPCASE(0xEA, WRITE_MEMu8(IMMu16, rA); adv_cpu(core, 3, 4));
+		OPCASE(0xFA, rA = READ_MEMu8(IMMu16); adv_cpu(core, 3, 4));
 		//-------------------------------------------------------------------
 		// 8-bit arithmetic and logical instructions
 		// (ALU) A, r8/[HL]/i8
@@ -720,26 +981,26 @@ interpret_once(struct gb_core* restrict core) {
 		//-------------------------------------------------------------------
 		// 16-bit load and arithmetic instructions
 		// LD r16, i16
-		OPCASES_4r16(0x01, LD16, READ_MEMu16(rPC+1), WRITEBACK, 3, 3);
+		OPCASES_4r16(0x01, LD16, IMMu16, WRITEBACK, 3, 3);
 		// PUSH r16
 		OPCASES_3r16(0xC5, PUSH, 0, DISCARD, 1, 4);
-		case 0xF5: pack_flags(&(core->cpu));
-		           PUSH(core, rAF, 0); adv_cpu(core, 1, 4); break;
+		OPCASE(0xF5, SYNC_FLAGS(); pack_flags(&(core->cpu));
+		             PUSH(core, rAF, 0); adv_cpu(core, 1, 4));
 		// POP r16
 		OPCASES_3r16(0xC1, POP, 0, WRITEBACK, 1, 3);
-		case 0xF1: rAF = POP(core, 0, 0); adv_cpu(core, 1, 3);
-		           unpack_flags(&(core->cpu)); break;
+		OPCASE(0xF1, SYNC_FLAGS(); rAF = POP(core, 0, 0); adv_cpu(core, 1, 3);
+		             unpack_flags(&(core->cpu)));
 		// LD [i16], SP
-		case 0x08: WRITE_MEMu16(rPC+1, rSP); adv_cpu(core, 3, 5); break;
+		OPCASE(0x08, WRITE_MEMu16(IMMu16, rSP); adv_cpu(core, 3, 5));
 		// LD HL, SP+si8
-		case 0xF8: rHL = ADD_SP_si8(core); adv_cpu(core, 2, 3); break;
+		OPCASE(0xF8, rHL = ADD_SP_si8(core, IMMs8); adv_cpu(core, 2, 3));
 		// LD SP, HL
-		case 0xF9: rSP = rHL; adv_cpu(core, 1, 2); break;
+		OPCASE(0xF9, rSP = rHL; adv_cpu(core, 1, 2));
 		// ADD HL, r16
 		// Uses DISCARD handling because HL is modified within ADD_HL()
 		OPCASES_4r16(0x09, ADD_HL, 0, DISCARD, 1, 2);
 		// ADD SP, si8
-		case 0xE8: rSP = ADD_SP_si8(core); adv_cpu(core, 2, 4); break;
+		OPCASE(0xE8, rSP = ADD_SP_si8(core, IMMs8); adv_cpu(core, 2, 4));
 		// INC/DEC r16
 		OPCASES_4r16(0x03, INC16, 0, WRITEBACK, 1, 2);
 		OPCASES_4r16(0x0B, DEC16, 0, WRITEBACK, 1, 2);
@@ -751,80 +1012,73 @@ interpret_once(struct gb_core* restrict core) {
 		OPCASE_R(0x1F, RRA , rA, 0, WRITEBACK, 1, 1);
 		//-------------------------------------------------------------------
 		// Jump, call, return, and reset instructions
-		OPCASES_JP(0xC2, 0xC3, JP);
-		OPCASES_JP(0x20, 0x18, JR);
-		OPCASES_JP(0xC4, 0xCD, CALL);
-		OPCASES_JP(0xC0, 0xC9, RET);
-		case 0xE9: rPC = rHL; gb_sch_advance(core, 1); break; // JP HL
-		case 0xD9: // RETI: Functionally identical to EI followed by RET
-			RET(core, 0xFF);
-			gb_mem_io_set_ime(core, 1);
-			break;
+		OPCASES_JP(0xC2, 0xC3, JP, IMMu16);
+		OPCASES_JP(0x20, 0x18, JR, IMMs8);
+		OPCASES_JP(0xC4, 0xCD, CALL, IMMu16);
+		OPCASES_JP(0xC0, 0xC9, RET, 0);
+		OPCASE(0xE9, rPC = rHL; adv_cycles(core, 1)); // JP HL
+		OPCASE(0xD9, // RETI: Functionally identical to EI followed by RET
+			RET(core, 0xFF, 0);
+			gb_mem_io_set_ime(core, 1));
 		// RST $XX
-		case 0xC7: RST(core, 0x00); break;
-		case 0xCF: RST(core, 0x08); break;
-		case 0xD7: RST(core, 0x10); break;
-		case 0xDF: RST(core, 0x18); break;
-		case 0xE7: RST(core, 0x20); break;
-		case 0xEF: RST(core, 0x28); break;
-		case 0xF7: RST(core, 0x30); break;
-		case 0xFF: RST(core, 0x38); break;
+		OPCASE(0xC7, RST(core, 0x00));
+		OPCASE(0xCF, RST(core, 0x08));
+		OPCASE(0xD7, RST(core, 0x10));
+		OPCASE(0xDF, RST(core, 0x18));
+		OPCASE(0xE7, RST(core, 0x20));
+		OPCASE(0xEF, RST(core, 0x28));
+		OPCASE(0xF7, RST(core, 0x30));
+		OPCASE(0xFF, RST(core, 0x38));
 		//-------------------------------------------------------------------
 		// Miscellaneous instructions
 		OPCASE_R(0x27, DAA, rA, 0, WRITEBACK, 1, 1);
 		OPCASE_R(0x2F, CPL, rA, 0, WRITEBACK, 1, 1);
 		OPCASE_R(0x37, SCF, 0, 0, DISCARD, 1, 1);
 		OPCASE_R(0x3F, CCF, 0, 0, DISCARD, 1, 1);
-		case 0x00: adv_cpu(core, 1, 1); break; // NOP
-		case 0x10: adv_cpu(core, 2, 1); break; // TODO: STOP
-		case 0x76: core->cpu.state |= CPUSTATE_HALTED; adv_cpu(core, 1, 1); break; // HALT
-		case 0xCB: CB_interpret_once(core); break; // CB PREFIX
-		case 0xF3: // DI: Clear IME (Interrupt Master Enable)
+		OPCASE(0x00, adv_cpu(core, 1, 1)); // NOP
+		OPCASE(0x10, adv_cpu(core, 2, 1)); // TODO: STOP
+		OPCASE(0x76, core->cpu.state |= CPUSTATE_HALTED; adv_cpu(core, 1, 1)); // HALT
+		OPCASE(0xCB, CB_DISPATCH); // CB PREFIX
+		OPCASE(0xF3, // DI: Clear IME (Interrupt Master Enable)
 			gb_mem_io_set_ime(core, 0);
-			adv_cpu(core, 1, 1);
-			break;
-		case 0xFB: // EI: Set IME (Interrupt Master Enable)
-			execute_EI(core);
-			break;
-		default:
-			fprintf(stderr, "Unimplemented opcode 0x%X at 0x%X", READ_MEMu8(rPC), rPC);
-			break;
-	} // end switch
-} // end interpret_once()
+			adv_cpu(core, 1, 1));
+		OPCASE(0xFB, // EI: Set IME (Interrupt Master Enable)
+			if (execute_EI(core))
+				DISPATCH_UNCHECKED);
+#ifdef GB_CPU_DISPATCH_THREADED
+		//-------------------------------------------------------------------
+		// CB-prefixed instructions, dispatched from 0xCB's handler.
+#undef OPTABLE
+#define OPTABLE cb_table
+		OPCASES_CB;
+#undef OPTABLE
+#define OPTABLE op_table
+#endif
+	INTERPRET_END
+} // end interpret()
 
+#ifndef GB_CPU_DISPATCH_THREADED
 //=======================================================================
 // doc CB_interpret_once()
-// TODO
+// Executes a single CB-prefixed instruction.
 //=======================================================================
 // def CB_interpret_once()
 static inline void
-CB_interpret_once(struct gb_core* restrict core) {
-	switch (READ_MEMu8(rPC+1)) {
-		//-------------------------------------------------------------------
-		// Rotation/Shift operations
-		// `rhs` is unused, so `0` is passed to the macro.
-		OPCASES_7r8HL_rhs(0x00, RLC , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x08, RRC , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x10, RL  , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x18, RR  , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x20, SLA , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x28, SRA , 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x30, SWAP, 0, WRITEBACK, 16);
-		OPCASES_7r8HL_rhs(0x38, SRL , 0, WRITEBACK, 16);
-		//-------------------------------------------------------------------
-		// BIT, RES, and SET operations.
-		OPCASES_7r8HL_8b(0x40, BIT, DISCARD, 12);
-		OPCASES_7r8HL_8b(0x80, RES, WRITEBACK, 16);
-		OPCASES_7r8HL_8b(0xC0, SET, WRITEBACK, 16);
+CB_interpret_once(struct gb_core* restrict core, uint8_t cb_opcode) {
+	switch (cb_opcode) {
+		OPCASES_CB;
 	} // end switch
 } // end CB_interpret_once()
+#endif
 
 //=======================================================================
 // doc execute_EI()
-// TODO
+// Returns nonzero if the next instruction must be dispatched
+// immediately, without checking CPU state, after which IME will be set
+// (see resolve_state()).
 //=======================================================================
 // def execute_EI()
-static inline void
+static inline uint8_t
 execute_EI(struct gb_core* restrict core) {
 	// EI is delayed by 1 additional cycle, meaning 2 things:
 	// 1. 1 instruction will run after EI before IME is set.
@@ -842,12 +1096,48 @@ execute_EI(struct gb_core* restrict core) {
 		} else {
 			// Run next instruction, then enable interrupts.
 			adv_cpu(core, 1, 1); // EI advancement
-			interpret_once(core);
-			gb_mem_io_set_ime(core, 1);
+			core->cpu.state |= CPUSTATE_EI_PENDING;
+			return 1;
 		}
 	} else {
 		// IME already set. Effectively a NOP.
 		adv_cpu(core, 1, 1);
 	} // end ifelse !ime
+	return 0;
 } // end execute_EI()
 
+//=======================================================================
+// doc resolve_state()
+// Handles any CPU state which is resolved by the interpreter itself,
+// rather than by the caller of interpret().
+// Returns nonzero if no state remains, and execution may continue.
+//=======================================================================
+// def resolve_state()
+static inline uint8_t
+resolve_state(struct gb_core* restrict core) {
+	if (core->cpu.state & CPUSTATE_EI_PENDING) {
+		// The instruction following EI has now run.
+		core->cpu.state &= ~CPUSTATE_EI_PENDING;
+		gb_mem_io_set_ime(core, 1);
+	}
+	return !core->cpu.state;
+} // end resolve_state()
+
+#ifdef GB_CPU_LAZY_FLAGS
+//=======================================================================
+// doc materialize_flags()
+// Computes the flags of the last recorded operation (see SET_FLAGS()).
+//=======================================================================
+// def materialize_flags()
+static void
+materialize_flags(struct gb_core* restrict core) {
+	struct gb_cpu_lazy_flags lazy = CPU.lazy;
+	CPU.lazy.op = LAZY_NONE;
+	switch (lazy.op) {
+		case LAZY_ADD: ADD8_flags(core, lazy.lhs, lazy.rhs, lazy.carry); return;
+		case LAZY_SUB: SUB_flags(core, lazy.lhs, lazy.rhs, lazy.carry); return;
+		case LAZY_AND: AND_flags(core, lazy.lhs, 0, 0); return;
+		case LAZY_OR: OR_flags(core, lazy.lhs, 0, 0); return;
+	}
+} // end materialize_flags()
+#endif
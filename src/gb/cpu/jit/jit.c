@@ -0,0 +1,375 @@
+#ifdef GB_CPU_JIT
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/jit.h"
+#include "gb/cpu/jit/x64.h"
+#define GB_LOG_MAX_LEVEL LVL_WRN
+#include "gb/log.h"
+#include "gb/mem.h"
+#include "gb/mem/region.h"
+
+#define SELF (core->cpu.jit)
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static inline struct gb_cpu_jit_entry*
+lookup(struct gb_core* restrict core, const struct gb_cpu_block* restrict block);
+static uint8_t
+translate(
+		struct gb_core* restrict core,
+		struct gb_cpu_jit_entry* restrict entry,
+		const struct gb_cpu_block* restrict block);
+static void
+flush(struct gb_core* restrict core);
+static uint8_t
+protect(struct gb_core* restrict core, uint8_t writable);
+#ifdef GB_CPU_JIT_VERIFY
+static void
+log_write(struct gb_core* restrict core, uint16_t addr, uint8_t value);
+static void
+undo_writes(struct gb_core* restrict core);
+static void
+capture(const struct gb_core* restrict core, struct gb_cpu_jit_regs* restrict dst);
+static void
+restore(struct gb_core* restrict core, const struct gb_cpu_jit_regs* restrict src);
+#endif
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_cpu_jit_init()
+void
+gb_cpu_jit_init(struct gb_core* restrict core) {
+	memset(SELF.entry, 0, sizeof(SELF.entry));
+	SELF.code = NULL;
+	SELF.used = 0;
+	SELF.writable = 0;
+	SELF.looped = 0;
+#ifdef GB_CPU_JIT_VERIFY
+	SELF.verify_remaining = 0;
+	SELF.write_count = 0;
+#endif
+} // end gb_cpu_jit_init()
+
+//=======================================================================
+// def gb_cpu_jit_destroy()
+void
+gb_cpu_jit_destroy(struct gb_core* restrict core) {
+	if (SELF.code)
+		munmap(SELF.code, GB_CPU_JIT_CODE_SIZE);
+	SELF.code = NULL;
+	SELF.used = 0;
+} // end gb_cpu_jit_destroy()
+
+//=======================================================================
+// def gb_cpu_jit_fetch()
+const struct gb_cpu_uop*
+gb_cpu_jit_fetch(struct gb_core* restrict core) {
+	const struct gb_cpu_uop* uop = gb_cpu_bcache_fetch(core);
+	// Any state (most importantly a pending EI) must be seen by the
+	// interpreter after exactly one instruction.
+	while (!core->cpu.state) {
+		const struct gb_cpu_block* block = core->cpu.bcache.current;
+		if (!block || block->pc >= MEM_E_ROM2)
+			break; // Only ROM is translated.
+		struct gb_cpu_jit_entry* entry = lookup(core, block);
+		if (entry->status != JIT_NATIVE && !translate(core, entry, block))
+			break;
+		// Native code leaves before any instruction which would bring
+		// the next event due; don't enter it only to leave at once.
+		if (core->sch.budget <= entry->cycles)
+			break;
+		SELF.looped = 0;
+#ifdef GB_CPU_JIT_VERIFY
+		// Run the native code, then rewind, and have the interpreter
+		// run the same instructions.
+		struct gb_cpu_jit_regs before;
+		capture(core, &before);
+		SELF.write_count = 0;
+		uint8_t ran = entry->fn(core);
+		capture(core, &SELF.expect);
+		restore(core, &before);
+		undo_writes(core);
+		SELF.verify_pc = block->pc;
+		SELF.verify_remaining = SELF.looped + ran;
+		break;
+#else
+		uint8_t ran = entry->fn(core);
+#ifdef GB_CPU_COUNT_INSTRUCTIONS
+		core->cpu.instructions += SELF.looped + ran;
+#endif
+		if (ran < block->len) // Interpret the rest of the block.
+			return block->uop + ran;
+		uop = gb_cpu_bcache_fetch(core);
+#endif
+	}
+	return uop;
+} // end gb_cpu_jit_fetch()
+
+//=======================================================================
+// def gb_cpu_jit_write8()
+uint8_t
+gb_cpu_jit_write8(struct gb_core* core, uint16_t addr, uint8_t value) {
+	if (!gb_mem_is_plain_write(core, addr))
+		return 0;
+#ifdef GB_CPU_JIT_VERIFY
+	log_write(core, addr, value);
+#else
+	gb_mem_u8write(core, addr, value);
+#endif
+	return 1;
+} // end gb_cpu_jit_write8()
+
+//=======================================================================
+// def gb_cpu_jit_write16()
+uint8_t
+gb_cpu_jit_write16(struct gb_core* core, uint16_t addr, uint16_t value) {
+	uint16_t next = addr + 1;
+	if (!gb_mem_is_plain_write(core, addr) || !gb_mem_is_plain_write(core, next))
+		return 0;
+#ifdef GB_CPU_JIT_VERIFY
+	log_write(core, addr, value & 0xFF);
+	log_write(core, next, value >> 8);
+#else
+	gb_mem_u16write(core, addr, value);
+#endif
+	return 1;
+} // end gb_cpu_jit_write16()
+
+#ifdef GB_CPU_JIT_VERIFY
+//=======================================================================
+// def gb_cpu_jit_verify()
+void
+gb_cpu_jit_verify(struct gb_core* restrict core) {
+	struct gb_cpu_jit_regs actual;
+	capture(core, &actual);
+	const struct gb_cpu_jit_regs* expect = &SELF.expect;
+	// The last write to each address must have left the same value.
+	uint8_t writes_match = 1;
+	for (uint16_t i = 0; i < SELF.write_count; ++i) {
+		const struct gb_cpu_jit_write* w = &SELF.writes[i];
+		uint8_t last = 1;
+		for (uint16_t j = i + 1; j < SELF.write_count; ++j)
+			last &= SELF.writes[j].addr != w->addr;
+		if (last && gb_mem_u8read(core, w->addr) != w->after) {
+			fprintf(stderr, "JIT wrote $%02" PRIX8 " to $%04" PRIX16
+					", interpreter $%02" PRIX8 ".\n",
+					w->after, w->addr, gb_mem_u8read(core, w->addr));
+			writes_match = 0;
+		}
+	}
+	if (writes_match && !memcmp(actual.r, expect->r, sizeof(actual.r))
+	 && actual.sp == expect->sp && actual.pc == expect->pc
+	 && actual.fz == expect->fz && actual.fn == expect->fn
+	 && actual.fh == expect->fh && actual.fc == expect->fc
+	 && actual.budget == expect->budget)
+		return;
+
+	const struct gb_cpu_jit_regs* regs[2] = { expect, &actual };
+	const char* names[2] = { "jit", "interpreter" };
+	fprintf(stderr, "JIT mismatch in block at $%04" PRIX16 ":\n", SELF.verify_pc);
+	for (int i = 0; i < 2; ++i) {
+		const struct gb_cpu_jit_regs* r = regs[i];
+		fprintf(stderr, "%12s: r=", names[i]);
+		for (int j = 0; j < 8; ++j)
+			fprintf(stderr, "%02" PRIX8, r->r[j]);
+		fprintf(stderr, " sp=%04" PRIX16 " pc=%04" PRIX16
+				" znhc=%" PRIu8 "%" PRIu8 "%" PRIu8 "%" PRIu8
+				" budget=%" PRId32 "\n",
+				r->sp, r->pc, r->fz, r->fn, r->fh, r->fc, r->budget);
+	}
+	abort();
+} // end gb_cpu_jit_verify()
+#endif
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc lookup()
+// Returns the entry for `block`, retagging it if it last described a
+// different block (or the same address in another ROM bank).
+//=======================================================================
+// def lookup()
+static inline struct gb_cpu_jit_entry*
+lookup(struct gb_core* restrict core, const struct gb_cpu_block* restrict block) {
+	struct gb_cpu_jit_entry* entry = SELF.entry
+		+ (block - core->cpu.bcache.blocks);
+	if (!entry->tagged || entry->pc != block->pc || entry->bank != block->bank) {
+		memset(entry, 0, sizeof(*entry));
+		entry->pc = block->pc;
+		entry->bank = block->bank;
+		entry->tagged = 1;
+	}
+	return entry;
+} // end lookup()
+
+//=======================================================================
+// doc translate()
+// Translates `block` once it is hot.
+// Returns nonzero if `entry` now holds native code.
+//=======================================================================
+// def translate()
+static uint8_t
+translate(
+		struct gb_core* restrict core,
+		struct gb_cpu_jit_entry* restrict entry,
+		const struct gb_cpu_block* restrict block) {
+	if (entry->status == JIT_REJECTED || ++entry->heat < GB_CPU_JIT_THRESHOLD)
+		return 0;
+	if (!SELF.code) {
+		void* code = mmap(NULL, GB_CPU_JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code == MAP_FAILED) {
+			LOGW("Could not map JIT code buffer. Interpreting instead.");
+			entry->status = JIT_REJECTED;
+			return 0;
+		}
+		SELF.code = code;
+		SELF.used = 0;
+		SELF.writable = 1;
+	}
+	if (!protect(core, 1)) {
+		entry->status = JIT_REJECTED;
+		return 0;
+	}
+	if (GB_CPU_JIT_CODE_SIZE - SELF.used < GB_CPU_JIT_BLOCK_MAX_CODE)
+		flush(core);
+
+	uint8_t* dst = SELF.code + SELF.used;
+	size_t size;
+	uint8_t cycles;
+	uint8_t len = gb_cpu_jit_x64_translate(dst, &size, &cycles, block);
+	if (len) {
+		__builtin___clear_cache((char*)dst, (char*)dst + size);
+		SELF.used += (size + 15) & ~(size_t)15;
+	}
+	if (!protect(core, 0)) {
+		// Nothing in the buffer can run any more.
+		flush(core);
+		len = 0;
+	}
+	if (!len) {
+		entry->status = JIT_REJECTED;
+		return 0;
+	}
+	entry->fn = (gb_cpu_jit_fn)(void*)dst;
+	entry->len = len;
+	entry->cycles = cycles;
+	entry->status = JIT_NATIVE;
+	return 1;
+} // end translate()
+
+//=======================================================================
+// doc flush()
+// Discards all native code, once the code buffer is full.
+// Entries keep their tags, and are retranslated once hot again.
+//=======================================================================
+// def flush()
+static void
+flush(struct gb_core* restrict core) {
+	LOGD("Flushing JIT code buffer.");
+	for (uint16_t i = 0; i < GB_CPU_BCACHE_SLOTS; ++i) {
+		SELF.entry[i].status = JIT_COLD;
+		SELF.entry[i].heat = 0;
+		SELF.entry[i].fn = NULL;
+	}
+	SELF.used = 0;
+} // end flush()
+
+//=======================================================================
+// doc protect()
+// Maps the code buffer read/write if `writable`, or read/execute
+// otherwise, unless it already is.
+// Returns nonzero on success.
+//=======================================================================
+// def protect()
+static uint8_t
+protect(struct gb_core* restrict core, uint8_t writable) {
+	if (SELF.writable == writable)
+		return 1;
+	if (mprotect(SELF.code, GB_CPU_JIT_CODE_SIZE,
+			writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC)) {
+		LOGW("Could not change protection of JIT code buffer.");
+		return 0;
+	}
+	SELF.writable = writable;
+	return 1;
+} // end protect()
+
+#ifdef GB_CPU_JIT_VERIFY
+//=======================================================================
+// def capture()
+static void
+capture(const struct gb_core* restrict core, struct gb_cpu_jit_regs* restrict dst) {
+	memcpy(dst->r, core->cpu.r, sizeof(dst->r));
+	dst->sp = core->cpu.sp;
+	dst->pc = core->cpu.pc;
+	dst->fz = core->cpu.fz;
+	dst->fn = core->cpu.fn;
+	dst->fh = core->cpu.fh;
+	dst->fc = core->cpu.fc;
+	dst->budget = core->sch.budget;
+} // end capture()
+
+//=======================================================================
+// def restore()
+static void
+restore(struct gb_core* restrict core, const struct gb_cpu_jit_regs* restrict src) {
+	memcpy(core->cpu.r, src->r, sizeof(src->r));
+	core->cpu.sp = src->sp;
+	core->cpu.pc = src->pc;
+	core->cpu.fz = src->fz;
+	core->cpu.fn = src->fn;
+	core->cpu.fh = src->fh;
+	core->cpu.fc = src->fc;
+	core->sch.budget = src->budget;
+} // end restore()
+
+//=======================================================================
+// doc log_write()
+// Makes a write for native code, recording it so that it can be undone.
+//=======================================================================
+// def log_write()
+static void
+log_write(struct gb_core* restrict core, uint16_t addr, uint8_t value) {
+	assert(SELF.write_count < GB_CPU_JIT_MAX_WRITES);
+	struct gb_cpu_jit_write* w = &SELF.writes[SELF.write_count++];
+	w->addr = addr;
+	w->before = gb_mem_u8read(core, addr);
+	gb_mem_u8write(core, addr, value);
+	// Not necessarily `value`: OAM ignores writes during modes 2 and 3.
+	w->after = gb_mem_u8read(core, addr);
+} // end log_write()
+
+//=======================================================================
+// doc undo_writes()
+// Restores the memory which native code wrote, latest write first.
+//=======================================================================
+// def undo_writes()
+static void
+undo_writes(struct gb_core* restrict core) {
+	for (uint16_t i = SELF.write_count; i--; )
+		gb_mem_u8write(core, SELF.writes[i].addr, SELF.writes[i].before);
+} // end undo_writes()
+#endif
+
+#endif // GB_CPU_JIT
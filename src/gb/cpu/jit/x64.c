@@ -0,0 +1,1038 @@
+#ifdef GB_CPU_JIT
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
+#include "gb/cpu/jit.h"
+#include "gb/cpu/jit/x64.h"
+#include "gb/cpu/reg.h"
+#include "gb/mem/region.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal type/constant definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+// Native code follows the System V calling convention, and is called
+// with RDI holding the `struct gb_core*`. It keeps that in RBX, so that
+// it survives calls to the write helpers, and saves RBP to hold values
+// across them.
+// EAX, ECX, and EDX are scratch registers; their low bytes (AL, CL, DL)
+// are addressable without a REX prefix.
+enum host_reg {
+	EAX = 0,
+	ECX = 1,
+	EDX = 2,
+	EBX = 3,
+	EBP = 5,
+	ESI = 6,
+	EDI = 7
+};
+
+// Condition codes, as encoded in Jcc/SETcc.
+enum host_cc {
+	CC_B  = 0x2, // Below (carry)
+	CC_E  = 0x4, // Equal (zero)
+	CC_NE = 0x5, // Not equal (not zero)
+	CC_BE = 0x6, // Below or equal
+	CC_A  = 0x7, // Above
+	CC_S  = 0x8, // Sign
+	CC_G  = 0xF  // Greater (signed)
+};
+
+// Opcodes of `op r/m32, r32`.
+enum host_alu {
+	ALU_ADD = 0x01,
+	ALU_OR  = 0x09,
+	ALU_AND = 0x21,
+	ALU_SUB = 0x29,
+	ALU_XOR = 0x31,
+	ALU_MOV = 0x89
+};
+
+// Operations of the shift group (`/digit` of opcode 0xD0).
+enum host_shift {
+	SH_ROL = 0,
+	SH_ROR = 1,
+	SH_RCL = 2,
+	SH_RCR = 3,
+	SH_SHL = 4,
+	SH_SHR = 5,
+	SH_SAR = 7
+};
+
+// Displacements of CPU state from RBX.
+// All of them fit in a signed byte, so every access uses disp8.
+#define OFF_R(index) ((uint8_t)(offsetof(struct gb_core, cpu.r) + (index)))
+#define OFF_SP ((uint8_t)offsetof(struct gb_core, cpu.sp))
+#define OFF_PC ((uint8_t)offsetof(struct gb_core, cpu.pc))
+#define OFF_FZ ((uint8_t)offsetof(struct gb_core, cpu.fz))
+#define OFF_FN ((uint8_t)offsetof(struct gb_core, cpu.fn))
+#define OFF_FH ((uint8_t)offsetof(struct gb_core, cpu.fh))
+#define OFF_FC ((uint8_t)offsetof(struct gb_core, cpu.fc))
+static_assert(offsetof(struct gb_core, cpu.fc) < 0x80);
+// Displacements of the rest, which need disp32.
+#define OFF_BUDGET ((uint32_t)offsetof(struct gb_core, sch.budget))
+#define OFF_RPAGE ((uint32_t)offsetof(struct gb_core, mem.rpage))
+#define OFF_LOOPED ((uint32_t)offsetof(struct gb_core, cpu.jit.looped))
+#ifdef GB_CPU_JIT_VERIFY
+#define OFF_WRITE_COUNT ((uint32_t)offsetof(struct gb_core, cpu.jit.write_count))
+#endif
+
+// 8-bit register operand (bits 0-2/3-5 of an opcode) to register index.
+// Index 6 ([HL]) accesses memory, and is handled separately.
+static const uint8_t r8_index[8] = { iB, iC, iD, iE, iH, iL, 0xFF, iA };
+#define OFF_R8(operand) OFF_R(r8_index[(operand)])
+// 16-bit register operand (bits 4-5 of an opcode) to displacement.
+static const uint8_t r16_offset[4] = {
+	OFF_R(iBC), OFF_R(iDE), OFF_R(iHL), OFF_SP
+};
+
+// ALU operations, as encoded in bits 3-5 of opcodes 0x80-0xBF.
+enum alu8 {
+	ALU8_ADD = 0,
+	ALU8_ADC,
+	ALU8_SUB,
+	ALU8_SBC,
+	ALU8_AND,
+	ALU8_XOR,
+	ALU8_OR,
+	ALU8_CP
+};
+
+enum {
+	// Upper bound on the native code of any one instruction, including
+	// its budget check and exits.
+	UOP_MAX_CODE = 256
+};
+static_assert(2 * UOP_MAX_CODE <= GB_CPU_JIT_BLOCK_MAX_CODE);
+
+// `start` is the native code of the block's first instruction, at
+// `start_pc`, where a block jumping back to its start loops to.
+struct emitter {
+	uint8_t* p;
+	const uint8_t* start;
+	uint16_t start_pc;
+};
+
+// Where an instruction of a block leaves native code if it cannot make
+// its write: before that instruction, having run `index` instructions
+// which took `cycles`.
+struct bail {
+	uint16_t pc;
+	uint8_t index;
+	uint8_t cycles;
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static uint8_t
+emit_uop(
+		struct emitter* restrict e,
+		const struct gb_cpu_uop* restrict uop,
+		const struct bail* restrict bail);
+static uint8_t
+emit_cb(struct emitter* restrict e, uint8_t cb);
+static uint8_t
+emit_branch(
+		struct emitter* restrict e,
+		const struct gb_cpu_uop* restrict uop,
+		const struct bail* restrict bail);
+static void
+emit_alu8(struct emitter* restrict e, uint8_t alu8);
+static void
+emit_read(struct emitter* restrict e);
+static void
+emit_read16(struct emitter* restrict e);
+static void
+emit_write(
+		struct emitter* restrict e,
+		const struct bail* restrict bail,
+		uint8_t wide);
+static uint8_t*
+emit_guard(struct emitter* restrict e, const struct bail* restrict bail);
+static void
+emit_jump(struct emitter* restrict e, uint16_t target, uint8_t cycles, uint8_t ran);
+static void
+emit_exit(struct emitter* restrict e, uint16_t pc, uint8_t cycles, uint8_t ran);
+static void
+emit_exit_eax(struct emitter* restrict e, uint8_t cycles, uint8_t ran);
+static void
+emit_return(struct emitter* restrict e, uint8_t cycles, uint8_t ran);
+static inline uint8_t
+never_plain(uint16_t addr);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Instruction encoders
+//-----------------------------------------------------------------------
+//=======================================================================
+static inline void
+emit8(struct emitter* restrict e, uint8_t byte) {
+	*e->p++ = byte;
+}
+static inline void
+emit16(struct emitter* restrict e, uint16_t value) {
+	emit8(e, value & 0xFF);
+	emit8(e, value >> 8);
+}
+static inline void
+emit32(struct emitter* restrict e, uint32_t value) {
+	emit16(e, value & 0xFFFF);
+	emit16(e, value >> 16);
+}
+static inline void
+emit64(struct emitter* restrict e, uint64_t value) {
+	emit32(e, value & 0xFFFFFFFF);
+	emit32(e, value >> 32);
+}
+// ModRM for [RBX+disp8] with `reg` in the reg field.
+static inline void
+modrm_core(struct emitter* restrict e, uint8_t reg, uint8_t off) {
+	emit8(e, 0x40 | (reg << 3) | EBX);
+	emit8(e, off);
+}
+// movzx reg, byte [rbx+off]
+static inline void
+load8(struct emitter* restrict e, uint8_t reg, uint8_t off) {
+	emit8(e, 0x0F); emit8(e, 0xB6); modrm_core(e, reg, off);
+}
+// movzx reg, word [rbx+off]
+static inline void
+load16(struct emitter* restrict e, uint8_t reg, uint8_t off) {
+	emit8(e, 0x0F); emit8(e, 0xB7); modrm_core(e, reg, off);
+}
+// mov byte [rbx+off], reg8 (AL, CL, DL or BL only)
+static inline void
+store8(struct emitter* restrict e, uint8_t off, uint8_t reg) {
+	emit8(e, 0x88); modrm_core(e, reg, off);
+}
+// mov word [rbx+off], reg16
+static inline void
+store16(struct emitter* restrict e, uint8_t off, uint8_t reg) {
+	emit8(e, 0x66); emit8(e, 0x89); modrm_core(e, reg, off);
+}
+// mov byte [rbx+off], imm8
+static inline void
+store8i(struct emitter* restrict e, uint8_t off, uint8_t imm) {
+	emit8(e, 0xC6); modrm_core(e, 0, off); emit8(e, imm);
+}
+// mov word [rbx+off], imm16
+static inline void
+store16i(struct emitter* restrict e, uint8_t off, uint16_t imm) {
+	emit8(e, 0x66); emit8(e, 0xC7); modrm_core(e, 0, off); emit16(e, imm);
+}
+// add/sub word [rbx+off], imm8
+static inline void
+add16i(struct emitter* restrict e, uint8_t off, int8_t imm) {
+	emit8(e, 0x66); emit8(e, 0x83); modrm_core(e, imm < 0 ? 5 : 0, off);
+	emit8(e, imm < 0 ? -imm : imm);
+}
+// mov reg, imm32
+static inline void
+movi(struct emitter* restrict e, uint8_t reg, uint32_t imm) {
+	emit8(e, 0xB8 + reg); emit32(e, imm);
+}
+// op dst, src (32-bit)
+static inline void
+alu(struct emitter* restrict e, uint8_t op, uint8_t dst, uint8_t src) {
+	emit8(e, op); emit8(e, 0xC0 | (src << 3) | dst);
+}
+// test reg, imm32
+static inline void
+testi(struct emitter* restrict e, uint8_t reg, uint32_t imm) {
+	emit8(e, 0xF7); emit8(e, 0xC0 | reg); emit32(e, imm);
+}
+// test al, al
+static inline void
+test_al(struct emitter* restrict e) {
+	emit8(e, 0x84); emit8(e, 0xC0);
+}
+// (shift) reg8, 1
+static inline void
+shift1(struct emitter* restrict e, uint8_t shift, uint8_t reg) {
+	emit8(e, 0xD0); emit8(e, 0xC0 | (shift << 3) | reg);
+}
+// movzx reg, reg16 (clears bits 16-31 after 16-bit address arithmetic)
+static inline void
+zext16(struct emitter* restrict e, uint8_t reg) {
+	emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xC0 | (reg << 3) | reg);
+}
+// setcc byte [rbx+off]
+static inline void
+setcc(struct emitter* restrict e, uint8_t cc, uint8_t off) {
+	emit8(e, 0x0F); emit8(e, 0x90 | cc); modrm_core(e, 0, off);
+}
+// jcc rel8, returning where to patch in the displacement.
+static inline uint8_t*
+jcc8(struct emitter* restrict e, uint8_t cc) {
+	emit8(e, 0x70 | cc);
+	emit8(e, 0);
+	return e->p - 1;
+}
+// Points the jump whose displacement is at `rel8` to the current position.
+static inline void
+patch8(struct emitter* restrict e, uint8_t* rel8) {
+	assert(e->p - (rel8 + 1) < 0x80);
+	*rel8 = (uint8_t)(e->p - (rel8 + 1));
+}
+// Fills in an imm32 emitted as 0.
+static inline void
+patch32(uint8_t* imm32, uint32_t value) {
+	for (uint8_t i = 0; i < 4; ++i)
+		imm32[i] = (value >> (8 * i)) & 0xFF;
+}
+// sub dword [rbx+budget], imm32
+static inline void
+sub_budget(struct emitter* restrict e, uint32_t cycles) {
+	emit8(e, 0x81); emit8(e, 0x80 | (5 << 3) | EBX); emit32(e, OFF_BUDGET);
+	emit32(e, cycles);
+}
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_cpu_jit_x64_translate()
+uint8_t
+gb_cpu_jit_x64_translate(
+		uint8_t* restrict dst,
+		size_t* restrict size,
+		uint8_t* restrict cycles,
+		const struct gb_cpu_block* restrict block) {
+	struct emitter e = { dst, NULL, block->pc };
+	emit8(&e, 0x53); // push rbx
+	emit8(&e, 0x55); // push rbp
+	emit8(&e, 0x48); emit8(&e, 0x83); emit8(&e, 0xEC); emit8(&e, 0x08); // sub rsp, 8
+	emit8(&e, 0x48); alu(&e, ALU_MOV, EBX, EDI); // mov rbx, rdi
+	e.start = e.p;
+
+	// Each instruction is preceded by its budget check, whose limit is
+	// filled in once the instruction's cycles are known.
+	struct bail bail = { .cycles = 0 };
+	uint8_t first_cycles = 0;
+	uint8_t len = 0;
+	for (; len < block->len; ++len) {
+		// Leave room for this instruction and whatever ends the block.
+		if (GB_CPU_JIT_BLOCK_MAX_CODE - (e.p - dst) < 2 * UOP_MAX_CODE)
+			break;
+		bail.pc = block->uop[len].pc;
+		bail.index = len;
+		uint8_t* guard = e.p;
+		uint8_t* limit = emit_guard(&e, &bail);
+		uint8_t uop_cycles = emit_uop(&e, block->uop + len, &bail);
+		if (!uop_cycles) {
+			e.p = guard;
+			break;
+		}
+		if (!len)
+			first_cycles = uop_cycles;
+		bail.cycles += uop_cycles;
+		patch32(limit, bail.cycles);
+	}
+
+	uint8_t max_cycles = 0;
+	if (len < block->len) {
+		bail.pc = block->uop[len].pc;
+		bail.index = len;
+		uint8_t* guard = e.p;
+		uint8_t* limit = emit_guard(&e, &bail);
+		max_cycles = emit_branch(&e, block->uop + len, &bail);
+		if (max_cycles)
+			patch32(limit, max_cycles);
+		else
+			e.p = guard;
+	}
+	if (max_cycles) {
+		if (!len)
+			first_cycles = max_cycles;
+		++len; // The branch ended the block.
+	} else {
+		if (len < 2) // Not worth leaving the interpreter for.
+			return 0;
+		uint16_t next = (len < block->len) ? block->uop[len].pc : block->end;
+		emit_exit(&e, next, bail.cycles, len);
+	}
+
+	assert(e.p - dst <= GB_CPU_JIT_BLOCK_MAX_CODE);
+	*size = e.p - dst;
+	*cycles = first_cycles;
+	return len;
+} // end gb_cpu_jit_x64_translate()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc emit_uop()
+// Emits native code for `uop`, if it is a supported instruction which
+// does not end the block. `bail` is where it leaves if it cannot make
+// its write.
+// Flags are computed exactly as the interpreter computes them.
+// Returns the number of cycles the instruction takes, or 0 if nothing
+// was emitted.
+//=======================================================================
+// def emit_uop()
+static uint8_t
+emit_uop(
+		struct emitter* restrict e,
+		const struct gb_cpu_uop* restrict uop,
+		const struct bail* restrict bail) {
+	uint8_t op = uop->opcode;
+	if (op >= 0x40 && op < 0x80) { // LD r8, r8/[HL] / LD [HL], r8
+		uint8_t dst = (op >> 3) & 7, src = op & 7;
+		if (op == 0x76) // HALT
+			return 0;
+		if (dst == 6) { // LD [HL], r8
+			load16(e, ECX, OFF_R(iHL));
+			load8(e, EDX, OFF_R8(src));
+			emit_write(e, bail, 0);
+			return 2;
+		}
+		if (src == 6) { // LD r8, [HL]
+			load16(e, ECX, OFF_R(iHL));
+			emit_read(e);
+			store8(e, OFF_R8(dst), EAX);
+			return 2;
+		}
+		load8(e, EAX, OFF_R8(src));
+		store8(e, OFF_R8(dst), EAX);
+		return 1;
+	}
+	if (op >= 0x80 && op < 0xC0) { // (ALU) A, r8/[HL]
+		if ((op & 7) == 6) {
+			load16(e, ECX, OFF_R(iHL));
+			emit_read(e);
+			alu(e, ALU_MOV, ECX, EAX);
+		} else {
+			load8(e, ECX, OFF_R8(op & 7));
+		}
+		emit_alu8(e, (op >> 3) & 7);
+		return (op & 7) == 6 ? 2 : 1;
+	}
+	if ((op & 0xC7) == 0xC6) { // (ALU) A, i8
+		movi(e, ECX, (uint8_t)uop->imm);
+		emit_alu8(e, (op >> 3) & 7);
+		return 2;
+	}
+	if (op == 0x36) { // LD [HL], i8
+		load16(e, ECX, OFF_R(iHL));
+		movi(e, EDX, (uint8_t)uop->imm);
+		emit_write(e, bail, 0);
+		return 3;
+	}
+	if ((op & 0xC7) == 0x06) { // LD r8, i8
+		store8i(e, OFF_R8(op >> 3), (uint8_t)uop->imm);
+		return 2;
+	}
+	if ((op & 0xC6) == 0x04) { // INC/DEC r8/[HL]
+		uint8_t dec = op & 1;
+		uint8_t off = OFF_R8((op >> 3) & 7);
+		uint8_t mem = ((op >> 3) & 7) == 6;
+		if (mem) {
+			load16(e, ECX, OFF_R(iHL));
+			emit_read(e);
+		} else {
+			load8(e, EAX, off);
+		}
+		emit8(e, dec ? 0x2C : 0x04); emit8(e, 0x01); // sub/add al, 1
+		if (mem) {
+			// Flags are set only once the write is made.
+			emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD0); // movzx edx, al
+			alu(e, ALU_MOV, EBP, EDX);
+			load16(e, ECX, OFF_R(iHL));
+			emit_write(e, bail, 0);
+			alu(e, ALU_MOV, EAX, EBP);
+			test_al(e);
+		}
+		setcc(e, CC_E, OFF_FZ);
+		if (!mem)
+			store8(e, off, EAX);
+		if (dec) {
+			emit8(e, 0x24); emit8(e, 0x0F); // and al, 0xF
+			emit8(e, 0x3C); emit8(e, 0x0F); // cmp al, 0xF
+		} else {
+			emit8(e, 0xA8); emit8(e, 0x0F); // test al, 0xF
+		}
+		setcc(e, CC_E, OFF_FH);
+		store8i(e, OFF_FN, dec);
+		return mem ? 3 : 1;
+	}
+	uint8_t off16 = r16_offset[(op >> 4) & 3];
+	switch (op & 0xCF) {
+		case 0x01: // LD r16, i16
+			store16i(e, off16, uop->imm);
+			return 3;
+		case 0x03: // INC r16
+			add16i(e, off16, 1);
+			return 2;
+		case 0x0B: // DEC r16
+			add16i(e, off16, -1);
+			return 2;
+		case 0x09: // ADD HL, r16
+			// H and C are the carries out of bits 11 and 15, recovered
+			// from (HL ^ r16 ^ sum).
+			load16(e, EAX, OFF_R(iHL));
+			load16(e, ECX, off16);
+			alu(e, ALU_MOV, EDX, EAX);
+			alu(e, ALU_XOR, EDX, ECX);
+			alu(e, ALU_ADD, EAX, ECX);
+			alu(e, ALU_XOR, EDX, EAX);
+			testi(e, EDX, 0x1000);
+			setcc(e, CC_NE, OFF_FH);
+			testi(e, EAX, 0x10000);
+			setcc(e, CC_NE, OFF_FC);
+			store16(e, OFF_R(iHL), EAX);
+			store8i(e, OFF_FN, 0);
+			return 2;
+		case 0xC5: { // PUSH r16
+			if (op == 0xF5) {
+				// DL = Z << 7 | N << 6 | H << 5 | C << 4, and DH = A.
+				// F is only stored once the write is made.
+				movi(e, EDX, 0);
+				const uint8_t flags[4] = { OFF_FZ, OFF_FN, OFF_FH, OFF_FC };
+				for (uint8_t i = 0; i < 4; ++i) {
+					emit8(e, 0x0A); modrm_core(e, EDX, flags[i]); // or dl, [rbx+off]
+					if (i < 3)
+						shift1(e, SH_SHL, EDX);
+				}
+				emit8(e, 0xC0); emit8(e, 0xE2); emit8(e, 4); // shl dl, 4
+				emit8(e, 0x8A); modrm_core(e, 6, OFF_R(iA)); // mov dh, [rbx+off]
+				alu(e, ALU_MOV, EBP, EDX);
+			} else {
+				load16(e, EDX, off16);
+			}
+			load16(e, ECX, OFF_SP);
+			emit8(e, 0x83); emit8(e, 0xE9); emit8(e, 2); // sub ecx, 2
+			zext16(e, ECX);
+			emit_write(e, bail, 1);
+			add16i(e, OFF_SP, -2);
+			if (op == 0xF5) {
+				// Without a REX prefix, 8-bit register 5 is CH, not BPL.
+				alu(e, ALU_MOV, EAX, EBP);
+				store8(e, OFF_R(iF), EAX);
+			}
+			return 4;
+		}
+		case 0xC1: // POP r16
+			load16(e, ECX, OFF_SP);
+			emit_read16(e);
+			add16i(e, OFF_SP, 2);
+			if (op == 0xF1) {
+				store16(e, OFF_R(iAF), EAX);
+				const uint8_t flags[4] = { OFF_FC, OFF_FH, OFF_FN, OFF_FZ };
+				emit8(e, 0xC1); emit8(e, 0xE8); emit8(e, 4); // shr eax, 4
+				for (uint8_t i = 0; i < 4; ++i) {
+					alu(e, ALU_MOV, EDX, EAX);
+					emit8(e, 0x80); emit8(e, 0xE2); emit8(e, 1); // and dl, 1
+					store8(e, flags[i], EDX);
+					if (i < 3)
+						shift1(e, SH_SHR, EAX);
+				}
+			} else {
+				store16(e, off16, EAX);
+			}
+			return 3;
+	}
+	switch (op) {
+		case 0x00: // NOP
+			return 1;
+		case 0x02: // LD [BC], A
+		case 0x12: // LD [DE], A
+		case 0x22: // LD [HL+], A
+		case 0x32: // LD [HL-], A
+			load16(e, ECX, op < 0x20 ? off16 : OFF_R(iHL));
+			load8(e, EDX, OFF_R(iA));
+			emit_write(e, bail, 0);
+			if (op >= 0x20)
+				add16i(e, OFF_R(iHL), op == 0x22 ? 1 : -1);
+			return 2;
+		case 0x0A: // LD A, [BC]
+		case 0x1A: // LD A, [DE]
+		case 0x2A: // LD A, [HL+]
+		case 0x3A: // LD A, [HL-]
+			load16(e, ECX, op < 0x20 ? off16 : OFF_R(iHL));
+			emit_read(e);
+			store8(e, OFF_R(iA), EAX);
+			if (op >= 0x20)
+				add16i(e, OFF_R(iHL), op == 0x2A ? 1 : -1);
+			return 2;
+		case 0xE0: // LD [FF00+i8], A
+		case 0xEA: { // LD [i16], A
+			uint16_t addr = (op == 0xE0) ? MEM_B_IO | (uint8_t)uop->imm : uop->imm;
+			if (never_plain(addr))
+				return 0; // Always the interpreter's
+			movi(e, ECX, addr);
+			load8(e, EDX, OFF_R(iA));
+			emit_write(e, bail, 0);
+			return (op == 0xE0) ? 3 : 4;
+		}
+		case 0xF0: // LD A, [FF00+i8]
+		case 0xF2: // LD A, [FF00+C]
+		case 0xFA: // LD A, [i16]
+			if (op == 0xF2) {
+				load8(e, ECX, OFF_R(iC));
+				emit8(e, 0x81); emit8(e, 0xC9); emit32(e, MEM_B_IO); // or ecx, 0xFF00
+			} else {
+				movi(e, ECX, op == 0xFA ? uop->imm : MEM_B_IO | (uint8_t)uop->imm);
+			}
+			emit_read(e);
+			store8(e, OFF_R(iA), EAX);
+			return op == 0xF2 ? 2 : op == 0xF0 ? 3 : 4;
+		case 0x07: // RLCA
+		case 0x0F: // RRCA
+		case 0x17: // RLA
+		case 0x1F: // RRA
+			// As RLC/RRC/RL/RR A, but Z is always reset.
+			load8(e, EAX, OFF_R(iA));
+			if (op >= 0x17) {
+				load8(e, ECX, OFF_FC);
+				shift1(e, SH_SHR, ECX); // carry in
+			}
+			shift1(e, op == 0x07 ? SH_ROL : op == 0x0F ? SH_ROR
+			         : op == 0x17 ? SH_RCL : SH_RCR, EAX);
+			setcc(e, CC_B, OFF_FC);
+			store8(e, OFF_R(iA), EAX);
+			store8i(e, OFF_FZ, 0);
+			store8i(e, OFF_FN, 0);
+			store8i(e, OFF_FH, 0);
+			return 1;
+		case 0x2F: // CPL: not byte [rbx+off]
+			emit8(e, 0xF6); modrm_core(e, 2, OFF_R(iA));
+			store8i(e, OFF_FN, 1);
+			store8i(e, OFF_FH, 1);
+			return 1;
+		case 0x37: // SCF
+			store8i(e, OFF_FN, 0);
+			store8i(e, OFF_FH, 0);
+			store8i(e, OFF_FC, 1);
+			return 1;
+		case 0x3F: // CCF: xor byte [rbx+off], 1
+			store8i(e, OFF_FN, 0);
+			store8i(e, OFF_FH, 0);
+			emit8(e, 0x80); modrm_core(e, 6, OFF_FC); emit8(e, 1);
+			return 1;
+		case 0xCB:
+			return emit_cb(e, (uint8_t)uop->imm);
+		case 0xF9: // LD SP, HL
+			load16(e, EAX, OFF_R(iHL));
+			store16(e, OFF_SP, EAX);
+			return 2;
+	}
+	return 0;
+} // end emit_uop()
+
+//=======================================================================
+// doc emit_cb()
+// Emits native code for CB-prefixed instruction `cb`, if it operates on
+// a register. RRC and SLA are left to the interpreter, whose results
+// for them differ from the hardware's.
+// Returns the number of cycles the instruction takes, or 0 if nothing
+// was emitted.
+//=======================================================================
+// def emit_cb()
+static uint8_t
+emit_cb(struct emitter* restrict e, uint8_t cb) {
+	if ((cb & 7) == 6) // [HL]
+		return 0;
+	uint8_t off = OFF_R8(cb & 7);
+	uint8_t bit = (cb >> 3) & 7;
+	if (cb >= 0x40) {
+		if (cb < 0x80) { // BIT: test byte [rbx+off], imm8
+			emit8(e, 0xF6); modrm_core(e, 0, off); emit8(e, 1 << bit);
+			setcc(e, CC_E, OFF_FZ);
+			store8i(e, OFF_FH, 1);
+			store8i(e, OFF_FN, 0);
+		} else if (cb < 0xC0) { // RES: and byte [rbx+off], imm8
+			emit8(e, 0x80); modrm_core(e, 4, off); emit8(e, ~(1 << bit));
+		} else { // SET: or byte [rbx+off], imm8
+			emit8(e, 0x80); modrm_core(e, 1, off); emit8(e, 1 << bit);
+		}
+		return 2;
+	}
+
+	load8(e, EAX, off);
+	switch (bit) {
+		case 0: shift1(e, SH_ROL, EAX); break; // RLC
+		case 2: // RL
+		case 3: // RR
+			load8(e, ECX, OFF_FC);
+			shift1(e, SH_SHR, ECX); // carry in
+			shift1(e, bit == 2 ? SH_RCL : SH_RCR, EAX);
+			break;
+		case 5: shift1(e, SH_SAR, EAX); break; // SRA
+		case 6: // SWAP: rol al, 4
+			emit8(e, 0xC0); emit8(e, 0xC0); emit8(e, 4);
+			store8i(e, OFF_FC, 0);
+			break;
+		case 7: shift1(e, SH_SHR, EAX); break; // SRL
+		default: // RRC, SLA
+			return 0;
+	}
+	if (bit != 6)
+		setcc(e, CC_B, OFF_FC);
+	store8(e, off, EAX);
+	test_al(e);
+	setcc(e, CC_E, OFF_FZ);
+	store8i(e, OFF_FN, 0);
+	store8i(e, OFF_FH, 0);
+	return 2;
+} // end emit_cb()
+
+//=======================================================================
+// doc emit_branch()
+// Emits native code for `uop` followed by the block's exit, if `uop`
+// is a supported jump, call, return, or RST. `bail` holds the cycles
+// taken by the preceding instructions. A jump to the start of the block
+// loops (see emit_jump()).
+// Returns the maximum number of cycles the block can take, or 0 if
+// nothing was emitted.
+//=======================================================================
+// def emit_branch()
+static uint8_t
+emit_branch(
+		struct emitter* restrict e,
+		const struct gb_cpu_uop* restrict uop,
+		const struct bail* restrict bail) {
+	uint8_t op = uop->opcode;
+	uint8_t cycles = bail->cycles;
+	uint8_t ran = bail->index + 1;
+	if (op == 0xE9) { // JP HL
+		load16(e, EAX, OFF_R(iHL));
+		emit_exit_eax(e, cycles + 1, ran);
+		return cycles + 1;
+	}
+
+	uint16_t target, next;
+	uint8_t taken, untaken;
+	uint8_t conditional;
+	if (op == 0xC3 || (op & 0xE7) == 0xC2) { // JP (cc,) i16
+		target = uop->imm;
+		next = uop->pc + 3;
+		taken = 4;
+		untaken = 3;
+		conditional = op != 0xC3;
+	} else if (op == 0x18 || (op & 0xE7) == 0x20) { // JR (cc,) si8
+		next = uop->pc + 2;
+		target = next + (int8_t)uop->imm;
+		taken = 3;
+		untaken = 2;
+		conditional = op != 0x18;
+	} else if (op == 0xCD || (op & 0xE7) == 0xC4) { // CALL (cc,) i16
+		target = uop->imm;
+		next = uop->pc + 3;
+		taken = 6;
+		untaken = 3;
+		conditional = op != 0xCD;
+	} else if (op == 0xC9 || (op & 0xE7) == 0xC0) { // RET (cc)
+		target = 0; // Popped
+		next = uop->pc + 1;
+		taken = (op == 0xC9) ? 4 : 5;
+		untaken = 2;
+		conditional = op != 0xC9;
+	} else if ((op & 0xC7) == 0xC7) { // RST
+		target = op & 0x38;
+		next = uop->pc + 1;
+		taken = 4;
+		untaken = 0;
+		conditional = 0;
+	} else {
+		return 0;
+	}
+
+	if (conditional) {
+		// Bits 3-4: NZ, Z, NC, C
+		uint8_t cond = (op >> 3) & 3;
+		emit8(e, 0x80); modrm_core(e, 7, (cond & 2) ? OFF_FC : OFF_FZ);
+		emit8(e, 0x00); // cmp byte [rbx+off], 0
+		// Skip to the untaken exit if the condition is false.
+		uint8_t* rel8 = jcc8(e, (cond & 1) ? CC_E : CC_NE);
+		if ((op & 0xC7) == 0xC0) { // RET cc
+			load16(e, ECX, OFF_SP);
+			emit_read16(e);
+			add16i(e, OFF_SP, 2);
+			emit_exit_eax(e, cycles + taken, ran);
+		} else if ((op & 0xC7) == 0xC4) { // CALL cc
+			load16(e, ECX, OFF_SP);
+			emit8(e, 0x83); emit8(e, 0xE9); emit8(e, 2); // sub ecx, 2
+			zext16(e, ECX);
+			movi(e, EDX, next);
+			emit_write(e, bail, 1);
+			add16i(e, OFF_SP, -2);
+			emit_exit(e, target, cycles + taken, ran);
+		} else { // JP cc, JR cc
+			emit_jump(e, target, cycles + taken, ran);
+		}
+		patch8(e, rel8);
+		emit_exit(e, next, cycles + untaken, ran);
+		return cycles + taken;
+	}
+
+	if (op == 0xC9) { // RET
+		load16(e, ECX, OFF_SP);
+		emit_read16(e);
+		add16i(e, OFF_SP, 2);
+		emit_exit_eax(e, cycles + taken, ran);
+	} else if (op == 0xCD || (op & 0xC7) == 0xC7) { // CALL, RST
+		load16(e, ECX, OFF_SP);
+		emit8(e, 0x83); emit8(e, 0xE9); emit8(e, 2); // sub ecx, 2
+		zext16(e, ECX);
+		movi(e, EDX, next);
+		emit_write(e, bail, 1);
+		add16i(e, OFF_SP, -2);
+		emit_exit(e, target, cycles + taken, ran);
+	} else { // JP, JR
+		emit_jump(e, target, cycles + taken, ran);
+	}
+	return cycles + taken;
+} // end emit_branch()
+
+//=======================================================================
+// doc emit_alu8()
+// Emits `A = A (op) ECX` and its flags, for ALU operation `alu8`
+// (see `enum alu8`).
+//=======================================================================
+// def emit_alu8()
+static void
+emit_alu8(struct emitter* restrict e, uint8_t alu8) {
+	load8(e, EAX, OFF_R(iA));
+	switch (alu8) {
+		case ALU8_ADD:
+		case ALU8_ADC:
+			// Z is set only if the unwrapped sum is 0, as in the
+			// interpreter. H is the carry out of bit 3, recovered from
+			// (A ^ rhs ^ sum).
+			alu(e, ALU_MOV, EDX, EAX);
+			alu(e, ALU_XOR, EDX, ECX);
+			alu(e, ALU_ADD, EAX, ECX);
+			if (alu8 == ALU8_ADC) {
+				load8(e, ECX, OFF_FC);
+				alu(e, ALU_ADD, EAX, ECX);
+			}
+			alu(e, ALU_XOR, EDX, EAX);
+			emit8(e, 0x85); emit8(e, 0xC0); // test eax, eax
+			setcc(e, CC_E, OFF_FZ);
+			emit8(e, 0x3D); emit32(e, 0xFF); // cmp eax, 0xFF
+			setcc(e, CC_A, OFF_FC);
+			store8(e, OFF_R(iA), EAX);
+			testi(e, EDX, 0x10);
+			setcc(e, CC_NE, OFF_FH);
+			store8i(e, OFF_FN, 0);
+			return;
+		case ALU8_SUB:
+		case ALU8_CP:
+			alu(e, ALU_SUB, EAX, ECX);
+			setcc(e, CC_E, OFF_FZ);
+			setcc(e, CC_B, OFF_FC);
+			if (alu8 == ALU8_SUB)
+				store8(e, OFF_R(iA), EAX);
+			// The interpreter's half-borrow test never succeeds.
+			store8i(e, OFF_FH, 0);
+			store8i(e, OFF_FN, 1);
+			return;
+		case ALU8_SBC:
+			load8(e, EDX, OFF_FC);
+			alu(e, ALU_SUB, EAX, ECX);
+			alu(e, ALU_SUB, EAX, EDX);
+			setcc(e, CC_E, OFF_FZ);
+			setcc(e, CC_S, OFF_FC);
+			store8(e, OFF_R(iA), EAX);
+			store8i(e, OFF_FH, 0);
+			store8i(e, OFF_FN, 1);
+			return;
+		case ALU8_AND:
+		case ALU8_XOR:
+		case ALU8_OR:
+			alu(e, alu8 == ALU8_AND ? ALU_AND
+			     : alu8 == ALU8_XOR ? ALU_XOR : ALU_OR, EAX, ECX);
+			setcc(e, CC_E, OFF_FZ);
+			store8(e, OFF_R(iA), EAX);
+			store8i(e, OFF_FN, 0);
+			store8i(e, OFF_FH, alu8 == ALU8_AND);
+			store8i(e, OFF_FC, 0);
+			return;
+	}
+} // end emit_alu8()
+
+//=======================================================================
+// doc emit_read()
+// Emits `EAX = byte at ECX`, which must hold a 16-bit address, through
+// the read page table (see gb_mem_u8read()). Clobbers ECX.
+//=======================================================================
+// def emit_read()
+static void
+emit_read(struct emitter* restrict e) {
+	alu(e, ALU_MOV, EAX, ECX);
+	emit8(e, 0xC1); emit8(e, 0xE8); emit8(e, 8); // shr eax, 8
+	// mov rax, [rbx + rax*8 + rpage]
+	emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x84); emit8(e, 0xC3);
+	emit32(e, OFF_RPAGE);
+	emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0); // test rax, rax
+	uint8_t* unbacked = jcc8(e, CC_E);
+	emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xC9); // movzx ecx, cl
+	emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x04); emit8(e, 0x08); // movzx eax, byte [rax+rcx]
+	emit8(e, 0xEB); // jmp rel8
+	uint8_t* done = e->p;
+	emit8(e, 0);
+	patch8(e, unbacked);
+	movi(e, EAX, 0xFF);
+	patch8(e, done);
+} // end emit_read()
+
+//=======================================================================
+// doc emit_read16()
+// Emits `EAX = word at ECX` (little-endian), like gb_mem_u16read().
+// Clobbers ECX and EBP.
+//=======================================================================
+// def emit_read16()
+static void
+emit_read16(struct emitter* restrict e) {
+	alu(e, ALU_MOV, EBP, ECX);
+	emit_read(e);
+	alu(e, ALU_MOV, EDX, EBP);
+	alu(e, ALU_MOV, EBP, EAX);
+	emit8(e, 0x8D); emit8(e, 0x4A); emit8(e, 1); // lea ecx, [rdx+1]
+	zext16(e, ECX);
+	emit_read(e);
+	emit8(e, 0xC1); emit8(e, 0xE0); emit8(e, 8); // shl eax, 8
+	alu(e, ALU_OR, EAX, EBP);
+} // end emit_read16()
+
+//=======================================================================
+// doc emit_write()
+// Emits a call writing EDX (a byte, or a word if `wide`) to the address
+// in ECX (see gb_cpu_jit_write8()), which leaves through `bail` if the
+// write cannot be made. Clobbers EAX, ECX, and EDX.
+//=======================================================================
+// def emit_write()
+static void
+emit_write(
+		struct emitter* restrict e,
+		const struct bail* restrict bail,
+		uint8_t wide) {
+	emit8(e, 0x48); alu(e, ALU_MOV, EDI, EBX); // mov rdi, rbx
+	alu(e, ALU_MOV, ESI, ECX);
+	emit8(e, 0x48); emit8(e, 0xB8); // mov rax, imm64
+	emit64(e, (uintptr_t)(wide ? (void*)gb_cpu_jit_write16 : (void*)gb_cpu_jit_write8));
+	emit8(e, 0xFF); emit8(e, 0xD0); // call rax
+	test_al(e);
+	uint8_t* written = jcc8(e, CC_NE);
+	emit_exit(e, bail->pc, bail->cycles, bail->index);
+	patch8(e, written);
+} // end emit_write()
+
+//=======================================================================
+// doc emit_guard()
+// Emits a check that the budget outlasts the instruction which follows,
+// leaving through `bail` otherwise.
+// Returns where to patch in the cycles which the block will have taken
+// by the end of that instruction.
+//=======================================================================
+// def emit_guard()
+static uint8_t*
+emit_guard(struct emitter* restrict e, const struct bail* restrict bail) {
+	// cmp dword [rbx+budget], imm32
+	emit8(e, 0x81); emit8(e, 0x80 | (7 << 3) | EBX); emit32(e, OFF_BUDGET);
+	uint8_t* limit = e->p;
+	emit32(e, 0);
+	uint8_t* covered = jcc8(e, CC_G);
+	emit_exit(e, bail->pc, bail->cycles, bail->index);
+	patch8(e, covered);
+	return limit;
+} // end emit_guard()
+
+//=======================================================================
+// doc emit_jump()
+// Emits the exit of a block which jumps to `target` having taken
+// `cycles` and run `ran` instructions. If `target` is the start of the
+// block, consumes the cycles and loops back to it instead.
+//=======================================================================
+// def emit_jump()
+static void
+emit_jump(struct emitter* restrict e, uint16_t target, uint8_t cycles, uint8_t ran) {
+	if (target != e->start_pc) {
+		emit_exit(e, target, cycles, ran);
+		return;
+	}
+#ifdef GB_CPU_JIT_VERIFY
+	// Leave while another pass is sure to fit in the write log.
+	// cmp word [rbx+write_count], imm16
+	emit8(e, 0x66); emit8(e, 0x81); emit8(e, 0x80 | (7 << 3) | EBX);
+	emit32(e, OFF_WRITE_COUNT);
+	emit16(e, GB_CPU_JIT_MAX_WRITES - 2 * GB_CPU_BLOCK_MAX_UOPS);
+	uint8_t* room = jcc8(e, CC_BE);
+	emit_exit(e, target, cycles, ran);
+	patch8(e, room);
+#endif
+	sub_budget(e, cycles);
+	// add dword [rbx+looped], imm8
+	emit8(e, 0x83); emit8(e, 0x80 | EBX); emit32(e, OFF_LOOPED); emit8(e, ran);
+	emit8(e, 0xE9); // jmp rel32
+	emit32(e, (uint32_t)(e->start - (e->p + 4)));
+} // end emit_jump()
+
+//=======================================================================
+// doc emit_exit()
+// Emits code which sets PC to `pc`, consumes `cycles` from the budget,
+// and returns `ran`, the number of instructions run.
+//=======================================================================
+// def emit_exit()
+static void
+emit_exit(struct emitter* restrict e, uint16_t pc, uint8_t cycles, uint8_t ran) {
+	store16i(e, OFF_PC, pc);
+	emit_return(e, cycles, ran);
+} // end emit_exit()
+
+//=======================================================================
+// doc emit_exit_eax()
+// Like emit_exit(), for a PC held in AX.
+//=======================================================================
+// def emit_exit_eax()
+static void
+emit_exit_eax(struct emitter* restrict e, uint8_t cycles, uint8_t ran) {
+	store16(e, OFF_PC, EAX);
+	emit_return(e, cycles, ran);
+} // end emit_exit_eax()
+
+//=======================================================================
+// doc emit_return()
+// Emits code which consumes `cycles` from the budget, and returns `ran`.
+//=======================================================================
+// def emit_return()
+static void
+emit_return(struct emitter* restrict e, uint8_t cycles, uint8_t ran) {
+	if (cycles)
+		sub_budget(e, cycles);
+	movi(e, EAX, ran);
+	emit8(e, 0x48); emit8(e, 0x83); emit8(e, 0xC4); emit8(e, 0x08); // add rsp, 8
+	emit8(e, 0x5D); // pop rbp
+	emit8(e, 0x5B); // pop rbx
+	emit8(e, 0xC3); // ret
+} // end emit_return()
+
+//=======================================================================
+// doc never_plain()
+// Returns nonzero if writes to `addr` are never plain (see
+// gb_mem_is_plain_write()): they go to the MBC, SRAM, or I/O.
+//=======================================================================
+// def never_plain()
+static inline uint8_t
+never_plain(uint16_t addr) {
+	return addr < MEM_B_VRAM
+	    || (addr >= MEM_B_SRAM && addr < MEM_E_SRAM)
+	    || (addr >= MEM_B_IO && addr < MEM_B_HRAM)
+	    || addr == MEM_E_HRAM;
+} // end never_plain()
+
+#endif // GB_CPU_JIT
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "gb/core/typedef.h"
 #include "gb/cpu.h"
+#include "gb/cpu/interpreter.h"
 #include "gb/cpu/opc.h"
 #include "gb/cpu/opc/decoder/oper.h"
 #include "gb/cpu/opc/decoder/opnd.h"
@@ -90,13 +91,15 @@ size_t
 gb_opc_string(
 		char* restrict buf, size_t bufsz,
 		const struct gb_opc_components* restrict opc,
-		const struct gb_core* restrict core) {
+		struct gb_core* restrict core) {
 	struct write_dst dst = {
 		.buf = buf,
 		.pos = 0,
 		.size = bufsz
 	};
 	if (core != NULL) {
+		// Flags are reported as live values; compute any still pending.
+		gb_cpu_sync_flags(core);
 		// Write opcode's memory byte offset
 		prefix_byteno(&dst, core->cpu.pc);
 		// Write opcode and immediate bytes
@@ -0,0 +1,151 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "gb/hash.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL CONSTANT DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+enum {
+	STRIPE_SIZE = 32, // bytes, 8 per lane
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static inline uint64_t
+rotl64(uint64_t x, int r);
+static inline uint64_t
+read64(const uint8_t* p);
+static inline uint32_t
+read32(const uint8_t* p);
+static inline uint64_t
+lane_round(uint64_t acc, uint64_t input);
+static inline uint64_t
+merge_lane(uint64_t acc, uint64_t lane);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_hash64()
+uint64_t
+gb_hash64(const void* restrict data, size_t len, uint64_t seed) {
+	const uint8_t* p = data;
+	const uint8_t* end = p + len;
+	uint64_t h;
+	if (len >= STRIPE_SIZE) {
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const uint8_t* last_stripe = end - STRIPE_SIZE;
+		do {
+			v1 = lane_round(v1, read64(p));
+			v2 = lane_round(v2, read64(p + 8));
+			v3 = lane_round(v3, read64(p + 16));
+			v4 = lane_round(v4, read64(p + 24));
+			p += STRIPE_SIZE;
+		} while (p <= last_stripe);
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = merge_lane(h, v1);
+		h = merge_lane(h, v2);
+		h = merge_lane(h, v3);
+		h = merge_lane(h, v4);
+	} else {
+		h = seed + PRIME5;
+	}
+	h += (uint64_t)len;
+
+	// Tail, of fewer than STRIPE_SIZE bytes
+	for (; end - p >= 8; p += 8) {
+		h ^= lane_round(0, read64(p));
+		h = rotl64(h, 27) * PRIME1 + PRIME4;
+	}
+	if (end - p >= 4) {
+		h ^= (uint64_t)read32(p) * PRIME1;
+		h = rotl64(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; ++p) {
+		h ^= *p * PRIME5;
+		h = rotl64(h, 11) * PRIME1;
+	}
+
+	// Avalanche
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+} // end gb_hash64()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def rotl64()
+static inline uint64_t
+rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+} // end rotl64()
+
+//=======================================================================
+// doc read64(), read32()
+// Read little-endian values, whatever the host's byte order.
+//=======================================================================
+// def read64()
+static inline uint64_t
+read64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+} // end read64()
+
+//=======================================================================
+// def read32()
+static inline uint32_t
+read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+} // end read32()
+
+//=======================================================================
+// def lane_round()
+static inline uint64_t
+lane_round(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME1;
+} // end lane_round()
+
+//=======================================================================
+// def merge_lane()
+static inline uint64_t
+merge_lane(uint64_t acc, uint64_t lane) {
+	acc ^= lane_round(0, lane);
+	return acc * PRIME1 + PRIME4;
+} // end merge_lane()
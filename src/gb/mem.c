@@ -1,14 +1,20 @@
+#include <assert.h>
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "gb/core/typedef.h"
 #include "gb/cpu.h"
+#include "gb/cpu/bcache.h"
 #include "gb/log.h"
 #include "gb/mem.h"
 #include "gb/mem/io.h"
 #include "gb/mode.h"
 #include "gb/pad.h"
+#include "gb/pak.h"
+#include "gb/pak/const.h"
+#include "gb/pak/mbc.h"
+#include "gb/pak/typedef.h"
 #include "gb/ppu.h"
 
 #define GB_LOG_MAX_LEVEL LVL_NONE
@@ -25,6 +31,13 @@
 // Internal function declarations
 //-----------------------------------------------------------------------
 //=======================================================================
+static void
+map_pages(struct gb_core* restrict core);
+static void
+u8write_slow(
+		struct gb_core* restrict core,
+		uint16_t addr,
+		uint8_t value);
 static inline void
 u8writef(
 		struct gb_core* restrict core,
@@ -36,7 +49,34 @@ echo_ram_write(
 		uint16_t addr,
 		uint8_t value);
 static void
+on_mbc_write(struct gb_core* restrict core);
+static void
 disable_audio(struct gb_core* restrict core);
+static inline void
+check_code_write(struct gb_core* restrict core, uint16_t addr);
+static inline void
+mark_ppu_granule(struct gb_core* restrict core, uint16_t granule);
+static void
+copy_ppu_registers(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst);
+static void
+copy_ppu_granules(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst,
+		const uint64_t dirty[GB_MEM_PPU_DIRTY_WORDS]);
+static void
+flag_ppu_tiles(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst);
+static void
+begin_ppu_epoch(struct gb_core* restrict core);
+static void
+end_ppu_generation(struct gb_core* restrict core, struct gb_ppu_state* restrict dst);
+static void
+dma_to_oam(struct gb_core* restrict core, const uint8_t* restrict src);
+static void
+write_palette(struct gb_core* restrict core, uint16_t addr, uint8_t value);
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -57,14 +97,22 @@ const char* gb_mem_rom_filepath = NULL;
 // def gb_mem_init()
 uint8_t
 gb_mem_init(struct gb_core* restrict core) {
-	assert(gb_mem_rom_filepath != NULL);
-	FILE* tetris = fopen(gb_mem_rom_filepath, "rb");
-	if (tetris == NULL) {
-		fprintf(stderr, "Failed to open %s.\n", gb_mem_rom_filepath);
+	return gb_mem_init_rom(core, gb_mem_rom_filepath);
+} // end gb_mem_init()
+
+//=======================================================================
+// def gb_mem_init_rom()
+uint8_t
+gb_mem_init_rom(struct gb_core* restrict core, const char* restrict rom_filepath) {
+	assert(rom_filepath != NULL);
+	map_pages(core);
+	struct gb_pak* pak = gb_pak_create(rom_filepath);
+	if (pak == NULL) {
+		fprintf(stderr, "Failed to load %s.\n", rom_filepath);
 		return 1;
 	}
-	if (fread(SELF.map, 1, 0x8000 /* 32 KiB */, tetris) != 0x8000) {
-		fputs("Failed to read from ROM file.\n", stderr);
+	if (gb_pak_insert(pak, &SELF)) {
+		gb_pak_delete(pak);
 		return 1;
 	}
 
@@ -72,8 +120,13 @@ gb_mem_init(struct gb_core* restrict core) {
 	SELF.stat_int = 0;
 	SELF.ime = 0;
 	// Other
-	SELF.pak = NULL;
 	SELF.pad = 0xFF; // Nothing pressed
+	// PPU state hand-off
+	memset(SELF.ppu_dirty, 0, sizeof(SELF.ppu_dirty));
+	SELF.ppu_epoch = 1; // Snapshots synced at epoch 0 need a full copy.
+	memset(SELF.ppu_lines, 0, sizeof(SELF.ppu_lines));
+	SELF.ppu_generation = 0;
+	SELF.ppu_frames = 0;
 
 #define IO(reg) (SELF.map[IO_##reg])
 	IO(JOYP) = 0xCF;
@@ -98,28 +151,48 @@ gb_mem_init(struct gb_core* restrict core) {
 	IO(WX)   = 0x00;
 	IO(IE)   = 0xE0;
 #undef IO
+	SELF.ppu_palettes = (struct gb_ppu_palettes){
+		.generation = 1,
+		.bgp = SELF.map[IO_BGP],
+		.obp0 = SELF.map[IO_OBP0],
+		.obp1 = SELF.map[IO_OBP1]
+	};
+	for (uint8_t line = 0; line < PPU_SCR_HEIGHT; ++line)
+		gb_mem_io_capture_line(core, line);
+	SELF.ppu_lines_changed = 1; // The first hand-off is always new.
+	SELF.ppu_lcdc = SELF.map[IO_LCDC];
 	return 0;
-} // end gb_mem_init()
+} // end gb_mem_init_rom()
+
+//=======================================================================
+// def gb_mem_destroy()
+void
+gb_mem_destroy(struct gb_core* restrict core) {
+	gb_pak_delete(SELF.pak);
+	SELF.pak = NULL;
+} // end gb_mem_destroy()
 
 //=======================================================================
 // def gb_mem_direct_read()
 uint8_t
 gb_mem_direct_read(const struct gb_core* restrict core, uint16_t addr) {
-	return core->mem.map[addr];
+	const uint8_t* page = core->mem.rpage[addr >> 8];
+	return page ? page[addr & 0xFF] : 0xFF;
 } // end gb_mem_direct_read()
 
 //=======================================================================
 // def gb_mem_u8read()
 uint8_t
 gb_mem_u8read(const struct gb_core* restrict core, uint16_t addr) {
-	return core->mem.map[addr];
+	const uint8_t* page = core->mem.rpage[addr >> 8];
+	return page ? page[addr & 0xFF] : 0xFF;
 } // end gb_mem_u8read()
 
 //=======================================================================
 // def gb_mem_s8read()
 int8_t
 gb_mem_s8read(const struct gb_core* restrict core, uint16_t addr) {
-	return *((int8_t*)(core->mem.map + addr));
+	return (int8_t)gb_mem_u8read(core, addr);
 } // end gb_mem_s8read()
 
 //=======================================================================
@@ -133,9 +206,12 @@ gb_mem_u8readff(const struct gb_core* restrict core, uint16_t addr) {
 // def gb_mem_u16read()
 uint16_t
 gb_mem_u16read(const struct gb_core* restrict core, uint16_t addr) {
-	// TODO: Account for Big/Mixed Endian machines.
 	// TODO: Account for proper memory write timings.
-	return *((uint16_t*)(core->mem.map + addr));
+	const uint8_t* page = core->mem.rpage[addr >> 8];
+	uint8_t offset = addr & 0xFF;
+	if (page && offset != 0xFF) // Both bytes within the same page
+		return page[offset] | (page[offset + 1] << 8);
+	return gb_mem_u8read(core, addr) | (gb_mem_u8read(core, addr + 1) << 8);
 } // end gb_mem_u16read()
 
 //=======================================================================
@@ -146,32 +222,15 @@ gb_mem_u8write(
 		uint16_t addr,
 		uint8_t value) {
 	//LOGT("gb_mem_u8write($%" PRIX16 ", $%" PRIX8 ")", addr, value);
-	switch (addr >> 12) { // Address via upper nybble
-		case 0x0: case 0x1: case 0x2: case 0x3: // ROM1
-		case 0x4: case 0x5: case 0x6: case 0x7: // ROM2
-		case 0xA: case 0xB: // SRAM
-			// TODO: Pass to MBC
-			return;
-		case 0x8: case 0x9: // VRAM
-			// TODO: On CGB, this needs to writethrough to backing VRAM array.
-			// The backing array contains both banks of VRAM that CGB has.
-			core->mem.map[addr] = value;
-			return;
-		case 0xC: case 0xD: // RAM1, RAM2
-			// TODO: On CGB, must writethrough to backing RAM array that
-			// contains all banks.
-			core->mem.map[addr] = value;
-			if (addr < MEM_E_ERAM - MEM_SZ_RAM) // Echo RAM range
-				core->mem.map[addr + MEM_SZ_RAM] = value;
-			return;
-		case 0xE: // Echo RAM (most of it, rest shares 0xF range with many other registers).
-			echo_ram_write(core, addr, value);
-			return;
-		case 0xF: // Range containing many different things.
-			u8writef(core, addr, value);
-			return;
-	} // end switch 
-	core->mem.map[addr] = value;
+	uint8_t* page = core->mem.wpage[addr >> 8];
+	if (page) { // Plain memory (VRAM, RAM)
+		page[addr & 0xFF] = value;
+		check_code_write(core, addr);
+		if ((uint16_t)(addr - MEM_B_VRAM) < MEM_SZ_VRAM)
+			mark_ppu_granule(core, (addr - MEM_B_VRAM) >> GB_MEM_PPU_GRANULE_BITS);
+		return;
+	}
+	u8write_slow(core, addr, value);
 } // end gb_mem_u8write()
 
 //=======================================================================
@@ -215,9 +274,6 @@ gb_mem_u8writeff(
 		case IO_WAVC: case IO_WAVD: case IO_WAVE: case IO_WAVF:
 		case IO_SCY:  // Background viewport position Y
 		case IO_SCX:  // Background viewport position X
-		case IO_BGP:  // DMG BG palette
-		case IO_OBP0: // DMG OBJ palette 0
-		case IO_OBP1: // DMG OBJ palette 1
 		case IO_WY:   // Window Y position
 		case IO_WX:   // Window X position
 		case IO_NOBT: // Disable boot ROM
@@ -280,6 +336,11 @@ gb_mem_u8writeff(
 			gb_sch_on_lcdc_update(core, core->mem.map[IO_LCDC], value);
 			core->mem.map[IO_LCDC] = value;
 			return;
+		case IO_BGP:  // DMG BG palette
+		case IO_OBP0: // DMG OBJ palette 0
+		case IO_OBP1: // DMG OBJ palette 1
+			write_palette(core, addr, value);
+			return;
 		case IO_STAT: // LCD status
 			IO_MASKED_WRITE(addr, IO_STAT_WRITABLE, value);
 			return;
@@ -293,10 +354,12 @@ gb_mem_u8writeff(
 			//       for 160 cycles.
 			if (value > 0xDF)
 				value = 0xDF; // TODO: Investigate and emulate proper behavior.
-			memcpy(core->mem.map + MEM_B_OAM, core->mem.map + value * 0x100, MEM_SZ_OAM);
+			dma_to_oam(core, core->mem.rpage[value]);
 		default:
-			if (addr >= MEM_B_HRAM)
-				core->mem.map[addr] = value; // HRAM write, no side-effects
+			if (addr >= MEM_B_HRAM) {
+				core->mem.map[addr] = value; // HRAM write
+				check_code_write(core, addr);
+			}
 			return;
 	} // end switch
 } // end gb_mem_u8writeff()
@@ -315,6 +378,19 @@ gb_mem_u16write(
 	gb_mem_u8write(core, addr+1, (value >> 8) & 0xFF);
 } // end gb_mem_u16write()
 
+//=======================================================================
+// def gb_mem_is_plain_write()
+uint8_t
+gb_mem_is_plain_write(const struct gb_core* restrict core, uint16_t addr) {
+	if (core->mem.wpage[addr >> 8]) // VRAM, RAM
+		return 1;
+	// Echo RAM, OAM (whose writes depend only on STAT), and the
+	// forbidden region after it, whose writes are ignored.
+	if (addr >= MEM_B_ERAM && addr < MEM_B_IO)
+		return 1;
+	return addr >= MEM_B_HRAM && addr < MEM_E_HRAM;
+} // end gb_mem_is_plain_write()
+
 //=======================================================================
 // def gb_mem_copy_ppu_state()
 void
@@ -322,34 +398,59 @@ gb_mem_copy_ppu_state(
 		struct gb_core* restrict core,
 		struct gb_ppu_state* restrict dst) {
 	LOGT("start: core=%p, dst=%p", core, dst);
-	dst->mode = GBMODE_DMG;
-	memcpy(dst->vram, core->mem.map + MEM_B_VRAM, MEM_SZ_VRAM);
-	memcpy(dst->oam, core->mem.map + MEM_B_OAM, MEM_SZ_OAM);
-	static_assert(sizeof(uint8_t*) >= 3);
-//	LOGD("Before palette copy.");
-//	intptr_t intpal;
-//	uint8_t* palette;
-//	intpal = (((intptr_t)(core->mem.map[IO_BGP])) << 16);
-//	LOGD("intpal (1) = %p", intpal);
-//	palette = (uint8_t*)intpal;
-//	LOGD("palette (1) = %p", palette);
-//	palette |= (uint8_t*)(((intptr_t)(core->mem.map[IO_OBP1])) << 8);
-//	LOGD("palette (2) = %p", palette);
-//	palette |= (uint8_t*)((intptr_t)(core->mem.map[IO_OBP0]));
-//	LOGD("palette (3) = %p", palette);
-	dst->palette = (uint8_t*)(
-			(((intptr_t)(core->mem.map[IO_BGP ])) << 16) |
-			(((intptr_t)(core->mem.map[IO_OBP1])) <<  8) |
-			  (intptr_t)(core->mem.map[IO_OBP0])
-	);
-	dst->lcdc = core->mem.map[IO_LCDC];
-	dst->scy = core->mem.map[IO_SCY];
-	dst->scx = core->mem.map[IO_SCX];
-	dst->wy = core->mem.map[IO_WY];
-	dst->wx = core->mem.map[IO_WX];
+	dst->vram = dst->buffer;
+	dst->oam = dst->buffer + MEM_SZ_VRAM;
+	uint64_t epoch = SELF.ppu_epoch;
+	if (!dst->synced || epoch - dst->synced >= GB_MEM_PPU_DIRTY_HISTORY) {
+		memcpy(dst->vram, core->mem.map + MEM_B_VRAM, MEM_SZ_VRAM);
+		memcpy(dst->oam, core->mem.map + MEM_B_OAM, MEM_SZ_OAM);
+	} else {
+		uint64_t dirty[GB_MEM_PPU_DIRTY_WORDS] = {0};
+		for (uint64_t e = dst->synced + 1; e <= epoch; ++e) {
+			for (int w = 0; w < GB_MEM_PPU_DIRTY_WORDS; ++w)
+				dirty[w] |= SELF.ppu_dirty[e % GB_MEM_PPU_DIRTY_HISTORY][w];
+		}
+		copy_ppu_granules(core, dst, dirty);
+	}
+	dst->synced = epoch;
+	flag_ppu_tiles(core, dst);
+	end_ppu_generation(core, dst);
+	begin_ppu_epoch(core);
+	copy_ppu_registers(core, dst);
 	LOGT("returning");
 } // end gb_mem_copy_ppu_state()
 
+//=======================================================================
+// def gb_mem_view_ppu_state()
+void
+gb_mem_view_ppu_state(
+		struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst) {
+	dst->vram = core->mem.map + MEM_B_VRAM;
+	dst->oam = core->mem.map + MEM_B_OAM;
+	dst->synced = 0; // `buffer` is no longer kept up to date.
+	flag_ppu_tiles(core, dst);
+	end_ppu_generation(core, dst);
+	begin_ppu_epoch(core);
+	copy_ppu_registers(core, dst);
+} // end gb_mem_view_ppu_state()
+
+//=======================================================================
+// doc copy_ppu_registers()
+// Copies the registers which the PPU reads, other than VRAM and OAM:
+// those captured for each line, and those of the hand-off itself.
+//=======================================================================
+// def copy_ppu_registers()
+static void
+copy_ppu_registers(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst) {
+	dst->mode = GBMODE_DMG;
+	dst->frame = core->mem.ppu_frames;
+	memcpy(dst->lines, core->mem.ppu_lines, sizeof(dst->lines));
+	dst->lcdc = core->mem.map[IO_LCDC];
+} // end copy_ppu_registers()
+
 void
 gb_mem_set_pad(struct gb_core* restrict core, uint8_t gb_pad) {
 	core->mem.pad = gb_pad;
@@ -363,7 +464,64 @@ gb_mem_set_pad(struct gb_core* restrict core, uint8_t gb_pad) {
 //=======================================================================
 
 //=======================================================================
-// doc u8write()
+// doc map_pages()
+// Points the page tables at the flat memory map, except for ROM and
+// SRAM, which are left for the pak to map (see gb_pak_insert()).
+// Reads of echo RAM are served from the RAM it mirrors, and only VRAM
+// and RAM are written directly; all other writes have side effects or
+// are ignored.
+//=======================================================================
+// def map_pages()
+static void
+map_pages(struct gb_core* restrict core) {
+	for (uint16_t page = 0; page < 0x100; ++page) {
+		SELF.rpage[page] = SELF.map + (page << 8);
+		SELF.wpage[page] = NULL;
+	}
+	for (uint16_t page = MEM_B_ROM1 >> 8; page < MEM_E_ROM2 >> 8; ++page)
+		SELF.rpage[page] = NULL;
+	for (uint16_t page = MEM_B_SRAM >> 8; page < MEM_E_SRAM >> 8; ++page)
+		SELF.rpage[page] = NULL;
+	for (uint16_t page = MEM_B_ERAM >> 8; page < MEM_E_ERAM >> 8; ++page)
+		SELF.rpage[page] = SELF.map + (page << 8) - MEM_SZ_RAM;
+	// TODO: On CGB, VRAM and RAM2 pages must point into the selected banks.
+	for (uint16_t page = MEM_B_VRAM >> 8; page < MEM_E_VRAM >> 8; ++page)
+		SELF.wpage[page] = SELF.map + (page << 8);
+	for (uint16_t page = MEM_B_RAM1 >> 8; page < MEM_E_RAM2 >> 8; ++page)
+		SELF.wpage[page] = SELF.map + (page << 8);
+} // end map_pages()
+
+//=======================================================================
+// doc u8write_slow()
+// Writes to a page which has no host memory in `wpage`.
+//=======================================================================
+// def u8write_slow()
+static void
+u8write_slow(
+		struct gb_core* restrict core,
+		uint16_t addr,
+		uint8_t value) {
+	switch (addr >> 12) { // Address via upper nybble
+		case 0x0: case 0x1: case 0x2: case 0x3: // ROM1
+		case 0x4: case 0x5: case 0x6: case 0x7: // ROM2
+			mbc_write8[SELF.pak->mbc_id].rom(&SELF, SELF.pak, addr, value);
+			on_mbc_write(core);
+			return;
+		case 0xA: case 0xB: // SRAM
+			mbc_write8[SELF.pak->mbc_id].ram(&SELF, SELF.pak, addr, value);
+			return;
+		// VRAM and RAM (0x8, 0x9, 0xC, 0xD) are always in `wpage`.
+		case 0xE: // Echo RAM (most of it, rest shares 0xF range with many other registers).
+			echo_ram_write(core, addr, value);
+			return;
+		case 0xF: // Range containing many different things.
+			u8writef(core, addr, value);
+			return;
+	} // end switch
+} // end u8write_slow()
+
+//=======================================================================
+// doc u8writef()
 // TODO
 //=======================================================================
 // def u8writef()
@@ -382,8 +540,11 @@ u8writef(
 		case 0xFE: // OAM (or prohibited region following it)
 			// Ignore writes to prohibited region
 			// -OR- to OAM during PPU modes 2 and 3.
-			if (addr < MEM_E_OAM && (core->mem.map[IO_STAT] & IO_STAT_MODE) < 2)
+			if (addr < MEM_E_OAM && (core->mem.map[IO_STAT] & IO_STAT_MODE) < 2) {
 				core->mem.map[addr] = value;
+				mark_ppu_granule(core, GB_MEM_PPU_VRAM_GRANULES
+						+ ((addr - MEM_B_OAM) >> GB_MEM_PPU_GRANULE_BITS));
+			}
 			return;
 		case 0xFF: // I/O registers + HRAM
 			gb_mem_u8writeff(core, addr, value);
@@ -401,10 +562,25 @@ echo_ram_write(
 		struct gb_core* restrict core,
 		uint16_t addr,
 		uint8_t value) {
-	core->mem.map[addr] = value;              // ECHO RAM write
+	// Echo RAM itself is never read (see map_pages()).
 	core->mem.map[addr - MEM_SZ_RAM] = value; // RAM write
+	check_code_write(core, addr - MEM_SZ_RAM);
 } // end echo_ram_write()
 
+//=======================================================================
+// doc on_mbc_write()
+// Informs the block cache of the ROM banks that the MBC now maps,
+// as read back from the page tables.
+//=======================================================================
+// def on_mbc_write()
+static void
+on_mbc_write(struct gb_core* restrict core) {
+	const uint8_t* rom = SELF.pak->rom;
+	gb_cpu_bcache_on_rom_bank(core,
+			(SELF.rpage[MEM_B_ROM1 >> 8] - rom) / PAK_ROM_BANK_SIZE,
+			(SELF.rpage[MEM_B_ROM2 >> 8] - rom) / PAK_ROM_BANK_SIZE);
+} // end on_mbc_write()
+
 //=======================================================================
 //=======================================================================
 // def disable_audio()
@@ -440,3 +616,153 @@ disable_audio(struct gb_core* restrict core) {
 	memset(core->mem.map + IO_WAV0, 0, (IO_WAVF+1) - IO_WAV0);
 } // end disable_audio()
 
+//=======================================================================
+// doc check_code_write()
+// Invalidates cached CPU blocks decoded from the granule of RAM
+// containing `addr`, if there are any.
+//=======================================================================
+// def check_code_write()
+static inline void
+check_code_write(struct gb_core* restrict core, uint16_t addr) {
+	if (core->cpu.bcache.watch[addr >> GB_CPU_BCACHE_GRANULE_BITS])
+		gb_cpu_bcache_on_code_write(core, addr);
+} // end check_code_write()
+
+//=======================================================================
+// doc mark_ppu_granule()
+// Flags a granule of VRAM or OAM as written during the current epoch.
+// `granule` counts VRAM granules first, then OAM granules.
+//=======================================================================
+// def mark_ppu_granule()
+static inline void
+mark_ppu_granule(struct gb_core* restrict core, uint16_t granule) {
+	SELF.ppu_dirty[SELF.ppu_epoch % GB_MEM_PPU_DIRTY_HISTORY][granule >> 6] |=
+		(uint64_t)1 << (granule & 63);
+} // end mark_ppu_granule()
+
+//=======================================================================
+// doc flag_ppu_tiles()
+// Flags each tile written since `dst->tiles_synced` in `dst->tiles_dirty`
+// (or every tile, if those writes are no longer known), up to the end
+// of the current epoch.
+//=======================================================================
+// def flag_ppu_tiles()
+static void
+flag_ppu_tiles(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst) {
+	// Granules of tile data are whole tiles, in the same order.
+	static_assert(PPU_TILE_SIZE == 1 << GB_MEM_PPU_GRANULE_BITS);
+	static_assert((int)PPU_TILE_DIRTY_WORDS <= (int)GB_MEM_PPU_DIRTY_WORDS);
+	uint64_t epoch = SELF.ppu_epoch;
+	if (!dst->tiles_synced || epoch - dst->tiles_synced >= GB_MEM_PPU_DIRTY_HISTORY) {
+		memset(dst->tiles_dirty, 0xFF, sizeof(dst->tiles_dirty));
+	} else {
+		for (uint64_t e = dst->tiles_synced + 1; e <= epoch; ++e) {
+			for (int w = 0; w < PPU_TILE_DIRTY_WORDS; ++w)
+				dst->tiles_dirty[w] |= SELF.ppu_dirty[e % GB_MEM_PPU_DIRTY_HISTORY][w];
+		}
+	}
+	dst->tiles_synced = epoch;
+} // end flag_ppu_tiles()
+
+//=======================================================================
+// doc begin_ppu_epoch()
+// Ends the current epoch, reusing the row of the oldest one for the next.
+//=======================================================================
+// def begin_ppu_epoch()
+static void
+begin_ppu_epoch(struct gb_core* restrict core) {
+	uint64_t epoch = ++SELF.ppu_epoch;
+	memset(SELF.ppu_dirty[epoch % GB_MEM_PPU_DIRTY_HISTORY], 0,
+			sizeof(SELF.ppu_dirty[0]));
+} // end begin_ppu_epoch()
+
+//=======================================================================
+// doc end_ppu_generation()
+// Bumps the PPU state generation if anything the PPU reads changed
+// during the current epoch, and hands it off in `dst->generation`.
+//=======================================================================
+// def end_ppu_generation()
+static void
+end_ppu_generation(struct gb_core* restrict core, struct gb_ppu_state* restrict dst) {
+	const uint64_t* written = SELF.ppu_dirty[SELF.ppu_epoch % GB_MEM_PPU_DIRTY_HISTORY];
+	uint64_t changed = SELF.ppu_lines_changed || SELF.map[IO_LCDC] != SELF.ppu_lcdc;
+	for (int w = 0; w < GB_MEM_PPU_DIRTY_WORDS; ++w)
+		changed |= written[w];
+	if (changed)
+		++SELF.ppu_generation;
+	SELF.ppu_lines_changed = 0;
+	SELF.ppu_lcdc = SELF.map[IO_LCDC];
+	dst->generation = SELF.ppu_generation;
+} // end end_ppu_generation()
+
+//=======================================================================
+// doc dma_to_oam()
+// Copies OAM from `src`, or fills it with $FF if `src` is NULL
+// (unbacked), flagging only the granules whose contents change, as
+// games commonly copy the same objects every frame.
+//=======================================================================
+// def dma_to_oam()
+static void
+dma_to_oam(struct gb_core* restrict core, const uint8_t* restrict src) {
+	enum { GRANULE_SIZE = 1 << GB_MEM_PPU_GRANULE_BITS };
+	uint8_t unbacked[GRANULE_SIZE];
+	if (src == NULL)
+		memset(unbacked, 0xFF, sizeof(unbacked));
+	uint8_t* dst = SELF.map + MEM_B_OAM;
+	for (uint16_t g = GB_MEM_PPU_VRAM_GRANULES; g < GB_MEM_PPU_GRANULES; ++g) {
+		const uint8_t* granule = (src != NULL) ? src : unbacked;
+		if (memcmp(dst, granule, GRANULE_SIZE)) {
+			memcpy(dst, granule, GRANULE_SIZE);
+			mark_ppu_granule(core, g);
+		}
+		dst += GRANULE_SIZE;
+		if (src != NULL)
+			src += GRANULE_SIZE;
+	}
+} // end dma_to_oam()
+
+//=======================================================================
+// doc write_palette()
+// Writes DMG palette register `addr`, bumping the palette generation
+// if its value changes.
+//=======================================================================
+// def write_palette()
+static void
+write_palette(struct gb_core* restrict core, uint16_t addr, uint8_t value) {
+	if (SELF.map[addr] == value)
+		return;
+	SELF.map[addr] = value;
+	struct gb_ppu_palettes* palettes = &(SELF.ppu_palettes);
+	palettes->bgp = SELF.map[IO_BGP];
+	palettes->obp0 = SELF.map[IO_OBP0];
+	palettes->obp1 = SELF.map[IO_OBP1];
+	if (++(palettes->generation) == 0)
+		palettes->generation = 1;
+} // end write_palette()
+
+//=======================================================================
+// doc copy_ppu_granules()
+// Copies each granule of VRAM and OAM flagged in `dirty` to `dst`.
+//=======================================================================
+// def copy_ppu_granules()
+static void
+copy_ppu_granules(
+		const struct gb_core* restrict core,
+		struct gb_ppu_state* restrict dst,
+		const uint64_t dirty[GB_MEM_PPU_DIRTY_WORDS]) {
+	enum { GRANULE_SIZE = 1 << GB_MEM_PPU_GRANULE_BITS };
+	for (int w = 0; w < GB_MEM_PPU_DIRTY_WORDS; ++w) {
+		for (uint64_t bits = dirty[w]; bits; bits &= bits - 1) {
+			uint16_t g = (uint16_t)(w * 64 + __builtin_ctzll(bits));
+			if (g < GB_MEM_PPU_VRAM_GRANULES) {
+				size_t offset = (size_t)g * GRANULE_SIZE;
+				memcpy(dst->vram + offset, SELF.map + MEM_B_VRAM + offset, GRANULE_SIZE);
+			} else {
+				size_t offset = (size_t)(g - GB_MEM_PPU_VRAM_GRANULES) * GRANULE_SIZE;
+				memcpy(dst->oam + offset, SELF.map + MEM_B_OAM + offset, GRANULE_SIZE);
+			}
+		}
+	}
+} // end copy_ppu_granules()
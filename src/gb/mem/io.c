@@ -1,5 +1,7 @@
+#include <assert.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <string.h>
 #include "gb/core/typedef.h"
 #include "gb/cpu.h"
 #include "gb/log.h"
@@ -103,6 +105,7 @@ gb_mem_io_advance_ppu(struct gb_core* restrict core) {
 			lycompare(core);
 
 			if (core->mem.map[IO_LY] == 144) { // begin vertical blank
+				core->mem.ppu_frames += 1;
 				core->mem.map[IO_STAT] += 1; // Mode 0->1
 				core->mem.stat_int |= (stat & IO_STAT_INT_MODE1); // Check mode 1 stat interrupt
 				gb_mem_io_request_interrupt(core, IO_IFE_VBLANK);
@@ -124,6 +127,7 @@ gb_mem_io_advance_ppu(struct gb_core* restrict core) {
 			break;
 		case 2: // OAM scan
 			// Begin pixel-drawing
+			gb_mem_io_capture_line(core, core->mem.map[IO_LY]);
 			core->mem.stat_int &= ~IO_STAT_INT_MODE2;
 			core->mem.map[IO_STAT] += 1; // Mode 2->3
 			break;
@@ -159,6 +163,89 @@ gb_mem_io_increment_tima(struct gb_core* restrict core) {
 	}
 } // end gb_mem_io_increment_tima()
 
+//=======================================================================
+// doc gb_mem_io_skip_div()
+// Equivalent to `increments` calls to gb_mem_io_increment_div().
+//=======================================================================
+// def gb_mem_io_skip_div()
+void
+gb_mem_io_skip_div(struct gb_core* restrict core, uint64_t increments) {
+	core->mem.map[IO_DIV] += (uint8_t)increments;
+} // end gb_mem_io_skip_div()
+
+//=======================================================================
+// doc gb_mem_io_skip_tima()
+// Equivalent to `increments` calls to gb_mem_io_increment_tima().
+// If TIMA overflows at least once, a single timer interrupt is
+// requested, as IF cannot record more than one.
+//=======================================================================
+// def gb_mem_io_skip_tima()
+void
+gb_mem_io_skip_tima(struct gb_core* restrict core, uint64_t increments) {
+	uint16_t until_overflow = 0x100 - core->mem.map[IO_TIMA];
+	if (increments < until_overflow) {
+		core->mem.map[IO_TIMA] += (uint8_t)increments;
+		return;
+	}
+	// After the first overflow, TIMA counts from TMA and overflows
+	// every (0x100 - TMA) increments.
+	increments -= until_overflow;
+	uint8_t tma = core->mem.map[IO_TMA];
+	core->mem.map[IO_TIMA] = tma + (uint8_t)(increments % (0x100 - tma));
+	gb_mem_io_request_interrupt(core, IO_IFE_TIMER);
+} // end gb_mem_io_skip_tima()
+
+//=======================================================================
+// doc gb_mem_io_skip_lines()
+// Advances LY by `lines` without passing through the intermediate
+// PPU modes. The PPU must be in mode 0 or 1, and must remain in the
+// same mode for every skipped line (i.e. LY must not cross 144 or wrap
+// back to 0).
+// Only valid while no STAT interrupt sources are selected, as no STAT
+// interrupt line changes are emulated.
+// Skipped visible lines are captured with the current registers, which
+// cannot change while lines are being skipped.
+//=======================================================================
+// def gb_mem_io_skip_lines()
+void
+gb_mem_io_skip_lines(struct gb_core* restrict core, uint8_t lines) {
+	assert(!(core->mem.map[IO_STAT] & IO_STAT_WRITABLE));
+	assert((core->mem.map[IO_STAT] & IO_STAT_MODE) <= 1);
+	if ((core->mem.map[IO_STAT] & IO_STAT_MODE) == 0) {
+		for (uint8_t i = 1; i <= lines; ++i)
+			gb_mem_io_capture_line(core, core->mem.map[IO_LY] + i);
+	}
+	core->mem.map[IO_LY] += lines;
+	lycompare(core);
+} // end gb_mem_io_skip_lines()
+
+//=======================================================================
+// doc gb_mem_io_capture_line()
+// Records the registers which line `line` is drawn with, noting whether
+// they changed (see struct gb_mem). Lines outside of the screen are
+// ignored.
+//=======================================================================
+// def gb_mem_io_capture_line()
+void
+gb_mem_io_capture_line(struct gb_core* restrict core, uint8_t line) {
+	if (line >= PPU_SCR_HEIGHT)
+		return;
+	const uint8_t* map = core->mem.map;
+	struct gb_ppu_line regs;
+	memset(&regs, 0, sizeof(regs)); // Zero any padding, for memcmp().
+	regs.palettes = core->mem.ppu_palettes;
+	regs.lcdc = map[IO_LCDC];
+	regs.scy = map[IO_SCY];
+	regs.scx = map[IO_SCX];
+	regs.wy = map[IO_WY];
+	regs.wx = map[IO_WX];
+	struct gb_ppu_line* dst = &(core->mem.ppu_lines[line]);
+	if (memcmp(dst, &regs, sizeof(regs))) {
+		memcpy(dst, &regs, sizeof(regs));
+		core->mem.ppu_lines_changed = 1;
+	}
+} // end gb_mem_io_capture_line()
+
 //=======================================================================
 // def gb_mem_io_update_joyp()
 void
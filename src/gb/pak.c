@@ -8,8 +8,13 @@
 #include <string.h>
 #define GB_LOG_MAX_LEVEL LVL_TRC
 #include "gb/log.h"
+#include "gb/mem/typedef.h"
 #include "gb/pak.h"
+#include "gb/pak/const.h"
 #include "gb/pak/header.h"
+#include "gb/pak/mbc.h"
+#include "gb/pak/mbc/common.h"
+#include "gb/pak/sav.h"
 #include "gb/pak/typedef.h"
 #define PRX_TRUNCATE_PREFIX 1
 #include "prx/io.h"
@@ -50,13 +55,21 @@
 //      Measure the save file's true size (according to the file system).
 //      If this does not match the size reported by ROM, emit a warning.
 //      Proceed to use whichever size is bigger.
-// 4. Allocate bytes for a gb_pak object + ROM array + RAM array.
+// 4. Map the ROM file read-only. If it cannot be mapped (e.g. it is not
+//    a regular file, or is shorter than its header reports), it is
+//    instead loaded into a ROM array, as described below.
+//    If RAM is battery-backed, likewise map the save file read-write and
+//    shared, creating it if necessary (see gb/pak/sav.h).
+//    Allocate bytes for a gb_pak object + ROM array (unless mapped) +
+//    RAM array (unless mapped).
 //    While running, ROM and RAM will be contained entirely in memory.
 //   a. If RAM is battery-backed but no file exists, use RAM size reported
 //      by ROM. If RAM is battery-backed and a save file exists, use whichever
 //      is larger between file size and RAM size reported by ROM header.
-// 5. Load ROM file into memory, then close ROM file.
-// 6. If save file exists, load it into memory, then close save file.
+// 5. Load ROM file into memory unless mapped, then close ROM file.
+//    A mapping outlives its file handle.
+// 6. If save file exists and could not be mapped, load it into memory,
+//    then close save file.
 // 7. Perform further initialization of gb_pak object based on ROM header
 //    data as necessary.
 //
@@ -107,7 +120,9 @@ fpcreate_pak(
 static struct gb_pak*
 alloc_pak(
 		const struct pakhdr_alloc_info* restrict ainfo,
-		const char* save_filepath);
+		const char* save_filepath,
+		void* rom_map,
+		struct paksav* sav);
 //-------------------------------------
 static int
 init_pak(
@@ -153,23 +168,36 @@ gb_pak_delete(struct gb_pak* restrict pak) {
 	if (pak == NULL)
 		return;
 
-	if (pak->battery)
-		LOGW("Saving on pak object deletion not-yet-implemented.");
+	if (pak->sav != NULL)
+		paksav_close(pak->sav); // Flushes any unsaved writes.
+	else if (pak->battery && pak->ram_bank_count != 0)
+		LOGW("SAV: RAM could not be mapped to its save file, and won't be saved.");
+	if (pak->rom_mapped)
+		io_funmap(pak->rom, (size_t)pak->rom_bank_count * PAK_ROM_BANK_SIZE);
 	free(pak);
 } // end gb_pak_delete()
 
 //=======================================================================
 // def gb_pak_insert()
-void
-gb_pak_insert(
-		struct gb_pak* restrict pak,
-		uint8_t* restrict rom_map,
-		uint8_t* restrict ram_map) {
+int
+gb_pak_insert(struct gb_pak* restrict pak, struct gb_mem* restrict mem) {
 	assert(pak != NULL);
-	assert(rom_map != NULL);
-	assert(ram_map != NULL);
-
+	assert(mem != NULL);
+	if (pak->mbc_id >= PAKMBC_COUNT || mbc_write8[pak->mbc_id].rom == NULL) {
+		LOGF("Pak uses an unsupported MBC (mbc_id=%u).", pak->mbc_id);
+		return 1;
+	}
 
+	pak->rom_bank_curr = 1;
+	pak->ram_bank_curr = 0;
+	pak->mbc1_bank2 = 0;
+	pak->mbc1_mode = 0;
+	// Paks without an MBC have no means of disabling their RAM.
+	pak->ram_enabled = (pak->mbc_id == PAKMBC_NONE);
+	mbc_map_rom(mem, pak, 0, pak->rom_bank_curr);
+	mbc_map_ram(mem, pak);
+	mem->pak = pak;
+	return 0;
 } // end gb_pak_insert()
 
 //=======================================================================
@@ -266,9 +294,15 @@ fpcreate_pak(
 	struct pakhdr_alloc_info ainfo;
 	if (pakhdr_get_alloc_info(&ainfo, rom_file))
 		goto fail_close_rom_file;
-	struct gb_pak* pak = alloc_pak(&ainfo, ram_fp);
+	// Mapping spares copying the whole image up front, and lets all
+	// processes running the same ROM share its pages.
+	void* rom_map = io_fmap(ainfo.rom_size, rom_file);
+	struct paksav* sav = NULL;
+	if (ainfo.battery && ainfo.ram_size != 0)
+		sav = paksav_open(ram_fp, ainfo.ram_size);
+	struct gb_pak* pak = alloc_pak(&ainfo, ram_fp, rom_map, sav);
 	if (pak == NULL)
-		goto fail_close_rom_file;
+		goto fail_close_sav;
 	if (init_pak(pak, &ainfo, rom_file, ram_fp))
 		goto fail_free_pak;
 
@@ -276,6 +310,9 @@ fpcreate_pak(
 	return pak; // success
 fail_free_pak:
 	free(pak);
+fail_close_sav:
+	paksav_close(sav);
+	io_funmap(rom_map, ainfo.rom_size);
 fail_close_rom_file:
 	fclose(rom_file);
 	return NULL;
@@ -286,14 +323,16 @@ fail_close_rom_file:
 static struct gb_pak*
 alloc_pak(
 		const struct pakhdr_alloc_info* restrict ainfo,
-		const char* save_filepath) {
+		const char* save_filepath,
+		void* rom_map,
+		struct paksav* sav) {
 	assert(ainfo != NULL);
 
 	// Total allocation size is the sum of:
 	// 1. The members of `struct gb_pak`
 	// 2. A copy of the save filepath, including terminating NUL
-	// 3. A copy of the pak's ROM image
-	// 4. A copy of the pak's RAM region
+	// 3. A copy of the pak's ROM image, unless it is mapped (`rom_map`)
+	// 4. A copy of the pak's RAM region, unless it is mapped (`sav`)
 	//
 	// Each item is placed after the prior item, meaning that all
 	// pak memory is stored in one contiguous memory region.
@@ -308,11 +347,12 @@ alloc_pak(
 	alloc_size = pad_size_for_alignment(alloc_size);
 	// 2. Save offset and reserve space
 	size_t rom_offset = alloc_size;
-	alloc_size += ainfo->rom_size;
+	if (rom_map == NULL)
+		alloc_size += ainfo->rom_size;
 	//--- Allocate buffer for RAM ---
 	// Same as above
-	size_t ram_offset;
-	if (ainfo->ram_size != 0) {
+	size_t ram_offset = 0;
+	if (ainfo->ram_size != 0 && sav == NULL) {
 		alloc_size = pad_size_for_alignment(alloc_size);
 		ram_offset = alloc_size;
 		alloc_size += ainfo->ram_size;
@@ -326,8 +366,13 @@ alloc_pak(
 
 	// Initialize internal pointers:
 	pak->save_filepath = (ainfo->battery ? (char*)pak + sizeof(struct gb_pak) : NULL);
-	pak->rom = (char*)pak + rom_offset;
-	pak->ram = (ainfo->ram_size != 0 ? (char*)pak + ram_offset : NULL);
+	pak->rom = (rom_map != NULL ? rom_map : (char*)pak + rom_offset);
+	pak->rom_mapped = (rom_map != NULL);
+	if (sav != NULL)
+		pak->ram = sav->map;
+	else
+		pak->ram = (ainfo->ram_size != 0 ? (char*)pak + ram_offset : NULL);
+	pak->sav = sav;
 
 	return pak; // success
 } // end alloc_pak()
@@ -346,21 +391,26 @@ init_pak(
 
 	//--------------------------------------
 	//--- Copy ROM from file into memory ---
-	size_t filesize = io_fload(pak->rom, ainfo->rom_size, rom_file);
-	if (filesize == (size_t)-1) {
-		LOGF("Failed to copy ROM from file into memory.");
-		return 1; // Failed to copy ROM.
-	}
-	LOGI("ROM: expected filesize=%zu, actual filesize=%zu", ainfo->rom_size, filesize);
-	if (filesize != ainfo->rom_size) {
-		LOGW("ROM filesize=%zu does not match expected size=%zu!", filesize, ainfo->rom_size);
-		if (filesize > ainfo->rom_size)
-			LOGW("ROM data beyond reported size won't be loaded.");
-		else {
-			LOGW("ROM bytes beyond actual filesize will be padded with 0xFF.");
-			memset(pak->rom + filesize, 0xFF, ainfo->rom_size - filesize);
+	size_t filesize;
+	if (pak->rom_mapped) {
+		LOGI("ROM: mapped %zu bytes from file.", ainfo->rom_size);
+	} else {
+		filesize = io_fload(pak->rom, ainfo->rom_size, rom_file);
+		if (filesize == (size_t)-1) {
+			LOGF("Failed to copy ROM from file into memory.");
+			return 1; // Failed to copy ROM.
 		}
-	}
+		LOGI("ROM: expected filesize=%zu, actual filesize=%zu", ainfo->rom_size, filesize);
+		if (filesize != ainfo->rom_size) {
+			LOGW("ROM filesize=%zu does not match expected size=%zu!", filesize, ainfo->rom_size);
+			if (filesize > ainfo->rom_size)
+				LOGW("ROM data beyond reported size won't be loaded.");
+			else {
+				LOGW("ROM bytes beyond actual filesize will be padded with 0xFF.");
+				memset(pak->rom + filesize, 0xFF, ainfo->rom_size - filesize);
+			}
+		}
+	} // end ifelse (ROM is mapped)
 
 	//----------------------------------------------------
 	//--- Copy RAM from file into memory, if it exists ---
@@ -368,23 +418,27 @@ init_pak(
 		assert(save_filepath != NULL);
 		assert(pak->save_filepath != NULL);
 		LOGI("Pak supports battery-backed saves. Attempting to load save file...");
-		// Might be good to check for existence of save file.
-		// Save file not existing is normal for first runs of a game,
-		// and thus is not a fatal error, but there are many other
-		// fatal errors that could occur unrelated to file existence.
-		filesize = io_fpload(pak->ram, ainfo->ram_size, save_filepath);
-		if (filesize == (size_t)-1) {
-			LOGI("SAV: No existing savefile identified by '%s'", save_filepath);
+		if (pak->sav != NULL) {
+			LOGI("SAV: Mapped %zu bytes from '%s'", ainfo->ram_size, save_filepath);
 		} else {
-			LOGI("SAV: Expected filesize=%zu, actual filesize=%zu", ainfo->ram_size, filesize);
-			if (filesize != ainfo->ram_size) {
-				LOGW("SAV: Filesize=%zu does not match expected size=%zu!", filesize, ainfo->ram_size);
-				if (filesize > ainfo->rom_size)
-					LOGW("SAV: Data beyond reported size won't be loaded.");
-				else
-					LOGW("SAV: Region bytes beyond actual filesize won't be initialized.");
-			} // end if (filesize != ainfo->ram_size)
-		} // end ifelse (unable to load file)
+			// Might be good to check for existence of save file.
+			// Save file not existing is normal for first runs of a game,
+			// and thus is not a fatal error, but there are many other
+			// fatal errors that could occur unrelated to file existence.
+			filesize = io_fpload(pak->ram, ainfo->ram_size, save_filepath);
+			if (filesize == (size_t)-1) {
+				LOGI("SAV: No existing savefile identified by '%s'", save_filepath);
+			} else {
+				LOGI("SAV: Expected filesize=%zu, actual filesize=%zu", ainfo->ram_size, filesize);
+				if (filesize != ainfo->ram_size) {
+					LOGW("SAV: Filesize=%zu does not match expected size=%zu!", filesize, ainfo->ram_size);
+					if (filesize > ainfo->rom_size)
+						LOGW("SAV: Data beyond reported size won't be loaded.");
+					else
+						LOGW("SAV: Region bytes beyond actual filesize won't be initialized.");
+				} // end if (filesize != ainfo->ram_size)
+			} // end ifelse (unable to load file)
+		} // end ifelse (RAM is mapped)
 
 		// Copy save_filepath into the pak, for later saves.
 		strcpy(pak->save_filepath, save_filepath);
@@ -402,6 +456,7 @@ init_pak(
 	// Pak state fields:
 	pak->rom_bank_curr = pak->ram_bank_curr = 0;
 	pak->dirty_ram = 0;
+	pak->ram_enabled = 0;
 
 	return 0; // success
 } // end init_pak()
@@ -1,7 +1,13 @@
 #include "gb/pak/mbc.h"
+#include "gb/pak/mbc/mbc1.h"
+#include "gb/pak/mbc/mbc3.h"
+#include "gb/pak/mbc/mbc5.h"
 #include "gb/pak/mbc/none.h"
 
-const struct mbc_write8_pair mbc_write8[] = {
-	{ .rom=mbc_write8_rom_none, .ram=mbc_write8_ram_none }, // NONE
+// Unsupported MBCs are left NULL.
+const struct mbc_write8_pair mbc_write8[PAKMBC_COUNT] = {
+	[PAKMBC_NONE] = { .rom=mbc_write8_rom_none, .ram=mbc_write8_ram_none },
+	[PAKMBC_MBC1] = { .rom=mbc_write8_rom_mbc1, .ram=mbc_write8_ram_mbc1 },
+	[PAKMBC_MBC3] = { .rom=mbc_write8_rom_mbc3, .ram=mbc_write8_ram_mbc3 },
+	[PAKMBC_MBC5] = { .rom=mbc_write8_rom_mbc5, .ram=mbc_write8_ram_mbc5 },
 }; // end mbc_write8[]
-
@@ -1,9 +1,12 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "gb/mem/region.h"
 #include "gb/mem/typedef.h"
 #include "gb/pak.h"
 #include "gb/pak/const.h"
 #include "gb/pak/mbc/common.h"
+#include "gb/pak/sav.h"
 #include "gb/pak/typedef.h"
 
 //=======================================================================
@@ -17,14 +20,50 @@ mbc_sram_write(
 	assert(pak != NULL);
 	assert(addr >= MEM_B_SRAM && addr < MEM_E_SRAM);
 
-	if (pak->ram_bank_count > 0) {
+	if (pak->ram_enabled && pak->ram_bank_curr < pak->ram_bank_count) {
 		assert(pak->ram != NULL);
-		// Write to memory map's external RAM region:
-		mem->map[addr] = val;
-		// Write to pak's backing SRAM array:
-		addr -= MEM_B_SRAM;
-		((uint8_t*)pak->ram)[pak->ram_bank_curr * PAK_RAM_BANK_SIZE + addr] = val;
+		// The SRAM pages of `mem` read straight from this array.
+		size_t offset = pak->ram_bank_curr * PAK_RAM_BANK_SIZE + (addr - MEM_B_SRAM);
+		((uint8_t*)pak->ram)[offset] = val;
 		pak->dirty_ram = 1;
-	} // end if (pak->ram_bank_count > 0)
+		if (pak->sav != NULL)
+			paksav_mark(pak->sav, offset);
+	} // end if (RAM is enabled and exists)
 } // end mbc_sram_write()
 
+//=======================================================================
+// def mbc_map_rom()
+void
+mbc_map_rom(
+		struct gb_mem* restrict mem,
+		const struct gb_pak* restrict pak,
+		uint16_t bank0, uint16_t bank) {
+	assert(mem != NULL);
+	assert(pak != NULL);
+	// Bank counts are always powers of two.
+	uint16_t mask = pak->rom_bank_count - 1;
+	const uint8_t* rom0 = (const uint8_t*)pak->rom
+		+ (size_t)(bank0 & mask) * PAK_ROM_BANK_SIZE;
+	const uint8_t* rom = (const uint8_t*)pak->rom
+		+ (size_t)(bank & mask) * PAK_ROM_BANK_SIZE;
+	for (uint16_t page = 0; page < (MEM_SZ_ROM1 >> 8); ++page) {
+		mem->rpage[(MEM_B_ROM1 >> 8) + page] = rom0 + (page << 8);
+		mem->rpage[(MEM_B_ROM2 >> 8) + page] = rom + (page << 8);
+	}
+} // end mbc_map_rom()
+
+//=======================================================================
+// def mbc_map_ram()
+void
+mbc_map_ram(
+		struct gb_mem* restrict mem,
+		const struct gb_pak* restrict pak) {
+	assert(mem != NULL);
+	assert(pak != NULL);
+	const uint8_t* ram = NULL;
+	if (pak->ram_enabled && pak->ram_bank_curr < pak->ram_bank_count)
+		ram = (const uint8_t*)pak->ram + pak->ram_bank_curr * PAK_RAM_BANK_SIZE;
+	// Writes always go through the MBC, which tracks dirty RAM.
+	for (uint16_t page = 0; page < (MEM_SZ_SRAM >> 8); ++page)
+		mem->rpage[(MEM_B_SRAM >> 8) + page] = ram ? ram + (page << 8) : NULL;
+} // end mbc_map_ram()
@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/mem.h"
+#include "gb/pak.h"
+#include "gb/pak/mbc/common.h"
+#include "gb/pak/mbc/mbc1.h"
+#include "gb/pak/typedef.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static void
+remap(struct gb_mem* restrict mem, struct gb_pak* restrict pak);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def mbc_write8_rom_mbc1()
+void
+mbc_write8_rom_mbc1(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	assert(pak != NULL);
+	switch (addr >> 13) { // One register per 8 KiB
+		case 0: // 0x0000-0x1FFF: RAM enable
+			pak->ram_enabled = ((val & 0x0F) == 0x0A);
+			break;
+		case 1: // 0x2000-0x3FFF: ROM bank (lower 5 bits)
+			// Selecting bank 0 selects bank 1 instead, so banks $20,
+			// $40 and $60 are unreachable.
+			val &= 0x1F;
+			pak->rom_bank_curr = (pak->rom_bank_curr & ~0x1F) | (val ? val : 1);
+			break;
+		case 2: // 0x4000-0x5FFF: RAM bank, or ROM bank (upper 2 bits)
+			pak->mbc1_bank2 = val & 0x03;
+			pak->rom_bank_curr = (pak->rom_bank_curr & 0x1F) | (pak->mbc1_bank2 << 5);
+			break;
+		case 3: // 0x6000-0x7FFF: Banking mode select
+			pak->mbc1_mode = val & 0x01;
+			break;
+	} // end switch
+	remap(mem, pak);
+} // end mbc_write8_rom_mbc1()
+
+//=======================================================================
+// def mbc_write8_ram_mbc1()
+void
+mbc_write8_ram_mbc1(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	mbc_sram_write(mem, pak, addr, val);
+} // end mbc_write8_ram_mbc1()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc remap()
+// In mode 0, the secondary bank register only affects 0x4000-0x7FFF.
+// In mode 1, it also selects the bank at 0x0000-0x3FFF (large ROMs)
+// and the RAM bank (large RAMs).
+//=======================================================================
+// def remap()
+static void
+remap(struct gb_mem* restrict mem, struct gb_pak* restrict pak) {
+	uint8_t bank2 = pak->mbc1_mode ? pak->mbc1_bank2 : 0;
+	mbc_map_rom(mem, pak, bank2 << 5, pak->rom_bank_curr);
+	if (pak->ram_bank_count > 0)
+		pak->ram_bank_curr = bank2 & (pak->ram_bank_count - 1);
+	mbc_map_ram(mem, pak);
+} // end remap()
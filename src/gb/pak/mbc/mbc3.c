@@ -0,0 +1,55 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/mem.h"
+#include "gb/pak.h"
+#include "gb/pak/mbc/common.h"
+#include "gb/pak/mbc/mbc3.h"
+#include "gb/pak/typedef.h"
+
+//=======================================================================
+// doc mbc_write8_rom_mbc3()
+// TODO: Emulate the real-time clock. Its registers are currently
+//       unmapped (read as $FF), and latching it does nothing.
+//=======================================================================
+// def mbc_write8_rom_mbc3()
+void
+mbc_write8_rom_mbc3(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	assert(pak != NULL);
+	switch (addr >> 13) { // One register per 8 KiB
+		case 0: // 0x0000-0x1FFF: RAM and RTC enable
+			pak->ram_enabled = ((val & 0x0F) == 0x0A);
+			mbc_map_ram(mem, pak);
+			return;
+		case 1: // 0x2000-0x3FFF: ROM bank (7 bits, 0 selects 1)
+			val &= 0x7F;
+			pak->rom_bank_curr = val ? val : 1;
+			mbc_map_rom(mem, pak, 0, pak->rom_bank_curr);
+			return;
+		case 2: // 0x4000-0x5FFF: RAM bank ($00-$07) or RTC register ($08-$0C)
+			if (val > 0x0C)
+				return;
+			// RTC registers are never below `ram_bank_count`, so they
+			// are left unmapped.
+			pak->ram_bank_curr = val;
+			mbc_map_ram(mem, pak);
+			return;
+		case 3: // 0x6000-0x7FFF: Latch clock data
+			return;
+	} // end switch
+} // end mbc_write8_rom_mbc3()
+
+//=======================================================================
+// def mbc_write8_ram_mbc3()
+void
+mbc_write8_ram_mbc3(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	assert(pak != NULL);
+	if (pak->ram_bank_curr <= 0x07)
+		mbc_sram_write(mem, pak, addr, val);
+} // end mbc_write8_ram_mbc3()
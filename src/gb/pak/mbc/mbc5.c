@@ -0,0 +1,49 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/mem.h"
+#include "gb/pak.h"
+#include "gb/pak/mbc/common.h"
+#include "gb/pak/mbc/mbc5.h"
+#include "gb/pak/typedef.h"
+
+//=======================================================================
+// def mbc_write8_rom_mbc5()
+void
+mbc_write8_rom_mbc5(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	assert(pak != NULL);
+	switch (addr >> 12) { // One register per 4 KiB (some repeated)
+		case 0x0: case 0x1: // 0x0000-0x1FFF: RAM enable
+			pak->ram_enabled = (val == 0x0A);
+			mbc_map_ram(mem, pak);
+			return;
+		case 0x2: // 0x2000-0x2FFF: ROM bank (lower 8 bits)
+			pak->rom_bank_curr = (pak->rom_bank_curr & 0x100) | val;
+			mbc_map_rom(mem, pak, 0, pak->rom_bank_curr);
+			return;
+		case 0x3: // 0x3000-0x3FFF: ROM bank (9th bit)
+			pak->rom_bank_curr = (pak->rom_bank_curr & 0xFF) | ((val & 0x01) << 8);
+			mbc_map_rom(mem, pak, 0, pak->rom_bank_curr);
+			return;
+		case 0x4: case 0x5: // 0x4000-0x5FFF: RAM bank
+			// TODO: On rumble paks, bit 3 drives the motor instead.
+			pak->ram_bank_curr = val & 0x0F;
+			mbc_map_ram(mem, pak);
+			return;
+		default: // 0x6000-0x7FFF: Unused
+			return;
+	} // end switch
+} // end mbc_write8_rom_mbc5()
+
+//=======================================================================
+// def mbc_write8_ram_mbc5()
+void
+mbc_write8_ram_mbc5(
+		struct gb_mem* restrict mem,
+		struct gb_pak* restrict pak,
+		uint16_t addr, uint8_t val) {
+	mbc_sram_write(mem, pak, addr, val);
+} // end mbc_write8_ram_mbc5()
@@ -0,0 +1,206 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/log.h"
+#include "gb/pak/sav.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static int
+flusher_main(void* arg);
+static void
+flush_pages(const struct paksav* restrict sav, uint_least32_t pages);
+static void
+add_timespec_msec(struct timespec* restrict dst, long msec);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def paksav_open()
+struct paksav*
+paksav_open(const char* restrict filepath, size_t size) {
+	assert(filepath != NULL);
+	assert(size != 0 && size <= PAKSAV_MAX_SIZE);
+
+	struct paksav* sav = malloc(sizeof(*sav));
+	if (sav == NULL) {
+		LOGE("Unable to allocate %zu bytes.", sizeof(*sav));
+		return NULL;
+	}
+	sav->fd = open(filepath, O_RDWR | O_CREAT, 0644);
+	if (sav->fd < 0) {
+		LOGW("SAV: Unable to open '%s' for writing.", filepath);
+		goto fail_free_sav;
+	}
+	struct stat st;
+	if (fstat(sav->fd, &st) || !S_ISREG(st.st_mode)) {
+		LOGW("SAV: '%s' is not a regular file.", filepath);
+		goto fail_close_fd;
+	}
+	LOGI("SAV: Expected filesize=%zu, actual filesize=%lld",
+			size, (long long)st.st_size);
+	if ((size_t)st.st_size < size) {
+		// Storing to mapped pages beyond end-of-file would fault.
+		if (st.st_size != 0)
+			LOGW("SAV: Region bytes beyond actual filesize will be zeroed.");
+		if (ftruncate(sav->fd, (off_t)size)) {
+			LOGW("SAV: Unable to extend '%s' to %zu bytes.", filepath, size);
+			goto fail_close_fd;
+		}
+	} else if ((size_t)st.st_size > size) {
+		LOGW("SAV: Data beyond reported size won't be loaded.");
+	}
+	void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sav->fd, 0);
+	if (map == MAP_FAILED) {
+		LOGW("SAV: Unable to map '%s'.", filepath);
+		goto fail_close_fd;
+	}
+	sav->map = map;
+	sav->size = size;
+	atomic_init(&sav->dirty, 0);
+	sav->stop = 0;
+	if (mtx_init(&sav->lock, mtx_plain) != thrd_success)
+		goto fail_unmap;
+	if (cnd_init(&sav->wake) != thrd_success)
+		goto fail_destroy_lock;
+	if (thrd_create(&sav->flusher, flusher_main, sav) != thrd_success) {
+		LOGW("SAV: Unable to start flusher thread.");
+		goto fail_destroy_wake;
+	}
+	return sav; // success
+
+fail_destroy_wake:
+	cnd_destroy(&sav->wake);
+fail_destroy_lock:
+	mtx_destroy(&sav->lock);
+fail_unmap:
+	munmap(sav->map, size);
+fail_close_fd:
+	close(sav->fd);
+fail_free_sav:
+	free(sav);
+	return NULL;
+} // end paksav_open()
+
+//=======================================================================
+// def paksav_close()
+void
+paksav_close(struct paksav* restrict sav) {
+	if (sav == NULL)
+		return;
+
+	mtx_lock(&sav->lock);
+	sav->stop = 1;
+	cnd_signal(&sav->wake);
+	mtx_unlock(&sav->lock);
+	thrd_join(sav->flusher, NULL);
+
+	cnd_destroy(&sav->wake);
+	mtx_destroy(&sav->lock);
+	munmap(sav->map, sav->size);
+	close(sav->fd);
+	free(sav);
+} // end paksav_close()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc flusher_main()
+// Collects dirty pages every PAKSAV_DEBOUNCE_MS, and flushes those
+// collected so far once a period passes without any new writes, or once
+// the oldest has waited PAKSAV_FLUSH_INTERVAL_MS. Flushes everything
+// left when stopped.
+//=======================================================================
+// def flusher_main()
+static int
+flusher_main(void* arg) {
+	struct paksav* sav = arg;
+	uint_least32_t pending = 0;
+	long pending_ms = 0;
+	uint8_t stop = 0;
+
+	while (!stop) {
+		struct timespec deadline;
+		timespec_get(&deadline, TIME_UTC);
+		add_timespec_msec(&deadline, PAKSAV_DEBOUNCE_MS);
+		mtx_lock(&sav->lock);
+		while (!sav->stop
+				&& cnd_timedwait(&sav->wake, &sav->lock, &deadline) == thrd_success)
+			; // Woken spuriously.
+		stop = sav->stop;
+		mtx_unlock(&sav->lock);
+
+		uint_least32_t fresh = atomic_exchange_explicit(&sav->dirty, 0,
+				memory_order_acquire);
+		if (!pending)
+			pending_ms = 0;
+		pending |= fresh;
+		if (!pending)
+			continue;
+		pending_ms += PAKSAV_DEBOUNCE_MS;
+		if (stop || !fresh || pending_ms >= PAKSAV_FLUSH_INTERVAL_MS) {
+			flush_pages(sav, pending);
+			pending = 0;
+		}
+	} // end while (!stop)
+	return 0;
+} // end flusher_main()
+
+//=======================================================================
+// doc flush_pages()
+// Synchronously writes each run of consecutive pages set in `pages`
+// back to the save file.
+//=======================================================================
+// def flush_pages()
+static void
+flush_pages(const struct paksav* restrict sav, uint_least32_t pages) {
+	// msync() requires addresses aligned to the host's page size, which
+	// may be larger than PAKSAV_PAGE_SIZE.
+	size_t host_page = (size_t)sysconf(_SC_PAGESIZE);
+	while (pages) {
+		unsigned first = (unsigned)__builtin_ctzl(pages);
+		unsigned end = first;
+		while (end < 32 && (pages >> end & 1))
+			++end;
+		pages &= ~(uint_least32_t)((((uint64_t)1 << (end - first)) - 1) << first);
+
+		size_t begin = (size_t)first * PAKSAV_PAGE_SIZE / host_page * host_page;
+		size_t limit = (size_t)end * PAKSAV_PAGE_SIZE;
+		if (limit > sav->size)
+			limit = sav->size;
+		if (msync(sav->map + begin, limit - begin, MS_SYNC))
+			LOGW("SAV: Failed to flush bytes [%zu, %zu).", begin, limit);
+	}
+} // end flush_pages()
+
+//=======================================================================
+// def add_timespec_msec()
+static void
+add_timespec_msec(struct timespec* restrict dst, long msec) {
+	dst->tv_sec += msec / 1000;
+	dst->tv_nsec += (msec % 1000) * 1000000;
+	if (dst->tv_nsec >= 1000000000) {
+		// Perform arithmetic carry:
+		dst->tv_sec += 1;
+		dst->tv_nsec -= 1000000000;
+	}
+} // end add_timespec_msec()
@@ -1,14 +1,18 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <SDL.h>
 #include "gb/core.h"
 #include "gb/log.h"
 #include "gb/mem/io.h"
 #include "gb/ppu.h"
+#include "gb/ppu/hashlog.h"
+#include "gb/ppu/kernel.h"
+#include "gb/ppu/pool.h"
 #include "gb/ppu/shared.h"
-#include "gb/video/sdl.h"
+#include "gb/prof.h"
+#include "gb/video.h"
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -90,37 +94,42 @@ struct tile_bounds {
 //=======================================================================
 // def gb_ppu_init()
 int
-gb_ppu_init(struct gb_ppu* restrict ppu) {
-	struct gb_video_sdl_params params = {
-		.window_title="Game Boy",
-		.window = { .width = PPU_SCR_WIDTH * 3, .height = PPU_SCR_HEIGHT * 3 },
-		.output = { .width = PPU_SCR_WIDTH, .height = PPU_SCR_HEIGHT }
-	};
-	if (gb_video_sdl_init(&(ppu->target), &params))
-		return 1;
+gb_ppu_init(struct gb_ppu* restrict ppu, struct gb_video* restrict target) {
+	assert(target != NULL);
+	ppu->target = target;
+	ppu->pool = NULL;
+	ppu->hashes = NULL;
+	gb_ppu_kernels_init();
 
-	void* mem = malloc(MEM_SZ_VRAM + MEM_SZ_OAM);
+	uint8_t* mem = malloc(MEM_SZ_VRAM + MEM_SZ_OAM);
 	if (mem == NULL)
-		goto destroy_video;
+		return 1;
+	ppu->state.tiles = malloc(PPU_TILE_COUNT * sizeof(*(ppu->state.tiles)));
+	if (ppu->state.tiles == NULL) {
+		free(mem);
+		return 1;
+	}
+	ppu->state.buffer = mem;
 	ppu->state.vram = mem;
 	ppu->state.oam = mem + MEM_SZ_VRAM;
+	ppu->state.synced = 0;
+	memset(ppu->state.tiles_dirty, 0xFF, sizeof(ppu->state.tiles_dirty));
+	ppu->state.tiles_synced = 0;
 	ppu->dmg_colors[0] = GREYSCALE_WHITE;
 	ppu->dmg_colors[1] = GREYSCALE_LGREY;
 	ppu->dmg_colors[2] = GREYSCALE_DGREY;
 	ppu->dmg_colors[3] = GREYSCALE_BLACK;
+	memset(ppu->line_palettes, 0, sizeof(ppu->line_palettes));
 	
 	return 0;
-destroy_video:
-	gb_video_sdl_destroy(&(ppu->target));
-	return 1;
 } // end gb_ppu_init()
 
 //=======================================================================
 // def gb_ppu_destroy()
 void
 gb_ppu_destroy(struct gb_ppu* restrict ppu) {
-	free(ppu->state.vram);
-	gb_video_sdl_destroy(&(ppu->target));
+	free(ppu->state.tiles);
+	free(ppu->state.buffer);
 } // end gb_ppu_destroy()
 
 //=======================================================================
@@ -129,25 +138,68 @@ uint8_t
 gb_dmg_draw(struct gb_ppu* restrict ppu) {
 	if (!(ppu->state.lcdc & IO_LCDC_PPU_ENABLED)) {
 		//fputs("PPU IS OFF!\n", stderr);
-		return gb_video_sdl_draw_clear(&(ppu->target));
+		if (ppu->hashes != NULL)
+			gb_ppu_hashlog_clear(ppu->hashes, ppu->state.frame);
+		GB_PROF_BEGIN(prof_clear);
+		uint8_t failed = gb_video_draw_clear(ppu->target);
+		GB_PROF_END(GB_PROF_PRESENT, prof_clear);
+		return failed;
 	}
 
-	uint32_t* pixels = gb_video_sdl_start_drawing(&(ppu->target), NULL);
+	uint32_t* pixels = gb_video_start_drawing(ppu->target);
 	if (pixels == NULL)
 		return 1;
+	gb_ppu_draw_frame(ppu, pixels);
+	if (ppu->hashes != NULL)
+		gb_ppu_hashlog_frame(ppu->hashes, ppu->state.frame, pixels);
+
+	GB_PROF_BEGIN(prof_present);
+	uint8_t failed = gb_video_finish_drawing(ppu->target);
+	GB_PROF_END(GB_PROF_PRESENT, prof_present);
+	return failed;
+} // end gb_dmg_draw()
+
+//=======================================================================
+// def gb_dmg_draw_changed()
+uint8_t
+gb_dmg_draw_changed(struct gb_ppu* restrict ppu, uint64_t* restrict shown) {
+	if (ppu->state.generation == *shown) {
+		GB_PROF_BEGIN(prof_repeat);
+		int repeated = gb_video_repeat_frame(ppu->target);
+		GB_PROF_END(GB_PROF_PRESENT, prof_repeat);
+		if (repeated != GB_VIDEO_REDRAW) {
+			if (ppu->hashes != NULL)
+				gb_ppu_hashlog_repeat(ppu->hashes, ppu->state.frame);
+			return repeated != 0;
+		}
+		// The target lost the frame; the same state draws it again.
+	}
+	*shown = ppu->state.generation;
+	return gb_dmg_draw(ppu);
+} // end gb_dmg_draw_changed()
 
-	static const uint8_t LINE_LIMIT = PPU_SCR_HEIGHT;
-	uint8_t i = 0;
-	for (; i < LINE_LIMIT; ++i) {
-		//LOGD("pixels = %p", pixels);
+//=======================================================================
+// def gb_ppu_draw_frame()
+void
+gb_ppu_draw_frame(struct gb_ppu* restrict ppu, uint32_t* restrict pixels) {
+	assert(pixels != NULL);
+	GB_PROF_BEGIN(prof_decode);
+	gb_ppu_decode_tiles(&(ppu->state));
+	gb_ppu_index_objs(&(ppu->state));
+	GB_PROF_END(GB_PROF_PPU_ENCODE, prof_decode);
+	GB_PROF_BEGIN(prof_palette);
+	gb_ppu_resolve_palettes(ppu);
+	GB_PROF_END(GB_PROF_PALETTE, prof_palette);
+
+	if (ppu->pool != NULL) {
+		gb_ppu_pool_draw(ppu->pool, pixels, ppu);
+		return;
+	}
+	for (uint8_t i = 0; i < PPU_SCR_HEIGHT; ++i) {
 		gb_ppu_draw_line(pixels, ppu, i);
 		pixels += PPU_SCR_WIDTH;
 	}
-
-	if (gb_video_sdl_finish_drawing(&(ppu->target)))
-		return 1;
-	return 0;
-} // end gb_dmg_draw()
+} // end gb_ppu_draw_frame()
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -1,73 +1,136 @@
 #include <assert.h>
-#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include "gb/mem/region.h"
-#include "gb/mode.h"
-#include "gb/ppu/state.h"
+#include <threads.h>
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/log.h"
+#include "gb/ppu.h"
+#include "gb/ppu/buf.h"
+#include "gb/video.h"
 
-enum {
-	PPU_MAX_BUFFERS = 32,
-};
-
-struct gb_ppu_buf {
-	uint8_t* statebuf;
-	uint8_t* vrambuf;
-	uint8_t* oambuf;
-	uint8_t* palettebuf;
-	uint32_t statebuf_usage;
-	uint32_t vrambuf_usage;
-	uint32_t oambuf_usage;
-	uint32_t palettebuf_usage;
-	uint8_t statebuf_curr;
-	uint8_t vrambuf_curr;
-	uint8_t oambuf_curr;
-	uint8_t palettebuf_curr;
-	uint8_t mode;
-}; // end struct gb_ppu_buf
-#define BUF_USAGE_BITCOUNT(buffer_name) \
-	((sizeof (((struct gb_ppu_buf*)0)->buffer_name##_usage)) * CHAR_BIT)
-static_assert(BUF_USAGE_BITCOUNT(statebuf) >= PPU_MAX_BUFFERS);
-static_assert(BUF_USAGE_BITCOUNT(vrambuf) >= PPU_MAX_BUFFERS);
-static_assert(BUF_USAGE_BITCOUNT(oambuf) >= PPU_MAX_BUFFERS);
-static_assert(BUF_USAGE_BITCOUNT(palettebuf) >= PPU_MAX_BUFFERS);
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
 
+//=======================================================================
+// def gb_ppu_buf_create()
 struct gb_ppu_buf*
-gb_ppu_buf_create(enum gb_mode mode) {
-	// Calculate cumulative size of buffers which represent PPU state.
-	size_t oam_bufsz = MEM_OAM_SZ * PPU_MAX_BUFFERS;
-	size_t state_bufsz, vram_bufsz, palette_bufsz;
-	if (mode != GBMODE_CGB) {
-		state_bufsz =
-			(sizeof(struct gb_ppu_state) + PPU_DMGPAL_SZ) * PPU_MAX_BUFFERS;
-		vram_bufsz = MEM_VRAM_SZ * PPU_MAX_BUFFERS;
-		palette_bufsz = 0; // DMG palettes stored in state object
-	} else {
-		state_bufsz = sizeof(struct gb_ppu_state) * PPU_MAX_BUFFERS;
-		vram_bufsz = MEM_VRAM_SZ * 2 * PPU_MAX_BUFFERS;
-		palette_bufsz = PPU_CGBPAL_SZ * PPU_MAX_BUFFERS;
+gb_ppu_buf_create(unsigned count, struct gb_video* restrict target) {
+	assert(target != NULL);
+	assert(count >= 2 && count <= PPU_MAX_BUFFERS);
+	struct gb_ppu_buf* buf = malloc(sizeof(*buf));
+	if (buf == NULL)
+		return NULL;
+	buf->slots = malloc(count * sizeof(*(buf->slots)));
+	if (buf->slots == NULL)
+		goto free_buf;
+	if (mtx_init(&(buf->lock), mtx_plain) != thrd_success)
+		goto free_slots;
+	if (cnd_init(&(buf->ready)) != thrd_success)
+		goto destroy_lock;
+	for (buf->count = 0; buf->count < count; ++(buf->count)) {
+		if (gb_ppu_init(&(buf->slots[buf->count]), target)) {
+			LOGE("Unable to initialize PPU buffer %u.", buf->count);
+			goto destroy_slots;
+		}
 	}
+	atomic_init(&(buf->published), 0);
+	atomic_init(&(buf->consumed), 0);
+	atomic_init(&(buf->dropped), 0);
+	atomic_init(&(buf->closed), 0);
+	return buf;
 
-	size_t bufsz = state_bufsz + vram_bufsz + oam_bufsz + palette_bufsz;
-	struct gb_ppu_buf* buf = malloc(sizeof(struct gb_ppu_buf) + bufsz);
-	if (buf == NULL)
+destroy_slots:
+	while (buf->count--)
+		gb_ppu_destroy(&(buf->slots[buf->count]));
+	cnd_destroy(&(buf->ready));
+destroy_lock:
+	mtx_destroy(&(buf->lock));
+free_slots:
+	free(buf->slots);
+free_buf:
+	free(buf);
+	return NULL;
+} // end gb_ppu_buf_create()
+
+//=======================================================================
+// def gb_ppu_buf_destroy()
+void
+gb_ppu_buf_destroy(struct gb_ppu_buf* restrict buf) {
+	for (unsigned i = 0; i < buf->count; ++i)
+		gb_ppu_destroy(&(buf->slots[i]));
+	cnd_destroy(&(buf->ready));
+	mtx_destroy(&(buf->lock));
+	free(buf->slots);
+	free(buf);
+} // end gb_ppu_buf_destroy()
+
+//=======================================================================
+// def gb_ppu_buf_acquire()
+struct gb_ppu*
+gb_ppu_buf_acquire(struct gb_ppu_buf* restrict buf) {
+	// Only this thread writes `published`.
+	uint_fast64_t published =
+		atomic_load_explicit(&(buf->published), memory_order_relaxed);
+	// Acquires the consumer's finished reads of released slots.
+	uint_fast64_t consumed =
+		atomic_load_explicit(&(buf->consumed), memory_order_acquire);
+	if (published - consumed >= buf->count) {
+		atomic_fetch_add_explicit(&(buf->dropped), 1, memory_order_relaxed);
 		return NULL;
+	}
+	return &(buf->slots[published % buf->count]);
+} // end gb_ppu_buf_acquire()
 
-	// Initialize buffer pointers.
-	void* offset = buf;
-	buf->statebuf = (offset += sizeof(struct gb_ppu_buf));
-	buf->vrambuf = (offset += state_bufsz);
-	buf->oambuf = (offset += vram_bufsz);
-	buf->palettebuf = (offset += oam_bufsz);
-	assert((offset + palette_bufsz) - (buf + sizeof(struct gb_ppu_buf)) == bufsz);
+//=======================================================================
+// def gb_ppu_buf_publish()
+void
+gb_ppu_buf_publish(struct gb_ppu_buf* restrict buf) {
+	atomic_fetch_add_explicit(&(buf->published), 1, memory_order_release);
+	// Signalled under the lock, so a consumer which has just found
+	// nothing published cannot miss it.
+	mtx_lock(&(buf->lock));
+	cnd_signal(&(buf->ready));
+	mtx_unlock(&(buf->lock));
+} // end gb_ppu_buf_publish()
 
-	// Clear all bits of buffer usage trackers.
-	buf->statebuf_usage = buf->vrambuf_usage =
-		buf->oambuf_usage = buf->palettebuf_usage = 0;
-	// Initialize current buffer to last buffer, so first usage wraps to first buffer.
-	buf->statebuf_curr = buf->vrambuf_curr =
-		buf->oambuf_curr = buf->palettebuf_curr = PPU_MAX_BUFFERS - 1;
-	buf->mode = mode;
+//=======================================================================
+// def gb_ppu_buf_close()
+void
+gb_ppu_buf_close(struct gb_ppu_buf* restrict buf) {
+	mtx_lock(&(buf->lock));
+	atomic_store(&(buf->closed), 1);
+	cnd_signal(&(buf->ready));
+	mtx_unlock(&(buf->lock));
+} // end gb_ppu_buf_close()
 
-	return buf;
-} // end gb_ppu_buf_create()
+//=======================================================================
+// def gb_ppu_buf_wait()
+struct gb_ppu*
+gb_ppu_buf_wait(struct gb_ppu_buf* restrict buf) {
+	// Only this thread writes `consumed`.
+	uint_fast64_t consumed =
+		atomic_load_explicit(&(buf->consumed), memory_order_relaxed);
+	uint_fast64_t published;
+	mtx_lock(&(buf->lock));
+	while ((published = atomic_load_explicit(&(buf->published),
+			memory_order_acquire)) == consumed && !atomic_load(&(buf->closed)))
+		cnd_wait(&(buf->ready), &(buf->lock));
+	mtx_unlock(&(buf->lock));
+	if (published == consumed)
+		return NULL; // Closed
+
+	// Skip to the newest frame, releasing older ones undrawn.
+	atomic_store_explicit(&(buf->consumed), published - 1, memory_order_release);
+	return &(buf->slots[(published - 1) % buf->count]);
+} // end gb_ppu_buf_wait()
 
+//=======================================================================
+// def gb_ppu_buf_release()
+void
+gb_ppu_buf_release(struct gb_ppu_buf* restrict buf) {
+	atomic_fetch_add_explicit(&(buf->consumed), 1, memory_order_release);
+} // end gb_ppu_buf_release()
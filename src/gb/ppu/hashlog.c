@@ -0,0 +1,186 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/hash.h"
+#include "gb/log.h"
+#include "gb/ppu/hashlog.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static void
+append(struct gb_ppu_hashlog* restrict log, const struct gb_ppu_hashlog_record* restrict record);
+static inline void
+put_u32(uint8_t* restrict dst, uint32_t value);
+static inline void
+put_u64(uint8_t* restrict dst, uint64_t value);
+static inline uint32_t
+get_u32(const uint8_t* restrict src);
+static inline uint64_t
+get_u64(const uint8_t* restrict src);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_ppu_hashlog_open()
+int
+gb_ppu_hashlog_open(struct gb_ppu_hashlog* restrict log, const char* restrict path) {
+	assert(log != NULL);
+	assert(path != NULL);
+	log->file = fopen(path, "wb");
+	if (log->file == NULL) {
+		LOGE("Unable to create hash log %s: %s.", path, strerror(errno));
+		return 1;
+	}
+	log->last = (struct gb_ppu_hashlog_record){0};
+	log->failed = 0;
+	uint8_t header[GB_PPU_HASHLOG_HEADER_SIZE];
+	memcpy(header, GB_PPU_HASHLOG_MAGIC, 4);
+	put_u32(header + 4, GB_PPU_HASHLOG_VERSION);
+	if (fwrite(header, sizeof(header), 1, log->file) != 1) {
+		LOGE("Unable to write hash log %s: %s.", path, strerror(errno));
+		fclose(log->file);
+		return 1;
+	}
+	return 0;
+} // end gb_ppu_hashlog_open()
+
+//=======================================================================
+// def gb_ppu_hashlog_close()
+int
+gb_ppu_hashlog_close(struct gb_ppu_hashlog* restrict log) {
+	if (fclose(log->file))
+		log->failed = 1;
+	if (log->failed)
+		LOGE("Hash log is incomplete.");
+	return log->failed;
+} // end gb_ppu_hashlog_close()
+
+//=======================================================================
+// def gb_ppu_hashlog_frame()
+void
+gb_ppu_hashlog_frame(
+		struct gb_ppu_hashlog* restrict log,
+		uint64_t frame,
+		const uint32_t* restrict pixels) {
+	struct gb_ppu_hashlog_record record = {
+		.frame = frame,
+		.pixels = gb_hash64(pixels,
+				PPU_SCR_WIDTH * PPU_SCR_HEIGHT * sizeof(*pixels), 0),
+		.encoded = gb_hash64(log->encoded, sizeof(log->encoded), 0)
+	};
+	append(log, &record);
+} // end gb_ppu_hashlog_frame()
+
+//=======================================================================
+// def gb_ppu_hashlog_clear()
+void
+gb_ppu_hashlog_clear(struct gb_ppu_hashlog* restrict log, uint64_t frame) {
+	struct gb_ppu_hashlog_record record = {.frame = frame};
+	append(log, &record);
+} // end gb_ppu_hashlog_clear()
+
+//=======================================================================
+// def gb_ppu_hashlog_repeat()
+void
+gb_ppu_hashlog_repeat(struct gb_ppu_hashlog* restrict log, uint64_t frame) {
+	struct gb_ppu_hashlog_record record = log->last;
+	record.frame = frame;
+	append(log, &record);
+} // end gb_ppu_hashlog_repeat()
+
+//=======================================================================
+// def gb_ppu_hashlog_read_header()
+int
+gb_ppu_hashlog_read_header(FILE* restrict file) {
+	uint8_t header[GB_PPU_HASHLOG_HEADER_SIZE];
+	if (fread(header, sizeof(header), 1, file) != 1)
+		return 1;
+	return memcmp(header, GB_PPU_HASHLOG_MAGIC, 4)
+		|| get_u32(header + 4) != GB_PPU_HASHLOG_VERSION;
+} // end gb_ppu_hashlog_read_header()
+
+//=======================================================================
+// def gb_ppu_hashlog_read()
+int
+gb_ppu_hashlog_read(FILE* restrict file, struct gb_ppu_hashlog_record* restrict dst) {
+	uint8_t buf[GB_PPU_HASHLOG_RECORD_SIZE];
+	size_t n = fread(buf, 1, sizeof(buf), file);
+	if (n == 0 && feof(file))
+		return 0;
+	if (n != sizeof(buf))
+		return -1;
+	dst->frame = get_u64(buf);
+	dst->pixels = get_u64(buf + 8);
+	dst->encoded = get_u64(buf + 16);
+	return 1;
+} // end gb_ppu_hashlog_read()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// doc append()
+// Writes `record`, through the file's buffer.
+//=======================================================================
+// def append()
+static void
+append(struct gb_ppu_hashlog* restrict log, const struct gb_ppu_hashlog_record* restrict record) {
+	log->last = *record;
+	uint8_t buf[GB_PPU_HASHLOG_RECORD_SIZE];
+	put_u64(buf, record->frame);
+	put_u64(buf + 8, record->pixels);
+	put_u64(buf + 16, record->encoded);
+	if (!log->failed && fwrite(buf, sizeof(buf), 1, log->file) != 1) {
+		LOGE("Unable to write hash log: %s.", strerror(errno));
+		log->failed = 1;
+	}
+} // end append()
+
+//=======================================================================
+// def put_u32()
+static inline void
+put_u32(uint8_t* restrict dst, uint32_t value) {
+	for (int i = 0; i < 4; ++i)
+		dst[i] = (uint8_t)(value >> (i * 8));
+} // end put_u32()
+
+//=======================================================================
+// def put_u64()
+static inline void
+put_u64(uint8_t* restrict dst, uint64_t value) {
+	for (int i = 0; i < 8; ++i)
+		dst[i] = (uint8_t)(value >> (i * 8));
+} // end put_u64()
+
+//=======================================================================
+// def get_u32()
+static inline uint32_t
+get_u32(const uint8_t* restrict src) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+		value |= (uint32_t)src[i] << (i * 8);
+	return value;
+} // end get_u32()
+
+//=======================================================================
+// def get_u64()
+static inline uint64_t
+get_u64(const uint8_t* restrict src) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i)
+		value |= (uint64_t)src[i] << (i * 8);
+	return value;
+} // end get_u64()
@@ -0,0 +1,296 @@
+#include <assert.h>
+#include <stdint.h>
+#include <threads.h>
+#include "gb/log.h"
+#include "gb/ppu/kernel.h"
+#include "gb/ppu/shared.h"
+#include "gb/ppu/state.h"
+#ifdef GB_PPU_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#define GB_LOG_MAX_LEVEL LVL_INF
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static void
+select_kernels(void);
+static inline uint8_t
+dmg_color_index(uint8_t enc);
+#ifdef GB_PPU_KERNELS_X86
+static inline void
+transpose_dmg_colors(
+		__m128i planes[4],
+		const uint32_t colors[GB_PPU_DMG_COLORS]);
+#endif
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL VARIABLE DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+gb_ppu_decode_tile_fn* gb_ppu_decode_tile = gb_ppu_decode_tile_scalar;
+gb_ppu_resolve_dmg_fn* gb_ppu_resolve_dmg = gb_ppu_resolve_dmg_scalar;
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_ppu_kernels_init()
+void
+gb_ppu_kernels_init(void) {
+	static once_flag once = ONCE_FLAG_INIT;
+	call_once(&once, select_kernels);
+} // end gb_ppu_kernels_init()
+
+//=======================================================================
+// def gb_ppu_decode_tile_scalar()
+void
+gb_ppu_decode_tile_scalar(
+		struct gb_ppu_tile* restrict dst,
+		const uint8_t data[PPU_TILE_SIZE]) {
+	for (uint8_t row = 0; row < PPU_TILE_LEN; ++row) {
+		uint8_t low = data[row * PPU_TILE_ROW_SIZE];
+		uint8_t high = data[row * PPU_TILE_ROW_SIZE + 1];
+		for (uint8_t x = 0; x < PPU_TILE_LEN; ++x) {
+			// The leftmost pixel is in the most significant bits.
+			uint8_t bit = (PPU_TILE_LEN-1) - x;
+			uint8_t color = ((low >> bit) & 1) | (((high >> bit) & 1) << 1);
+			dst->px[0][row][x] = color;
+			dst->px[1][row][bit] = color;
+		}
+	}
+} // end gb_ppu_decode_tile_scalar()
+
+//=======================================================================
+// def gb_ppu_resolve_dmg_scalar()
+void
+gb_ppu_resolve_dmg_scalar(
+		uint32_t dst[PPU_SCR_WIDTH],
+		const uint8_t enc[PPU_SCR_WIDTH],
+		const uint32_t colors[GB_PPU_DMG_COLORS]) {
+	for (uint8_t i = 0; i < PPU_SCR_WIDTH; ++i)
+		dst[i] = colors[dmg_color_index(enc[i])];
+} // end gb_ppu_resolve_dmg_scalar()
+
+#ifdef GB_PPU_KERNELS_X86
+//=======================================================================
+// doc gb_ppu_decode_tile_sse2()
+// Each row's low and high bitplanes are broadcast to the two halves of
+// a vector, and each byte is compared against the bit of its pixel,
+// giving 1 or 2 per set bit. ORing the halves gives the row's indices.
+// Comparing against the bits in reverse order gives the flipped row.
+//=======================================================================
+// def gb_ppu_decode_tile_sse2()
+__attribute__((target("sse2")))
+void
+gb_ppu_decode_tile_sse2(
+		struct gb_ppu_tile* restrict dst,
+		const uint8_t data[PPU_TILE_SIZE]) {
+	const __m128i bits = _mm_setr_epi8(
+			0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+			0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i flipped_bits = _mm_setr_epi8(
+			0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+			0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+	const __m128i weights = _mm_setr_epi8(
+			1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2);
+	for (uint8_t row = 0; row < PPU_TILE_LEN; ++row) {
+		uint16_t planes;
+		__builtin_memcpy(&planes, data + row * PPU_TILE_ROW_SIZE, sizeof(planes));
+		// Low plane in bytes 0-7, high plane in bytes 8-15:
+		__m128i v = _mm_cvtsi32_si128(planes);
+		v = _mm_unpacklo_epi8(v, v);
+		v = _mm_unpacklo_epi16(v, v);
+		v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 0, 0));
+
+		__m128i px = _mm_and_si128(weights,
+				_mm_cmpeq_epi8(_mm_and_si128(v, bits), bits));
+		_mm_storel_epi64((__m128i*)dst->px[0][row],
+				_mm_or_si128(px, _mm_srli_si128(px, 8)));
+		px = _mm_and_si128(weights,
+				_mm_cmpeq_epi8(_mm_and_si128(v, flipped_bits), flipped_bits));
+		_mm_storel_epi64((__m128i*)dst->px[1][row],
+				_mm_or_si128(px, _mm_srli_si128(px, 8)));
+	}
+} // end gb_ppu_decode_tile_sse2()
+
+//=======================================================================
+// doc gb_ppu_resolve_dmg_ssse3()
+// The color table is transposed into 4 vectors of 16 bytes, one per
+// byte of a color, so that each can be looked up with PSHUFB 16 pixels
+// at a time, and the looked-up bytes interleaved back into colors.
+//=======================================================================
+// def gb_ppu_resolve_dmg_ssse3()
+__attribute__((target("ssse3")))
+void
+gb_ppu_resolve_dmg_ssse3(
+		uint32_t dst[PPU_SCR_WIDTH],
+		const uint8_t enc[PPU_SCR_WIDTH],
+		const uint32_t colors[GB_PPU_DMG_COLORS]) {
+	static_assert(PPU_SCR_WIDTH % 16 == 0);
+	__m128i planes[4];
+	transpose_dmg_colors(planes, colors);
+	const __m128i byte0 = planes[0];
+	const __m128i byte1 = planes[1];
+	const __m128i byte2 = planes[2];
+	const __m128i byte3 = planes[3];
+
+	const __m128i bg_bit = _mm_set1_epi8(0x08);
+	const __m128i low_bits = _mm_set1_epi8(0x07);
+	for (uint8_t i = 0; i < PPU_SCR_WIDTH; i += 16) {
+		__m128i e = _mm_loadu_si128((const __m128i*)(enc + i));
+		// See dmg_color_index().
+		__m128i index = _mm_or_si128(
+				_mm_and_si128(_mm_srli_epi16(e, 4), bg_bit),
+				_mm_and_si128(e, low_bits));
+		__m128i b0 = _mm_shuffle_epi8(byte0, index);
+		__m128i b1 = _mm_shuffle_epi8(byte1, index);
+		__m128i b2 = _mm_shuffle_epi8(byte2, index);
+		__m128i b3 = _mm_shuffle_epi8(byte3, index);
+		__m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+		__m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+		__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+		__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+		__m128i* out = (__m128i*)(dst + i);
+		_mm_storeu_si128(out,     _mm_unpacklo_epi16(lo01, lo23));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+	}
+} // end gb_ppu_resolve_dmg_ssse3()
+
+//=======================================================================
+// doc gb_ppu_resolve_dmg_avx2()
+// As gb_ppu_resolve_dmg_ssse3(), 32 pixels at a time. VPSHUFB and the
+// unpacks work within each 128-bit half, so the second half of each
+// result holds pixels 16 later than the first, and the halves are
+// recombined in order before storing.
+//=======================================================================
+// def gb_ppu_resolve_dmg_avx2()
+__attribute__((target("avx2")))
+void
+gb_ppu_resolve_dmg_avx2(
+		uint32_t dst[PPU_SCR_WIDTH],
+		const uint8_t enc[PPU_SCR_WIDTH],
+		const uint32_t colors[GB_PPU_DMG_COLORS]) {
+	static_assert(PPU_SCR_WIDTH % 32 == 0);
+	__m128i planes[4];
+	transpose_dmg_colors(planes, colors);
+	// Both halves look up from the same table.
+	const __m256i byte0 = _mm256_broadcastsi128_si256(planes[0]);
+	const __m256i byte1 = _mm256_broadcastsi128_si256(planes[1]);
+	const __m256i byte2 = _mm256_broadcastsi128_si256(planes[2]);
+	const __m256i byte3 = _mm256_broadcastsi128_si256(planes[3]);
+
+	const __m256i bg_bit = _mm256_set1_epi8(0x08);
+	const __m256i low_bits = _mm256_set1_epi8(0x07);
+	for (uint8_t i = 0; i < PPU_SCR_WIDTH; i += 32) {
+		__m256i e = _mm256_loadu_si256((const __m256i*)(enc + i));
+		// See dmg_color_index().
+		__m256i index = _mm256_or_si256(
+				_mm256_and_si256(_mm256_srli_epi16(e, 4), bg_bit),
+				_mm256_and_si256(e, low_bits));
+		__m256i b0 = _mm256_shuffle_epi8(byte0, index);
+		__m256i b1 = _mm256_shuffle_epi8(byte1, index);
+		__m256i b2 = _mm256_shuffle_epi8(byte2, index);
+		__m256i b3 = _mm256_shuffle_epi8(byte3, index);
+		__m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+		__m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+		__m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+		__m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+		// Pixels 0-3 and 16-19, 4-7 and 20-23, and so on:
+		__m256i p0 = _mm256_unpacklo_epi16(lo01, lo23);
+		__m256i p1 = _mm256_unpackhi_epi16(lo01, lo23);
+		__m256i p2 = _mm256_unpacklo_epi16(hi01, hi23);
+		__m256i p3 = _mm256_unpackhi_epi16(hi01, hi23);
+		__m256i* out = (__m256i*)(dst + i);
+		_mm256_storeu_si256(out,     _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+		_mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+		_mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+} // end gb_ppu_resolve_dmg_avx2()
+#endif // GB_PPU_KERNELS_X86
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def select_kernels()
+static void
+select_kernels(void) {
+	const char* decode_name = "scalar";
+	const char* resolve_name = "scalar";
+#ifdef GB_PPU_KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		gb_ppu_decode_tile = gb_ppu_decode_tile_sse2;
+		decode_name = "SSE2";
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		gb_ppu_resolve_dmg = gb_ppu_resolve_dmg_avx2;
+		resolve_name = "AVX2";
+	} else if (__builtin_cpu_supports("ssse3")) {
+		gb_ppu_resolve_dmg = gb_ppu_resolve_dmg_ssse3;
+		resolve_name = "SSSE3";
+	}
+#endif
+	LOGI("PPU kernels: decode %s, resolve %s.", decode_name, resolve_name);
+} // end select_kernels()
+
+#ifdef GB_PPU_KERNELS_X86
+//=======================================================================
+// doc transpose_dmg_colors()
+// Splits the color table of gb_ppu_resolve_dmg() into 4 vectors, where
+// byte i of vector n is byte n of color i.
+//=======================================================================
+// def transpose_dmg_colors()
+__attribute__((target("ssse3")))
+static inline void
+transpose_dmg_colors(
+		__m128i planes[4],
+		const uint32_t colors[GB_PPU_DMG_COLORS]) {
+	// Gather byte n of each of 4 colors into lane n of each vector,
+	// then transpose the lanes.
+	const __m128i gather = _mm_setr_epi8(
+			0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m128i* src = (const __m128i*)colors;
+	__m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128(src), gather);
+	__m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), gather);
+	__m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), gather);
+	__m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), gather);
+	__m128i t0 = _mm_unpacklo_epi32(c0, c1);
+	__m128i t1 = _mm_unpacklo_epi32(c2, c3);
+	__m128i t2 = _mm_unpackhi_epi32(c0, c1);
+	__m128i t3 = _mm_unpackhi_epi32(c2, c3);
+	planes[0] = _mm_unpacklo_epi64(t0, t1);
+	planes[1] = _mm_unpackhi_epi64(t0, t1);
+	planes[2] = _mm_unpacklo_epi64(t2, t3);
+	planes[3] = _mm_unpackhi_epi64(t2, t3);
+} // end transpose_dmg_colors()
+#endif // GB_PPU_KERNELS_X86
+
+//=======================================================================
+// doc dmg_color_index()
+// Index into the color table of gb_ppu_resolve_dmg() of an encoded DMG
+// pixel. OBJ pixels carry their palette (0 or 1) in the low palette
+// bit, and BG pixels no palette, so the low 3 bits select the color
+// within the OBJ palettes or BGP, and the palette type bit adds 8 for
+// BGP.
+//=======================================================================
+// def dmg_color_index()
+static inline uint8_t
+dmg_color_index(uint8_t enc) {
+	static_assert(PPU_ENC_PALETTE_TYPE >> 4 == 0x08);
+	return ((enc >> 4) & 0x08) | (enc & 0x07);
+} // end dmg_color_index()
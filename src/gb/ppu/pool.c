@@ -0,0 +1,194 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <threads.h>
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/log.h"
+#include "gb/ppu.h"
+#include "gb/ppu/pool.h"
+#include "gb/ppu/shared.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL CONSTANT DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+enum {
+	BAND_COUNT = PPU_SCR_HEIGHT / PPU_POOL_BAND_LINES,
+	// Times an idle worker yields, checking for the next frame,
+	// before parking.
+	SPIN_YIELDS = 64,
+	GENERATION_SHIFT = 32,
+};
+static_assert(PPU_SCR_HEIGHT % PPU_POOL_BAND_LINES == 0);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static int
+worker_main(void* arg);
+static void
+draw_bands(struct gb_ppu_pool* restrict pool, uint32_t generation);
+static uint32_t
+await_frame(struct gb_ppu_pool* restrict pool, uint32_t seen);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_ppu_pool_init()
+int
+gb_ppu_pool_init(struct gb_ppu_pool* restrict pool, unsigned threads) {
+	assert(pool != NULL);
+	if (threads > PPU_POOL_MAX_THREADS)
+		threads = PPU_POOL_MAX_THREADS;
+	atomic_init(&(pool->work), 0);
+	atomic_init(&(pool->bands_done), 0);
+	atomic_init(&(pool->parked), 0);
+	atomic_init(&(pool->stop), 0);
+	pool->pixels = NULL;
+	pool->ppu = NULL;
+	pool->count = 0;
+	if (mtx_init(&(pool->lock), mtx_plain) != thrd_success)
+		return 1;
+	if (cnd_init(&(pool->wake)) != thrd_success) {
+		mtx_destroy(&(pool->lock));
+		return 1;
+	}
+	for (; pool->count < threads; ++(pool->count)) {
+		if (thrd_create(&(pool->threads[pool->count]), worker_main, pool)
+				!= thrd_success) {
+			LOGE("Unable to start PPU worker %u.", pool->count);
+			gb_ppu_pool_destroy(pool);
+			return 1;
+		}
+	}
+	return 0;
+} // end gb_ppu_pool_init()
+
+//=======================================================================
+// def gb_ppu_pool_destroy()
+void
+gb_ppu_pool_destroy(struct gb_ppu_pool* restrict pool) {
+	assert(pool != NULL);
+	atomic_store(&(pool->stop), 1);
+	mtx_lock(&(pool->lock));
+	cnd_broadcast(&(pool->wake));
+	mtx_unlock(&(pool->lock));
+	for (unsigned i = 0; i < pool->count; ++i)
+		thrd_join(pool->threads[i], NULL);
+	pool->count = 0;
+	cnd_destroy(&(pool->wake));
+	mtx_destroy(&(pool->lock));
+} // end gb_ppu_pool_destroy()
+
+//=======================================================================
+// def gb_ppu_pool_draw()
+void
+gb_ppu_pool_draw(
+		struct gb_ppu_pool* restrict pool,
+		uint32_t* restrict pixels,
+		const struct gb_ppu* restrict ppu) {
+	assert(pool != NULL);
+	assert(pixels != NULL);
+	assert(ppu != NULL);
+	// Every band of the previous frame was drawn before it returned,
+	// so no worker still reads these.
+	pool->pixels = pixels;
+	pool->ppu = ppu;
+	atomic_store_explicit(&(pool->bands_done), 0, memory_order_relaxed);
+	uint32_t generation = (uint32_t)(atomic_load_explicit(&(pool->work),
+			memory_order_relaxed) >> GENERATION_SHIFT) + 1;
+	// Publishes the frame, and opens its bands to be claimed.
+	atomic_store(&(pool->work), (uint_fast64_t)generation << GENERATION_SHIFT);
+	if (atomic_load(&(pool->parked))) {
+		mtx_lock(&(pool->lock));
+		cnd_broadcast(&(pool->wake));
+		mtx_unlock(&(pool->lock));
+	}
+
+	draw_bands(pool, generation);
+	// Wait out bands which workers are still drawing.
+	while (atomic_load_explicit(&(pool->bands_done), memory_order_acquire)
+			< BAND_COUNT)
+		thrd_yield();
+} // end gb_ppu_pool_draw()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def worker_main()
+static int
+worker_main(void* arg) {
+	struct gb_ppu_pool* pool = arg;
+	uint32_t seen = 0;
+	while (1) {
+		seen = await_frame(pool, seen);
+		if (atomic_load(&(pool->stop)))
+			return 0;
+		draw_bands(pool, seen);
+	}
+} // end worker_main()
+
+//=======================================================================
+// doc draw_bands()
+// Claims and draws bands of frame `generation` until none are left to
+// claim. Claiming fails, and so this returns, once a later frame has
+// been published, so a slow thread never draws a stale band.
+//=======================================================================
+// def draw_bands()
+static void
+draw_bands(struct gb_ppu_pool* restrict pool, uint32_t generation) {
+	uint_fast64_t work = atomic_load(&(pool->work));
+	while ((uint32_t)(work >> GENERATION_SHIFT) == generation
+			&& (uint32_t)work < BAND_COUNT) {
+		// Acquires the frame's `pixels` and `ppu` on success.
+		if (!atomic_compare_exchange_weak(&(pool->work), &work, work + 1))
+			continue;
+		uint8_t line = (uint8_t)((uint32_t)work * PPU_POOL_BAND_LINES);
+		uint32_t* dst = pool->pixels + (uint32_t)line * PPU_SCR_WIDTH;
+		for (uint8_t i = 0; i < PPU_POOL_BAND_LINES; ++i) {
+			gb_ppu_draw_line(dst, pool->ppu, line + i);
+			dst += PPU_SCR_WIDTH;
+		}
+		atomic_fetch_add_explicit(&(pool->bands_done), 1, memory_order_release);
+		work = atomic_load(&(pool->work));
+	}
+} // end draw_bands()
+
+//=======================================================================
+// doc await_frame()
+// Returns the generation of the first frame published after `seen`,
+// once there is one, or `seen` once the pool is stopping.
+// Spins for a while before parking, as frames may follow closely.
+//=======================================================================
+// def await_frame()
+static uint32_t
+await_frame(struct gb_ppu_pool* restrict pool, uint32_t seen) {
+	uint32_t generation;
+	for (int i = 0; i < SPIN_YIELDS; ++i) {
+		generation = (uint32_t)(atomic_load(&(pool->work)) >> GENERATION_SHIFT);
+		if (generation != seen || atomic_load(&(pool->stop)))
+			return generation;
+		thrd_yield();
+	}
+	mtx_lock(&(pool->lock));
+	// Counted as parked before checking again, so that a frame
+	// published after the check always finds this worker to wake.
+	atomic_fetch_add(&(pool->parked), 1);
+	while ((generation = (uint32_t)(atomic_load(&(pool->work)) >> GENERATION_SHIFT))
+			== seen && !atomic_load(&(pool->stop)))
+		cnd_wait(&(pool->wake), &(pool->lock));
+	atomic_fetch_sub(&(pool->parked), 1);
+	mtx_unlock(&(pool->lock));
+	return generation;
+} // end await_frame()
@@ -4,14 +4,16 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <threads.h>
 #include "gb/core/decl.h"
 #include "gb/log.h"
 #include "gb/mem/io.h"
 #include "gb/mem/region.h"
 #include "gb/mode.h"
 #include "gb/ppu.h"
+#include "gb/ppu/hashlog.h"
+#include "gb/ppu/kernel.h"
 #include "gb/ppu/shared.h"
+#include "gb/prof.h"
 
 #define GB_LOG_MAX_LEVEL LVL_INF
 
@@ -125,7 +127,8 @@ enum {
 //=======================================================================
 
 struct bg_shared_info {
-	uint8_t* tiledata;
+	// Decoded tiles, from the one which tile index 0 selects.
+	const struct gb_ppu_tile* tiles;
 	uint8_t tile_index_xor;
 	uint8_t gb_mode;
 }; // end struct bg_shared_info
@@ -152,18 +155,10 @@ struct tile_info {
 	int16_t x;
 }; // end struct tile_info
 
-struct shift_bits {
-	int8_t curr; // Current bit
-	int8_t end;  // Ending bit
-	int8_t incr; // Incrementation direction and scale
-}; // end struct shift_bits
-
-//=======================================================================
-//-----------------------------------------------------------------------
-// INTERNAL VARIABLE DEFINITIONS
-//-----------------------------------------------------------------------
-//=======================================================================
-thread_local const uint8_t* sorting_oam;
+struct tile_span {
+	uint8_t begin; // First onscreen column of a tile row
+	uint8_t end;   // Column after the last onscreen one
+}; // end struct tile_span
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -174,6 +169,7 @@ static void
 gb_ppu_encode_bg_row(
 		uint8_t dst[PPU_SCR_WIDTH],
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t screen_row);
 static uint8_t*
 gb_ppu_encode_bg_layer_row(
@@ -183,48 +179,46 @@ gb_ppu_encode_bg_layer_row(
 static uint8_t*
 gb_ppu_encode_bg_tile_row(
 		uint8_t* restrict dst,
-		const uint8_t* restrict tiledata,
+		const struct gb_ppu_tile* restrict tiles,
 		const struct tile_info* restrict info);
 static void
 encode_obj_row(
 		uint8_t* restrict dst,
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t line);
 static void
 encode_obj_tile_row(
 		uint8_t* restrict dst,
-		const uint8_t* restrict vram,
+		const struct gb_ppu_tile* restrict tiles,
 		const struct obj_info* restrict obj,
 		const struct tile_info* restrict tile);
-static inline uint8_t
-select_line_objs(
-		uint8_t obj_indices[PPU_MAX_OBJS_PER_LINE],
-		const uint8_t* restrict oam,
-		const struct obj_info* restrict info);
-static inline void
-bit_shift_parameters(
-		struct shift_bits* restrict shift,
-		const struct tile_info* restrict tile);
-static inline uint_fast8_t
-color_code(const uint8_t data[PPU_TILE_ROW_SIZE], uint_fast8_t bit);
+static inline struct tile_span
+onscreen_span(const struct tile_info* restrict tile);
 static inline struct bg_shared_info
-create_bg_shared_info(const struct gb_ppu_state* restrict state);
+create_bg_shared_info(
+		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs);
 static inline const uint8_t*
 get_bg_tilemap_ptr(
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t tilemap_bitmask);
-static inline uint16_t
-get_tile_data_row_index(
+static inline const uint8_t*
+get_tile_row(
+		const struct gb_ppu_tile* restrict tiles,
 		const struct tile_info* restrict tile,
 		uint8_t double_size);
 static inline void
 resolve_palettes(
 		uint32_t* restrict colors,
-		const uint8_t* restrict gb_palettes,
+		const struct gb_ppu_palettes* restrict palettes,
 		const uint32_t dmg_colors[4],
 		uint8_t gb_mode);
-static int
-x_sort_objs(const void* obj1, const void* obj2);
+static inline void
+x_sort_objs(
+		struct gb_ppu_line_objs* restrict objs,
+		const uint8_t* restrict oam);
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -232,6 +226,104 @@ x_sort_objs(const void* obj1, const void* obj2);
 //-----------------------------------------------------------------------
 //=======================================================================
 
+//=======================================================================
+// doc gb_ppu_decode_tiles()
+// Decodes each tile flagged in `state->tiles_dirty` from `state->vram`
+// into `state->tiles`, and clears its flag. Call once VRAM has been
+// handed off, before drawing any line of it.
+//=======================================================================
+// def gb_ppu_decode_tiles()
+void
+gb_ppu_decode_tiles(struct gb_ppu_state* restrict state) {
+	for (int w = 0; w < PPU_TILE_DIRTY_WORDS; ++w) {
+		uint64_t dirty = state->tiles_dirty[w];
+		while (dirty) {
+			uint16_t t = w * 64 + __builtin_ctzll(dirty);
+			gb_ppu_decode_tile(&(state->tiles[t]), state->vram + t * PPU_TILE_SIZE);
+			dirty &= dirty - 1; // Clear lowest set bit
+		}
+		state->tiles_dirty[w] = 0;
+	}
+} // end gb_ppu_decode_tiles()
+
+//=======================================================================
+// doc gb_ppu_index_objs()
+// Indexes the objects in `state->oam` into `state->line_objs` by the
+// lines they fall on, at the object height each line was drawn with.
+// Call once OAM and line registers have been handed off, before drawing
+// any line of them.
+//=======================================================================
+// def gb_ppu_index_objs()
+void
+gb_ppu_index_objs(struct gb_ppu_state* restrict state) {
+	assert(state != NULL);
+	for (uint8_t line = 0; line < PPU_SCR_HEIGHT; ++line)
+		state->line_objs[line].count = 0;
+
+	//---------------------------------------------------------------------
+	// The first 10 objects (ordered by position in OAM) on a line
+	// are selected for drawing, regardless of X-position. Any
+	// objects after the first ten are ignored, regardless of Y-position.
+	// Visiting objects in OAM order fills each line's bucket in that order.
+	//------
+	// Guarantee no overflow in `i` when traversing OAM:
+	static_assert(MEM_SZ_OAM <= UINT8_MAX - PPU_OAM_ENTRY_SIZE);
+	for (uint8_t i = 0; i < MEM_SZ_OAM; i += PPU_OAM_ENTRY_SIZE) {
+		// Screen line of the object's top row, which may be offscreen:
+		int16_t top = (int16_t)(state->oam[i + PPU_OAM_YPOS]) - PPU_OBJ_YOFF;
+		// Lines which an object of either height could fall on:
+		int16_t begin = (top < 0 ? 0 : top);
+		int16_t end = top + OBJ_LARGE_HEIGHT;
+		if (end > PPU_SCR_HEIGHT)
+			end = PPU_SCR_HEIGHT;
+		for (int16_t line = begin; line < end; ++line) {
+			// Object height may change between lines.
+			uint8_t height = (state->lines[line].lcdc & IO_LCDC_OBJ_SIZE) ?
+				OBJ_LARGE_HEIGHT : OBJ_SMALL_HEIGHT;
+			struct gb_ppu_line_objs* objs = &(state->line_objs[line]);
+			if (line - top < height && objs->count < PPU_MAX_OBJS_PER_LINE)
+				objs->oam[objs->count++] = i;
+		}
+	} // end iteration over OAM
+
+	//---------------------------------------------------------------------
+	// On DMG, objects are prioritized by order of ascending X-coordinate
+	// (lower X-coordinate = higher priority),
+	// with objects with matching X-coordinates prioritized by ascending
+	// OAM index (lower index = higher priority).
+	//
+	// On CGB, object priority is determined solely by ascending OAM index
+	// (lower index = higher priority).
+	//
+	// Priority determines how overlapping objects behave with one another.
+	// Higher priority objects are drawn over lower priority objects.
+	if (state->mode == GBMODE_CGB)
+		return;
+	for (uint8_t line = 0; line < PPU_SCR_HEIGHT; ++line)
+		x_sort_objs(&(state->line_objs[line]), state->oam);
+} // end gb_ppu_index_objs()
+
+//=======================================================================
+// doc gb_ppu_resolve_palettes()
+// Resolves the colors of each line's palettes into `ppu->line_colors`,
+// unless they were already resolved from the same palette generation.
+// Call once line registers have been handed off, before drawing any
+// line of them.
+//=======================================================================
+// def gb_ppu_resolve_palettes()
+void
+gb_ppu_resolve_palettes(struct gb_ppu* restrict ppu) {
+	assert(ppu != NULL);
+	for (uint8_t line = 0; line < PPU_SCR_HEIGHT; ++line) {
+		const struct gb_ppu_palettes* palettes = &(ppu->state.lines[line].palettes);
+		if (ppu->line_palettes[line] == palettes->generation)
+			continue;
+		resolve_palettes(ppu->line_colors[line], palettes, ppu->dmg_colors,
+				ppu->state.mode);
+		ppu->line_palettes[line] = palettes->generation;
+	}
+} // end gb_ppu_resolve_palettes()
+
 //#undef GB_LOG_MAX_LEVEL
 //#define GB_LOG_MAX_LEVEL LVL_TRC
 void
@@ -239,23 +331,24 @@ gb_ppu_draw_line(
 		uint32_t dst[PPU_SCR_WIDTH],
 		const struct gb_ppu* restrict ppu,
 		uint8_t line) {
+	const struct gb_ppu_line* regs = &(ppu->state.lines[line]);
+	GB_PROF_BEGIN(prof_encode);
 	uint8_t enc[PPU_SCR_WIDTH];
-	gb_ppu_encode_bg_row(enc, &(ppu->state), line);
-	encode_obj_row(enc, &(ppu->state), line);
+	gb_ppu_encode_bg_row(enc, &(ppu->state), regs, line);
+	encode_obj_row(enc, &(ppu->state), regs, line);
+	if (ppu->hashes != NULL)
+		memcpy(ppu->hashes->encoded[line], enc, PPU_SCR_WIDTH);
+	GB_PROF_END(GB_PROF_PPU_ENCODE, prof_encode);
 
-	uint32_t colors[CGB_NUM_COLORS];
-	resolve_palettes(colors, ppu->state.palette, ppu->dmg_colors, ppu->state.mode);
+	GB_PROF_BEGIN(prof_palette);
 	if (ppu->state.mode != GBMODE_CGB) {
 		// DMG
-		for (uint8_t i = 0; i < PPU_SCR_WIDTH; ++i) {
-			if (PPU_ENC_IS_OBJ(enc[i])) // OBJ
-				dst[i] = colors[enc[i] & (PPU_ENC_PALETTE | PPU_ENC_COLOR)];
-			else // BG
-				dst[i] = colors[(enc[i] & PPU_ENC_COLOR) + BGP_OFFSET];
-		}
+		static_assert(BGP_OFFSET + COLORS_PER_PALETTE <= GB_PPU_DMG_COLORS);
+		gb_ppu_resolve_dmg(dst, enc, ppu->line_colors[line]);
 	} else {
 		assert(0); // to-be-implemented
 	}
+	GB_PROF_END(GB_PROF_PALETTE, prof_palette);
 } // end gb_ppu_draw_line()
 //#undef GB_LOG_MAX_LEVEL
 //#define GB_LOG_MAX_LEVEL LVL_INF
@@ -265,33 +358,35 @@ static void
 gb_ppu_encode_bg_row(
 		uint8_t dst[PPU_SCR_WIDTH],
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t screen_row) {
 	assert(state != NULL);
+	assert(regs != NULL);
 	assert(screen_row < PPU_SCR_HEIGHT);
 
 	if (state->mode != GBMODE_CGB &&
-	    !(state->lcdc & IO_LCDC_BG_ENABLED)) {
+	    !(regs->lcdc & IO_LCDC_BG_ENABLED)) {
 		// (DMG-only) BG is disabled
 		// Fill dst with deprioritized color 0 pixels.
 		for (uint8_t i = 0; i < PPU_SCR_WIDTH; ++i)
 			dst[i] = PPU_ENC_PALETTE_BG;
 	}
 
-	struct bg_shared_info shared = create_bg_shared_info(state);
+	struct bg_shared_info shared = create_bg_shared_info(state, regs);
 	// Subtract offset to get screen x-coordinate of window:
-	int16_t wnd_x = (int16_t)(state->wx) - PPU_WND_XOFF; 
+	int16_t wnd_x = (int16_t)(regs->wx) - PPU_WND_XOFF; 
 	uint8_t wnd_visible = // window visibility
-		(state->lcdc & IO_LCDC_WND_ENABLED && // window is enabled
-		 state->wy <= screen_row &&           // window (y) has begun by this line
+		(regs->lcdc & IO_LCDC_WND_ENABLED && // window is enabled
+		 regs->wy <= screen_row &&           // window (y) has begun by this line
 		 wnd_x < PPU_SCR_WIDTH);              // window (x) begins before line ends
 	uint8_t bg_visible = (!wnd_visible || wnd_x > 0);
 
 	//--- Background layer ---
 	if (bg_visible) {
 		struct bg_layer_info layer = {
-			.tilemap = get_bg_tilemap_ptr(state, IO_LCDC_BG_TILEMAP),
-			.bg_row = screen_row + state->scy, // Overflow is intentional.
-			.bg_col_init = state->scx,
+			.tilemap = get_bg_tilemap_ptr(state, regs, IO_LCDC_BG_TILEMAP),
+			.bg_row = screen_row + regs->scy, // Overflow is intentional.
+			.bg_col_init = regs->scx,
 			.width = (wnd_visible ? wnd_x : PPU_SCR_WIDTH)
 		}; // end layer definition
 		dst = gb_ppu_encode_bg_layer_row(dst, &shared, &layer);
@@ -301,8 +396,8 @@ gb_ppu_encode_bg_row(
 	if (wnd_visible) {
 		// Window is visible
 		struct bg_layer_info layer = {
-			.tilemap = get_bg_tilemap_ptr(state, IO_LCDC_WND_TILEMAP),
-			.bg_row = screen_row - state->wy,
+			.tilemap = get_bg_tilemap_ptr(state, regs, IO_LCDC_WND_TILEMAP),
+			.bg_row = screen_row - regs->wy,
 			.bg_col_init = 0,
 			.width = PPU_SCR_WIDTH - wnd_x
 		}; // end layer definition
@@ -351,7 +446,7 @@ gb_ppu_encode_bg_layer_row(
 
 		LOGT("dst = %p, tile.x = %" PRId16 ", tile.index = %" PRIu8 ", tilemap_col = %" PRIu8,
 				dst, tile.x, tile.index, tilemap_col);
-		dst = gb_ppu_encode_bg_tile_row(dst, shared->tiledata, &tile);
+		dst = gb_ppu_encode_bg_tile_row(dst, shared->tiles, &tile);
 		tilemap_col = (tilemap_col + 1) % PPU_BG_TILES_PER_LENGTH;
 		tile.x += PPU_TILE_LENGTH;
 	} // end while (tile.x < tile.end_x)
@@ -365,14 +460,14 @@ gb_ppu_encode_bg_layer_row(
 static uint8_t*
 gb_ppu_encode_bg_tile_row(
 		uint8_t* restrict dst,
-		const uint8_t* restrict tiledata,
+		const struct gb_ppu_tile* restrict tiles,
 		const struct tile_info* restrict info) {
 	assert(dst != NULL);
-	assert(tiledata != NULL);
+	assert(tiles != NULL);
 	assert(info != NULL);
 	
-	// Pointer to tile color data in VRAM:
-	uint16_t data_index = get_tile_data_row_index(info, 0);
+	// Decoded row of the tile, already flipped if need be:
+	const uint8_t* row = get_tile_row(tiles, info, 0);
 	// Calculate encoded palette, minus color, which will be
 	// applied later when looping over this object's pixels.
 	// NOTE: DMG callers are expected to zero all attributes.
@@ -383,15 +478,12 @@ gb_ppu_encode_bg_tile_row(
 	LOGD("enc_palette=0x%02X & PPU_ENC_COLOR=0x%02X = 0x%02X",
 			enc_palette, PPU_ENC_COLOR, enc_palette & PPU_ENC_COLOR);
 	assert((enc_palette & PPU_ENC_COLOR) == 0);
-	// Cull offscreen pixels and determine bit traversal order:
-	struct shift_bits bit;
-	bit_shift_parameters(&bit, info);
-	LOGT("bit={.curr=%d,.end=%d,.incr=%d}", bit.curr, bit.end, bit.incr);
+	// Cull offscreen pixels:
+	struct tile_span span = onscreen_span(info);
+	LOGT("span={.begin=%u,.end=%u}", span.begin, span.end);
 	// Encode color data to dst.
-	while (bit.curr != bit.end) {
-		*(dst++) = enc_palette | color_code(tiledata + data_index, bit.curr);
-		bit.curr += bit.incr;
-	}
+	for (uint8_t x = span.begin; x < span.end; ++x)
+		*(dst++) = enc_palette | row[x];
 	return dst;
 } // end gb_ppu_encode_bg_tile_row()
 //#undef GB_LOG_MAX_LEVEL
@@ -403,19 +495,22 @@ static void
 encode_obj_row(
 		uint8_t* restrict dst,
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t line) {
-	if (!(state->lcdc & IO_LCDC_OBJ_ENABLED))
+	if (!(regs->lcdc & IO_LCDC_OBJ_ENABLED))
 		return;
 
 	struct obj_info obj_info = {
-		.bg_yields_priority = !(state->lcdc & IO_LCDC_BG_ENABLED),
+		.bg_yields_priority = !(regs->lcdc & IO_LCDC_BG_ENABLED),
 		.line = line,
-		.double_height = state->lcdc & IO_LCDC_OBJ_SIZE,
+		.double_height = regs->lcdc & IO_LCDC_OBJ_SIZE,
 		.is_cgb = state->mode == GBMODE_CGB
 	};
 
-	uint8_t objv[PPU_MAX_OBJS_PER_LINE];
-	uint8_t objc = select_line_objs(objv, state->oam, &obj_info);
+	// Already in priority order (see gb_ppu_index_objs()):
+	const struct gb_ppu_line_objs* objs = &(state->line_objs[line]);
+	const uint8_t* objv = objs->oam;
+	uint8_t objc = objs->count;
 	LOGD("obj_info={.line=%u,.double_height=%u}, objc = %u",
 			obj_info.line, obj_info.double_height, objc);
 
@@ -449,7 +544,7 @@ encode_obj_row(
 		tile_info.x = (int16_t)x - PPU_OBJ_XOFF;
 
 		uint8_t dst_offset = (tile_info.x < 0 ? 0 : tile_info.x);
-		encode_obj_tile_row(dst + dst_offset, state->vram, &obj_info, &tile_info);
+		encode_obj_tile_row(dst + dst_offset, state->tiles, &obj_info, &tile_info);
 	} // end iteration over objv
 } // end encode_obj_row()
 
@@ -458,16 +553,17 @@ encode_obj_row(
 static void
 encode_obj_tile_row(
 		uint8_t* restrict dst,
-		const uint8_t* restrict vram,
+		const struct gb_ppu_tile* restrict tiles,
 		const struct obj_info* restrict obj,
 		const struct tile_info* restrict tile) {
 	assert(dst != NULL);
+	assert(tiles != NULL);
 	assert(obj != NULL);
 	assert(tile != NULL);
 	assert(tile->index < MEM_SZ_OAM);
 
-	// Pointer to the row of tile color data in VRAM:
-	uint16_t data_ptr = get_tile_data_row_index(tile, obj->double_height);
+	// Decoded row of the tile, already flipped if need be:
+	const uint8_t* row = get_tile_row(tiles, tile, obj->double_height);
 
 	// Calculate encoded palette, minus color, which will be
 	// applied later when looping over this object's pixels.
@@ -480,16 +576,14 @@ encode_obj_tile_row(
 		(tile->attribs & PPU_ATTR_CGBPAL) << PPU_ENC_COLOR_SZ;
 	assert((enc_palette & PPU_ENC_COLOR) == 0);
 
-	// Clamp usage of color bits to only onscreen pixels, and
-	// determine the direction of traversal.
-	struct shift_bits bit;
-	bit_shift_parameters(&bit, tile);
+	// Clamp usage of colors to only onscreen pixels.
+	struct tile_span span = onscreen_span(tile);
 
 	// Does the background globally yield priority?
 	if (!obj->bg_yields_priority) {
 		// Background does NOT yield priority.
 		uint8_t obj_yields_priority = tile->attribs & PPU_ATTR_BGPRIORITY;
-		while (bit.curr != bit.end) {
+		for (uint8_t x = span.begin; x < span.end; ++x) {
 			if ((!obj_yields_priority && !PPU_ENC_HAS_PRIORITY(*dst)) ||
 					!PPU_ENC_GET_COLOR(*dst)) {
 				// Either:
@@ -498,98 +592,28 @@ encode_obj_tile_row(
 				//    -OR-
 				// 2. Current color is zero, which ALWAYS yields priority.
 				// OBJ colors 1-3 will take priority over BG pixels.
-				uint8_t color = color_code(vram + data_ptr, bit.curr);
+				uint8_t color = row[x];
 				if (color != 0)
 					*dst = enc_palette | color;
 			}
 			dst += 1;
-			bit.curr += bit.incr;
-		} // end incrementation over color bits
+		} // end iteration over columns
 	} else {
 		// Background is yielding priority.
 		// OBJ colors 1-3 will take priority over BG colors.
-		while (bit.curr != bit.end) {
+		for (uint8_t x = span.begin; x < span.end; ++x) {
 			// Any object pixels already drawn take priority, so
 			// only overwrite BG pixels.
 			if (PPU_ENC_IS_BG(*dst)) {
-				uint8_t color = color_code(vram + data_ptr, bit.curr);
+				uint8_t color = row[x];
 				if (color != 0)
 					*dst = enc_palette | color;
 			}
 			dst += 1;
-			bit.curr += bit.incr;
-		} // end incrementation over color bits
+		} // end iteration over columns
 	} // end ifelse BG does NOT yield priority
 } // end gb_ppu_encode_obj_tile_row()
 
-//=======================================================================
-// def select_line_objs()
-static inline uint8_t
-select_line_objs(
-		uint8_t obj_indices[PPU_MAX_OBJS_PER_LINE],
-		const uint8_t* restrict oam,
-		const struct obj_info* restrict info) {
-	LOGT("begin");
-	assert(oam != NULL);
-	assert(info != NULL);
-	assert(info->line < PPU_SCR_HEIGHT);
-	// Guarantee no overflow when adding PPU_OBJ_YOFF to line:
-	static_assert(PPU_SCR_HEIGHT + PPU_OBJ_YOFF < UINT8_MAX);
-
-	//---------------------------------------------------------------------
-	// The first 10 objects (ordered by position in OAM) on this line
-	// are selected for drawing, regardless of X-position. Any
-	// objects after the first ten are ignored, regardless of Y-position.
-	//------
-	// Apply object Y offset to get line relative to object coordinates.
-	uint8_t offset_line = info->line + PPU_OBJ_YOFF;
-	// Guarantee subtracting height from line won't overflow through 0:
-	static_assert(OBJ_LARGE_HEIGHT-1 <= PPU_OBJ_YOFF);
-	// Minimum Y-coordinate for visible objects on this line:
-	uint8_t min_line = offset_line -
-		(!(info->double_height) ? (OBJ_SMALL_HEIGHT-1) : (OBJ_LARGE_HEIGHT-1));
-	// Maximum Y-coordinate for visible objects on this line:
-	uint8_t max_line = offset_line;
-
-	// Guarantee no overflow in `i` when traversing OAM:
-	static_assert(MEM_SZ_OAM <= UINT8_MAX - PPU_OAM_ENTRY_SIZE);
-	// Record OAM offsets for up to 10 objects on this line:
-	LOGT("counting objects from Y=[%u,%u]", min_line, max_line);
-	uint8_t obj_count = 0;
-	for (uint8_t i = 0; i < MEM_SZ_OAM; i += PPU_OAM_ENTRY_SIZE) {
-		if (oam[i + PPU_OAM_YPOS] >= min_line && oam[i + PPU_OAM_YPOS] <= max_line) {
-			obj_indices[obj_count++] = i;
-			if (obj_count >= PPU_MAX_OBJS_PER_LINE)
-				break;
-		}
-	} // end iteration over OAM
-	LOGT("objects on line: %u", obj_count);
-	
-	//---------------------------------------------------------------------
-	// On DMG, objects are prioritized by order of ascending X-coordinate
-	// (lower X-coordinate = higher priority),
-	// with objects with matching X-coordinates prioritized by ascending
-	// OAM index (lower index = higher priority).
-	//
-	// On CGB, object priority is determined solely by ascending OAM index
-	// (lower index = higher priority).
-	//
-	// Priority determines how overlapping objects behave with one another.
-	// Higher priority objects are drawn over lower priority objects.
-	if (!(info->is_cgb) && obj_count > 1) {
-		LOGD("Pre-sorting obj indices:");
-		for (uint8_t i = 0; i < obj_count; ++i)
-			LOGD("obj_indices[%u]=%u", i, obj_indices[i]);
-		sorting_oam = oam;
-		qsort(obj_indices, obj_count, sizeof(uint8_t), x_sort_objs);
-		LOGD("Post-sorting obj indices:");
-		for (uint8_t i = 0; i < obj_count; ++i)
-			LOGD("obj_indices[%u]=%u", i, obj_indices[i]);
-	}
-	LOGT("end");
-	return obj_count;
-} // end select_line_objs()
-
 //=======================================================================
 //-----------------------------------------------------------------------
 // INTERNAL FUNCTION DEFINITIONS
@@ -597,11 +621,13 @@ select_line_objs(
 //=======================================================================
 
 //=======================================================================
-static inline void
-bit_shift_parameters(
-		struct shift_bits* restrict shift,
-		const struct tile_info* restrict tile) {
-	assert(shift != NULL);
+// doc onscreen_span()
+// Returns the columns of a (decoded, already flipped) tile row which
+// fall within [0, tile->end_x) on screen.
+//=======================================================================
+// def onscreen_span()
+static inline struct tile_span
+onscreen_span(const struct tile_info* restrict tile) {
 	assert(tile != NULL);
 	// Not totally off the left or right edges of the screen, respectively:
 	assert(tile->x > -PPU_TILE_LENGTH);
@@ -623,40 +649,40 @@ bit_shift_parameters(
 	else
 		cull_right = 0;
 
-	// Determine what bits to skip based on culled pixels,
-	// and the direction of traversal based on the XFLIP attribute.
-	// If XFLIP is set, then the graphic is flipped horizontally.
-	if (!(tile->attribs & PPU_ATTR_XFLIP)) { // Not flipped
-		// Traverse bits from more to less significant
-		shift->curr = (PPU_TILE_LEN-1) - cull_left;
-		shift->end = cull_right - 1;
-		shift->incr = -1;
-	} else { // Flipped horizontally
-		// Traverse bits from less to more signficant
-		shift->curr = cull_left;
-		shift->end = PPU_TILE_LEN - cull_right;
-		shift->incr = 1;
-	}
-} // end bit_shift_parameters()
+	return (struct tile_span){
+		.begin = cull_left,
+		.end = PPU_TILE_LEN - cull_right
+	};
+} // end onscreen_span()
 
 //=======================================================================
 static inline const uint8_t*
 get_bg_tilemap_ptr(
 		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs,
 		uint8_t tilemap_bitmask) {
 	assert(state != NULL);
 	assert(tilemap_bitmask == IO_LCDC_BG_TILEMAP ||
 	       tilemap_bitmask == IO_LCDC_WND_TILEMAP);
 	return state->vram +
-		(!(state->lcdc & tilemap_bitmask) ? VRAM_BGMAP0 : VRAM_BGMAP1);
+		(!(regs->lcdc & tilemap_bitmask) ? VRAM_BGMAP0 : VRAM_BGMAP1);
 } // end get_bg_tilemap_ptr()
 
 //=======================================================================
-static inline uint16_t
-get_tile_data_row_index(
+// doc get_tile_row()
+// Returns the decoded row of `tiles` which `tile` selects, flipped as
+// its attributes say.
+//=======================================================================
+// def get_tile_row()
+static inline const uint8_t*
+get_tile_row(
+		const struct gb_ppu_tile* restrict tiles,
 		const struct tile_info* restrict tile,
 		uint8_t double_size) {
+	assert(tiles != NULL);
 	assert(tile != NULL);
+	// Only VRAM bank 0 is decoded.
+	assert(!(tile->attribs & PPU_ATTR_BANK));
 	LOGD("tile->row=%u, double_size=%u", tile->row, double_size);
 	// Assert that overflow won't occur:
 	static_assert((PPU_TILE_LEN * 2) - 1 <= UINT8_MAX);
@@ -673,23 +699,13 @@ get_tile_data_row_index(
 	if (double_size)
 		index &= ~1;
 
-	uint16_t data_row_index =
-		index * PPU_TILE_SIZE +  // offset to start of selected tile +
-		row * PPU_TILE_ROW_SIZE; // offset to selected row
-	if (tile->attribs & PPU_ATTR_BANK) // Data within bank 1?
-		data_row_index += MEM_SZ_VRAM; // Apply size of bank 0 as an offset.
-	LOGT("index=0x%02X, row=%u, data_row_index=0x%04X", index, row, data_row_index);
-	return data_row_index;
-} // end get_tile_data_row_index()
-
-//=======================================================================
-// def color_code()
-static inline uint_fast8_t
-color_code(const uint8_t data[PPU_TILE_ROW_SIZE], uint_fast8_t bit) {
-	uint_fast8_t low_bit  = (data[0] >> bit) & 1;
-	uint_fast8_t high_bit = (data[1] >> bit) & 1;
-	return (high_bit << 1) | low_bit;
-} // end color_code()
+	// Rows past the first tile of a double size object are in the next.
+	const struct gb_ppu_tile* selected =
+		tiles + index + row / PPU_TILE_LEN;
+	uint8_t flipped = (tile->attribs & PPU_ATTR_XFLIP) != 0;
+	LOGT("index=0x%02X, row=%u, flipped=%u", index, row, flipped);
+	return selected->px[flipped][row % PPU_TILE_LEN];
+} // end get_tile_row()
 
 //static const uint8_t*
 //dmg_obj_tile_row_data(
@@ -730,7 +746,9 @@ color_code(const uint8_t data[PPU_TILE_ROW_SIZE], uint_fast8_t bit) {
 
 //=======================================================================
 static inline struct bg_shared_info
-create_bg_shared_info(const struct gb_ppu_state* restrict state) {
+create_bg_shared_info(
+		const struct gb_ppu_state* restrict state,
+		const struct gb_ppu_line* restrict regs) {
 	assert(state != NULL);
 	// If the BG_TILEMAP bit in LCDC is...
 	// 1: Indices 0-127 are mapped to VRAM_DATA0.
@@ -744,17 +762,17 @@ create_bg_shared_info(const struct gb_ppu_state* restrict state) {
 	// at VRAM_DATA1 and all indices have their 7th bit inverted
 	// (which is the equivalent of adding 128 of an unsigned 8-bit int).
 	struct bg_shared_info info;
-	if (state->lcdc & IO_LCDC_BG_TILEDATA) {
-		info.tiledata = state->vram + VRAM_DATA0;
+	if (regs->lcdc & IO_LCDC_BG_TILEDATA) {
+		info.tiles = state->tiles + VRAM_DATA0 / PPU_TILE_SIZE;
 		info.tile_index_xor = 0x00; // No inversion of bit 7
 	} else {
-		info.tiledata = state->vram + VRAM_DATA1;
+		info.tiles = state->tiles + VRAM_DATA1 / PPU_TILE_SIZE;
 		info.tile_index_xor = 0x80; // Invert bit 7
 	}
 
 	info.gb_mode = state->mode;
-	LOGT("lcdc=0x%02u,info={.tiledata=%p (%p),.tile_index_xor=0x%02X,.gb_mode=%u}",
-			state->lcdc, info.tiledata, info.tiledata - state->vram,
+	LOGT("lcdc=0x%02u,info={.tiles=%p (+%td),.tile_index_xor=0x%02X,.gb_mode=%u}",
+			regs->lcdc, info.tiles, info.tiles - state->tiles,
 			info.tile_index_xor, info.gb_mode);
 	return info;
 } // end create_bg_shared_info()
@@ -766,16 +784,16 @@ create_bg_shared_info(const struct gb_ppu_state* restrict state) {
 static inline void
 resolve_palettes(
 		uint32_t* restrict colors,
-		const uint8_t* restrict gb_palettes,
+		const struct gb_ppu_palettes* restrict palettes,
 		const uint32_t dmg_colors[4],
 		uint8_t gb_mode) {
 	if (gb_mode != GBMODE_CGB) {
 		LOGT("DMG colors");
-		// DMG has 3 palettes, each encoded into 1 byte.
-		// They are stored in the lowest 3 bytes of gb_palettes
-		// (meaning that gb_palettes isn't actually a pointer).
-		// In order of ascending byte significance, the palettes are stored as:
-		// 	OBP0, OBP1, BGP
+		// DMG has 3 palettes, each encoded into 1 byte, in the same order
+		// as their colors in `colors`.
+		const uint8_t gb_palettes[DMG_NUM_PALETTES] = {
+			palettes->obp0, palettes->obp1, palettes->bgp
+		};
 		static_assert(DMG_NUM_PALETTES < UINT8_MAX);
 		for (uint8_t p = 0; p < DMG_NUM_PALETTES; ++p) {
 			// Each palette represents 4 colors.
@@ -786,8 +804,7 @@ resolve_palettes(
 			// Color 3 = bits[7-6]
 			// Each 2-bit value indicates one of the four system colors,
 			// which are stored in `dmg_colors`
-			uint8_t palette =
-				(((intptr_t)gb_palettes) >> (p * DMG_PALETTE_BITS)) & 0xFF;
+			uint8_t palette = gb_palettes[p];
 			uint8_t c = p * COLORS_PER_PALETTE;
 			colors[c  ] = dmg_colors[palette & 0x3];
 			colors[c+1] = dmg_colors[(palette >> DMG_COLOR_BITS) & 0x3];
@@ -797,6 +814,11 @@ resolve_palettes(
 			LOGT("palette[%u]=0x%02X, colors[%u]=0x%08X,[%u]=0x%08X,[%u]=0x%08X,[%u]=0x%08X",
 					p, palette, c, colors[c], c+1, colors[c+1], c+2, colors[c+2], c+3, colors[c+3]);
 		}
+		// The SIMD kernels load the whole table, so keep the entries past
+		// BGP's colors defined.
+		static_assert((int)DMG_NUM_COLORS <= (int)GB_PPU_DMG_COLORS);
+		memset(colors + DMG_NUM_COLORS, 0,
+				(GB_PPU_DMG_COLORS - DMG_NUM_COLORS) * sizeof(*colors));
 	} else {
 		assert(0); // to-be-implemented
 	}
@@ -804,20 +826,26 @@ resolve_palettes(
 //#undef GB_LOG_MAX_LEVEL
 //#define GB_LOG_MAX_LEVEL LVL_INF
 
+//=======================================================================
+// doc x_sort_objs()
+// Sorts `objs` by ascending X-coordinate in `oam`. Objects which share
+// an X-coordinate keep their (ascending OAM offset) order.
+// Insertion sort, as a line has at most 10 objects.
 //=======================================================================
 // def x_sort_objs()
-static int
-x_sort_objs(const void* obj1, const void* obj2) {
-	uint8_t obj1i = *((uint8_t*)obj1);
-	uint8_t obj2i = *((uint8_t*)obj2);
-	uint8_t obj1x = sorting_oam[obj1i + PPU_OAM_XPOS];
-	uint8_t obj2x = sorting_oam[obj2i + PPU_OAM_XPOS];
-	int diff = (int)obj1x - obj2x;
-	if (diff) // not equal
-		return diff;
-
-	// Objects share an identical X-coordinate.
-	// Sort by lowest index.
-	return (int)obj1i - obj2i;
+static inline void
+x_sort_objs(
+		struct gb_ppu_line_objs* restrict objs,
+		const uint8_t* restrict oam) {
+	assert(objs != NULL);
+	assert(oam != NULL);
+	for (uint8_t i = 1; i < objs->count; ++i) {
+		uint8_t obj = objs->oam[i];
+		uint8_t x = oam[obj + PPU_OAM_XPOS];
+		uint8_t j = i;
+		for (; j > 0 && oam[objs->oam[j - 1] + PPU_OAM_XPOS] > x; --j)
+			objs->oam[j] = objs->oam[j - 1];
+		objs->oam[j] = obj;
+	}
 } // end x_sort_objs()
 
@@ -0,0 +1,8 @@
+#ifdef GB_PROFILE
+#include <stdatomic.h>
+#include <stdint.h>
+#include "gb/prof.h"
+
+_Atomic uint64_t gb_prof_ns[GB_PROF_PHASE_COUNT];
+
+#endif // GB_PROFILE
@@ -1,16 +1,17 @@
 #include <assert.h>
 #include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "gb/core/typedef.h"
 #include "gb/mem.h"
 #include "gb/mem/io.h"
+#include "gb/prof.h"
 #define GB_LOG_MAX_LEVEL LVL_TRC
 #include "gb/log.h"
 #include "gb/sch.h"
 
-#define EV(index) (core->sch.ev[index])
-#define EV_HEADER (EV(SCHEV_HEADER))
-#define EV_FIRST (EV(EV_HEADER.next))
+#define SELF (core->sch)
+#define EV(index) (SELF.ev[index])
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -22,6 +23,8 @@ enum ppu_mode { HBLANK, VBLANK, OAM_SCAN, PIXEL_DRAW };
 static const uint16_t CYC_PPU[] = { 51, 114, 20, 43 };
 // Duration between incrementations of DIV, in cycles.
 enum { CYC_DIV = 64 };
+// Duration of a full scanline (modes 2, 3, and 0; or mode 1), in cycles.
+enum { CYC_LINE = 114 };
 // Duration between incrementations of TIMA, in cycles,
 // depending on the clock selected in the TAC register.
 static const uint16_t CYC_TIMA[] = { 256, 4, 16, 64 };
@@ -35,12 +38,35 @@ static void
 execute_event(struct gb_core* restrict core);
 static inline void
 pause_event(struct gb_core* restrict core, enum gb_schev_id target);
-static inline enum gb_schev_id
-pop_event(struct gb_core* restrict core);
 static inline void
-remove_event(struct gb_core* restrict core, enum gb_schev_id event);
-static void
-insert_event(struct gb_core* restrict core, enum gb_schev_id target);
+resume_event(struct gb_core* restrict core, enum gb_schev_id target);
+static inline void
+schedule_event(
+		struct gb_core* restrict core,
+		enum gb_schev_id target,
+		uint64_t when);
+static inline void
+remove_event(struct gb_core* restrict core, enum gb_schev_id target);
+static inline uint64_t
+cycles_until(const struct gb_core* restrict core, enum gb_schev_id target);
+static inline void
+heap_sift_up(struct gb_core* restrict core, uint8_t pos);
+static inline void
+heap_sift_down(struct gb_core* restrict core, uint8_t pos);
+static inline void
+heap_place(struct gb_core* restrict core, uint8_t pos, uint8_t id);
+static inline void
+update_next(struct gb_core* restrict core);
+static inline void
+sync_now(struct gb_core* restrict core);
+static inline void
+fast_forward(struct gb_core* restrict core);
+static inline uint64_t
+skip_periodic(
+		struct gb_core* restrict core,
+		enum gb_schev_id target,
+		uint64_t period,
+		uint64_t horizon);
 static inline uint8_t
 clock_bit_state(struct gb_core* restrict core, uint8_t tac_clock_speed);
 
@@ -51,42 +77,83 @@ clock_bit_state(struct gb_core* restrict core, uint8_t tac_clock_speed);
 //=======================================================================
 void
 gb_sch_init(struct gb_core* restrict core) {
-	EV_HEADER.next = SCHEV_NONE;
-
-	EV(SCHEV_PPU).until = CYC_PPU[OAM_SCAN];
-	insert_event(core, SCHEV_PPU);
-	EV(SCHEV_DIV).until = CYC_DIV;
-	insert_event(core, SCHEV_DIV);
+	SELF.now = 0;
+	SELF.next = UINT64_MAX;
+	SELF.budget = 0;
+	SELF.heap_size = 0;
+	for (uint8_t i = 0; i < NUM_SCHEVS; ++i) {
+		EV(i).when = 0;
+		EV(i).pos = SCHEV_INACTIVE;
+	}
 
-	EV(SCHEV_TIMA).next = SCHEV_DISABLED;
-	EV(SCHEV_SERIAL).next = SCHEV_DISABLED;
-	EV(SCHEV_TIMELIMIT).next = SCHEV_DISABLED;
+	schedule_event(core, SCHEV_PPU, CYC_PPU[OAM_SCAN]);
+	schedule_event(core, SCHEV_DIV, CYC_DIV);
 } // end gb_sch_init()
 
+//=======================================================================
+// def gb_sch_advance()
 void
 gb_sch_advance(struct gb_core* restrict core, uint8_t cycles) {
+	SELF.budget -= cycles;
+	if (SELF.budget <= 0)
+		gb_sch_run_due(core);
+} // end gb_sch_advance()
+
+//=======================================================================
+// doc gb_sch_run_due()
+// Fires every event whose timestamp has been reached.
+// Called by the CPU once it has exhausted its cycle budget.
+//=======================================================================
+// def gb_sch_run_due()
+void
+gb_sch_run_due(struct gb_core* restrict core) {
 	// There should always be at least 1 event.
-	assert(EV_HEADER.next != SCHEV_NONE);
+	assert(SELF.heap_size > 0);
 
-	EV_FIRST.until -= cycles;
-	while (EV_FIRST.until <= 0)
+	GB_PROF_BEGIN(prof_begin);
+	sync_now(core);
+	while (SELF.now >= SELF.next)
 		execute_event(core);
-} // end gb_sch_advance()
+	GB_PROF_END(GB_PROF_SCH, prof_begin);
+} // end gb_sch_run_due()
+
+//=======================================================================
+// doc gb_sch_halt()
+// Advances time until an enabled interrupt is pending, as for a HALTed
+// CPU. Rather than stepping one cycle at a time, time jumps directly
+// from event to event, and events which cannot wake the CPU are
+// advanced in bulk (see fast_forward()).
+//=======================================================================
+// def gb_sch_halt()
+void
+gb_sch_halt(struct gb_core* restrict core) {
+	// There should always be at least 1 event.
+	assert(SELF.heap_size > 0);
+
+	GB_PROF_BEGIN(prof_begin);
+	sync_now(core);
+	while (!gb_mem_io_pending_interrupts(core)) {
+		fast_forward(core);
+		if (SELF.now < SELF.next)
+			SELF.now = SELF.next;
+		while (SELF.now >= SELF.next)
+			execute_event(core);
+	}
+	GB_PROF_END(GB_PROF_SCH, prof_begin);
+} // end gb_sch_halt()
 
 //=======================================================================
 // def gb_sch_on_div_reset()
 void
 gb_sch_on_div_reset(struct gb_core* restrict core) {
-	remove_event(core, SCHEV_DIV);
-	EV(SCHEV_DIV).until = CYC_DIV;
-	insert_event(core, SCHEV_DIV);
+	sync_now(core);
+	schedule_event(core, SCHEV_DIV, SELF.now + CYC_DIV);
 
 	uint8_t tac = gb_mem_direct_read(core, IO_TAC);
 	if (tac & IO_TAC_ENABLE) {
-		remove_event(core, SCHEV_TIMA);
-		EV(SCHEV_TIMA).until = CYC_TIMA[tac & IO_TAC_CLOCK_SELECT];
-		insert_event(core, SCHEV_TIMA);
-	} 
+		schedule_event(core, SCHEV_TIMA,
+				SELF.now + CYC_TIMA[tac & IO_TAC_CLOCK_SELECT]);
+	}
 } // end gb_sch_on_div_reset()
 
 //=======================================================================
@@ -99,7 +166,8 @@ gb_sch_on_tac_update(
 		return; // No change in TAC
 	if (!(old_tac & IO_TAC_ENABLE) && !(new_tac & IO_TAC_ENABLE))
 		return; // Clock goes from off-to-off, so clock changes are irrelevant.
-	
+
+	sync_now(core);
 	uint8_t old_enabled = old_tac & IO_TAC_ENABLE;
 	uint8_t old_clock = old_tac & IO_TAC_CLOCK_SELECT;
 	uint8_t new_enabled = new_tac & IO_TAC_ENABLE;
@@ -121,11 +189,14 @@ gb_sch_on_tac_update(
 	//---------------------------------------------------------------------
 	// Whether the timer is turning off or is changing clock rate, its
 	// currently scheduled event is now invalid.
-	remove_event(core, SCHEV_TIMA);
-	if (!new_enabled)
+	if (!new_enabled) {
+		remove_event(core, SCHEV_TIMA);
 		return; // If disabled, do not requeue.
+	}
 
 	// Reschedule enabled timer with its new clock value.
+	uint64_t div_until = cycles_until(core, SCHEV_DIV);
+	uint64_t tima_until;
 	switch (new_clock) {
 		case 0: // CPU clock / 1024
 			// TIMA increments every time DIV % 4 == 0
@@ -137,24 +208,24 @@ gb_sch_on_tac_update(
 			// * Add number of cycles before currently queued DIV
 			//   event fires to the previous value.
 			uint8_t div = gb_mem_direct_read(core, IO_DIV);
-			EV(SCHEV_TIMA).until =
-				((3 - (div % 4)) * CYC_DIV) + EV(SCHEV_DIV).until;
+			tima_until = ((3 - (div % 4)) * CYC_DIV) + div_until;
 			//-----------------------------------------------------------------
 			break;
 		case 1: // CPU clock / 16
 			// TIMA increments every time DIV's cycle counter % CYC_TIMA[1] (4) == 0
-			EV(SCHEV_TIMA).until = EV(SCHEV_DIV).until % CYC_TIMA[1];
+			tima_until = div_until % CYC_TIMA[1];
 			break;
 		case 2: // CPU clock / 64
 			// TIMA increments every time DIV's cycle counter % CYC_TIMA[2] (16) == 0
-			EV(SCHEV_TIMA).until = EV(SCHEV_DIV).until % CYC_TIMA[2];
+			tima_until = div_until % CYC_TIMA[2];
 			break;
 		case 3: // CPU clock / 256
+		default:
 			// TIMA increments every time DIV increments.
-			EV(SCHEV_TIMA).until = EV(SCHEV_DIV).until;
+			tima_until = div_until;
 			break;
 	} // switch (new_clock)
-	insert_event(core, SCHEV_TIMA);
+	schedule_event(core, SCHEV_TIMA, SELF.now + tima_until);
 } // end gb_sch_on_tac_update()
 
 //=======================================================================
@@ -169,11 +240,12 @@ gb_sch_on_lcdc_update(
 	new_lcdc &= IO_LCDC_PPU_ENABLED;
 	if (old_lcdc == new_lcdc)
 		return; // No scheduler changes.
-	
+
+	sync_now(core);
 	if (!new_lcdc) // PPU is turning off
 		pause_event(core, SCHEV_PPU);
 	else // PPU is turning on
-		insert_event(core, SCHEV_PPU);
+		resume_event(core, SCHEV_PPU);
 } // end gb_sch_on_lcdc_update()
 
 //=======================================================================
@@ -182,117 +254,313 @@ gb_sch_on_lcdc_update(
 //-----------------------------------------------------------------------
 //=======================================================================
 // def execute_event()
-// TODO: Execute a single event multiple times efficently.
-// Time passing rapidly enough to warrant optimization
-// can occur when HALTed or STOPped.
-// TODO: During HALT or STOP, only events that trigger
-// interrupts would matter.
 static void
 execute_event(struct gb_core* restrict core) {
-	// 1. Pop event from front of event queue.
-	// 2. Execute event.
-	// 3. Increment event cycles-before-firing counter by
-	//    the number of cycles before it fires again.
-	// 4. Re-insert event into event queue.
-	enum gb_schev_id event = pop_event(core);
+	// 1. Execute the event at the top of the heap.
+	// 2. Push its timestamp back by the number of cycles before it
+	//    fires again. Timestamps are advanced from the previous
+	//    timestamp (rather than `now`) so that no cycles are lost
+	//    when an instruction overshoots an event.
+	// 3. Restore heap ordering.
+	enum gb_schev_id event = SELF.heap[0];
 	switch (event) {
 		case SCHEV_PPU:
-			EV(SCHEV_PPU).until += CYC_PPU[gb_mem_io_advance_ppu(core)];
+			EV(SCHEV_PPU).when += CYC_PPU[gb_mem_io_advance_ppu(core)];
 			break;
 		case SCHEV_DIV:
 			gb_mem_io_increment_div(core);
-			EV(SCHEV_DIV).until += CYC_DIV;
+			EV(SCHEV_DIV).when += CYC_DIV;
 			break;
 		case SCHEV_TIMA:
 			gb_mem_io_increment_tima(core);
-			EV(SCHEV_TIMA).until +=
+			EV(SCHEV_TIMA).when +=
 				CYC_TIMA[gb_mem_direct_read(core, IO_TAC) & IO_TAC_CLOCK_SELECT];
 			break;
 		case SCHEV_SERIAL: // TODO: Not implemented
-			return; // Not reinserted
+			remove_event(core, event);
+			return; // Not rescheduled
 		case SCHEV_TIMELIMIT: // TODO: Not implemented
-			break;
 		default:
 			// TODO: Error
-			break;
+			remove_event(core, event);
+			return;
 	} // end switch (event)
-	insert_event(core, event);
-} // end execute_event()
 
-static inline enum gb_schev_id
-pop_event(struct gb_core* restrict core) {
-	// Undo relative adjustment to event following first event.
-	if (EV_FIRST.next != SCHEV_NONE)
-		EV(EV_FIRST.next).until += EV_FIRST.until;
-	// Connect header to event following first event.
-	enum gb_schev_id popped = EV_HEADER.next;
-	EV_HEADER.next = EV(popped).next;
-	return popped;
-} // end pop_event()
+	// The event handler may have rescheduled or removed other events,
+	// but never this one, so it is still in the heap. Re-sort it from
+	// its current position.
+	assert(EV(event).pos != SCHEV_INACTIVE);
+	heap_sift_down(core, EV(event).pos);
+	update_next(core);
+} // end execute_event()
 
+//=======================================================================
+// doc fast_forward()
+// Used while HALTed. Determines the earliest upcoming event which could
+// make an enabled interrupt pending (the "horizon"), then advances
+// every event that fires before the horizon in bulk, applying its
+// cumulative effect to the I/O registers arithmetically.
+//
+// Only events with no observable intermediate effects are skipped:
+// * DIV never raises interrupts.
+// * TIMA is skipped up to its next overflow if the timer interrupt is
+//   enabled, or indefinitely otherwise.
+// * LY is skipped one whole line at a time whilst in mode 0 or 1, and
+//   only when no STAT interrupt sources are selected, up to (but not
+//   including) the line on which the PPU would change modes for good.
+//
+// STOP and STAT-driven waits are not accelerated; they simply step from
+// event to event.
+//=======================================================================
+// def fast_forward()
 static inline void
-remove_event(struct gb_core* restrict core, enum gb_schev_id event) {
-	// Must find the event in the queue before removing it.
-	// The event pointing to it needs to be directed to the event
-	// following it.
-	enum gb_schev_id prev = SCHEV_HEADER;
-	while (EV(prev).next != SCHEV_NONE) {
-		if (EV(prev).next == event) {
-			EV(prev).next = EV(event).next; // prev.next = prev.next.next
-			EV(event).next = SCHEV_DISABLED;
-			return;
+fast_forward(struct gb_core* restrict core) {
+	uint8_t ie = gb_mem_direct_read(core, IO_IE);
+	uint64_t horizon = UINT64_MAX;
+
+	// PPU
+	uint8_t ppu_lines = 0;
+	if (EV(SCHEV_PPU).pos != SCHEV_INACTIVE) {
+		uint8_t stat = gb_mem_direct_read(core, IO_STAT);
+		uint8_t ly = gb_mem_direct_read(core, IO_LY);
+		if (!(stat & IO_STAT_WRITABLE) && !core->mem.stat_int) {
+			if ((stat & IO_STAT_MODE) == HBLANK && ly < 143)
+				ppu_lines = 143 - ly;
+			else if ((stat & IO_STAT_MODE) == VBLANK && ly < 153)
+				ppu_lines = 153 - ly;
+		}
+		horizon = EV(SCHEV_PPU).when + (uint64_t)ppu_lines * CYC_LINE;
+	}
+
+	// TIMA
+	uint64_t tima_period = 0;
+	if (EV(SCHEV_TIMA).pos != SCHEV_INACTIVE) {
+		tima_period =
+			CYC_TIMA[gb_mem_direct_read(core, IO_TAC) & IO_TAC_CLOCK_SELECT];
+		if (ie & IO_IFE_TIMER) {
+			uint64_t until_overflow = 0xFF - gb_mem_direct_read(core, IO_TIMA);
+			uint64_t overflow = EV(SCHEV_TIMA).when + until_overflow * tima_period;
+			if (overflow < horizon)
+				horizon = overflow;
 		}
-	} // end iteration through queued events
+	}
+
+	if (horizon == UINT64_MAX || horizon <= SELF.next)
+		return; // Nothing to skip.
+
+	// Skip whole lines, stopping short of the horizon. In mode 0, each
+	// line consists of 3 events, the last of which fires
+	// CYC_PPU[OAM_SCAN] + CYC_PPU[PIXEL_DRAW] cycles after the first.
+	if (ppu_lines) {
+		uint64_t span = 0;
+		if ((gb_mem_direct_read(core, IO_STAT) & IO_STAT_MODE) == HBLANK)
+			span = CYC_PPU[OAM_SCAN] + CYC_PPU[PIXEL_DRAW];
+		uint64_t when = EV(SCHEV_PPU).when;
+		uint64_t lines = (horizon > when + span)
+			? (horizon - when - span - 1) / CYC_LINE + 1
+			: 0;
+		if (lines > ppu_lines)
+			lines = ppu_lines;
+		if (lines) {
+			gb_mem_io_skip_lines(core, lines);
+			schedule_event(core, SCHEV_PPU, when + lines * CYC_LINE);
+		}
+	}
+	gb_mem_io_skip_div(core, skip_periodic(core, SCHEV_DIV, CYC_DIV, horizon));
+	if (tima_period) {
+		gb_mem_io_skip_tima(core,
+				skip_periodic(core, SCHEV_TIMA, tima_period, horizon));
+	}
+} // end fast_forward()
+
+//=======================================================================
+// doc skip_periodic()
+// Reschedules `target`, which fires every `period` cycles, to its first
+// firing at or after `horizon`.
+// Returns the number of firings skipped.
+//=======================================================================
+// def skip_periodic()
+static inline uint64_t
+skip_periodic(
+		struct gb_core* restrict core,
+		enum gb_schev_id target,
+		uint64_t period,
+		uint64_t horizon) {
+	uint64_t when = EV(target).when;
+	if (EV(target).pos == SCHEV_INACTIVE || when >= horizon)
+		return 0;
+	uint64_t skipped = (horizon - when - 1) / period + 1;
+	schedule_event(core, target, when + skipped * period);
+	return skipped;
+} // end skip_periodic()
+
+//=======================================================================
+// doc schedule_event()
+// Schedules `target` to fire at the absolute timestamp `when`.
+// If `target` is already queued, it is moved to its new position.
+//=======================================================================
+// def schedule_event()
+static inline void
+schedule_event(
+		struct gb_core* restrict core,
+		enum gb_schev_id target,
+		uint64_t when) {
+	assert(target < NUM_SCHEVS);
+	uint64_t old_when = EV(target).when;
+	EV(target).when = when;
+	if (EV(target).pos == SCHEV_INACTIVE) {
+		// Append to the end of the heap, then restore ordering.
+		assert(SELF.heap_size < NUM_SCHEVS);
+		heap_place(core, SELF.heap_size++, target);
+		heap_sift_up(core, EV(target).pos);
+	} else if (when < old_when) {
+		heap_sift_up(core, EV(target).pos);
+	} else {
+		heap_sift_down(core, EV(target).pos);
+	}
+	update_next(core);
+} // end schedule_event()
+
+//=======================================================================
+// doc remove_event()
+// Removes `target` from the queue, if it is queued.
+// Its timestamp is left unmodified.
+//=======================================================================
+// def remove_event()
+static inline void
+remove_event(struct gb_core* restrict core, enum gb_schev_id target) {
+	assert(target < NUM_SCHEVS);
+	uint8_t pos = EV(target).pos;
+	if (pos == SCHEV_INACTIVE)
+		return; // Not queued.
+
+	EV(target).pos = SCHEV_INACTIVE;
+	uint8_t last = --SELF.heap_size;
+	if (pos != last) {
+		// Fill the hole with the last event of the heap, then move it
+		// whichever direction is required to restore ordering.
+		uint8_t moved = SELF.heap[last];
+		heap_place(core, pos, moved);
+		heap_sift_up(core, pos);
+		heap_sift_down(core, EV(moved).pos);
+	}
+	update_next(core);
 } // end remove_event()
 
 //=======================================================================
-// doc insert_event()
-// Inserts a pre-prepared event into the list of active events.
-//
-// Before calling this function, the _absolute_ number of cycles
-// before `target` fires (independent of any active events) must
-// be assigned to `target`.until. This function will convert this
-// value to be relative to other active events in the list.
-//
-// Behavior is undefined if `target` is already a member of the list
-// of active events when calling this function.
-//-----------------------------------------------------------------------
-// Parameters:
-// * core
-//   The emulation core which owns the scheduler whose active event
-//   list will be inserted into.
-// * target
-//   The ID of the event to insert.
-//=======================================================================
-// def insert_event()
-static void
-insert_event(struct gb_core* restrict core, enum gb_schev_id target) {
-	// Iterate through the list of active events.
-	// `target` is to be inserted immediately before the first event
-	// in the list that fires after `target` fires.
-	// (The first event whose `until` value > `target`.until)
-	//
-	// For each event that fires before `target`, subtract that
-	// event's remaining cycles before firing from `target`'s remaining
-	// cycles.
-	// TODO: Optimize out `curr` (just use EV(prev).next)
-	enum gb_schev_id prev = SCHEV_HEADER;
-	enum gb_schev_id curr = EV_HEADER.next;
-	while (curr != SCHEV_NONE // SCHEV_NONE indicates end-of-list
-	    && EV(target).until > EV(curr).until) {
-		EV(target).until -= EV(curr).until;
-		prev = curr;
-		curr = EV(curr).next;
+// doc pause_event()
+// Removes `target` from the queue, remembering how many cycles remained
+// before it would have fired, so that resume_event() can continue it
+// from where it left off.
+//=======================================================================
+// def pause_event()
+static inline void
+pause_event(struct gb_core* restrict core, enum gb_schev_id target) {
+	LOGT("begin: core=%p, target=%d", core, target);
+	assert(target < NUM_SCHEVS);
+	if (EV(target).pos == SCHEV_INACTIVE)
+		return; // target event not running
+
+	uint64_t remaining = cycles_until(core, target);
+	remove_event(core, target);
+	EV(target).when = remaining;
+	LOGT("returning: remaining=%" PRIu64, remaining);
+} // end pause_event()
+
+//=======================================================================
+// doc resume_event()
+// Requeues an event previously paused by pause_event().
+//=======================================================================
+// def resume_event()
+static inline void
+resume_event(struct gb_core* restrict core, enum gb_schev_id target) {
+	assert(target < NUM_SCHEVS);
+	if (EV(target).pos != SCHEV_INACTIVE)
+		return; // Already running.
+	schedule_event(core, target, SELF.now + EV(target).when);
+} // end resume_event()
+
+//=======================================================================
+// def cycles_until()
+static inline uint64_t
+cycles_until(const struct gb_core* restrict core, enum gb_schev_id target) {
+	assert(EV(target).pos != SCHEV_INACTIVE);
+	// Events are always executed as soon as `now` reaches them.
+	return (EV(target).when > SELF.now) ? EV(target).when - SELF.now : 0;
+} // end cycles_until()
+
+//=======================================================================
+// def heap_place()
+static inline void
+heap_place(struct gb_core* restrict core, uint8_t pos, uint8_t id) {
+	SELF.heap[pos] = id;
+	EV(id).pos = pos;
+} // end heap_place()
+
+//=======================================================================
+// def heap_sift_up()
+static inline void
+heap_sift_up(struct gb_core* restrict core, uint8_t pos) {
+	uint8_t id = SELF.heap[pos];
+	uint64_t when = EV(id).when;
+	while (pos > 0) {
+		uint8_t parent = (pos - 1) / 2;
+		if (EV(SELF.heap[parent]).when <= when)
+			break;
+		heap_place(core, pos, SELF.heap[parent]);
+		pos = parent;
 	}
+	heap_place(core, pos, id);
+} // end heap_sift_up()
 
-	// Insert `target` between `prev` and `curr`.
-	// Subtract `target`'s cycles-before-firing from `curr`'s
-	// cycles-before-firing.
-	EV(prev).next = target;
-	EV(target).next = curr;
-	if (curr != SCHEV_NONE)
-		EV(curr).until -= EV(target).until;
-} // end insert_event()
+//=======================================================================
+// def heap_sift_down()
+static inline void
+heap_sift_down(struct gb_core* restrict core, uint8_t pos) {
+	uint8_t id = SELF.heap[pos];
+	uint64_t when = EV(id).when;
+	while (1) {
+		uint8_t child = pos * 2 + 1;
+		if (child >= SELF.heap_size)
+			break;
+		// Select the earlier of the two children.
+		if (child + 1 < SELF.heap_size
+		 && EV(SELF.heap[child + 1]).when < EV(SELF.heap[child]).when)
+			child += 1;
+		if (when <= EV(SELF.heap[child]).when)
+			break;
+		heap_place(core, pos, SELF.heap[child]);
+		pos = child;
+	}
+	heap_place(core, pos, id);
+} // end heap_sift_down()
+
+//=======================================================================
+// doc update_next()
+// Recaches the timestamp of the earliest event, and recalculates the
+// CPU's cycle budget from it.
+// `now` must be up-to-date (see sync_now()) before calling this.
+//=======================================================================
+// def update_next()
+static inline void
+update_next(struct gb_core* restrict core) {
+	SELF.next = (SELF.heap_size > 0) ? EV(SELF.heap[0]).when : UINT64_MAX;
+	uint64_t budget = (SELF.next > SELF.now) ? SELF.next - SELF.now : 0;
+	SELF.budget = (budget < INT32_MAX) ? (int32_t)budget : INT32_MAX;
+} // end update_next()
+
+//=======================================================================
+// doc sync_now()
+// Brings `now` up-to-date with the cycles the CPU has consumed from its
+// budget since the budget was last calculated.
+//=======================================================================
+// def sync_now()
+static inline void
+sync_now(struct gb_core* restrict core) {
+	// The DIV event is always queued, so `next` is always finite and
+	// the budget is never clamped.
+	SELF.now = SELF.next - SELF.budget;
+} // end sync_now()
 
 static inline uint8_t
 clock_bit_state(struct gb_core* restrict core, uint8_t tac_clock_speed) {
@@ -303,6 +571,7 @@ clock_bit_state(struct gb_core* restrict core, uint8_t tac_clock_speed) {
 	//
 	// Also note that the emulation ignores the lowest 2 inaccessible DIV
 	// bits for the purposes of scheduling.
+	uint64_t div_until = cycles_until(core, SCHEV_DIV);
 	switch (tac_clock_speed) {
 		case 0: // DIV bit 9 (bit 1 of DIV register)
 			return gb_mem_direct_read(core, IO_DIV) & 0x2;
@@ -313,69 +582,11 @@ clock_bit_state(struct gb_core* restrict core, uint8_t tac_clock_speed) {
 		// The bit chosen is shifted over by 2, as the lowest 2
 		// inaccessible DIV bits are not emulated.
 		case 1: // DIV bit 3
-			return (CYC_DIV - EV(SCHEV_DIV).until) & 0x02;
+			return (CYC_DIV - div_until) & 0x02;
 		case 2: // DIV bit 5
-			return (CYC_DIV - EV(SCHEV_DIV).until) & 0x08;
+			return (CYC_DIV - div_until) & 0x08;
 		case 3: // DIV bit 7
-			return (CYC_DIV - EV(SCHEV_DIV).until) & 0x20;
+			return (CYC_DIV - div_until) & 0x20;
 	} // end switch (tac_clock_speed)
+	return 0;
 } // end clock_bit_state()
-
-//=======================================================================
-// doc pause_event()
-// TODO
-//=======================================================================
-// def pause_event()
-static inline void
-pause_event(struct gb_core* restrict core, enum gb_schev_id target) {
-	LOGT("begin: core=%p, target=%d", core, target);
-	assert(target < NUM_SCHEVS);
-	assert(target != SCHEV_HEADER);
-	if (EV(target).next == SCHEV_DISABLED)
-		return; // target event not running
-
-	// Locate `target` event in the active event queue, and accumulate
-	// the absolute number of cycles before `target` fires.
-	// At the end of this loop, `prev` should be the event BEFORE `target`.
-	int16_t target_abs_until = EV(target).until;
-	enum gb_schev_id prev = SCHEV_HEADER;
-	while (EV(prev).next != SCHEV_NONE && EV(prev).next != target) {
-		LOGT("inside loop: prev=%d, target_abs_util=%" PRId16, prev, target_abs_until);
-		prev = EV(prev).next;
-		target_abs_until += EV(prev).until;
-	}
-	LOGT("after loop: prev=%d, prev.next=%d, target_abs_until=%" PRId16,
-			prev, EV(prev).next, target_abs_until);
-	if (EV(prev).next == SCHEV_NONE) {
-		// Target event not found, but should be running.
-		// This is a programming error.
-		assert(0);
-		return;
-	}
-
-	// Event's position in the queue is known and its cycle
-	// count has been made absolute. Disconnect `target` from the queue.
-	if (EV(target).next != SCHEV_NONE)
-		EV(EV(target).next).until += EV(target).until; // target.next.until += target.until
-	EV(prev).next = EV(target).next; // prev.next = target.next
-	EV(target).next = SCHEV_DISABLED;
-	EV(target).until = target_abs_until;
-	LOGT("returning");
-} // end pause_event()
-
-//static inline enum gb_schev_index
-//find_prev_event(
-//		struct gb_core* restrict core,
-//		enum gb_schev_index target_event) {
-//	if (core->sch.next == target_event)
-//		return SCHEV_NONE; // Front event, has no previous event.
-//
-//	enum gb_schev_index current_event = core->sch.next;
-//	while (current_event != SCHEV_NONE) {
-//		if (core->sch.ev[current_event].next == target_event)
-//			return current_event;
-//		event =
-//	} // end iteration through core->sch.ev
-//	return SCHEV_NONE; // Event is not queued, has no previous event.
-//} // end find_prior_event()
-
@@ -0,0 +1,108 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/video.h"
+#include "gb/video/mem.h"
+
+enum {
+	// Blank frames are black, as on the SDL sink.
+	BLANK_COLOR = 0xFF000000
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static uint32_t*
+start_drawing(struct gb_video* restrict vid);
+static int
+finish_drawing(struct gb_video* restrict vid);
+static int
+draw_clear(struct gb_video* restrict vid);
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input);
+static void
+destroy(struct gb_video* restrict vid);
+
+static const struct gb_video_ops mem_ops = {
+	.start_drawing = start_drawing,
+	.finish_drawing = finish_drawing,
+	.draw_clear = draw_clear,
+	// `pixels` still holds the last frame.
+	.repeat_frame = finish_drawing,
+	.poll = poll_input,
+	.destroy = destroy
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_video_mem_init()
+void
+gb_video_mem_init(
+		struct gb_video_mem* restrict vid,
+		gb_video_mem_fn on_frame,
+		void* user) {
+	assert(vid != NULL);
+	vid->base.ops = &mem_ops;
+	vid->on_frame = on_frame;
+	vid->user = user;
+	vid->frames = 0;
+	vid->stop = 0;
+	for (size_t i = 0; i < PPU_SCR_WIDTH * PPU_SCR_HEIGHT; ++i)
+		vid->pixels[i] = BLANK_COLOR;
+} // end gb_video_mem_init()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def start_drawing()
+static uint32_t*
+start_drawing(struct gb_video* restrict vid) {
+	return ((struct gb_video_mem*)vid)->pixels;
+} // end start_drawing()
+
+//=======================================================================
+// def finish_drawing()
+static int
+finish_drawing(struct gb_video* restrict vid) {
+	struct gb_video_mem* mem = (struct gb_video_mem*)vid;
+	++mem->frames;
+	if (mem->on_frame != NULL && mem->on_frame(mem->user, mem->pixels))
+		mem->stop = 1;
+	return 0;
+} // end finish_drawing()
+
+//=======================================================================
+// def draw_clear()
+static int
+draw_clear(struct gb_video* restrict vid) {
+	struct gb_video_mem* mem = (struct gb_video_mem*)vid;
+	for (size_t i = 0; i < PPU_SCR_WIDTH * PPU_SCR_HEIGHT; ++i)
+		mem->pixels[i] = BLANK_COLOR;
+	return finish_drawing(vid);
+} // end draw_clear()
+
+//=======================================================================
+// def poll_input()
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input) {
+	input->fast_forward = 1;
+	return ((const struct gb_video_mem*)vid)->stop;
+} // end poll_input()
+
+//=======================================================================
+// def destroy()
+static void
+destroy(struct gb_video* restrict vid) {
+	(void)vid; // Pixels belong to the caller.
+} // end destroy()
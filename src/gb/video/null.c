@@ -0,0 +1,81 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gb/video.h"
+#include "gb/video/null.h"
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static uint32_t*
+start_drawing(struct gb_video* restrict vid);
+static int
+finish_drawing(struct gb_video* restrict vid);
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input);
+static void
+destroy(struct gb_video* restrict vid);
+
+static const struct gb_video_ops null_ops = {
+	.start_drawing = start_drawing,
+	.finish_drawing = finish_drawing,
+	.draw_clear = finish_drawing,
+	.repeat_frame = finish_drawing,
+	.poll = poll_input,
+	.destroy = destroy
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// External function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_video_null_init()
+void
+gb_video_null_init(struct gb_video_null* restrict vid, uint64_t frame_limit) {
+	assert(vid != NULL);
+	vid->base.ops = &null_ops;
+	vid->frames = 0;
+	vid->frame_limit = frame_limit;
+} // end gb_video_null_init()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def start_drawing()
+static uint32_t*
+start_drawing(struct gb_video* restrict vid) {
+	return ((struct gb_video_null*)vid)->pixels;
+} // end start_drawing()
+
+//=======================================================================
+// def finish_drawing()
+static int
+finish_drawing(struct gb_video* restrict vid) {
+	++((struct gb_video_null*)vid)->frames;
+	return 0;
+} // end finish_drawing()
+
+//=======================================================================
+// def poll_input()
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input) {
+	const struct gb_video_null* null = (const struct gb_video_null*)vid;
+	input->fast_forward = 1;
+	return null->frame_limit != 0 && null->frames >= null->frame_limit;
+} // end poll_input()
+
+//=======================================================================
+// def destroy()
+static void
+destroy(struct gb_video* restrict vid) {
+	(void)vid; // Owns no resources.
+} // end destroy()
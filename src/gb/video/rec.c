@@ -0,0 +1,465 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <threads.h>
+#define GB_LOG_MAX_LEVEL LVL_INF
+#include "gb/log.h"
+#include "gb/video.h"
+#include "gb/video/rec.h"
+
+enum {
+	PIXELS = PPU_SCR_WIDTH * PPU_SCR_HEIGHT,
+	// Blank frames are black, as on the SDL sink.
+	BLANK_COLOR = 0xFF000000,
+};
+
+// A frame every 70224 cycles of the 4194304 Hz clock (~59.73 Hz).
+static const char Y4M_HEADER[] =
+	"YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C444\n";
+static const char Y4M_FRAME[] = "FRAME\n";
+static const char Y4M_REPEAT[] = "FRAME XREPEAT\n";
+static const uint8_t RAW_FRAME = 'F';
+static const uint8_t RAW_REPEAT = 'R';
+static_assert(PPU_SCR_WIDTH == 160 && PPU_SCR_HEIGHT == 144);
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DECLARATIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+static uint32_t*
+start_drawing(struct gb_video* restrict vid);
+static int
+finish_drawing(struct gb_video* restrict vid);
+static int
+draw_clear(struct gb_video* restrict vid);
+static int
+repeat_frame(struct gb_video* restrict vid);
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input);
+static void
+destroy(struct gb_video* restrict vid);
+
+static void
+emit_frame(struct gb_video_rec* restrict rec, const uint32_t* restrict pixels);
+static void
+emit_repeat(struct gb_video_rec* restrict rec);
+static uint8_t*
+acquire_slot(struct gb_video_rec* restrict rec);
+static void
+publish_slot(struct gb_video_rec* restrict rec, size_t len);
+static size_t
+convert_y4m(uint8_t* restrict dst, const uint32_t* restrict pixels);
+static void
+flush_slots(struct gb_video_rec* restrict rec);
+static int
+write_slots(struct gb_video_rec* restrict rec, uint64_t begin, uint64_t end);
+static int
+write_all(int fd, struct iovec* restrict iov, int iovcnt);
+static int
+writer_main(void* arg);
+
+static const struct gb_video_ops rec_ops = {
+	.start_drawing = start_drawing,
+	.finish_drawing = finish_drawing,
+	.draw_clear = draw_clear,
+	.repeat_frame = repeat_frame,
+	.poll = poll_input,
+	.destroy = destroy
+};
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// EXTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def gb_video_rec_init()
+int
+gb_video_rec_init(
+		struct gb_video_rec* restrict vid,
+		const struct gb_video_rec_params* restrict params) {
+	assert(vid != NULL);
+	assert(params != NULL);
+	unsigned count = params->slots ? params->slots : GB_VIDEO_REC_DEFAULT_SLOTS;
+	if (count < 2 || count > GB_VIDEO_REC_MAX_SLOTS) {
+		LOGE("Invalid recording slot count: %u.", count);
+		return 1;
+	}
+	vid->base.ops = &rec_ops;
+	vid->fd = params->fd;
+	vid->format = params->format;
+	vid->dedup = params->dedup;
+	vid->frame_limit = params->frame_limit;
+	vid->frames = 0;
+	vid->repeats = 0;
+	vid->stalls = 0;
+	atomic_init(&(vid->failed), 0);
+	vid->cur = 0;
+	for (size_t i = 0; i < PIXELS; ++i)
+		vid->frame[1][i] = BLANK_COLOR;
+	vid->count = count;
+	if (vid->format == GB_VIDEO_REC_Y4M)
+		vid->slot_size = sizeof(Y4M_REPEAT) - 1 + PIXELS * 3;
+	else
+		vid->slot_size = sizeof(RAW_FRAME) + PIXELS * sizeof(uint32_t);
+	atomic_init(&(vid->published), 0);
+	atomic_init(&(vid->written), 0);
+	atomic_init(&(vid->closing), 0);
+	vid->threaded = params->threaded;
+
+	vid->data = malloc(vid->slot_size * count);
+	vid->lens = malloc(sizeof(*(vid->lens)) * count);
+	if (vid->data == NULL || vid->lens == NULL) {
+		LOGE("Unable to allocate %u recording slots.", count);
+		goto free_slots;
+	}
+	if (vid->format == GB_VIDEO_REC_Y4M) {
+		struct iovec header = {
+			.iov_base = (void*)Y4M_HEADER,
+			.iov_len = sizeof(Y4M_HEADER) - 1
+		};
+		if (write_all(vid->fd, &header, 1))
+			goto free_slots;
+	}
+	if (mtx_init(&(vid->lock), mtx_plain) != thrd_success)
+		goto free_slots;
+	if (cnd_init(&(vid->ready)) != thrd_success)
+		goto destroy_lock;
+	if (cnd_init(&(vid->space)) != thrd_success)
+		goto destroy_ready;
+	if (vid->threaded && thrd_create(&(vid->writer), writer_main, vid) != thrd_success) {
+		LOGE("Unable to start recording writer thread.");
+		goto destroy_space;
+	}
+	return 0;
+
+destroy_space:
+	cnd_destroy(&(vid->space));
+destroy_ready:
+	cnd_destroy(&(vid->ready));
+destroy_lock:
+	mtx_destroy(&(vid->lock));
+free_slots:
+	free(vid->lens);
+	free(vid->data);
+	return 1;
+} // end gb_video_rec_init()
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// INTERNAL FUNCTION DEFINITIONS
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def start_drawing()
+static uint32_t*
+start_drawing(struct gb_video* restrict vid) {
+	struct gb_video_rec* rec = (struct gb_video_rec*)vid;
+	return rec->frame[rec->cur];
+} // end start_drawing()
+
+//=======================================================================
+// def finish_drawing()
+static int
+finish_drawing(struct gb_video* restrict vid) {
+	struct gb_video_rec* rec = (struct gb_video_rec*)vid;
+	++rec->frames;
+	const uint32_t* drawn = rec->frame[rec->cur];
+	if (rec->dedup && rec->frames > 1
+			&& !memcmp(drawn, rec->frame[rec->cur ^ 1], sizeof(rec->frame[0]))) {
+		emit_repeat(rec);
+		return 0;
+	}
+	emit_frame(rec, drawn);
+	rec->cur ^= 1;
+	return 0;
+} // end finish_drawing()
+
+//=======================================================================
+// def draw_clear()
+static int
+draw_clear(struct gb_video* restrict vid) {
+	struct gb_video_rec* rec = (struct gb_video_rec*)vid;
+	for (size_t i = 0; i < PIXELS; ++i)
+		rec->frame[rec->cur][i] = BLANK_COLOR;
+	return finish_drawing(vid);
+} // end draw_clear()
+
+//=======================================================================
+// def repeat_frame()
+static int
+repeat_frame(struct gb_video* restrict vid) {
+	struct gb_video_rec* rec = (struct gb_video_rec*)vid;
+	++rec->frames;
+	if (rec->dedup && rec->frames > 1)
+		emit_repeat(rec);
+	else
+		emit_frame(rec, rec->frame[rec->cur ^ 1]);
+	return 0;
+} // end repeat_frame()
+
+//=======================================================================
+// def poll_input()
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input) {
+	const struct gb_video_rec* rec = (const struct gb_video_rec*)vid;
+	input->fast_forward = 1;
+	if (atomic_load_explicit(&(rec->failed), memory_order_relaxed))
+		return 1;
+	return rec->frame_limit && rec->frames >= rec->frame_limit;
+} // end poll_input()
+
+//=======================================================================
+// def destroy()
+static void
+destroy(struct gb_video* restrict vid) {
+	struct gb_video_rec* rec = (struct gb_video_rec*)vid;
+	if (rec->threaded) {
+		mtx_lock(&(rec->lock));
+		atomic_store(&(rec->closing), 1);
+		cnd_signal(&(rec->ready));
+		mtx_unlock(&(rec->lock));
+		thrd_join(rec->writer, NULL);
+	} else {
+		flush_slots(rec);
+	}
+	LOGI("Recorded %llu frames (%llu repeats); waited on the writer %llu times.",
+			(unsigned long long)rec->frames, (unsigned long long)rec->repeats,
+			(unsigned long long)rec->stalls);
+	cnd_destroy(&(rec->space));
+	cnd_destroy(&(rec->ready));
+	mtx_destroy(&(rec->lock));
+	free(rec->lens);
+	free(rec->data);
+} // end destroy()
+
+//=======================================================================
+// doc emit_frame()
+// Converts `pixels` into the next slot.
+//=======================================================================
+// def emit_frame()
+static void
+emit_frame(struct gb_video_rec* restrict rec, const uint32_t* restrict pixels) {
+	uint8_t* dst = acquire_slot(rec);
+	size_t len;
+	if (rec->format == GB_VIDEO_REC_Y4M) {
+		len = sizeof(Y4M_FRAME) - 1;
+		memcpy(dst, Y4M_FRAME, len);
+		len += convert_y4m(dst + len, pixels);
+	} else {
+		len = 0;
+		if (rec->dedup)
+			dst[len++] = RAW_FRAME;
+		// Pixels are already RGBA in memory order (as SDL_PIXELFORMAT_RGBA32).
+		memcpy(dst + len, pixels, PIXELS * sizeof(uint32_t));
+		len += PIXELS * sizeof(uint32_t);
+	}
+	publish_slot(rec, len);
+} // end emit_frame()
+
+//=======================================================================
+// def emit_repeat()
+static void
+emit_repeat(struct gb_video_rec* restrict rec) {
+	++rec->repeats;
+	uint8_t* dst = acquire_slot(rec);
+	if (rec->format == GB_VIDEO_REC_Y4M) {
+		memcpy(dst, Y4M_REPEAT, sizeof(Y4M_REPEAT) - 1);
+		publish_slot(rec, sizeof(Y4M_REPEAT) - 1);
+	} else {
+		*dst = RAW_REPEAT;
+		publish_slot(rec, sizeof(RAW_REPEAT));
+	}
+} // end emit_repeat()
+
+//=======================================================================
+// doc acquire_slot()
+// Returns the slot to convert the next frame into, writing or waiting
+// for the writer thread to write older ones if the ring is full.
+//=======================================================================
+// def acquire_slot()
+static uint8_t*
+acquire_slot(struct gb_video_rec* restrict rec) {
+	// Only this thread writes `published`.
+	uint_fast64_t published =
+		atomic_load_explicit(&(rec->published), memory_order_relaxed);
+	// Acquires the writer's finished reads of written slots.
+	if (published - atomic_load_explicit(&(rec->written), memory_order_acquire)
+			>= rec->count) {
+		if (rec->threaded) {
+			++rec->stalls;
+			mtx_lock(&(rec->lock));
+			cnd_signal(&(rec->ready));
+			while (published - atomic_load(&(rec->written)) >= rec->count)
+				cnd_wait(&(rec->space), &(rec->lock));
+			mtx_unlock(&(rec->lock));
+		} else {
+			flush_slots(rec);
+		}
+	}
+	return rec->data + (published % rec->count) * rec->slot_size;
+} // end acquire_slot()
+
+//=======================================================================
+// doc publish_slot()
+// Passes the slot returned by acquire_slot(), now holding `len` bytes,
+// to the writer.
+//=======================================================================
+// def publish_slot()
+static void
+publish_slot(struct gb_video_rec* restrict rec, size_t len) {
+	uint_fast64_t published =
+		atomic_load_explicit(&(rec->published), memory_order_relaxed);
+	rec->lens[published % rec->count] = len;
+	atomic_store_explicit(&(rec->published), ++published, memory_order_release);
+	if (!rec->threaded)
+		return;
+	if (published - atomic_load_explicit(&(rec->written), memory_order_relaxed)
+			>= GB_VIDEO_REC_BATCH) {
+		// Signalled under the lock, so a writer which has just found too
+		// few slots pending cannot miss it.
+		mtx_lock(&(rec->lock));
+		cnd_signal(&(rec->ready));
+		mtx_unlock(&(rec->lock));
+	}
+} // end publish_slot()
+
+//=======================================================================
+// doc convert_y4m()
+// Converts `pixels` (RGBA in memory order) into Y, Cb, then Cr planes
+// with BT.601 limited-range coefficients. Returns the bytes written.
+//=======================================================================
+// def convert_y4m()
+static size_t
+convert_y4m(uint8_t* restrict dst, const uint32_t* restrict pixels) {
+	uint8_t* y = dst;
+	uint8_t* cb = y + PIXELS;
+	uint8_t* cr = cb + PIXELS;
+	// Frames hold few distinct colors, mostly in runs, so the last
+	// conversion is kept.
+	uint32_t last = 0;
+	uint8_t last_y = 16, last_cb = 128, last_cr = 128; // Transparent black
+	for (size_t i = 0; i < PIXELS; ++i) {
+		if (pixels[i] != last) {
+			last = pixels[i];
+			const uint8_t* rgba = (const uint8_t*)&(pixels[i]);
+			int r = rgba[0], g = rgba[1], b = rgba[2];
+			last_y = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			last_cb = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			last_cr = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+		y[i] = last_y;
+		cb[i] = last_cb;
+		cr[i] = last_cr;
+	}
+	return PIXELS * 3;
+} // end convert_y4m()
+
+//=======================================================================
+// doc flush_slots()
+// (Without a writer thread) Writes every pending slot.
+//=======================================================================
+// def flush_slots()
+static void
+flush_slots(struct gb_video_rec* restrict rec) {
+	uint64_t published = atomic_load(&(rec->published));
+	uint64_t written = atomic_load(&(rec->written));
+	if (published != written && !atomic_load(&(rec->failed))
+			&& write_slots(rec, written, published))
+		atomic_store(&(rec->failed), 1);
+	atomic_store(&(rec->written), published);
+} // end flush_slots()
+
+//=======================================================================
+// doc write_slots()
+// Writes slots [begin, end) with as few writev() calls as possible.
+// Returns nonzero on failure.
+//=======================================================================
+// def write_slots()
+static int
+write_slots(struct gb_video_rec* restrict rec, uint64_t begin, uint64_t end) {
+	assert(end - begin <= rec->count);
+	struct iovec iov[GB_VIDEO_REC_MAX_SLOTS];
+	int iovcnt = 0;
+	for (uint64_t n = begin; n != end; ++n) {
+		iov[iovcnt].iov_base = rec->data + (n % rec->count) * rec->slot_size;
+		iov[iovcnt].iov_len = rec->lens[n % rec->count];
+		++iovcnt;
+	}
+	return write_all(rec->fd, iov, iovcnt);
+} // end write_slots()
+
+//=======================================================================
+// doc write_all()
+// Writes every byte of `iov`, resuming after partial writes and
+// interruptions. Returns nonzero on failure.
+//=======================================================================
+// def write_all()
+static int
+write_all(int fd, struct iovec* restrict iov, int iovcnt) {
+	while (iovcnt > 0) {
+		ssize_t n = writev(fd, iov, iovcnt);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			LOGE("Unable to write recording: %s.", strerror(errno));
+			return 1;
+		}
+		// Skip what was written.
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			++iov;
+			--iovcnt;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t*)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+} // end write_all()
+
+//=======================================================================
+// doc writer_main()
+// Writes slots in batches of at least GB_VIDEO_REC_BATCH (or a full
+// ring, if smaller) until closed, then writes what is left.
+//=======================================================================
+// def writer_main()
+static int
+writer_main(void* arg) {
+	struct gb_video_rec* rec = arg;
+	unsigned batch = rec->count < GB_VIDEO_REC_BATCH ? rec->count : GB_VIDEO_REC_BATCH;
+	while (1) {
+		uint_fast64_t written =
+			atomic_load_explicit(&(rec->written), memory_order_relaxed);
+		uint_fast64_t published;
+		mtx_lock(&(rec->lock));
+		while ((published = atomic_load_explicit(&(rec->published),
+				memory_order_acquire)) - written < batch
+				&& !atomic_load(&(rec->closing)))
+			cnd_wait(&(rec->ready), &(rec->lock));
+		int closing = atomic_load(&(rec->closing));
+		mtx_unlock(&(rec->lock));
+
+		if (published != written) {
+			if (!atomic_load(&(rec->failed)) && write_slots(rec, written, published))
+				atomic_store(&(rec->failed), 1);
+			mtx_lock(&(rec->lock));
+			// Releases the slots, once read, to the drawing thread.
+			atomic_store_explicit(&(rec->written), published, memory_order_release);
+			cnd_signal(&(rec->space));
+			mtx_unlock(&(rec->lock));
+		}
+		// Closed only after the last frame is published.
+		if (closing && published == atomic_load(&(rec->published)))
+			return 0;
+	}
+} // end writer_main()
@@ -1,8 +1,45 @@
 #include <SDL.h>
 #define GB_LOG_MAX_LEVEL LVL_TRC
 #include "gb/log.h"
+#include "gb/pad.h"
+#include "gb/video.h"
 #include "gb/video/sdl.h"
 
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function declarations
+//-----------------------------------------------------------------------
+//=======================================================================
+static uint32_t*
+start_drawing(struct gb_video* restrict vid);
+static int
+finish_drawing(struct gb_video* restrict vid);
+static int
+draw_clear(struct gb_video* restrict vid);
+static int
+repeat_frame(struct gb_video* restrict vid);
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input);
+static void
+destroy(struct gb_video* restrict vid);
+static int
+create_texture(struct gb_video_sdl* restrict vid);
+static int
+handle_event(SDL_Event* restrict event, struct gb_video_input* restrict input);
+static void
+handle_keydown(const SDL_KeyboardEvent* restrict kevent, struct gb_video_input* restrict input);
+static void
+handle_keyup(const SDL_KeyboardEvent* restrict kevent, struct gb_video_input* restrict input);
+
+static const struct gb_video_ops sdl_ops = {
+	.start_drawing = start_drawing,
+	.finish_drawing = finish_drawing,
+	.draw_clear = draw_clear,
+	.repeat_frame = repeat_frame,
+	.poll = poll_input,
+	.destroy = destroy
+};
+
 void log_sdl_error(const char* restrict funcname) {
 	LOGE("%s(): %s", funcname, SDL_GetError());
 } // end log_sdl_error()
@@ -14,10 +51,11 @@ int gb_video_sdl_init(
 		const struct gb_video_sdl_params* restrict params) {
 	//-------------------------------------------------------
 	// Initialize video subsystem
-	if (SDL_InitSubSystem(SDL_INIT_VIDEO)) {
+	if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_EVENTS)) {
 		log_sdl_error("SDL_InitSubSystem");
 		return 1;
 	}
+	vid->base.ops = &sdl_ops;
 
 	//-------------------------------------------------------
 	// Create window with caller-requested size and title.
@@ -55,18 +93,17 @@ int gb_video_sdl_init(
 	//-------------------------------------------------------
 	// Create a single texture that will be used to buffer drawing
 	// pixels to the renderer's backbuffer.
-	vid->texture = SDL_CreateTexture(
-			vid->renderer, SDL_PIXELFORMAT_RGBA32,
-			SDL_TEXTUREACCESS_STREAMING, // texture will be updated constantly
-			params->output.width, params->output.height);
-	if (vid->texture == NULL) {
-		log_sdl_error("SDL_CreateTexture");
+	vid->width = params->output.width;
+	vid->height = params->output.height;
+	if (create_texture(vid))
 		goto destroy_renderer;
-	}
 
 	//-------------------------------------------------------
 	// Now that the window has been prepared, make it visible.
 	SDL_ShowWindow(vid->window);
+	vid->blank = 1;
+	vid->redraw = 0;
+	vid->lost = 0;
 	return 0;
 	//-------------------------------------------------------
 	// Cleanup on failure:
@@ -75,7 +112,7 @@ destroy_renderer:
 destroy_window:
 	SDL_DestroyWindow(vid->window);
 quit_subsystem:
-	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
 	return 1;
 } // end gb_video_sdl_init()
 
@@ -86,7 +123,7 @@ gb_video_sdl_destroy(struct gb_video_sdl* restrict vid) {
 	SDL_DestroyTexture(vid->texture);
 	SDL_DestroyRenderer(vid->renderer);
 	SDL_DestroyWindow(vid->window);
-	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
 } // end gb_video_sdl_destroy()
 
 //=======================================================================
@@ -96,6 +133,12 @@ gb_video_sdl_start_drawing(struct gb_video_sdl* restrict vid, int* pitch) {
 	int throwaway_pitch;
 	if (pitch == NULL)
 		pitch = &throwaway_pitch;
+	if (vid->lost) { // The render device was reset.
+		SDL_DestroyTexture(vid->texture);
+		if (create_texture(vid))
+			return NULL;
+		vid->lost = 0;
+	}
 
 	void* pixels;
 	if (SDL_LockTexture(vid->texture, NULL, &pixels, pitch)) {
@@ -119,6 +162,8 @@ gb_video_sdl_finish_drawing(struct gb_video_sdl* restrict vid) {
 		return 1;
 	}
 	SDL_RenderPresent(vid->renderer);
+	vid->blank = 0;
+	vid->redraw = 0;
 	return 0;
 } // end gb_video_sdl_finish_drawing()
 
@@ -131,6 +176,206 @@ gb_video_sdl_draw_clear(struct gb_video_sdl* restrict vid) {
 		return 1;
 	}
 	SDL_RenderPresent(vid->renderer);
+	vid->blank = 1;
+	vid->redraw = 0;
 	return 0;
 } // end gb_video_sdl_draw_clear()
 
+//=======================================================================
+// doc gb_video_sdl_repeat_frame()
+// The window keeps showing the last frame presented, so it is only
+// presented again if the window's contents may have been lost. The
+// texture still holds the last frame drawn, unless the render device
+// was reset, in which case GB_VIDEO_REDRAW asks for the frame itself.
+//=======================================================================
+// def gb_video_sdl_repeat_frame()
+int
+gb_video_sdl_repeat_frame(struct gb_video_sdl* restrict vid) {
+	if (!vid->redraw)
+		return 0;
+	if (vid->lost && !vid->blank)
+		return GB_VIDEO_REDRAW;
+	if (SDL_RenderClear(vid->renderer)) {
+		log_sdl_error("SDL_RenderClear");
+		return 1;
+	}
+	if (!vid->blank && SDL_RenderCopy(vid->renderer, vid->texture, NULL, NULL)) {
+		log_sdl_error("SDL_RenderCopy");
+		return 1;
+	}
+	SDL_RenderPresent(vid->renderer);
+	vid->redraw = 0;
+	return 0;
+} // end gb_video_sdl_repeat_frame()
+
+
+//=======================================================================
+//-----------------------------------------------------------------------
+// Internal function definitions
+//-----------------------------------------------------------------------
+//=======================================================================
+
+//=======================================================================
+// def start_drawing()
+static uint32_t*
+start_drawing(struct gb_video* restrict vid) {
+	return gb_video_sdl_start_drawing((struct gb_video_sdl*)vid, NULL);
+} // end start_drawing()
+
+//=======================================================================
+// def finish_drawing()
+static int
+finish_drawing(struct gb_video* restrict vid) {
+	return gb_video_sdl_finish_drawing((struct gb_video_sdl*)vid);
+} // end finish_drawing()
+
+//=======================================================================
+// def draw_clear()
+static int
+draw_clear(struct gb_video* restrict vid) {
+	return gb_video_sdl_draw_clear((struct gb_video_sdl*)vid);
+} // end draw_clear()
+
+//=======================================================================
+// def repeat_frame()
+static int
+repeat_frame(struct gb_video* restrict vid) {
+	return gb_video_sdl_repeat_frame((struct gb_video_sdl*)vid);
+} // end repeat_frame()
+
+//=======================================================================
+// def poll_input()
+static int
+poll_input(struct gb_video* restrict vid, struct gb_video_input* restrict input) {
+	struct gb_video_sdl* sdl = (struct gb_video_sdl*)vid;
+	SDL_Event event;
+	while (SDL_PollEvent(&event)) {
+		if (event.type == SDL_WINDOWEVENT &&
+				(event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+				 event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED))
+			sdl->redraw = 1;
+		else if (event.type == SDL_RENDER_TARGETS_RESET)
+			sdl->redraw = 1;
+		else if (event.type == SDL_RENDER_DEVICE_RESET)
+			sdl->redraw = sdl->lost = 1;
+		if (handle_event(&event, input))
+			return 1;
+	}
+	return 0;
+} // end poll_input()
+
+//=======================================================================
+// def destroy()
+static void
+destroy(struct gb_video* restrict vid) {
+	gb_video_sdl_destroy((struct gb_video_sdl*)vid);
+} // end destroy()
+
+//=======================================================================
+// doc create_texture()
+// Creates the texture which frames are drawn into, of the sink's output
+// size. Returns nonzero on failure.
+//=======================================================================
+// def create_texture()
+static int
+create_texture(struct gb_video_sdl* restrict vid) {
+	vid->texture = SDL_CreateTexture(
+			vid->renderer, SDL_PIXELFORMAT_RGBA32,
+			SDL_TEXTUREACCESS_STREAMING, // texture will be updated constantly
+			vid->width, vid->height);
+	if (vid->texture == NULL) {
+		log_sdl_error("SDL_CreateTexture");
+		return 1;
+	}
+	return 0;
+} // end create_texture()
+
+//=======================================================================
+// def handle_event()
+static int
+handle_event(SDL_Event* restrict event, struct gb_video_input* restrict input) {
+	switch(event->type) {
+		case SDL_KEYDOWN:
+			handle_keydown(&(event->key), input);
+			break;
+		case SDL_KEYUP:
+			handle_keyup(&(event->key), input);
+			break;
+		case SDL_WINDOWEVENT:
+			if (event->window.event == SDL_WINDOWEVENT_CLOSE)
+				return 1;
+			break;
+	}
+	return 0;
+} // end handle_event()
+
+//=======================================================================
+// def handle_keydown()
+static void
+handle_keydown(const SDL_KeyboardEvent* restrict kevent, struct gb_video_input* restrict input) {
+	switch (kevent->keysym.sym) {
+		case SDLK_f:
+			input->fast_forward = 1;
+			break;
+		case SDLK_RIGHT:
+			input->pad = gb_pad_press(input->pad, GBPAD_RIGHT);
+			break;
+		case SDLK_LEFT:
+			input->pad = gb_pad_press(input->pad, GBPAD_LEFT);
+			break;
+		case SDLK_UP:
+			input->pad = gb_pad_press(input->pad, GBPAD_UP);
+			break;
+		case SDLK_DOWN:
+			input->pad = gb_pad_press(input->pad, GBPAD_DOWN);
+			break;
+		case SDLK_z:
+			input->pad = gb_pad_press(input->pad, GBPAD_A);
+			break;
+		case SDLK_x:
+			input->pad = gb_pad_press(input->pad, GBPAD_B);
+			break;
+		case SDLK_RSHIFT:
+			input->pad = gb_pad_press(input->pad, GBPAD_SELECT);
+			break;
+		case SDLK_RETURN:
+			input->pad = gb_pad_press(input->pad, GBPAD_START);
+			break;
+	} // end switch()
+} // end handle_keydown()
+
+//=======================================================================
+// def handle_keyup()
+static void
+handle_keyup(const SDL_KeyboardEvent* restrict kevent, struct gb_video_input* restrict input) {
+	switch (kevent->keysym.sym) {
+		case SDLK_f:
+			input->fast_forward = 0;
+			break;
+		case SDLK_RIGHT:
+			input->pad = gb_pad_release(input->pad, GBPAD_RIGHT);
+			break;
+		case SDLK_LEFT:
+			input->pad = gb_pad_release(input->pad, GBPAD_LEFT);
+			break;
+		case SDLK_UP:
+			input->pad = gb_pad_release(input->pad, GBPAD_UP);
+			break;
+		case SDLK_DOWN:
+			input->pad = gb_pad_release(input->pad, GBPAD_DOWN);
+			break;
+		case SDLK_z:
+			input->pad = gb_pad_release(input->pad, GBPAD_A);
+			break;
+		case SDLK_x:
+			input->pad = gb_pad_release(input->pad, GBPAD_B);
+			break;
+		case SDLK_RSHIFT:
+			input->pad = gb_pad_release(input->pad, GBPAD_SELECT);
+			break;
+		case SDLK_RETURN:
+			input->pad = gb_pad_release(input->pad, GBPAD_START);
+			break;
+	} // end switch()
+} // end handle_keyup()
+
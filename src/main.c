@@ -1,38 +1,180 @@
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <SDL.h>
 #include "gb/core.h"
 #include "gb/core/typedef.h"
 #include "gb/mem.h"
 #include "gb/ppu.h"
+#include "gb/ppu/buf.h"
+#include "gb/ppu/hashlog.h"
+#include "gb/ppu/pool.h"
+#include "gb/ppu/shared.h"
+#include "gb/video.h"
+#include "gb/video/null.h"
+#include "gb/video/rec.h"
+#include "gb/video/sdl.h"
 
 static void
 print_usage();
 
 int main(int argc, char* argv[]) {
-	if (argc < 2) {
-		// ROM filepath not provided.
+	// Without a display, `--headless` discards frames, and stops after
+	// the given number of them (0 = never).
+	// `--render-threads` draws lines on that many PPU workers besides
+	// the drawing thread (see gb/ppu/pool.h).
+	// `--pipeline` emulates on its own thread, handing frames off to
+	// the main thread through that many buffers (0 = off; see
+	// gb/ppu/buf.h).
+	// `--record` records frames to a file ("-" = standard output) rather
+	// than displaying them, stopping after `--headless` frames, if given.
+	// `--record-format` is "y4m" (default) or "raw"; nonzero
+	// `--record-dedup` writes repeated frames as markers, and nonzero
+	// `--record-writer` writes from a background thread (see
+	// gb/video/rec.h).
+	// `--hash-log` logs a hash of each frame drawn to a file (see
+	// gb/ppu/hashlog.h).
+	int headless = 0;
+	unsigned long long headless_frames = 0;
+	unsigned render_threads = 0;
+	unsigned pipeline_buffers = 0;
+	const char* record_path = NULL;
+	const char* hash_log_path = NULL;
+	struct gb_video_rec_params record = {.format = GB_VIDEO_REC_Y4M};
+	int bad_args = (argc < 2);
+	for (int i = 2; i < argc && !bad_args; i += 2) {
+		if (i + 1 >= argc) {
+			bad_args = 1;
+		} else if (!strcmp(argv[i], "--headless")) {
+			headless = 1;
+			headless_frames = strtoull(argv[i + 1], NULL, 0);
+		} else if (!strcmp(argv[i], "--render-threads")) {
+			render_threads = (unsigned)strtoul(argv[i + 1], NULL, 0);
+		} else if (!strcmp(argv[i], "--pipeline")) {
+			pipeline_buffers = (unsigned)strtoul(argv[i + 1], NULL, 0);
+			bad_args = pipeline_buffers == 1 || pipeline_buffers > PPU_MAX_BUFFERS;
+		} else if (!strcmp(argv[i], "--hash-log")) {
+			hash_log_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--record")) {
+			record_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--record-format")) {
+			if (!strcmp(argv[i + 1], "y4m"))
+				record.format = GB_VIDEO_REC_Y4M;
+			else if (!strcmp(argv[i + 1], "raw"))
+				record.format = GB_VIDEO_REC_RAW;
+			else
+				bad_args = 1;
+		} else if (!strcmp(argv[i], "--record-dedup")) {
+			record.dedup = strtoul(argv[i + 1], NULL, 0) != 0;
+		} else if (!strcmp(argv[i], "--record-writer")) {
+			record.threaded = strtoul(argv[i + 1], NULL, 0) != 0;
+		} else {
+			bad_args = 1;
+		}
+	}
+	if (bad_args) {
 		print_usage(argc >= 1 ? argv[0] : "unknown");
 		return 1;
 	}
 
+	static struct gb_video_sdl sdl;
+	static struct gb_video_null null;
+	static struct gb_video_rec rec;
+	struct gb_video* video;
+	if (record_path != NULL) {
+		if (!strcmp(record_path, "-")) {
+			record.fd = STDOUT_FILENO;
+		} else if ((record.fd = open(record_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+			perror(record_path);
+			return 1;
+		}
+		// Report a closed pipe as a write failure, rather than dying of it.
+		signal(SIGPIPE, SIG_IGN);
+		record.frame_limit = headless_frames;
+		headless = 1;
+		if (gb_video_rec_init(&rec, &record)) {
+			if (record.fd != STDOUT_FILENO)
+				close(record.fd);
+			return 1;
+		}
+		video = &rec.base;
+	} else if (headless) {
+		gb_video_null_init(&null, headless_frames);
+		video = &null.base;
+	} else {
+		struct gb_video_sdl_params params = {
+			.window_title="Game Boy",
+			.window = { .width = PPU_SCR_WIDTH * 3, .height = PPU_SCR_HEIGHT * 3 },
+			.output = { .width = PPU_SCR_WIDTH, .height = PPU_SCR_HEIGHT }
+		};
+		if (gb_video_sdl_init(&sdl, &params))
+			return 1;
+		video = &sdl.base;
+	}
+
+	int status = 1;
 	struct gb_ppu ppu;
-	if (gb_ppu_init(&ppu))
-		return 1;
+	if (gb_ppu_init(&ppu, video))
+		goto destroy_video;
+	struct gb_ppu_buf* buf = NULL;
+	if (pipeline_buffers && (buf = gb_ppu_buf_create(pipeline_buffers, video)) == NULL)
+		goto destroy_ppu;
+	static struct gb_ppu_pool pool;
+	if (render_threads) {
+		if (gb_ppu_pool_init(&pool, render_threads))
+			goto destroy_buf;
+		ppu.pool = &pool;
+		for (unsigned i = 0; buf != NULL && i < buf->count; ++i)
+			buf->slots[i].pool = &pool;
+	}
+	static struct gb_ppu_hashlog hashes;
+	if (hash_log_path != NULL) {
+		if (gb_ppu_hashlog_open(&hashes, hash_log_path))
+			goto destroy_pool;
+		ppu.hashes = &hashes;
+		for (unsigned i = 0; buf != NULL && i < buf->count; ++i)
+			buf->slots[i].hashes = &hashes;
+	}
 
 	struct gb_core core;
 	gb_mem_rom_filepath = argv[1];
-	if (gb_core_init(&core)) {
-		gb_ppu_destroy(&ppu);
-		return 1;
-	}
-	gb_core_run(&core, &ppu);
+	if (gb_core_init(&core))
+		goto close_hashes;
+	if (buf != NULL)
+		gb_core_run_pipelined(&core, buf);
+	else
+		gb_core_run(&core, &ppu);
+	gb_core_destroy(&core);
+	status = 0;
 
-	SDL_Quit();
-	return 0;
+close_hashes:
+	if (ppu.hashes != NULL && gb_ppu_hashlog_close(ppu.hashes))
+		status = 1;
+destroy_pool:
+	if (ppu.pool != NULL)
+		gb_ppu_pool_destroy(ppu.pool);
+destroy_buf:
+	if (buf != NULL)
+		gb_ppu_buf_destroy(buf);
+destroy_ppu:
+	gb_ppu_destroy(&ppu);
+destroy_video:
+	gb_video_destroy(video);
+	if (record_path != NULL && record.fd != STDOUT_FILENO)
+		close(record.fd);
+	if (!headless)
+		SDL_Quit();
+	return status;
 }
 
 static void
 print_usage(const char* restrict program_name) {
-	printf("Usage:\n\t%s <ROM-filepath>\n", program_name);
+	printf("Usage:\n\t%s <ROM-filepath> [--headless <frames>]"
+			" [--render-threads <threads>] [--pipeline <buffers>]"
+			" [--record <file>] [--record-format <y4m|raw>]"
+			" [--record-dedup <0|1>] [--record-writer <0|1>]"
+			" [--hash-log <file>]\n", program_name);
 } // end print_usage()
-
@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 //=======================================================================
 //-----------------------------------------------------------------------
@@ -68,6 +70,39 @@ prx_io_fpload(
 	return size;
 } // end prx_io_fpload()
 
+//=======================================================================
+// def prx_io_fmap()
+// Maps the first `size` bytes of `file` read-only and copy-on-write,
+// so that every process mapping the same file shares the page cache.
+// Returns NULL if `file` is not a regular file of at least `size`
+// bytes, or cannot be mapped; callers should then load it instead.
+void*
+prx_io_fmap(size_t size, FILE* restrict file) {
+	assert(file != NULL);
+
+	int fd = fileno(file);
+	struct stat st;
+	if (size == 0 || fd < 0 || fstat(fd, &st))
+		return NULL;
+	if (!S_ISREG(st.st_mode) || (size_t)st.st_size < size)
+		return NULL; // Pages past end-of-file would fault on access.
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+	// Start reading the file in the background, rather than faulting
+	// it in a page at a time as it is first accessed.
+	madvise(map, size, MADV_WILLNEED);
+	return map;
+} // end prx_io_fmap()
+
+//=======================================================================
+// def prx_io_funmap()
+void
+prx_io_funmap(void* map, size_t size) {
+	if (map != NULL)
+		munmap(map, size);
+} // end prx_io_funmap()
+
 //=======================================================================
 // def prx_io_fp_has_extension()
 //int
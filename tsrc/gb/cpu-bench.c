@@ -0,0 +1,75 @@
+//=======================================================================
+// Headless CPU interpreter benchmark.
+// Runs a ROM for a fixed number of frames without video or input, then
+// reports the interpreter's throughput in millions of emulated
+// instructions per second (MIPS).
+//
+// Built once per dispatch method and once with the JIT (see
+// `make cpu-bench`), so that each can be compared on the same host and
+// ROM.
+//=======================================================================
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/interpreter.h"
+#include "gb/mem.h"
+#include "gb/sch.h"
+
+#ifndef GB_CPU_COUNT_INSTRUCTIONS
+#error "cpu-bench requires GB_CPU_COUNT_INSTRUCTIONS to be defined."
+#endif
+
+#ifdef GB_CPU_DISPATCH_SWITCH
+#define DISPATCH_NAME "switch"
+#else
+#define DISPATCH_NAME "threaded"
+#endif
+#ifdef GB_CPU_JIT
+#define JIT_NAME "+jit"
+#else
+#define JIT_NAME ""
+#endif
+
+enum { DEFAULT_FRAMES = 3600 }; // 1 minute of emulated time
+
+static double
+elapsed_seconds(
+		const struct timespec* restrict begin,
+		const struct timespec* restrict end) {
+	return (double)(end->tv_sec - begin->tv_sec)
+		+ (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+} // end elapsed_seconds()
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printf("Usage:\n\t%s <ROM-filepath> [frames]\n",
+				argc >= 1 ? argv[0] : "cpu-bench");
+		return 1;
+	}
+	unsigned long frames = (argc >= 3) ? strtoul(argv[2], NULL, 0) : DEFAULT_FRAMES;
+
+	static struct gb_core core;
+	gb_mem_rom_filepath = argv[1];
+	gb_cpu_init(&core);
+	if (gb_mem_init(&core))
+		return 1;
+	gb_sch_init(&core);
+	core.cpu.instructions = 0;
+
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	for (unsigned long f = 0; f < frames; ++f)
+		gb_cpu_interpret_frame(&core);
+	timespec_get(&end, TIME_UTC);
+
+	double seconds = elapsed_seconds(&begin, &end);
+	printf("dispatch=%s%s frames=%lu instructions=%" PRIu64
+			" seconds=%.3f mips=%.2f\n",
+			DISPATCH_NAME, JIT_NAME, frames, core.cpu.instructions, seconds,
+			(double)core.cpu.instructions / seconds / 1e6);
+	return 0;
+} // end main()
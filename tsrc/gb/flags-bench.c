@@ -0,0 +1,130 @@
+//=======================================================================
+// Flag evaluation microbenchmark.
+// Runs a synthetic ROM whose main loop consists almost entirely of
+// flag-setting ALU instructions, most of whose flags are overwritten
+// before anything reads them, and reports the interpreter's throughput
+// in millions of emulated instructions per second (MIPS).
+//
+// Built once with eager and once with lazy flag evaluation (see
+// `make flags-bench`), so that both can be compared on the same host.
+//=======================================================================
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/interpreter.h"
+#include "gb/mem.h"
+#include "gb/sch.h"
+
+#ifndef GB_CPU_COUNT_INSTRUCTIONS
+#error "flags-bench requires GB_CPU_COUNT_INSTRUCTIONS to be defined."
+#endif
+
+#ifdef GB_CPU_LAZY_FLAGS
+#define FLAGS_NAME "lazy"
+#else
+#define FLAGS_NAME "eager"
+#endif
+
+enum { DEFAULT_FRAMES = 3600 }; // 1 minute of emulated time
+enum { ROM_SIZE = 0x8000 };
+
+// The ROM enables the VBlank interrupt (whose handler simply returns),
+// then loops forever.
+static const uint8_t rom_vblank[] = {
+	0xD9                    // 0x0040: RETI
+};
+static const uint8_t rom_entry[] = {
+	0x00,                   // 0x0100: NOP
+	0xC3, 0x50, 0x01        //         JP $0150
+};
+static const uint8_t rom_main[] = {
+	0x3E, 0x01,             // 0x0150: LD A, $01
+	0xE0, 0xFF,             //         LDH [IE], A
+	0xFB,                   //         EI
+	// LOOP:
+	0x80,                   //         ADD A, B
+	0xA9,                   //         XOR C
+	0x92,                   //         SUB D
+	0xA3,                   //         AND E
+	0xB4,                   //         OR H
+	0x8D,                   //         ADC A, L
+	0xB8,                   //         CP B
+	0x0C,                   //         INC C
+	0x87,                   //         ADD A, A
+	0x9B,                   //         SBC A, E
+	0xC6, 0x37,             //         ADD A, $37
+	0xAA,                   //         XOR D
+	0xD6, 0x11,             //         SUB $11
+	0xB9,                   //         CP C
+	0x15,                   //         DEC D
+	0x20, 0xED,             //         JR NZ, LOOP
+	0x18, 0xEB              //         JR LOOP
+};
+
+static double
+elapsed_seconds(
+		const struct timespec* restrict begin,
+		const struct timespec* restrict end) {
+	return (double)(end->tv_sec - begin->tv_sec)
+		+ (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+} // end elapsed_seconds()
+
+// Writes the synthetic ROM to a temporary file, whose path is written
+// to `path`. Returns nonzero on failure.
+static int
+write_rom(char* restrict path) {
+	static uint8_t rom[ROM_SIZE];
+	memcpy(rom + 0x0040, rom_vblank, sizeof(rom_vblank));
+	memcpy(rom + 0x0100, rom_entry, sizeof(rom_entry));
+	memcpy(rom + 0x0150, rom_main, sizeof(rom_main));
+
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return 1;
+	FILE* file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+		return 1;
+	}
+	size_t written = fwrite(rom, 1, sizeof(rom), file);
+	return fclose(file) || written != sizeof(rom);
+} // end write_rom()
+
+int main(int argc, char* argv[]) {
+	unsigned long frames = (argc >= 2) ? strtoul(argv[1], NULL, 0) : DEFAULT_FRAMES;
+
+	char path[] = "/tmp/flags-bench-XXXXXX";
+	if (write_rom(path)) {
+		perror("Failed to write synthetic ROM");
+		return 1;
+	}
+
+	static struct gb_core core;
+	gb_mem_rom_filepath = path;
+	gb_cpu_init(&core);
+	uint8_t failed = gb_mem_init(&core);
+	remove(path);
+	if (failed)
+		return 1;
+	gb_sch_init(&core);
+	core.cpu.instructions = 0;
+
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	for (unsigned long f = 0; f < frames; ++f)
+		gb_cpu_interpret_frame(&core);
+	timespec_get(&end, TIME_UTC);
+
+	double seconds = elapsed_seconds(&begin, &end);
+	printf("flags=%s frames=%lu instructions=%" PRIu64
+			" seconds=%.3f mips=%.2f\n",
+			FLAGS_NAME, frames, core.cpu.instructions, seconds,
+			(double)core.cpu.instructions / seconds / 1e6);
+	return 0;
+} // end main()
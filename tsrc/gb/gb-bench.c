@@ -0,0 +1,288 @@
+//=======================================================================
+// Headless emulator benchmark.
+// Runs a ROM for a fixed number of frames as fast as possible, through
+// the CPU, scheduler, and PPU, presenting frames to the null video sink
+// (see gb/video/null.h). Optionally replays scripted pad input.
+//
+// Reports throughput and, if built with GB_PROFILE, the time spent in
+// each phase of emulation (see gb/prof.h), as JSON with one value per
+// line, so that results can be diffed across commits. Cycles are those
+// counted by the scheduler (1 MiHz machine cycles).
+//
+// Usage:
+//     ./gb-bench [-c] [-f frames] [-i input-script] [-r threads] <ROM-filepath>
+// With -c, PPU state is handed off through a copied snapshot, as it
+// would be to a PPU on another thread, rather than viewed in place.
+// With -r, lines are drawn concurrently by that many PPU workers
+// besides the main thread (see gb/ppu/pool.h). Phase times then include
+// the workers' drawing, and may add up to more than the elapsed time.
+//
+// An input script holds one pad state per line, as a frame number and
+// the buttons held from that frame onward, joined with '+', or "none":
+//     # frame buttons
+//     60      start
+//     64      none
+//     200     a+right
+// Frame numbers must ascend. Lines starting with '#' are ignored.
+//=======================================================================
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gb/core/typedef.h"
+#include "gb/cpu.h"
+#include "gb/cpu/interpreter.h"
+#include "gb/mem.h"
+#include "gb/pad.h"
+#include "gb/ppu.h"
+#include "gb/ppu/pool.h"
+#include "gb/prof.h"
+#include "gb/sch.h"
+#include "gb/video/null.h"
+
+#ifndef GB_CPU_COUNT_INSTRUCTIONS
+#error "gb-bench requires GB_CPU_COUNT_INSTRUCTIONS to be defined."
+#endif
+
+#ifdef GB_CPU_DISPATCH_SWITCH
+#define DISPATCH_NAME "switch"
+#else
+#define DISPATCH_NAME "threaded"
+#endif
+#ifdef GB_CPU_JIT
+#define JIT_NAME "on"
+#else
+#define JIT_NAME "off"
+#endif
+#ifdef GB_CPU_LAZY_FLAGS
+#define FLAGS_NAME "lazy"
+#else
+#define FLAGS_NAME "eager"
+#endif
+
+enum { DEFAULT_FRAMES = 3600 }; // 1 minute of emulated time
+enum { MAX_SCRIPT_LINE = 256 };
+
+//=======================================================================
+// doc struct pad_event
+// Pad state held from frame `frame` until the next event.
+//=======================================================================
+struct pad_event {
+	unsigned long frame;
+	uint8_t pad;
+}; // end struct pad_event
+
+static const struct {
+	const char* name;
+	uint8_t input;
+} button_names[] = {
+	{ "right", GBPAD_RIGHT }, { "left", GBPAD_LEFT },
+	{ "up", GBPAD_UP }, { "down", GBPAD_DOWN },
+	{ "a", GBPAD_A }, { "b", GBPAD_B },
+	{ "select", GBPAD_SELECT }, { "start", GBPAD_START }
+};
+
+static double
+elapsed_seconds(
+		const struct timespec* restrict begin,
+		const struct timespec* restrict end) {
+	return (double)(end->tv_sec - begin->tv_sec)
+		+ (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+} // end elapsed_seconds()
+
+// Returns the emulated cycle count, which is only kept in `now` while
+// the scheduler is running (see `struct gb_sch`).
+static uint64_t
+emulated_cycles(const struct gb_core* restrict core) {
+	return (uint64_t)((int64_t)core->sch.next - core->sch.budget);
+} // end emulated_cycles()
+
+// Parses a '+'-separated list of button names into a pad state.
+// Returns nonzero if a name is not recognized.
+static int
+parse_buttons(uint8_t* restrict pad, char* restrict list) {
+	*pad = gb_pad_init();
+	if (!strcmp(list, "none"))
+		return 0;
+	for (char* name = strtok(list, "+"); name; name = strtok(NULL, "+")) {
+		size_t i = 0;
+		while (i < sizeof(button_names) / sizeof(button_names[0])
+				&& strcmp(name, button_names[i].name))
+			++i;
+		if (i == sizeof(button_names) / sizeof(button_names[0]))
+			return 1;
+		*pad = gb_pad_press(*pad, button_names[i].input);
+	}
+	return 0;
+} // end parse_buttons()
+
+// Loads the input script at `path` into a newly-allocated array, whose
+// length is written to `count`. Returns NULL on failure.
+static struct pad_event*
+load_script(const char* restrict path, size_t* restrict count) {
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return NULL;
+	}
+	struct pad_event* events = NULL;
+	size_t capacity = 0;
+	*count = 0;
+	char line[MAX_SCRIPT_LINE];
+	for (unsigned long line_num = 1; fgets(line, sizeof(line), file); ++line_num) {
+		unsigned long frame;
+		char buttons[MAX_SCRIPT_LINE];
+		if (line[0] == '#' || sscanf(line, "%lu %s", &frame, buttons) < 1)
+			continue; // Comment or blank line.
+		struct pad_event event = { .frame = frame };
+		if (sscanf(line, "%lu %s", &frame, buttons) != 2
+				|| parse_buttons(&event.pad, buttons)
+				|| (*count && frame < events[*count - 1].frame)) {
+			fprintf(stderr, "%s:%lu: Invalid pad event.\n", path, line_num);
+			goto fail;
+		}
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			struct pad_event* grown = realloc(events, capacity * sizeof(*events));
+			if (grown == NULL)
+				goto fail;
+			events = grown;
+		}
+		events[(*count)++] = event;
+	}
+	fclose(file);
+	return events;
+fail:
+	free(events);
+	fclose(file);
+	return NULL;
+} // end load_script()
+
+int main(int argc, char* argv[]) {
+	unsigned long frames = DEFAULT_FRAMES;
+	const char* script_path = NULL;
+	uint8_t copy_state = 0;
+	unsigned render_threads = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "cf:i:r:")) != -1) {
+		switch (opt) {
+			case 'c': copy_state = 1; break;
+			case 'f': frames = strtoul(optarg, NULL, 0); break;
+			case 'i': script_path = optarg; break;
+			case 'r': render_threads = (unsigned)strtoul(optarg, NULL, 0); break;
+			default: optind = argc + 1; break;
+		}
+	}
+	if (optind != argc - 1) {
+		printf("Usage:\n\t%s [-c] [-f frames] [-i input-script] [-r threads]"
+				" <ROM-filepath>\n",
+				argc >= 1 ? argv[0] : "gb-bench");
+		return 1;
+	}
+	const char* rom_path = argv[optind];
+
+	size_t script_len = 0;
+	struct pad_event* script = NULL;
+	if (script_path != NULL && (script = load_script(script_path, &script_len)) == NULL)
+		return 1;
+
+	static struct gb_video_null video;
+	gb_video_null_init(&video, 0);
+	struct gb_ppu ppu;
+	if (gb_ppu_init(&ppu, &video.base))
+		return 1;
+	static struct gb_ppu_pool pool;
+	if (render_threads) {
+		if (gb_ppu_pool_init(&pool, render_threads))
+			return 1;
+		render_threads = pool.count;
+		ppu.pool = &pool;
+	}
+	static struct gb_core core;
+	gb_mem_rom_filepath = rom_path;
+	gb_cpu_init(&core);
+	if (gb_mem_init(&core))
+		return 1;
+	gb_sch_init(&core);
+	core.cpu.instructions = 0;
+	uint64_t first_cycle = emulated_cycles(&core);
+
+	uint8_t pad = gb_pad_init();
+	size_t next_event = 0;
+#ifdef GB_PROFILE
+	uint64_t frame_ns = 0;
+	for (int i = 0; i < GB_PROF_PHASE_COUNT; ++i)
+		atomic_store_explicit(&gb_prof_ns[i], 0, memory_order_relaxed);
+#endif
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	for (unsigned long f = 0; f < frames; ++f) {
+		for (; next_event < script_len && script[next_event].frame <= f; ++next_event) {
+			if (script[next_event].pad != pad)
+				gb_mem_set_pad(&core, pad = script[next_event].pad);
+		}
+		GB_PROF_BEGIN(prof_frame);
+		gb_cpu_interpret_frame(&core);
+#ifdef GB_PROFILE
+		frame_ns += gb_prof_now() - prof_frame;
+#endif
+		GB_PROF_BEGIN(prof_copy);
+		if (copy_state)
+			gb_mem_copy_ppu_state(&core, &ppu.state);
+		else
+			gb_mem_view_ppu_state(&core, &ppu.state);
+		GB_PROF_END(GB_PROF_PPU_ENCODE, prof_copy);
+		if (gb_dmg_draw(&ppu))
+			return 1;
+	}
+	timespec_get(&end, TIME_UTC);
+
+	double seconds = elapsed_seconds(&begin, &end);
+	uint64_t cycles = emulated_cycles(&core) - first_cycle;
+	printf("{\n");
+	printf("  \"rom\": \"%s\",\n", rom_path);
+	printf("  \"dispatch\": \"%s\",\n", DISPATCH_NAME);
+	printf("  \"jit\": \"%s\",\n", JIT_NAME);
+	printf("  \"flags\": \"%s\",\n", FLAGS_NAME);
+	printf("  \"ppu_state\": \"%s\",\n", copy_state ? "copy" : "view");
+	printf("  \"render_threads\": %u,\n", render_threads);
+	printf("  \"input_events\": %zu,\n", script_len);
+	printf("  \"frames\": %lu,\n", frames);
+	printf("  \"cycles\": %" PRIu64 ",\n", cycles);
+	printf("  \"instructions\": %" PRIu64 ",\n", core.cpu.instructions);
+	printf("  \"seconds\": %.6f,\n", seconds);
+	printf("  \"frames_per_sec\": %.2f,\n", (double)frames / seconds);
+	printf("  \"cycles_per_sec\": %.0f,\n", (double)cycles / seconds);
+	printf("  \"instructions_per_sec\": %.0f,\n",
+			(double)core.cpu.instructions / seconds);
+#ifdef GB_PROFILE
+	// The scheduler runs from within the interpreter.
+	gb_prof_ns[GB_PROF_CPU] = frame_ns - gb_prof_ns[GB_PROF_SCH];
+	static const char* phase_names[GB_PROF_PHASE_COUNT] = {
+		[GB_PROF_CPU] = "cpu",
+		[GB_PROF_SCH] = "scheduler",
+		[GB_PROF_PPU_ENCODE] = "ppu_encode",
+		[GB_PROF_PALETTE] = "palette_resolve",
+		[GB_PROF_PRESENT] = "present"
+	};
+	printf("  \"phase_seconds\": {\n");
+	for (int i = 0; i < GB_PROF_PHASE_COUNT; ++i) {
+		printf("    \"%s\": %.6f%s\n", phase_names[i], (double)gb_prof_ns[i] / 1e9,
+				i + 1 < GB_PROF_PHASE_COUNT ? "," : "");
+	}
+	printf("  }\n");
+#else
+	printf("  \"phase_seconds\": null\n");
+#endif
+	printf("}\n");
+
+	gb_mem_destroy(&core);
+	if (ppu.pool != NULL)
+		gb_ppu_pool_destroy(ppu.pool);
+	gb_ppu_destroy(&ppu);
+	free(script);
+	return 0;
+} // end main()
@@ -0,0 +1,167 @@
+//=======================================================================
+// PPU kernel microbenchmark.
+// Runs every version of each PPU kernel which the host supports (see
+// gb/ppu/kernel.h) over the same random input, checks that each one's
+// output matches the scalar version's, and reports the time per call
+// and speedup over the scalar version, one version per line.
+//
+// Decode calls each decode a tile; resolve calls each resolve a line.
+// Exits nonzero if any version's output differs.
+//
+// Usage: ./ppu-kernel-bench [iterations]
+//=======================================================================
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gb/ppu/kernel.h"
+#include "gb/ppu/shared.h"
+#include "gb/ppu/state.h"
+
+enum { DEFAULT_ITERATIONS = 200 };
+// Lines of random encoded pixels, resolved in turn.
+enum { LINES = 64 };
+
+struct decode_version {
+	const char* name;
+	gb_ppu_decode_tile_fn* fn;
+	int supported;
+};
+
+struct resolve_version {
+	const char* name;
+	gb_ppu_resolve_dmg_fn* fn;
+	int supported;
+};
+
+static double
+elapsed_seconds(
+		const struct timespec* restrict begin,
+		const struct timespec* restrict end) {
+	return (double)(end->tv_sec - begin->tv_sec)
+		+ (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+} // end elapsed_seconds()
+
+// Returns a random, valid encoded DMG pixel: BG, or OBJ of either
+// palette, with or without priority.
+static uint8_t
+random_dmg_pixel(void) {
+	unsigned r = (unsigned)rand();
+	uint8_t enc = (r & 3) | ((r >> 2) & 1 ? PPU_ENC_PRIORITY : 0);
+	if ((r >> 3) & 1)
+		return enc | PPU_ENC_PALETTE_BG;
+	return enc | (((r >> 4) & 1) << PPU_ENC_COLOR_SZ);
+} // end random_dmg_pixel()
+
+static double
+time_decode(
+		gb_ppu_decode_tile_fn* fn,
+		struct gb_ppu_tile* restrict tiles,
+		const uint8_t* restrict data,
+		unsigned long iterations) {
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	for (unsigned long i = 0; i < iterations; ++i) {
+		for (int t = 0; t < PPU_TILE_COUNT; ++t)
+			fn(&tiles[t], data + t * PPU_TILE_SIZE);
+	}
+	timespec_get(&end, TIME_UTC);
+	return elapsed_seconds(&begin, &end) / ((double)iterations * PPU_TILE_COUNT);
+} // end time_decode()
+
+static double
+time_resolve(
+		gb_ppu_resolve_dmg_fn* fn,
+		uint32_t (*restrict dst)[PPU_SCR_WIDTH],
+		const uint8_t (*restrict enc)[PPU_SCR_WIDTH],
+		const uint32_t colors[GB_PPU_DMG_COLORS],
+		unsigned long iterations) {
+	struct timespec begin, end;
+	timespec_get(&begin, TIME_UTC);
+	for (unsigned long i = 0; i < iterations * PPU_SCR_HEIGHT / LINES; ++i) {
+		for (int l = 0; l < LINES; ++l)
+			fn(dst[l], enc[l], colors);
+	}
+	timespec_get(&end, TIME_UTC);
+	return elapsed_seconds(&begin, &end)
+		/ ((double)(iterations * PPU_SCR_HEIGHT / LINES) * LINES);
+} // end time_resolve()
+
+int main(int argc, char* argv[]) {
+	unsigned long iterations =
+		(argc >= 2) ? strtoul(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+	if (iterations == 0)
+		iterations = 1;
+
+	struct decode_version decoders[] = {
+		{ "scalar", gb_ppu_decode_tile_scalar, 1 },
+#ifdef GB_PPU_KERNELS_X86
+		{ "sse2", gb_ppu_decode_tile_sse2, __builtin_cpu_supports("sse2") },
+#endif
+	};
+	struct resolve_version resolvers[] = {
+		{ "scalar", gb_ppu_resolve_dmg_scalar, 1 },
+#ifdef GB_PPU_KERNELS_X86
+		{ "ssse3", gb_ppu_resolve_dmg_ssse3, __builtin_cpu_supports("ssse3") },
+		{ "avx2", gb_ppu_resolve_dmg_avx2, __builtin_cpu_supports("avx2") },
+#endif
+	};
+
+	srand(1);
+	static uint8_t data[PPU_TILE_COUNT * PPU_TILE_SIZE];
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (uint8_t)rand();
+	static uint8_t enc[LINES][PPU_SCR_WIDTH];
+	for (int l = 0; l < LINES; ++l) {
+		for (int x = 0; x < PPU_SCR_WIDTH; ++x)
+			enc[l][x] = random_dmg_pixel();
+	}
+	uint32_t colors[GB_PPU_DMG_COLORS];
+	for (int c = 0; c < GB_PPU_DMG_COLORS; ++c)
+		colors[c] = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+
+	static struct gb_ppu_tile expected_tiles[PPU_TILE_COUNT];
+	static struct gb_ppu_tile tiles[PPU_TILE_COUNT];
+	static uint32_t expected_pixels[LINES][PPU_SCR_WIDTH];
+	static uint32_t pixels[LINES][PPU_SCR_WIDTH];
+	for (int t = 0; t < PPU_TILE_COUNT; ++t)
+		gb_ppu_decode_tile_scalar(&expected_tiles[t], data + t * PPU_TILE_SIZE);
+	for (int l = 0; l < LINES; ++l)
+		gb_ppu_resolve_dmg_scalar(expected_pixels[l], enc[l], colors);
+
+	int mismatches = 0;
+	double scalar_seconds = 0;
+	for (size_t v = 0; v < sizeof(decoders) / sizeof(decoders[0]); ++v) {
+		if (!decoders[v].supported) {
+			printf("kernel=decode version=%s supported=no\n", decoders[v].name);
+			continue;
+		}
+		memset(tiles, 0, sizeof(tiles));
+		double seconds = time_decode(decoders[v].fn, tiles, data, iterations);
+		int match = !memcmp(tiles, expected_tiles, sizeof(tiles));
+		mismatches += !match;
+		if (v == 0)
+			scalar_seconds = seconds;
+		printf("kernel=decode version=%s match=%s ns_per_tile=%.2f speedup=%.2f\n",
+				decoders[v].name, match ? "yes" : "NO", seconds * 1e9,
+				scalar_seconds / seconds);
+	}
+	for (size_t v = 0; v < sizeof(resolvers) / sizeof(resolvers[0]); ++v) {
+		if (!resolvers[v].supported) {
+			printf("kernel=resolve version=%s supported=no\n", resolvers[v].name);
+			continue;
+		}
+		memset(pixels, 0, sizeof(pixels));
+		double seconds = time_resolve(resolvers[v].fn, pixels,
+				(const uint8_t (*)[PPU_SCR_WIDTH])enc, colors, iterations);
+		int match = !memcmp(pixels, expected_pixels, sizeof(pixels));
+		mismatches += !match;
+		if (v == 0)
+			scalar_seconds = seconds;
+		printf("kernel=resolve version=%s match=%s ns_per_line=%.2f speedup=%.2f\n",
+				resolvers[v].name, match ? "yes" : "NO", seconds * 1e9,
+				scalar_seconds / seconds);
+	}
+	return mismatches != 0;
+} // end main()
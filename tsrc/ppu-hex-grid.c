@@ -88,17 +88,34 @@ main() {
 
 static void
 test_bg_hex() {
+	struct gb_video_sdl vid;
+	struct gb_video_sdl_params params = {
+		.window_title = "BG hex test",
+		.window = { .width = PPU_SCR_WIDTH * 3, .height = PPU_SCR_HEIGHT * 3 },
+		.output = { .width = PPU_SCR_WIDTH, .height = PPU_SCR_HEIGHT }
+	};
+	if (gb_video_sdl_init(&vid, &params))
+		return;
 	struct gb_ppu ppu;
-	if (gb_ppu_init(&ppu))
+	if (gb_ppu_init(&ppu, &vid.base)) {
+		gb_video_sdl_destroy(&vid);
 		return;
+	}
 
 	ppu.state.mode = GBMODE_DMG;
 	ppu.state.lcdc =
 		IO_LCDC_PPU_ENABLED |
 		IO_LCDC_BG_ENABLED |
 		IO_LCDC_BG_TILEDATA;
-	ppu.state.scy = ppu.state.scx = 0;
-	ppu.state.palette = (uint8_t*)0xE4E4E4;
+	for (uint_fast8_t i = 0; i < PPU_SCR_HEIGHT; ++i) {
+		ppu.state.lines[i] = (struct gb_ppu_line){
+			.lcdc = ppu.state.lcdc,
+			.palettes = {
+				.generation = 1,
+				.bgp = 0xE4, .obp0 = 0xE4, .obp1 = 0xE4
+			}
+		};
+	}
 	uint_fast16_t tile_data_size = 0x1000;
 	uint8_t value = 0x00;
 	for (uint_fast16_t i = 0; i < tile_data_size; i += VRAM_TILE_SIZE)
@@ -111,6 +128,8 @@ test_bg_hex() {
 //		ppu.state.vram[i] = value++;
 	gb_dmg_draw(&ppu);
 	fgetc(stdin);
+	gb_ppu_destroy(&ppu);
+	gb_video_sdl_destroy(&vid);
 } // end test_bg_hex()
 
 static void